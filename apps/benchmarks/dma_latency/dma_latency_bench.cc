@@ -0,0 +1,217 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Latency of a mix of small and large Domain::copy operations kept in
+//  flight together, the case where small copies used to wait behind
+//  large ones in the DMA queue.  Every copy is issued with no
+//  precondition and its completion is detected by polling its event,
+//  so the latency is from the copy call to the event triggering.
+//  Reports the p50, p99 and maximum latency for each size class.
+//  Builds against the shared low-level runtime by default; pass
+//  SHARED_LOWLEVEL=0 to build against the general one, which has the
+//  size-aware DMA queues (see -ll:dmasmall and -ll:dma).
+//
+// Usage: dma_latency_bench [-n <copies>] [-s <small KB>] [-l <large MB>]
+//                          [-p <percent large>] [-w <copies in flight>]
+
+#include "lowlevel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include <sched.h>
+
+using namespace LegionRuntime::LowLevel;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE,
+};
+
+struct BenchArgs {
+  int num_copies;
+  size_t small_bytes;
+  size_t large_bytes;
+  int large_percent;
+  int window;
+};
+
+struct CopyPair {
+  Domain domain;
+  RegionInstance src, dst;
+};
+
+struct PendingCopy {
+  Event done;
+  bool large;
+  double start;
+};
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static bool make_pair(Memory src_mem, Memory dst_mem, size_t bytes,
+                      CopyPair &pair)
+{
+  // copies of doubles, one field per instance
+  size_t elements = bytes / sizeof(double);
+  ElementMask mask(elements);
+  mask.enable(0, elements);
+  pair.domain = Domain(IndexSpace::create_index_space(mask));
+  pair.src = pair.domain.create_instance(src_mem, sizeof(double));
+  pair.dst = pair.domain.create_instance(dst_mem, sizeof(double));
+  return pair.src.exists() && pair.dst.exists();
+}
+
+static void report(const char *name, size_t bytes, std::vector<double> &lat)
+{
+  if (lat.empty())
+    return;
+  std::sort(lat.begin(), lat.end());
+  printf("%8s %12zd %8zd %12.1f %12.1f %12.1f\n", name, bytes, lat.size(),
+         lat[lat.size() / 2] * 1e6, lat[(lat.size() * 99) / 100] * 1e6,
+         lat.back() * 1e6);
+}
+
+static void top_level_task(const void *args, size_t arglen, Processor p)
+{
+  const BenchArgs *bench = (const BenchArgs*)args;
+  Machine *machine = Machine::get_machine();
+  // copy between the two largest memories, or within the largest one
+  //  if it is the only one big enough
+  Memory src_mem = Memory::NO_MEMORY, dst_mem = Memory::NO_MEMORY;
+  const std::set<Memory> &mems = machine->get_all_memories();
+  for (std::set<Memory>::const_iterator it = mems.begin();
+        it != mems.end(); it++)
+  {
+    size_t size = machine->get_memory_size(*it);
+    if (!src_mem.exists() || (size > machine->get_memory_size(src_mem)))
+    {
+      dst_mem = src_mem;
+      src_mem = *it;
+    }
+    else if (!dst_mem.exists() || (size > machine->get_memory_size(dst_mem)))
+      dst_mem = *it;
+  }
+  size_t needed = 2 * (bench->small_bytes + bench->large_bytes);
+  if (!dst_mem.exists() || (machine->get_memory_size(dst_mem) < needed))
+    dst_mem = src_mem;
+
+  CopyPair small_pair, large_pair;
+  if (!make_pair(src_mem, dst_mem, bench->small_bytes, small_pair) ||
+      !make_pair(src_mem, dst_mem, bench->large_bytes, large_pair))
+  {
+    printf("ERROR: unable to create instances, try a larger -ll:csize\n");
+    machine->shutdown();
+    return;
+  }
+  std::vector<Domain::CopySrcDstField> small_src(1), small_dst(1);
+  small_src[0] = Domain::CopySrcDstField(small_pair.src, 0, sizeof(double));
+  small_dst[0] = Domain::CopySrcDstField(small_pair.dst, 0, sizeof(double));
+  std::vector<Domain::CopySrcDstField> large_src(1), large_dst(1);
+  large_src[0] = Domain::CopySrcDstField(large_pair.src, 0, sizeof(double));
+  large_dst[0] = Domain::CopySrcDstField(large_pair.dst, 0, sizeof(double));
+
+  std::vector<double> small_lat, large_lat;
+  std::vector<PendingCopy> pending;
+  int issued = 0;
+  srand(12345);
+  double start = now_in_seconds();
+  while ((issued < bench->num_copies) || !pending.empty())
+  {
+    // keep the window full
+    while ((issued < bench->num_copies) &&
+           ((int)pending.size() < bench->window))
+    {
+      PendingCopy copy;
+      copy.large = ((rand() % 100) < bench->large_percent);
+      copy.start = now_in_seconds();
+      if (copy.large)
+        copy.done = large_pair.domain.copy(large_src, large_dst);
+      else
+        copy.done = small_pair.domain.copy(small_src, small_dst);
+      pending.push_back(copy);
+      issued++;
+    }
+    // retire anything that has finished, giving up the core between
+    //  polls so the DMA threads can run when cores are scarce
+    sched_yield();
+    for (unsigned idx = 0; idx < pending.size(); )
+    {
+      if (!pending[idx].done.has_triggered())
+      {
+        idx++;
+        continue;
+      }
+      double latency = now_in_seconds() - pending[idx].start;
+      if (pending[idx].large)
+        large_lat.push_back(latency);
+      else
+        small_lat.push_back(latency);
+      pending[idx] = pending.back();
+      pending.pop_back();
+    }
+  }
+  double elapsed = now_in_seconds() - start;
+
+  printf("%d copies (%d%% large) with %d in flight in %.3f s\n",
+         bench->num_copies, bench->large_percent, bench->window, elapsed);
+  printf("%8s %12s %8s %12s %12s %12s\n", "class", "bytes", "copies",
+         "p50 us", "p99 us", "max us");
+  report("small", bench->small_bytes, small_lat);
+  report("large", bench->large_bytes, large_lat);
+
+  small_pair.src.destroy();
+  small_pair.dst.destroy();
+  large_pair.src.destroy();
+  large_pair.dst.destroy();
+  machine->shutdown();
+}
+
+int main(int argc, char **argv)
+{
+  BenchArgs bench;
+  bench.num_copies = 1000;
+  bench.small_bytes = 4 << 10;
+  bench.large_bytes = 4 << 20;
+  bench.large_percent = 10;
+  bench.window = 32;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-n") && (i+1) < argc)
+      bench.num_copies = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && (i+1) < argc)
+      bench.small_bytes = (size_t)atoi(argv[++i]) << 10;
+    else if (!strcmp(argv[i], "-l") && (i+1) < argc)
+      bench.large_bytes = (size_t)atoi(argv[++i]) << 20;
+    else if (!strcmp(argv[i], "-p") && (i+1) < argc)
+      bench.large_percent = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-w") && (i+1) < argc)
+      bench.window = atoi(argv[++i]);
+  }
+
+  Processor::TaskIDTable task_table;
+  task_table[TOP_LEVEL_TASK] = top_level_task;
+  ReductionOpTable redop_table;
+  Machine machine(&argc, &argv, task_table, redop_table, false/*cps style*/);
+  machine.run(TOP_LEVEL_TASK, Machine::ONE_TASK_ONLY, &bench, sizeof(bench));
+  return 0;
+}
@@ -0,0 +1,122 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Latency of triggering an event that has 1, 100, and 10000 waiters.
+//  Each waiter is a user event whose trigger was deferred on the event
+//  being measured, so the time covers walking the waiter list and
+//  triggering every waiter, with no task execution mixed in.  Reports
+//  the median and worst trigger latency over several rounds, and the
+//  cost per waiter.  Builds against the shared low-level runtime by
+//  default; pass SHARED_LOWLEVEL=0 to build against the general one.
+//
+// Usage: event_trigger_bench [-r <rounds>] [-w <max waiters>]
+
+#include "lowlevel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+
+using namespace LegionRuntime::LowLevel;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE,
+};
+
+struct BenchArgs {
+  int rounds;
+  int max_waiters;
+};
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// Returns the latency in seconds of one trigger of an event with
+//  the given number of waiters
+static double time_trigger(int waiters, bool &all_triggered)
+{
+  UserEvent root = UserEvent::create_user_event();
+  std::vector<UserEvent> leaves(waiters);
+  for (int i = 0; i < waiters; i++)
+  {
+    leaves[i] = UserEvent::create_user_event();
+    leaves[i].trigger(root);
+  }
+  double start = now_in_seconds();
+  root.trigger();
+  // deferred triggers may be handed off to another thread, so the
+  //  trigger isn't done until the last waiter has seen it
+  for (int i = waiters-1; i >= 0; i--)
+    while (!leaves[i].has_triggered()) ;
+  double elapsed = now_in_seconds() - start;
+  all_triggered = true;
+  for (int i = 0; i < waiters; i++)
+    if (!leaves[i].has_triggered())
+      all_triggered = false;
+  return elapsed;
+}
+
+static void top_level_task(const void *args, size_t arglen, Processor p)
+{
+  const BenchArgs *bench = (const BenchArgs*)args;
+  printf("%8s %8s %14s %14s %14s\n", "waiters", "rounds",
+         "median us", "max us", "ns/waiter");
+  bool ok = true;
+  for (int waiters = 1; waiters <= bench->max_waiters; waiters *= 100)
+  {
+    std::vector<double> times(bench->rounds);
+    for (int r = 0; r < bench->rounds; r++)
+    {
+      bool triggered;
+      times[r] = time_trigger(waiters, triggered);
+      ok = ok && triggered;
+    }
+    std::sort(times.begin(), times.end());
+    double median = times[times.size()/2];
+    printf("%8d %8d %14.2f %14.2f %14.1f\n", waiters, bench->rounds,
+           median * 1e6, times.back() * 1e6, median * 1e9 / waiters);
+  }
+  if (!ok)
+    printf("ERROR: some waiters were not triggered\n");
+  Machine::get_machine()->shutdown();
+}
+
+int main(int argc, char **argv)
+{
+  BenchArgs bench;
+  bench.rounds = 20;
+  bench.max_waiters = 10000;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-r") && (i+1) < argc)
+      bench.rounds = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-w") && (i+1) < argc)
+      bench.max_waiters = atoi(argv[++i]);
+  }
+
+  Processor::TaskIDTable task_table;
+  task_table[TOP_LEVEL_TASK] = top_level_task;
+  ReductionOpTable redop_table;
+  Machine machine(&argc, &argv, task_table, redop_table, false/*cps style*/);
+  machine.run(TOP_LEVEL_TASK, Machine::ONE_TASK_ONLY, &bench, sizeof(bench));
+  return 0;
+}
@@ -0,0 +1,141 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Logical dependence analysis of many tasks that use disjoint subsets
+//  of the fields of one region.  The region has F fields split into
+//  groups of W; task i writes group i mod F/W, so every task depends
+//  only on the previous user of its own group while the logical state
+//  of the region accumulates users of all the others.  This is the case
+//  the per-field index of the logical user stores is meant for.  The
+//  index is off by default; compare a run with -hl:userindex 64, which
+//  indexes epoch lists of more than 64 users.
+//
+// The runtime's dependence statistics are turned on, so the average
+//  analysis time per operation is printed at shutdown alongside the
+//  launch time per task measured here.
+//
+// Usage: field_dependence_bench [-n <tasks>] [-f <fields>]
+//                               [-w <fields per task>]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+enum TaskIDs {
+  TOP_LEVEL_TASK_ID,
+  FIELD_TASK_ID,
+};
+
+enum FieldIDs {
+  FID_FIRST = 100,
+};
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, HighLevelRuntime *runtime)
+{
+  int num_tasks = 2000;
+  int num_fields = MAX_FIELDS;
+  int task_fields = 2;
+  const InputArgs &command_args = HighLevelRuntime::get_input_args();
+  for (int i = 1; i < command_args.argc; i++)
+  {
+    if ((i+1) >= command_args.argc)
+      break;
+    if (!strcmp(command_args.argv[i], "-n"))
+      num_tasks = atoi(command_args.argv[++i]);
+    else if (!strcmp(command_args.argv[i], "-f"))
+      num_fields = atoi(command_args.argv[++i]);
+    else if (!strcmp(command_args.argv[i], "-w"))
+      task_fields = atoi(command_args.argv[++i]);
+  }
+  assert((num_fields > 0) && (num_fields <= MAX_FIELDS));
+  assert((task_fields > 0) && (task_fields <= num_fields));
+  const int num_groups = num_fields / task_fields;
+
+  Rect<1> elem_rect(Point<1>(0),Point<1>(63));
+  IndexSpace is = runtime->create_index_space(ctx,
+                          Domain::from_rect<1>(elem_rect));
+  FieldSpace fs = runtime->create_field_space(ctx);
+  {
+    FieldAllocator allocator = runtime->create_field_allocator(ctx, fs);
+    for (int f = 0; f < num_fields; f++)
+      allocator.allocate_field(sizeof(double), FID_FIRST + f);
+  }
+  LogicalRegion lr = runtime->create_logical_region(ctx, is, fs);
+
+  std::vector<Future> futures;
+  futures.reserve(num_tasks);
+  double start = now_in_seconds();
+  for (int i = 0; i < num_tasks; i++)
+  {
+    TaskLauncher launcher(FIELD_TASK_ID, TaskArgument(NULL, 0));
+    launcher.add_region_requirement(
+        RegionRequirement(lr, READ_WRITE, EXCLUSIVE, lr));
+    const int group = i % num_groups;
+    for (int f = 0; f < task_fields; f++)
+      launcher.region_requirements[0].add_field(
+          FID_FIRST + group * task_fields + f);
+    futures.push_back(runtime->execute_task(ctx, launcher));
+  }
+  double launched = now_in_seconds();
+  for (int i = 0; i < num_tasks; i++)
+    futures[i].get_void_result();
+  double finished = now_in_seconds();
+
+  printf("%d tasks over %d groups of %d fields\n", num_tasks, num_groups,
+         task_fields);
+  printf("%14s %14s\n", "launch us/task", "total us/task");
+  printf("%14.2f %14.2f\n", (launched - start) * 1e6 / num_tasks,
+         (finished - start) * 1e6 / num_tasks);
+
+  runtime->destroy_logical_region(ctx, lr);
+  runtime->destroy_field_space(ctx, fs);
+  runtime->destroy_index_space(ctx, is);
+}
+
+void field_task(const Task *task,
+                const std::vector<PhysicalRegion> &regions,
+                Context ctx, HighLevelRuntime *runtime)
+{
+}
+
+int main(int argc, char **argv)
+{
+  HighLevelRuntime::set_top_level_task_id(TOP_LEVEL_TASK_ID);
+  HighLevelRuntime::register_legion_task<top_level_task>(TOP_LEVEL_TASK_ID,
+      Processor::LOC_PROC, true/*single*/, false/*index*/);
+  HighLevelRuntime::register_legion_task<field_task>(FIELD_TASK_ID,
+      Processor::LOC_PROC, true/*single*/, false/*index*/,
+      AUTO_GENERATE_ID, TaskConfigOptions(true/*leaf*/), "field_task");
+
+  // always report the runtime's dependence analysis statistics
+  std::vector<char*> args(argv, argv + argc);
+  char depstats[] = "-hl:depstats";
+  args.push_back(depstats);
+  args.push_back(NULL);
+  return HighLevelRuntime::start(argc + 1, &args[0]);
+}
@@ -0,0 +1,176 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cost of the field mask operations dependence analysis leans on, for
+//  the hybrid sparse/dense masks (-DHYBRID_FIELD_MASKS) and for the
+//  dense mask each one falls back to, at 128, 512 and 1024 fields.
+//  Masks are drawn with a given number of random bits set: a few, so
+//  hybrid masks stay sparse, and half of the fields, so they are dense.
+//  Reports nanoseconds per operation for &, -, !, pop_count and
+//  find_first_set, along with the size of each kind of mask.
+//
+// Usage: field_mask_bench [-n <masks>] [-r <repetitions>]
+
+#include "legion_utilities.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+
+using namespace LegionRuntime::HighLevel;
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+enum MaskOp {
+  OP_AND,
+  OP_DIFF,
+  OP_EMPTY,
+  OP_POP_COUNT,
+  OP_FIND_FIRST,
+  NUM_OPS,
+};
+
+static const char *op_names[NUM_OPS] = { "&", "-", "!", "pop_count",
+                                         "find_first_set" };
+
+template<typename MASK>
+static void make_masks(std::vector<MASK> &masks, int count, unsigned max,
+                       unsigned bits_set, unsigned seed)
+{
+  srand(seed);
+  masks.resize(count);
+  for (int i = 0; i < count; i++)
+  {
+    masks[i].clear();
+    for (unsigned b = 0; b < bits_set; b++)
+      masks[i].set_bit(rand() % max);
+  }
+}
+
+// Returns nanoseconds per operation; the results are folded into sink
+//  so the compiler can't drop the work
+template<typename MASK>
+static double time_op(const std::vector<MASK> &masks, MaskOp op, int reps,
+                      unsigned long long &sink)
+{
+  const size_t count = masks.size();
+  double start = now_in_seconds();
+  for (int r = 0; r < reps; r++)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      const MASK &lhs = masks[i];
+      const MASK &rhs = masks[(i + 1 + r) % count];
+      switch (op)
+      {
+        case OP_AND:
+          {
+            MASK result = lhs & rhs;
+            sink += result.find_first_set();
+            break;
+          }
+        case OP_DIFF:
+          {
+            MASK result = lhs - rhs;
+            sink += result.find_first_set();
+            break;
+          }
+        case OP_EMPTY:
+          {
+            sink += !lhs;
+            break;
+          }
+        case OP_POP_COUNT:
+          {
+            sink += MASK::pop_count(lhs);
+            break;
+          }
+        case OP_FIND_FIRST:
+          {
+            sink += lhs.find_first_set();
+            break;
+          }
+        default:
+          assert(false);
+      }
+    }
+  }
+  return (now_in_seconds() - start) * 1e9 / (double(count) * reps);
+}
+
+template<typename MASK>
+static void run_mask(const char *name, unsigned max, unsigned bits_set,
+                     int count, int reps, unsigned long long &sink)
+{
+  std::vector<MASK> masks;
+  make_masks(masks, count, max, bits_set, 12345);
+  printf("%6d %-8s %6d %6zd", max, name, bits_set, sizeof(MASK));
+  for (int op = 0; op < NUM_OPS; op++)
+    printf(" %10.2f", time_op(masks, (MaskOp)op, reps, sink));
+  printf("\n");
+}
+
+template<typename DENSE, unsigned MAX>
+static void run_width(int count, int reps, unsigned long long &sink)
+{
+  const unsigned sparse_bits = 4;
+  const unsigned dense_bits = MAX / 2;
+  run_mask<HybridBitMask<DENSE,MAX> >("hybrid", MAX, sparse_bits,
+                                      count, reps, sink);
+  run_mask<DENSE>("dense", MAX, sparse_bits, count, reps, sink);
+  run_mask<HybridBitMask<DENSE,MAX> >("hybrid", MAX, dense_bits,
+                                      count, reps, sink);
+  run_mask<DENSE>("dense", MAX, dense_bits, count, reps, sink);
+}
+
+int main(int argc, char **argv)
+{
+  int count = 1024;
+  int reps = 1000;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-n") && (i+1) < argc)
+      count = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && (i+1) < argc)
+      reps = atoi(argv[++i]);
+    else
+    {
+      fprintf(stderr, "Usage: %s [-n <masks>] [-r <repetitions>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  printf("%d masks, %d repetitions, ns per operation\n", count, reps);
+  printf("%6s %-8s %6s %6s", "fields", "mask", "set", "bytes");
+  for (int op = 0; op < NUM_OPS; op++)
+    printf(" %10s", op_names[op]);
+  printf("\n");
+  unsigned long long sink = 0;
+  // the same dense masks legion_types.h picks without AVX
+  run_width<SSEBitMask<128>,128>(count, reps, sink);
+  run_width<SSETLBitMask<512>,512>(count, reps, sink);
+  run_width<SSETLBitMask<1024>,1024>(count, reps, sink);
+  // keep the results alive
+  if (sink == 0)
+    printf("\n");
+  return 0;
+}
@@ -0,0 +1,164 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cost of the reference counting done when mapping a region whose data
+//  lives in many instances.  An index launch writes every piece of a
+//  partitioned region, leaving one valid instance per piece.  The
+//  top-level task then repeatedly maps and unmaps, read-only:
+//
+//   - each piece in turn, which takes and drops references on one of
+//      the many piece instances each time
+//   - the whole region, whose physical state has a valid view for every
+//      piece below it
+//
+// and reports the time per map/unmap pair.  Every mapping adds and
+//  removes valid and gc references on the views and managers it
+//  touches, so with few copies to issue this is mostly reference
+//  traffic.  Run with more -ll:util processors to add contention.
+//
+// Usage: instance_refs_bench [-p <pieces>] [-r <rounds>] [-e <elements>]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+enum TaskIDs {
+  TOP_LEVEL_TASK_ID,
+  INIT_TASK_ID,
+};
+
+enum FieldIDs {
+  FID_VAL,
+};
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static double map_and_unmap(Context ctx, HighLevelRuntime *runtime,
+                            LogicalRegion region, LogicalRegion parent,
+                            int count)
+{
+  double start = now_in_seconds();
+  for (int i = 0; i < count; i++)
+  {
+    InlineLauncher launcher(
+        RegionRequirement(region, READ_ONLY, EXCLUSIVE, parent));
+    launcher.requirement.add_field(FID_VAL);
+    PhysicalRegion mapped = runtime->map_region(ctx, launcher);
+    mapped.wait_until_valid();
+    runtime->unmap_region(ctx, mapped);
+  }
+  return now_in_seconds() - start;
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, HighLevelRuntime *runtime)
+{
+  int num_pieces = 64;
+  int rounds = 20;
+  int num_elements = 1 << 14;
+  const InputArgs &command_args = HighLevelRuntime::get_input_args();
+  for (int i = 1; i < command_args.argc; i++)
+  {
+    if ((i+1) >= command_args.argc)
+      break;
+    if (!strcmp(command_args.argv[i], "-p"))
+      num_pieces = atoi(command_args.argv[++i]);
+    else if (!strcmp(command_args.argv[i], "-r"))
+      rounds = atoi(command_args.argv[++i]);
+    else if (!strcmp(command_args.argv[i], "-e"))
+      num_elements = atoi(command_args.argv[++i]);
+  }
+  assert((num_pieces > 0) && (rounds > 0));
+  assert((num_elements % num_pieces) == 0);
+
+  Rect<1> elem_rect(Point<1>(0),Point<1>(num_elements-1));
+  IndexSpace is = runtime->create_index_space(ctx,
+                          Domain::from_rect<1>(elem_rect));
+  FieldSpace fs = runtime->create_field_space(ctx);
+  {
+    FieldAllocator allocator = runtime->create_field_allocator(ctx, fs);
+    allocator.allocate_field(sizeof(double), FID_VAL);
+  }
+  LogicalRegion lr = runtime->create_logical_region(ctx, is, fs);
+  Blockify<1> coloring(num_elements/num_pieces);
+  IndexPartition ip = runtime->create_index_partition(ctx, is, coloring);
+  LogicalPartition lp = runtime->get_logical_partition(ctx, lr, ip);
+
+  // one instance per piece
+  Rect<1> launch_rect(Point<1>(0),Point<1>(num_pieces-1));
+  ArgumentMap arg_map;
+  IndexLauncher init_launcher(INIT_TASK_ID, Domain::from_rect<1>(launch_rect),
+                              TaskArgument(NULL, 0), arg_map);
+  init_launcher.add_region_requirement(
+      RegionRequirement(lp, 0/*projection ID*/, WRITE_DISCARD, EXCLUSIVE, lr));
+  init_launcher.region_requirements[0].add_field(FID_VAL);
+  runtime->execute_index_space(ctx, init_launcher).wait_all_results();
+
+  std::vector<LogicalRegion> pieces(num_pieces);
+  for (int p = 0; p < num_pieces; p++)
+    pieces[p] = runtime->get_logical_subregion_by_color(ctx, lp, p);
+
+  // map each piece once and the whole region once before timing so
+  //  every instance the timed mappings use already exists
+  for (int p = 0; p < num_pieces; p++)
+    map_and_unmap(ctx, runtime, pieces[p], lr, 1);
+  map_and_unmap(ctx, runtime, lr, lr, 1);
+
+  double piece_time = 0.0;
+  for (int r = 0; r < rounds; r++)
+    for (int p = 0; p < num_pieces; p++)
+      piece_time += map_and_unmap(ctx, runtime, pieces[p], lr, 1);
+  double region_time = map_and_unmap(ctx, runtime, lr, lr, rounds);
+
+  printf("%d pieces, %d elements, %d rounds\n", num_pieces, num_elements,
+         rounds);
+  printf("%-8s %10s %16s\n", "mapping", "count", "us per map/unmap");
+  printf("%-8s %10d %16.2f\n", "piece", rounds * num_pieces,
+         piece_time * 1e6 / (rounds * num_pieces));
+  printf("%-8s %10d %16.2f\n", "region", rounds,
+         region_time * 1e6 / rounds);
+
+  runtime->destroy_logical_region(ctx, lr);
+  runtime->destroy_field_space(ctx, fs);
+  runtime->destroy_index_space(ctx, is);
+}
+
+void init_task(const Task *task,
+               const std::vector<PhysicalRegion> &regions,
+               Context ctx, HighLevelRuntime *runtime)
+{
+}
+
+int main(int argc, char **argv)
+{
+  HighLevelRuntime::set_top_level_task_id(TOP_LEVEL_TASK_ID);
+  HighLevelRuntime::register_legion_task<top_level_task>(TOP_LEVEL_TASK_ID,
+      Processor::LOC_PROC, true/*single*/, false/*index*/);
+  HighLevelRuntime::register_legion_task<init_task>(INIT_TASK_ID,
+      Processor::LOC_PROC, true/*single*/, true/*index*/,
+      AUTO_GENERATE_ID, TaskConfigOptions(true/*leaf*/), "init_task");
+
+  return HighLevelRuntime::start(argc, argv);
+}
@@ -0,0 +1,123 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of the logger with N messages from each of M threads.  For
+//  M = 1, 2, 4, ... up to the number of CPU processors (-ll:cpu), a task
+//  on each of M processors logs N info messages and the top-level task
+//  times how long it takes until they have all returned.  Run it with
+//  stderr redirected to compare the synchronous logger against
+//  -logfile <prefix>, and with -logbuf and -logdrop to see the effect
+//  of the buffer size and of dropping instead of stalling.  The log
+//  should end up with N * (1 + 2 + 4 + ...) lines from the bench
+//  category unless messages were dropped.  Builds against the shared
+//  low-level runtime by default; pass SHARED_LOWLEVEL=0 to build against
+//  the general one.
+//
+// Usage: logging_bench [-n <messages per thread>] [-ll:cpu <max threads>]
+
+#include "lowlevel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+
+using namespace LegionRuntime::LowLevel;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE,
+  LOG_TASK,
+};
+
+struct BenchArgs {
+  int messages;
+};
+
+struct LogArgs {
+  int thread;
+  int messages;
+};
+
+LegionRuntime::Logger::Category log_bench("bench");
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void log_task(const void *args, size_t arglen, Processor p)
+{
+  const LogArgs *log_args = (const LogArgs*)args;
+  // about as long as a typical runtime message
+  for (int i = 0; i < log_args->messages; i++)
+    log_bench.info("thread %d message %d of %d with a little more text "
+                   "to make it a realistic length", log_args->thread, i,
+                   log_args->messages);
+}
+
+static void top_level_task(const void *args, size_t arglen, Processor p)
+{
+  const BenchArgs *bench = (const BenchArgs*)args;
+  Machine *machine = Machine::get_machine();
+  std::vector<Processor> cpus;
+  const std::set<Processor> &procs = machine->get_all_processors();
+  for (std::set<Processor>::const_iterator it = procs.begin();
+        it != procs.end(); it++)
+    if (machine->get_processor_kind(*it) == Processor::LOC_PROC)
+      cpus.push_back(*it);
+
+  printf("%8s %10s %12s %14s\n", "threads", "messages", "seconds",
+         "messages/s");
+  for (unsigned threads = 1; threads <= cpus.size(); threads *= 2)
+  {
+    std::set<Event> done;
+    double start = now_in_seconds();
+    for (unsigned t = 0; t < threads; t++)
+    {
+      LogArgs log_args;
+      log_args.thread = t;
+      log_args.messages = bench->messages;
+      done.insert(cpus[t].spawn(LOG_TASK, &log_args, sizeof(log_args)));
+    }
+    Event::merge_events(done).wait();
+    double elapsed = now_in_seconds() - start;
+    long long total = (long long)threads * bench->messages;
+    printf("%8d %10lld %12.4f %14.0f\n", threads, total, elapsed,
+           total / elapsed);
+  }
+  machine->shutdown();
+}
+
+int main(int argc, char **argv)
+{
+  BenchArgs bench;
+  bench.messages = 100000;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-n") && (i+1) < argc)
+      bench.messages = atoi(argv[++i]);
+  }
+
+  Processor::TaskIDTable task_table;
+  task_table[TOP_LEVEL_TASK] = top_level_task;
+  task_table[LOG_TASK] = log_task;
+  ReductionOpTable redop_table;
+  Machine machine(&argc, &argv, task_table, redop_table, false/*cps style*/);
+  machine.run(TOP_LEVEL_TASK, Machine::ONE_TASK_ONLY, &bench, sizeof(bench));
+  return 0;
+}
@@ -0,0 +1,249 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays an allocation trace against the first-fit free list that
+//  Memory::Impl uses by default and the TLSF allocator selected with
+//  -ll:alloc tlsf.  Reports the throughput of each allocator and the
+//  peak fragmentation seen while replaying, where fragmentation is the
+//  fraction of free bytes that are not in the largest free block.
+//
+// By default the trace is generated: instance-sized requests (256 B to
+//  16 MB, log-uniform) with random lifetimes, holding the memory around
+//  70% full.  A recorded trace can be replayed instead with -f; each line
+//  is either "a <id> <bytes>" or "f <id>".
+//
+// Usage: mem_alloc_bench [-n <ops>] [-m <memory MB>] [-s <seed>]
+//                        [-f <trace file>]
+
+#include "lowlevel_alloc.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+
+using namespace LegionRuntime::LowLevel;
+
+struct TraceOp {
+  bool is_alloc;
+  int id;
+  size_t size;
+};
+
+// sizes are rounded the way Memory::Impl rounds them to its alignment
+static const size_t ALIGNMENT = 256;
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void generate_trace(std::vector<TraceOp> &trace, int num_ops,
+                           size_t mem_size, unsigned seed)
+{
+  srand(seed);
+  std::vector<int> live;
+  std::vector<size_t> sizes;
+  size_t used = 0;
+  const size_t target = mem_size / 10 * 7;
+  for (int i = 0; i < num_ops; i++)
+  {
+    TraceOp op;
+    // allocate more often while below the target occupancy
+    int alloc_pct = (used < target) ? 60 : 40;
+    op.is_alloc = live.empty() || ((rand() % 100) < alloc_pct);
+    if (op.is_alloc)
+    {
+      op.id = sizes.size();
+      // log-uniform between 2^8 and 2^24 bytes
+      double bits = 8.0 + 16.0 * ((double)rand() / RAND_MAX);
+      op.size = (size_t)(1ULL << (int)bits);
+      op.size += (size_t)(op.size * (bits - (int)bits));
+      op.size = (op.size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+      sizes.push_back(op.size);
+      live.push_back(op.id);
+      used += op.size;
+    }
+    else
+    {
+      int idx = rand() % live.size();
+      op.id = live[idx];
+      op.size = sizes[op.id];
+      live[idx] = live.back();
+      live.pop_back();
+      used -= op.size;
+    }
+    trace.push_back(op);
+  }
+}
+
+static bool read_trace(std::vector<TraceOp> &trace, const char *filename)
+{
+  FILE *f = fopen(filename, "r");
+  if (f == NULL)
+    return false;
+  std::vector<size_t> sizes;
+  char kind;
+  int id;
+  while (fscanf(f, " %c %d", &kind, &id) == 2)
+  {
+    TraceOp op;
+    op.id = id;
+    op.is_alloc = (kind == 'a');
+    if (op.is_alloc)
+    {
+      unsigned long size;
+      if (fscanf(f, "%lu", &size) != 1)
+        break;
+      op.size = ((size_t)size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+      if ((size_t)id >= sizes.size())
+        sizes.resize(id + 1, 0);
+      sizes[id] = op.size;
+    }
+    else
+    {
+      if ((id < 0) || ((size_t)id >= sizes.size()))
+        continue;
+      op.size = sizes[id];
+    }
+    trace.push_back(op);
+  }
+  fclose(f);
+  return true;
+}
+
+struct ReplayResult {
+  double seconds;
+  size_t failed;
+  double peak_fragmentation;
+  size_t peak_free_blocks;
+};
+
+// Replays the trace, sampling the allocator's statistics every
+//  sample_interval operations (0 means never, for timed runs)
+static void replay(MemoryAllocator *alloc, const std::vector<TraceOp> &trace,
+                   int sample_interval, ReplayResult &result)
+{
+  size_t max_id = 0;
+  for (unsigned i = 0; i < trace.size(); i++)
+    if ((size_t)trace[i].id > max_id)
+      max_id = trace[i].id;
+  // allocations can fail, so remember which ones we have to free
+  std::vector<off_t> offsets(max_id + 1, -1);
+  std::vector<size_t> sizes(max_id + 1, 0);
+  result.failed = 0;
+  result.peak_fragmentation = 0.0;
+  result.peak_free_blocks = 0;
+  double start = now_in_seconds();
+  for (unsigned i = 0; i < trace.size(); i++)
+  {
+    const TraceOp &op = trace[i];
+    if (op.is_alloc)
+    {
+      offsets[op.id] = alloc->alloc(op.size);
+      sizes[op.id] = op.size;
+      if (offsets[op.id] < 0)
+        result.failed++;
+    }
+    else if (offsets[op.id] >= 0)
+    {
+      alloc->free(offsets[op.id], op.size);
+      offsets[op.id] = -1;
+    }
+    if ((sample_interval > 0) && ((i % sample_interval) == 0))
+    {
+      Machine::MemoryAllocStats stats;
+      alloc->get_stats(stats);
+      if (stats.free_bytes > 0)
+      {
+        double frag = 1.0 - ((double)stats.largest_free_block /
+                             stats.free_bytes);
+        if (frag > result.peak_fragmentation)
+          result.peak_fragmentation = frag;
+      }
+      if (stats.num_free_blocks > result.peak_free_blocks)
+        result.peak_free_blocks = stats.num_free_blocks;
+    }
+  }
+  result.seconds = now_in_seconds() - start;
+  // leave the allocator empty again
+  for (unsigned i = 0; i < offsets.size(); i++)
+    if (offsets[i] >= 0)
+      alloc->free(offsets[i], sizes[i]);
+}
+
+int main(int argc, char **argv)
+{
+  int num_ops = 1000000;
+  size_t mem_mb = 1024;
+  unsigned seed = 12345;
+  const char *trace_file = NULL;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-n") && (i+1) < argc)
+      num_ops = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-m") && (i+1) < argc)
+      mem_mb = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && (i+1) < argc)
+      seed = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-f") && (i+1) < argc)
+      trace_file = argv[++i];
+    else
+    {
+      fprintf(stderr, "Usage: %s [-n <ops>] [-m <memory MB>] [-s <seed>] "
+                      "[-f <trace file>]\n", argv[0]);
+      return 1;
+    }
+  }
+  size_t mem_size = mem_mb << 20;
+
+  std::vector<TraceOp> trace;
+  if (trace_file != NULL)
+  {
+    if (!read_trace(trace, trace_file))
+    {
+      fprintf(stderr, "Unable to read trace file %s\n", trace_file);
+      return 1;
+    }
+  }
+  else
+    generate_trace(trace, num_ops, mem_size, seed);
+  printf("trace: %zd operations, %zd MB memory\n", trace.size(), mem_mb);
+
+  printf("%12s %12s %10s %14s %16s\n", "allocator", "Mops/s", "failed",
+         "peak frag %", "peak free blocks");
+  const char *names[2] = { "first-fit", "tlsf" };
+  MemoryAllocator::AllocatorKind kinds[2] =
+    { MemoryAllocator::ALLOC_FIRST_FIT, MemoryAllocator::ALLOC_TLSF };
+  for (int k = 0; k < 2; k++)
+  {
+    // one timed replay, then one that samples the fragmentation
+    ReplayResult timed, sampled;
+    MemoryAllocator *alloc = MemoryAllocator::create_allocator(kinds[k],
+                                                               mem_size);
+    replay(alloc, trace, 0, timed);
+    delete alloc;
+    alloc = MemoryAllocator::create_allocator(kinds[k], mem_size);
+    replay(alloc, trace, 1000, sampled);
+    delete alloc;
+    printf("%12s %12.2f %10zd %14.1f %16zd\n", names[k],
+           trace.size() / timed.seconds * 1e-6, timed.failed,
+           sampled.peak_fragmentation * 100.0, sampled.peak_free_blocks);
+  }
+  return 0;
+}
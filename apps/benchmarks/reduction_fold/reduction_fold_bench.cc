@@ -0,0 +1,228 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Bandwidth of flushing reduction fold instances, for a sum operator
+//  that opts in to the vectorized kernels of lowlevel_reduction.h and
+//  an identical one that doesn't.  Two things are measured:
+//
+//   - the span kernels (ReductionOp::apply and fold over a contiguous
+//      range, exclusive and atomic), which is what a fold instance
+//      flush turns into for every contiguous run of elements
+//   - whole-instance flushes through Domain::copy: a fold instance
+//      applied to a normal instance, and folded into another fold
+//      instance
+//
+// Builds against the shared low-level runtime by default; pass
+//  SHARED_LOWLEVEL=0 to build against the general one.
+//
+// Usage: reduction_fold_bench [-e <elements>] [-r <repetitions>]
+
+#include "lowlevel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+
+using namespace LegionRuntime::LowLevel;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE,
+};
+
+enum {
+  REDOP_VECTOR_SUM_ID = 1,
+  REDOP_SCALAR_SUM_ID = 2,
+};
+
+struct BenchArgs {
+  int elements;
+  int reps;
+};
+
+// the same sum twice, only the first one opts in to the vector kernels
+template <int WHICH>
+class DoubleSum {
+public:
+  typedef double LHS;
+  typedef double RHS;
+  static const double identity;
+
+  template <bool EXCLUSIVE> static void apply(LHS &lhs, RHS rhs);
+  template <bool EXCLUSIVE> static void fold(RHS &rhs1, RHS rhs2);
+};
+
+template <int WHICH>
+const double DoubleSum<WHICH>::identity = 0.0;
+
+template <int WHICH> template <bool EXCLUSIVE>
+/*static*/ void DoubleSum<WHICH>::apply(LHS &lhs, RHS rhs)
+{
+  if (EXCLUSIVE)
+    lhs += rhs;
+  else
+  {
+    // compare-and-swap loop, the way applications write atomic sums
+    union { double d; long long l; } oldval, newval;
+    do {
+      oldval.d = lhs;
+      newval.d = oldval.d + rhs;
+    } while (!__sync_bool_compare_and_swap((long long*)&lhs,
+                                           oldval.l, newval.l));
+  }
+}
+
+template <int WHICH> template <bool EXCLUSIVE>
+/*static*/ void DoubleSum<WHICH>::fold(RHS &rhs1, RHS rhs2)
+{
+  apply<EXCLUSIVE>(rhs1, rhs2);
+}
+
+typedef DoubleSum<0> VectorSum;
+typedef DoubleSum<1> ScalarSum;
+
+namespace LegionRuntime {
+  namespace LowLevel {
+    template <>
+    struct ReductionVectorTraits<VectorSum> {
+      static const ReductionVectorKind KIND = REDOP_VECTOR_SUM;
+    };
+  };
+};
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static double bench_kernels(const ReductionOpUntyped *redop, bool fold,
+                            bool exclusive, int elements, int reps)
+{
+  std::vector<double> lhs(elements, 1.0), rhs(elements, 0.5);
+  double start = now_in_seconds();
+  for (int r = 0; r < reps; r++)
+  {
+    if (fold)
+      redop->fold(&lhs[0], &rhs[0], elements, exclusive);
+    else
+      redop->apply(&lhs[0], &rhs[0], elements, exclusive);
+  }
+  double elapsed = now_in_seconds() - start;
+  // reads both arrays and writes one
+  return 3.0 * sizeof(double) * elements * reps / elapsed / (1 << 20);
+}
+
+static double bench_flush(Domain domain, Memory mem, ReductionOpID redop_id,
+                          bool fold, int elements, int reps)
+{
+  RegionInstance src = domain.create_instance(mem, sizeof(double), redop_id);
+  RegionInstance dst = fold ?
+    domain.create_instance(mem, sizeof(double), redop_id) :
+    domain.create_instance(mem, sizeof(double));
+  if (!src.exists() || !dst.exists())
+    return -1.0;
+  std::vector<Domain::CopySrcDstField> srcs(1), dsts(1);
+  srcs[0] = Domain::CopySrcDstField(src, 0, sizeof(double));
+  dsts[0] = Domain::CopySrcDstField(dst, 0, sizeof(double));
+  double start = now_in_seconds();
+  for (int r = 0; r < reps; r++)
+    domain.copy(srcs, dsts, Event::NO_EVENT, redop_id, fold).wait();
+  double elapsed = now_in_seconds() - start;
+  src.destroy();
+  dst.destroy();
+  return 3.0 * sizeof(double) * elements * reps / elapsed / (1 << 20);
+}
+
+static void top_level_task(const void *args, size_t arglen, Processor p)
+{
+  const BenchArgs *bench = (const BenchArgs*)args;
+  Machine *machine = Machine::get_machine();
+  ReductionOpUntyped *ops[2] = {
+    ReductionOpUntyped::create_reduction_op<VectorSum>(),
+    ReductionOpUntyped::create_reduction_op<ScalarSum>() };
+  const ReductionOpID ids[2] = { REDOP_VECTOR_SUM_ID, REDOP_SCALAR_SUM_ID };
+
+  printf("span kernels, %d doubles, MB/s\n", bench->elements);
+  printf("%-12s %12s %12s %12s %12s\n", "", "apply excl", "apply atomic",
+         "fold excl", "fold atomic");
+  for (int k = 0; k < 2; k++)
+  {
+    printf("%-12s", k ? "scalar sum" : "vector sum");
+    for (int fold = 0; fold < 2; fold++)
+      for (int excl = 1; excl >= 0; excl--)
+        printf(" %12.1f", bench_kernels(ops[k], fold, excl, bench->elements,
+                                        bench->reps));
+    printf("\n");
+  }
+  delete ops[0];
+  delete ops[1];
+
+  Memory mem = Memory::NO_MEMORY;
+  const std::set<Memory> &mems = machine->get_all_memories();
+  for (std::set<Memory>::const_iterator it = mems.begin();
+        it != mems.end(); it++)
+    if (!mem.exists() ||
+        (machine->get_memory_size(*it) > machine->get_memory_size(mem)))
+      mem = *it;
+  ElementMask mask(bench->elements);
+  mask.enable(0, bench->elements);
+  Domain domain(IndexSpace::create_index_space(mask));
+
+  printf("\ninstance flushes, %d doubles, MB/s\n", bench->elements);
+  printf("%-12s %12s %12s\n", "", "apply", "fold");
+  for (int k = 0; k < 2; k++)
+  {
+    printf("%-12s", k ? "scalar sum" : "vector sum");
+    for (int fold = 0; fold < 2; fold++)
+    {
+      double mbs = bench_flush(domain, mem, ids[k], fold, bench->elements,
+                               bench->reps);
+      if (mbs < 0.0)
+        printf(" %12s", "no memory");
+      else
+        printf(" %12.1f", mbs);
+    }
+    printf("\n");
+  }
+  machine->shutdown();
+}
+
+int main(int argc, char **argv)
+{
+  BenchArgs bench;
+  bench.elements = 1 << 20;
+  bench.reps = 10;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-e") && (i+1) < argc)
+      bench.elements = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && (i+1) < argc)
+      bench.reps = atoi(argv[++i]);
+  }
+
+  Processor::TaskIDTable task_table;
+  task_table[TOP_LEVEL_TASK] = top_level_task;
+  ReductionOpTable redop_table;
+  redop_table[REDOP_VECTOR_SUM_ID] =
+    ReductionOpUntyped::create_reduction_op<VectorSum>();
+  redop_table[REDOP_SCALAR_SUM_ID] =
+    ReductionOpUntyped::create_reduction_op<ScalarSum>();
+  Machine machine(&argc, &argv, task_table, redop_table, false/*cps style*/);
+  machine.run(TOP_LEVEL_TASK, Machine::ONE_TASK_ONLY, &bench, sizeof(bench));
+  return 0;
+}
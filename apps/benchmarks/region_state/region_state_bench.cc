@@ -0,0 +1,212 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cost of moving region tree state between nodes.  The top-level task
+//  creates a region with many fields and partitions it; every iteration
+//  then launches one task per subregion, each writing a rotating window
+//  of fields.  The mapper sends every task to a processor in a different
+//  address space than the one launching it, so each launch has to ship
+//  the logical and physical state of its subregion (SEND_REGION_STATE
+//  and friends) to the remote node and back.  Reports iterations/s and
+//  tasks/s; run with -hl:metrics <ms> to also see the number of messages
+//  and bytes sent.
+//
+// Builds against the general low-level runtime by default, since it
+//  needs at least two GASNet nodes to exercise anything.  On a single
+//  node every task stays local.
+//
+// Usage: region_state_bench [-i <iterations>] [-p <pieces>] [-f <fields>]
+//                           [-w <fields per task>] [-e <elements>]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+#include "legion.h"
+#include "default_mapper.h"
+using namespace LegionRuntime::HighLevel;
+using namespace LegionRuntime::Accessor;
+
+enum TaskIDs {
+  TOP_LEVEL_TASK_ID,
+  WRITE_TASK_ID,
+};
+
+enum FieldIDs {
+  FID_FIRST = 100,
+};
+
+// Sends every write task to a processor in another address space,
+//  round-robin, so that region state has to move between nodes
+class RemoteMapper : public DefaultMapper {
+public:
+  RemoteMapper(Machine *machine, HighLevelRuntime *rt, Processor local);
+public:
+  virtual void select_task_options(Task *task);
+protected:
+  std::vector<Processor> remote_procs;
+  unsigned next_remote;
+};
+
+RemoteMapper::RemoteMapper(Machine *m, HighLevelRuntime *rt, Processor p)
+  : DefaultMapper(m, rt, p), next_remote(0)
+{
+  const std::set<Processor> &all_procs = machine->get_all_processors();
+  for (std::set<Processor>::const_iterator it = all_procs.begin();
+        it != all_procs.end(); it++)
+  {
+    if ((machine->get_processor_kind(*it) == Processor::LOC_PROC) &&
+        (it->address_space() != local_proc.address_space()))
+      remote_procs.push_back(*it);
+  }
+}
+
+void RemoteMapper::select_task_options(Task *task)
+{
+  DefaultMapper::select_task_options(task);
+  if ((task->task_id != WRITE_TASK_ID) || remote_procs.empty())
+    return;
+  task->spawn_task = false;
+  task->map_locally = false;
+  task->target_proc = remote_procs[next_remote++ % remote_procs.size()];
+}
+
+void mapper_registration(Machine *machine, HighLevelRuntime *rt,
+                          const std::set<Processor> &local_procs)
+{
+  for (std::set<Processor>::const_iterator it = local_procs.begin();
+        it != local_procs.end(); it++)
+    rt->replace_default_mapper(new RemoteMapper(machine, rt, *it), *it);
+}
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, HighLevelRuntime *runtime)
+{
+  int iterations = 10;
+  int num_pieces = 16;
+  int num_fields = 64;
+  int task_fields = 4;
+  int num_elements = 1024;
+  const InputArgs &command_args = HighLevelRuntime::get_input_args();
+  for (int i = 1; i < command_args.argc; i++)
+  {
+    if ((i+1) >= command_args.argc)
+      break;
+    if (!strcmp(command_args.argv[i], "-i"))
+      iterations = atoi(command_args.argv[++i]);
+    else if (!strcmp(command_args.argv[i], "-p"))
+      num_pieces = atoi(command_args.argv[++i]);
+    else if (!strcmp(command_args.argv[i], "-f"))
+      num_fields = atoi(command_args.argv[++i]);
+    else if (!strcmp(command_args.argv[i], "-w"))
+      task_fields = atoi(command_args.argv[++i]);
+    else if (!strcmp(command_args.argv[i], "-e"))
+      num_elements = atoi(command_args.argv[++i]);
+  }
+  assert((num_pieces > 0) && (num_fields > 0));
+  assert((task_fields > 0) && (task_fields <= num_fields));
+  assert((num_elements % num_pieces) == 0);
+
+  Rect<1> elem_rect(Point<1>(0),Point<1>(num_elements-1));
+  IndexSpace is = runtime->create_index_space(ctx,
+                          Domain::from_rect<1>(elem_rect));
+  FieldSpace fs = runtime->create_field_space(ctx);
+  {
+    FieldAllocator allocator = runtime->create_field_allocator(ctx, fs);
+    for (int f = 0; f < num_fields; f++)
+      allocator.allocate_field(sizeof(double), FID_FIRST + f);
+  }
+  LogicalRegion lr = runtime->create_logical_region(ctx, is, fs);
+  Blockify<1> coloring(num_elements/num_pieces);
+  IndexPartition ip = runtime->create_index_partition(ctx, is, coloring);
+  LogicalPartition lp = runtime->get_logical_partition(ctx, lr, ip);
+
+  int num_tasks = 0;
+  double start = now_in_seconds();
+  for (int iter = 0; iter < iterations; iter++)
+  {
+    std::vector<Future> futures;
+    for (int color = 0; color < num_pieces; color++)
+    {
+      LogicalRegion subregion =
+        runtime->get_logical_subregion_by_color(ctx, lp, color);
+      TaskLauncher launcher(WRITE_TASK_ID, TaskArgument(NULL, 0));
+      launcher.add_region_requirement(
+          RegionRequirement(subregion, READ_WRITE, EXCLUSIVE, lr));
+      for (int f = 0; f < task_fields; f++)
+        launcher.region_requirements[0].add_field(
+            FID_FIRST + ((iter * task_fields + f) % num_fields));
+      futures.push_back(runtime->execute_task(ctx, launcher));
+      num_tasks++;
+    }
+    for (unsigned idx = 0; idx < futures.size(); idx++)
+      futures[idx].get_void_result();
+  }
+  double elapsed = now_in_seconds() - start;
+
+  printf("%d iterations of %d tasks, %d of %d fields each, %d elements\n",
+         iterations, num_pieces, task_fields, num_fields,
+         num_elements);
+  printf("%12s %12s %12s\n", "seconds", "iters/s", "tasks/s");
+  printf("%12.3f %12.1f %12.1f\n", elapsed, iterations / elapsed,
+         num_tasks / elapsed);
+
+  runtime->destroy_logical_region(ctx, lr);
+  runtime->destroy_field_space(ctx, fs);
+  runtime->destroy_index_space(ctx, is);
+}
+
+void write_task(const Task *task,
+                const std::vector<PhysicalRegion> &regions,
+                Context ctx, HighLevelRuntime *runtime)
+{
+  Domain dom = runtime->get_index_space_domain(ctx,
+      task->regions[0].region.get_index_space());
+  Rect<1> rect = dom.get_rect<1>();
+  for (std::set<FieldID>::const_iterator fit =
+        task->regions[0].privilege_fields.begin(); fit !=
+        task->regions[0].privilege_fields.end(); fit++)
+  {
+    RegionAccessor<AccessorType::Generic, double> acc =
+      regions[0].get_field_accessor(*fit).typeify<double>();
+    for (GenericPointInRectIterator<1> pir(rect); pir; pir++)
+    {
+      DomainPoint dp = DomainPoint::from_point<1>(pir.p);
+      acc.write(dp, acc.read(dp) + 1.0);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  HighLevelRuntime::set_top_level_task_id(TOP_LEVEL_TASK_ID);
+  HighLevelRuntime::register_legion_task<top_level_task>(TOP_LEVEL_TASK_ID,
+      Processor::LOC_PROC, true/*single*/, false/*index*/);
+  HighLevelRuntime::register_legion_task<write_task>(WRITE_TASK_ID,
+      Processor::LOC_PROC, true/*single*/, false/*index*/,
+      AUTO_GENERATE_ID, TaskConfigOptions(true/*leaf*/), "write_task");
+  HighLevelRuntime::set_registration_callback(mapper_registration);
+
+  return HighLevelRuntime::start(argc, argv);
+}
@@ -0,0 +1,222 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// STREAM-style memory bandwidth from every CPU processor to every memory
+//  it has an affinity to.  For each (processor, memory) pair three
+//  arrays of doubles are created in the memory and a task on the
+//  processor runs the four STREAM kernels over them:
+//
+//   copy:  c = a          scale: b = s*c
+//   add:   c = a + b      triad: a = b + s*c
+//
+// reporting the best GB/s of each kernel over several repetitions next
+//  to the bandwidth and latency the runtime announced for the pair.  With
+//  the general low-level runtime and -ll:nsize, a processor's own NUMA
+//  memory and the other domains' memories show up as separate rows, so
+//  local and remote bandwidth can be compared directly.  Memories that
+//  can't be accessed through a pointer (e.g. GASNet memory) and
+//  processors on other nodes are skipped.  Builds against the shared
+//  low-level runtime by default; pass SHARED_LOWLEVEL=0 to build against
+//  the general one.
+//
+// Usage: stream_bench [-n <elements>] [-r <repetitions>]
+
+#include "lowlevel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+
+using namespace LegionRuntime::LowLevel;
+using namespace LegionRuntime::Accessor;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE,
+  STREAM_TASK,
+};
+
+enum StreamKernel {
+  KERNEL_COPY,
+  KERNEL_SCALE,
+  KERNEL_ADD,
+  KERNEL_TRIAD,
+  NUM_KERNELS,
+};
+
+static const char *kernel_names[NUM_KERNELS] = { "copy", "scale", "add",
+                                                 "triad" };
+// arrays read and written by each kernel
+static const int kernel_arrays[NUM_KERNELS] = { 2, 2, 3, 3 };
+
+struct BenchArgs {
+  size_t elements;
+  int reps;
+};
+
+// Everything is on the top-level task's node, so the stream task can
+//  write its results straight back through a pointer
+struct StreamArgs {
+  double *a, *b, *c;
+  size_t elements;
+  int reps;
+  double *best_seconds;
+};
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void stream_task(const void *args, size_t arglen, Processor p)
+{
+  const StreamArgs *stream = (const StreamArgs*)args;
+  double *a = stream->a, *b = stream->b, *c = stream->c;
+  const size_t n = stream->elements;
+  const double scalar = 3.0;
+  // first touch happens here, on the processor being measured
+  for (size_t i = 0; i < n; i++)
+  {
+    a[i] = 1.0;
+    b[i] = 2.0;
+    c[i] = 0.0;
+  }
+  for (int k = 0; k < NUM_KERNELS; k++)
+    stream->best_seconds[k] = 0.0;
+  for (int r = 0; r < stream->reps; r++)
+  {
+    double times[NUM_KERNELS];
+    double start = now_in_seconds();
+    for (size_t i = 0; i < n; i++)
+      c[i] = a[i];
+    times[KERNEL_COPY] = now_in_seconds() - start;
+    start = now_in_seconds();
+    for (size_t i = 0; i < n; i++)
+      b[i] = scalar * c[i];
+    times[KERNEL_SCALE] = now_in_seconds() - start;
+    start = now_in_seconds();
+    for (size_t i = 0; i < n; i++)
+      c[i] = a[i] + b[i];
+    times[KERNEL_ADD] = now_in_seconds() - start;
+    start = now_in_seconds();
+    for (size_t i = 0; i < n; i++)
+      a[i] = b[i] + scalar * c[i];
+    times[KERNEL_TRIAD] = now_in_seconds() - start;
+    for (int k = 0; k < NUM_KERNELS; k++)
+      if ((r == 0) || (times[k] < stream->best_seconds[k]))
+        stream->best_seconds[k] = times[k];
+  }
+}
+
+// Returns a pointer to the instance's data, or NULL if the memory it
+//  lives in can't be accessed directly
+static double *instance_base(RegionInstance inst)
+{
+  RegionAccessor<AccessorType::Generic, double> acc =
+    inst.get_accessor().typeify<double>();
+  if (!acc.can_convert<AccessorType::SOA<sizeof(double)> >())
+    return NULL;
+  RegionAccessor<AccessorType::SOA<sizeof(double)>, double> soa =
+    acc.convert<AccessorType::SOA<sizeof(double)> >();
+  return &soa.ref(ptr_t(0));
+}
+
+static void top_level_task(const void *args, size_t arglen, Processor p)
+{
+  const BenchArgs *bench = (const BenchArgs*)args;
+  Machine *machine = Machine::get_machine();
+
+  ElementMask mask(bench->elements);
+  mask.enable(0, bench->elements);
+  Domain domain(IndexSpace::create_index_space(mask));
+
+  printf("%zd doubles per array, best of %d repetitions\n",
+         bench->elements, bench->reps);
+  printf("%10s %10s %6s %6s", "proc", "memory", "bw", "lat");
+  for (int k = 0; k < NUM_KERNELS; k++)
+    printf(" %8s", kernel_names[k]);
+  printf("  (GB/s)\n");
+
+  const std::set<Processor> &procs = machine->get_all_processors();
+  for (std::set<Processor>::const_iterator pit = procs.begin();
+        pit != procs.end(); pit++)
+  {
+    if ((machine->get_processor_kind(*pit) != Processor::LOC_PROC) ||
+        (pit->address_space() != p.address_space()))
+      continue;
+    std::vector<Machine::ProcessorMemoryAffinity> affinities;
+    machine->get_proc_mem_affinity(affinities, *pit);
+    for (unsigned idx = 0; idx < affinities.size(); idx++)
+    {
+      Memory m = affinities[idx].m;
+      if (m.address_space() != p.address_space())
+        continue;
+      RegionInstance a = domain.create_instance(m, sizeof(double));
+      RegionInstance b = domain.create_instance(m, sizeof(double));
+      RegionInstance c = domain.create_instance(m, sizeof(double));
+      StreamArgs stream;
+      stream.a = (a.exists() ? instance_base(a) : NULL);
+      stream.b = (b.exists() ? instance_base(b) : NULL);
+      stream.c = (c.exists() ? instance_base(c) : NULL);
+      if (stream.a && stream.b && stream.c)
+      {
+        double best_seconds[NUM_KERNELS];
+        stream.elements = bench->elements;
+        stream.reps = bench->reps;
+        stream.best_seconds = best_seconds;
+        pit->spawn(STREAM_TASK, &stream, sizeof(stream)).wait();
+        printf("%10llx %10llx %6d %6d",
+               (unsigned long long)pit->id, (unsigned long long)m.id,
+               affinities[idx].bandwidth, affinities[idx].latency);
+        for (int k = 0; k < NUM_KERNELS; k++)
+          printf(" %8.2f", kernel_arrays[k] * sizeof(double) *
+                 bench->elements / best_seconds[k] * 1e-9);
+        printf("\n");
+      }
+      if (a.exists())
+        a.destroy();
+      if (b.exists())
+        b.destroy();
+      if (c.exists())
+        c.destroy();
+    }
+  }
+  machine->shutdown();
+}
+
+int main(int argc, char **argv)
+{
+  BenchArgs bench;
+  bench.elements = 1 << 21;
+  bench.reps = 10;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-n") && (i+1) < argc)
+      bench.elements = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && (i+1) < argc)
+      bench.reps = atoi(argv[++i]);
+  }
+
+  Processor::TaskIDTable task_table;
+  task_table[TOP_LEVEL_TASK] = top_level_task;
+  task_table[STREAM_TASK] = stream_task;
+  ReductionOpTable redop_table;
+  Machine machine(&argc, &argv, task_table, redop_table, false/*cps style*/);
+  machine.run(TOP_LEVEL_TASK, Machine::ONE_TASK_ONLY, &bench, sizeof(bench));
+  return 0;
+}
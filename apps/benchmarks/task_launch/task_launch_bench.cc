@@ -0,0 +1,123 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Task launch throughput of the high-level runtime: N empty tasks
+//  launched one at a time, and one index space launch of N empty
+//  points.  Neither kind of task has region requirements, so the time
+//  is spent creating, mapping, scheduling, and recycling operations.
+//  Each launch kind is repeated and the best round is reported.
+//
+// Usage: task_launch_bench [-n <tasks>] [-r <rounds>]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+#include "legion.h"
+using namespace LegionRuntime::HighLevel;
+
+enum TaskIDs {
+  TOP_LEVEL_TASK_ID,
+  EMPTY_TASK_ID,
+};
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static double launch_individual(Context ctx, HighLevelRuntime *runtime,
+                                int num_tasks)
+{
+  double start = now_in_seconds();
+  std::vector<Future> futures;
+  futures.reserve(num_tasks);
+  for (int i = 0; i < num_tasks; i++)
+  {
+    TaskLauncher launcher(EMPTY_TASK_ID, TaskArgument(NULL, 0));
+    futures.push_back(runtime->execute_task(ctx, launcher));
+  }
+  for (int i = 0; i < num_tasks; i++)
+    futures[i].get_void_result();
+  return now_in_seconds() - start;
+}
+
+static double launch_index(Context ctx, HighLevelRuntime *runtime,
+                           int num_tasks)
+{
+  double start = now_in_seconds();
+  Rect<1> launch_bounds(Point<1>(0),Point<1>(num_tasks-1));
+  ArgumentMap arg_map;
+  IndexLauncher launcher(EMPTY_TASK_ID, Domain::from_rect<1>(launch_bounds),
+                         TaskArgument(NULL, 0), arg_map);
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+  fm.wait_all_results();
+  return now_in_seconds() - start;
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, HighLevelRuntime *runtime)
+{
+  int num_tasks = 10000;
+  int rounds = 5;
+  const InputArgs &command_args = HighLevelRuntime::get_input_args();
+  for (int i = 1; i < command_args.argc; i++)
+  {
+    if (!strcmp(command_args.argv[i], "-n") && (i+1) < command_args.argc)
+      num_tasks = atoi(command_args.argv[++i]);
+    else if (!strcmp(command_args.argv[i], "-r") &&
+             (i+1) < command_args.argc)
+      rounds = atoi(command_args.argv[++i]);
+  }
+  assert(num_tasks > 0);
+
+  printf("%-12s %8s %8s %14s %12s\n", "launch", "tasks", "rounds",
+         "best tasks/s", "us/task");
+  for (int kind = 0; kind < 2; kind++)
+  {
+    double best = 0.0;
+    for (int r = 0; r < rounds; r++)
+    {
+      double elapsed = kind ? launch_index(ctx, runtime, num_tasks) :
+                              launch_individual(ctx, runtime, num_tasks);
+      if ((r == 0) || (elapsed < best))
+        best = elapsed;
+    }
+    printf("%-12s %8d %8d %14.0f %12.2f\n", kind ? "index" : "individual",
+           num_tasks, rounds, num_tasks / best, best * 1e6 / num_tasks);
+  }
+}
+
+void empty_task(const Task *task,
+                const std::vector<PhysicalRegion> &regions,
+                Context ctx, HighLevelRuntime *runtime)
+{
+}
+
+int main(int argc, char **argv)
+{
+  HighLevelRuntime::set_top_level_task_id(TOP_LEVEL_TASK_ID);
+  HighLevelRuntime::register_legion_task<top_level_task>(TOP_LEVEL_TASK_ID,
+      Processor::LOC_PROC, true/*single*/, false/*index*/);
+  HighLevelRuntime::register_legion_task<empty_task>(EMPTY_TASK_ID,
+      Processor::LOC_PROC, true/*single*/, true/*index*/,
+      AUTO_GENERATE_ID, TaskConfigOptions(true/*leaf*/), "empty_task");
+
+  return HighLevelRuntime::start(argc, argv);
+}
@@ -0,0 +1,291 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Bandwidth of copies between instances with different layouts, over
+//  a matrix of field counts, field sizes and block factors.  A block
+//  factor of 1 is an array-of-structs layout, a block factor equal to
+//  the number of elements is struct-of-arrays, and anything in between
+//  is a hybrid.  Every copy moves all of the fields of the instance in
+//  a single Domain::copy.  After each copy the destination is checked
+//  against the source.  Builds against the shared low-level runtime by
+//  default; pass SHARED_LOWLEVEL=0 to build against the general one,
+//  where these copies go through the strided transposing path.
+//
+// Reductions between layouts take the same path with a different
+//  stride on each side, so a second table reduces every field of a
+//  source into the matching field of a destination, applying and
+//  folding, and checks the sums.  These use a 1-D rectangle, since the
+//  general runtime only hands rectangle reductions to the span copiers,
+//  and so only run there (the shared runtime can't copy rectangles).
+//
+// Usage: transpose_bench [-e <elements>] [-r <repetitions>]
+
+#include "lowlevel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+
+using namespace LegionRuntime::LowLevel;
+using namespace LegionRuntime::Accessor;
+using namespace LegionRuntime::Arrays;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE,
+};
+
+enum {
+  REDOP_SUM_ID = 1,
+};
+
+class DoubleSum {
+public:
+  typedef double LHS;
+  typedef double RHS;
+  static const double identity;
+
+  template <bool EXCLUSIVE> static void apply(LHS &lhs, RHS rhs)
+  {
+    lhs += rhs;
+  }
+  template <bool EXCLUSIVE> static void fold(RHS &rhs1, RHS rhs2)
+  {
+    rhs1 += rhs2;
+  }
+};
+
+const double DoubleSum::identity = 0.0;
+
+struct BenchArgs {
+  int elements;
+  int reps;
+};
+
+static double now_in_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// fills every field of every element with a pattern derived from its
+//  position, or checks that the pattern is there
+static bool fill_or_check(RegionInstance inst, int elements,
+                          const std::vector<size_t> &field_sizes, bool check)
+{
+  RegionAccessor<AccessorType::Generic> acc = inst.get_accessor();
+  std::vector<char> buffer(32);
+  size_t offset = 0;
+  for (unsigned f = 0; f < field_sizes.size(); f++)
+  {
+    RegionAccessor<AccessorType::Generic> fa =
+      acc.get_untyped_field_accessor(offset, field_sizes[f]);
+    for (int e = 0; e < elements; e++)
+    {
+      ptr_t ptr(e);
+      for (unsigned b = 0; b < field_sizes[f]; b++)
+        buffer[b] = (char)(e * 31 + f * 7 + b);
+      if (check)
+      {
+        std::vector<char> actual(field_sizes[f]);
+        fa.read_untyped(ptr, &actual[0], field_sizes[f]);
+        if (memcmp(&actual[0], &buffer[0], field_sizes[f]))
+          return false;
+      }
+      else
+        fa.write_untyped(ptr, &buffer[0], field_sizes[f]);
+    }
+    offset += field_sizes[f];
+  }
+  return true;
+}
+
+#ifndef SHARED_LOWLEVEL
+// reduces each double field of a source into the same field of a
+//  destination with a different block factor and checks every sum
+static bool check_reductions(Memory mem, int elements, int fields,
+                             size_t src_block, size_t dst_block, bool fold)
+{
+  Domain domain = Domain::from_rect<1>(Rect<1>(Point<1>(0),
+                                               Point<1>(elements - 1)));
+  std::vector<size_t> sizes(fields, sizeof(double));
+  RegionInstance src = domain.create_instance(mem, sizes, src_block);
+  RegionInstance dst = domain.create_instance(mem, sizes, dst_block);
+  assert(src.exists() && dst.exists());
+  RegionAccessor<AccessorType::Generic> src_acc = src.get_accessor();
+  RegionAccessor<AccessorType::Generic> dst_acc = dst.get_accessor();
+  for (int f = 0; f < fields; f++)
+  {
+    RegionAccessor<AccessorType::Generic> sa =
+      src_acc.get_untyped_field_accessor(f * sizeof(double), sizeof(double));
+    RegionAccessor<AccessorType::Generic> da =
+      dst_acc.get_untyped_field_accessor(f * sizeof(double), sizeof(double));
+    for (int e = 0; e < elements; e++)
+    {
+      DomainPoint dp = DomainPoint::from_point<1>(Point<1>(e));
+      double sval = e + 0.25 * f;
+      double dval = 1000.0 * (f + 1);
+      sa.write_untyped(dp, &sval, sizeof(sval));
+      da.write_untyped(dp, &dval, sizeof(dval));
+    }
+  }
+  for (int f = 0; f < fields; f++)
+  {
+    std::vector<Domain::CopySrcDstField> srcs, dsts;
+    srcs.push_back(Domain::CopySrcDstField(src, f * sizeof(double),
+                                           sizeof(double)));
+    dsts.push_back(Domain::CopySrcDstField(dst, f * sizeof(double),
+                                           sizeof(double)));
+    domain.copy(srcs, dsts, Event::NO_EVENT, REDOP_SUM_ID, fold).wait();
+  }
+  bool ok = true;
+  for (int f = 0; ok && (f < fields); f++)
+  {
+    RegionAccessor<AccessorType::Generic> da =
+      dst_acc.get_untyped_field_accessor(f * sizeof(double), sizeof(double));
+    for (int e = 0; e < elements; e++)
+    {
+      double actual;
+      da.read_untyped(DomainPoint::from_point<1>(Point<1>(e)),
+                      &actual, sizeof(actual));
+      if (actual != (1000.0 * (f + 1) + e + 0.25 * f))
+      {
+        ok = false;
+        break;
+      }
+    }
+  }
+  src.destroy();
+  dst.destroy();
+  return ok;
+}
+#endif
+
+static void top_level_task(const void *args, size_t arglen, Processor p)
+{
+  const BenchArgs *bench = (const BenchArgs*)args;
+  Machine *machine = Machine::get_machine();
+  // use the largest memory for both sides
+  Memory mem = Memory::NO_MEMORY;
+  const std::set<Memory> &mems = machine->get_all_memories();
+  for (std::set<Memory>::const_iterator it = mems.begin();
+        it != mems.end(); it++)
+    if (!mem.exists() ||
+        (machine->get_memory_size(*it) > machine->get_memory_size(mem)))
+      mem = *it;
+
+  ElementMask mask(bench->elements);
+  mask.enable(0, bench->elements);
+  Domain domain(IndexSpace::create_index_space(mask));
+
+  const int field_counts[] = { 1, 4, 16 };
+  const size_t field_sizes[] = { 4, 8, 16 };
+  // pairs of (source, destination) block factors, 0 means SOA
+  const int layouts[][2] = { { 1, 0 }, { 0, 1 }, { 1, 1 }, { 64, 0 },
+                             { 0, 64 }, { 16, 64 } };
+  const int num_layouts = sizeof(layouts) / sizeof(layouts[0]);
+
+  printf("%6s %6s %8s %8s %12s %8s\n", "fields", "bytes", "src blk",
+         "dst blk", "MB/s", "check");
+  bool all_ok = true;
+  for (unsigned fc = 0; fc < 3; fc++)
+    for (unsigned fs = 0; fs < 3; fs++)
+      for (int l = 0; l < num_layouts; l++)
+      {
+        std::vector<size_t> sizes(field_counts[fc], field_sizes[fs]);
+        size_t src_block = layouts[l][0] ? layouts[l][0] : bench->elements;
+        size_t dst_block = layouts[l][1] ? layouts[l][1] : bench->elements;
+        RegionInstance src = domain.create_instance(mem, sizes, src_block);
+        RegionInstance dst = domain.create_instance(mem, sizes, dst_block);
+        if (!src.exists() || !dst.exists())
+        {
+          printf("ERROR: unable to create instances, try a larger "
+                 "-ll:csize or a smaller -e\n");
+          machine->shutdown();
+          return;
+        }
+        std::vector<Domain::CopySrcDstField> srcs, dsts;
+        size_t offset = 0;
+        for (unsigned f = 0; f < sizes.size(); f++)
+        {
+          srcs.push_back(Domain::CopySrcDstField(src, offset, sizes[f]));
+          dsts.push_back(Domain::CopySrcDstField(dst, offset, sizes[f]));
+          offset += sizes[f];
+        }
+        fill_or_check(src, bench->elements, sizes, false/*check*/);
+        double start = now_in_seconds();
+        for (int r = 0; r < bench->reps; r++)
+          domain.copy(srcs, dsts).wait();
+        double elapsed = now_in_seconds() - start;
+        bool ok = fill_or_check(dst, bench->elements, sizes, true/*check*/);
+        all_ok = all_ok && ok;
+        double bytes = (double)offset * bench->elements * bench->reps;
+        printf("%6d %6zd %8zd %8zd %12.1f %8s\n", field_counts[fc],
+               field_sizes[fs], src_block, dst_block,
+               bytes / elapsed / (1 << 20), ok ? "OK" : "FAILED");
+        src.destroy();
+        dst.destroy();
+      }
+
+#ifndef SHARED_LOWLEVEL
+  printf("\n%6s %6s %8s %8s %8s %8s\n", "fields", "bytes", "src blk",
+         "dst blk", "redop", "check");
+  for (int l = 0; l < num_layouts; l++)
+    for (int fold = 0; fold < 2; fold++)
+    {
+      // one field of an AOS pair isn't contiguous and the span copiers
+      //  don't take it, and with equal strides there's nothing to check
+      if ((layouts[l][0] == 1) && (layouts[l][1] == 1))
+        continue;
+      const int fields = 4;
+      size_t src_block = layouts[l][0] ? layouts[l][0] : bench->elements;
+      size_t dst_block = layouts[l][1] ? layouts[l][1] : bench->elements;
+      bool ok = check_reductions(mem, bench->elements, fields,
+                                 src_block, dst_block, fold);
+      all_ok = all_ok && ok;
+      printf("%6d %6zd %8zd %8zd %8s %8s\n", fields, sizeof(double),
+             src_block, dst_block, fold ? "fold" : "apply",
+             ok ? "OK" : "FAILED");
+    }
+#endif
+  if (!all_ok)
+    printf("ERROR: some copies produced the wrong data\n");
+  machine->shutdown();
+}
+
+int main(int argc, char **argv)
+{
+  BenchArgs bench;
+  bench.elements = 1 << 14;
+  bench.reps = 4;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-e") && (i+1) < argc)
+      bench.elements = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && (i+1) < argc)
+      bench.reps = atoi(argv[++i]);
+  }
+
+  Processor::TaskIDTable task_table;
+  task_table[TOP_LEVEL_TASK] = top_level_task;
+  ReductionOpTable redop_table;
+  redop_table[REDOP_SUM_ID] =
+    ReductionOpUntyped::create_reduction_op<DoubleSum>();
+  Machine machine(&argc, &argv, task_table, redop_table, false/*cps style*/);
+  machine.run(TOP_LEVEL_TASK, Machine::ONE_TASK_ONLY, &bench, sizeof(bench));
+  return 0;
+}
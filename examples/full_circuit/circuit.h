@@ -118,6 +118,17 @@ public:
   template <bool EXCLUSIVE> static void fold(RHS &rhs1, RHS rhs2);
 };
 
+// AccumulateCharge is a plain float sum, so let the runtime use
+// vectorized kernels when it applies/folds whole reduction instances
+namespace LegionRuntime {
+  namespace LowLevel {
+    template <>
+    struct ReductionVectorTraits<AccumulateCharge> {
+      static const ReductionVectorKind KIND = REDOP_VECTOR_SUM;
+    };
+  };
+};
+
 class CalcNewCurrentsTask : public IndexLauncher {
 public:
   CalcNewCurrentsTask(LogicalPartition lp_pvt_wires,
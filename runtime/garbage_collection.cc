@@ -356,6 +356,8 @@ namespace LegionRuntime {
     void DistributedCollectable::add_gc_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_add_reference(&gc_references, cnt))
+        return;
       bool need_activate = false;
       bool need_validate = false;
       bool need_invalidate = false;
@@ -376,7 +378,7 @@ namespace LegionRuntime {
         AutoLock gc(gc_lock);
         if (first)
         {
-          gc_references += cnt;
+          __sync_fetch_and_add(&gc_references, cnt);
           first = false;
         }
         done = update_state((gc_references > 0),
@@ -401,6 +403,8 @@ namespace LegionRuntime {
     bool DistributedCollectable::remove_gc_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_remove_reference(&gc_references, cnt))
+        return false;
       bool need_activate = false;
       bool need_validate = false;
       bool need_invalidate = false;
@@ -424,7 +428,7 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
           assert(gc_references >= cnt);
 #endif
-          gc_references -= cnt;
+          __sync_fetch_and_sub(&gc_references, cnt);
           first = false;
         }
         done = update_state((gc_references > 0),
@@ -443,6 +447,8 @@ namespace LegionRuntime {
     void DistributedCollectable::add_valid_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_add_reference(&valid_references, cnt))
+        return;
       bool need_activate = false;
       bool need_validate = false;
       bool need_invalidate = false;
@@ -463,7 +469,7 @@ namespace LegionRuntime {
         AutoLock gc(gc_lock);
         if (first)
         {
-          valid_references += cnt;
+          __sync_fetch_and_add(&valid_references, cnt);
           first = false;
         }
         done = update_state((gc_references > 0),
@@ -487,6 +493,8 @@ namespace LegionRuntime {
     bool DistributedCollectable::remove_valid_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_remove_reference(&valid_references, cnt))
+        return false;
       bool need_activate = false;
       bool need_validate = false;
       bool need_invalidate = false;
@@ -510,7 +518,7 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
           assert(valid_references >= cnt);
 #endif
-          valid_references -= cnt;
+          __sync_fetch_and_sub(&valid_references, cnt);
           first = false;
         }
         done = update_state((gc_references > 0),
@@ -529,19 +537,23 @@ namespace LegionRuntime {
     void DistributedCollectable::add_resource_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_add_reference(&resource_references, cnt))
+        return;
       AutoLock gc(gc_lock);
-      resource_references += cnt;
+      __sync_fetch_and_add(&resource_references, cnt);
     }
 
     //--------------------------------------------------------------------------
     bool DistributedCollectable::remove_resource_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_remove_reference(&resource_references, cnt))
+        return false;
       AutoLock gc(gc_lock);
 #ifdef DEBUG_HIGH_LEVEL
       assert(resource_references >= cnt);
 #endif
-      resource_references -= cnt;
+      __sync_fetch_and_sub(&resource_references, cnt);
       return can_delete((gc_references > 0),
                         (owner && !remote_references.empty()),
                         (valid_references > 0),
@@ -837,6 +849,8 @@ namespace LegionRuntime {
     void HierarchicalCollectable::add_gc_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_add_reference(&gc_references, cnt))
+        return;
       bool need_activate = false;
       bool need_validate = false;
       bool need_invalidate = false;
@@ -857,7 +871,7 @@ namespace LegionRuntime {
         AutoLock gc(gc_lock);
         if (first)
         {
-          gc_references += cnt;
+          __sync_fetch_and_add(&gc_references, cnt);
           first = false;
         }
         done = update_state((gc_references > 0),
@@ -882,6 +896,8 @@ namespace LegionRuntime {
     bool HierarchicalCollectable::remove_gc_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_remove_reference(&gc_references, cnt))
+        return false;
       bool need_activate = false;
       bool need_validate = false;
       bool need_invalidate = false;
@@ -905,7 +921,7 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
           assert(gc_references >= cnt);
 #endif
-          gc_references -= cnt;
+          __sync_fetch_and_sub(&gc_references, cnt);
           first = false;
         }
         done = update_state((gc_references > 0),
@@ -924,6 +940,8 @@ namespace LegionRuntime {
     void HierarchicalCollectable::add_valid_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_add_reference(&valid_references, cnt))
+        return;
       bool need_activate = false;
       bool need_validate = false;
       bool need_invalidate = false;
@@ -944,7 +962,7 @@ namespace LegionRuntime {
         AutoLock gc(gc_lock);
         if (first)
         {
-          valid_references += cnt;
+          __sync_fetch_and_add(&valid_references, cnt);
           first = false;
         }
         done = update_state((gc_references > 0),
@@ -968,6 +986,8 @@ namespace LegionRuntime {
     bool HierarchicalCollectable::remove_valid_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_remove_reference(&valid_references, cnt))
+        return false;
       bool need_activate = false;
       bool need_validate = false;
       bool need_invalidate = false;
@@ -991,7 +1011,7 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
           assert(valid_references >= cnt);
 #endif
-          valid_references -= cnt;
+          __sync_fetch_and_sub(&valid_references, cnt);
           first = false;
         }
         done = update_state((gc_references > 0),
@@ -1010,19 +1030,23 @@ namespace LegionRuntime {
     void HierarchicalCollectable::add_resource_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_add_reference(&resource_references, cnt))
+        return;
       AutoLock gc(gc_lock);
-      resource_references += cnt;
+      __sync_fetch_and_add(&resource_references, cnt);
     }
 
     //--------------------------------------------------------------------------
     bool HierarchicalCollectable::remove_resource_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_remove_reference(&resource_references, cnt))
+        return false;
       AutoLock gc(gc_lock);
 #ifdef DEBUG_HIGH_LEVEL
       assert(resource_references >= cnt);
 #endif
-      resource_references -= cnt;
+      __sync_fetch_and_sub(&resource_references, cnt);
       return can_delete((gc_references > 0),
                         (remote_references > 0),
                         (valid_references > 0),
@@ -1033,6 +1057,8 @@ namespace LegionRuntime {
     void HierarchicalCollectable::add_remote_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_add_reference(&remote_references, cnt))
+        return;
       bool need_activate = false;
       bool need_validate = false;
       bool need_invalidate = false;
@@ -1053,7 +1079,7 @@ namespace LegionRuntime {
         AutoLock gc(gc_lock);
         if (first)
         {
-          remote_references += cnt;
+          __sync_fetch_and_add(&remote_references, cnt);
           first = false;
         }
         done = update_state((gc_references > 0),
@@ -1077,6 +1103,8 @@ namespace LegionRuntime {
     bool HierarchicalCollectable::remove_remote_reference(unsigned cnt /*=1*/)
     //--------------------------------------------------------------------------
     {
+      if (try_remove_reference(&remote_references, cnt))
+        return false;
       bool need_activate = false;
       bool need_validate = false;
       bool need_invalidate = false;
@@ -1100,7 +1128,7 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
           assert(remote_references >= cnt);
 #endif
-          remote_references -= cnt;
+          __sync_fetch_and_sub(&remote_references, cnt);
           first = false;
         }
         done = update_state((gc_references > 0),
@@ -99,6 +99,13 @@ namespace LegionRuntime {
                       bool has_remote_references,
                       bool has_valid_references,
                       bool has_resource_references);
+    protected:
+      // Reference counts only move to or from zero while holding the
+      // gc lock, which is the only time the state can change.  These 
+      // try to update a count without the lock and fail if the update 
+      // would move it to or from zero and needs the state machine.
+      static inline bool try_add_reference(unsigned *count, unsigned cnt);
+      static inline bool try_remove_reference(unsigned *count, unsigned cnt);
     protected:
       State current_state;
     };
@@ -297,6 +304,40 @@ namespace LegionRuntime {
       return (prev == cnt);
     }
 
+    //--------------------------------------------------------------------------
+    /*static*/ inline bool CollectableState::try_add_reference(unsigned *count,
+                                                               unsigned cnt)
+    //--------------------------------------------------------------------------
+    {
+      unsigned current = *((volatile unsigned*)count);
+      while (current > 0)
+      {
+        unsigned prev = __sync_val_compare_and_swap(count, current, 
+                                                    current + cnt);
+        if (prev == current)
+          return true;
+        current = prev;
+      }
+      return false;
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ inline bool CollectableState::try_remove_reference(
+                                                 unsigned *count, unsigned cnt)
+    //--------------------------------------------------------------------------
+    {
+      unsigned current = *((volatile unsigned*)count);
+      while (current > cnt)
+      {
+        unsigned prev = __sync_val_compare_and_swap(count, current,
+                                                    current - cnt);
+        if (prev == current)
+          return true;
+        current = prev;
+      }
+      return false;
+    }
+
   }; // namespace HighLevel 
 }; // namespace LegionRuntime
 
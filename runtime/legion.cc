@@ -57,15 +57,6 @@ namespace LegionRuntime {
     };
 #endif
 
-#ifdef LEGION_PROF
-    namespace LegionProf {
-      Logger::Category log_prof("legion_prof");
-      ProcessorProfiler *legion_prof_table = 
-        new ProcessorProfiler[MAX_NUM_PROCS + 1];
-      bool profiling_enabled;
-    };
-#endif
-
     const LogicalRegion LogicalRegion::NO_REGION = LogicalRegion();
     const LogicalPartition LogicalPartition::NO_PART = LogicalPartition(); 
 
@@ -3519,6 +3510,13 @@ namespace LegionRuntime {
       return runtime->runtime->sample_free_space(mem);
     }
 
+    //--------------------------------------------------------------------------
+    size_t Mapper::sample_largest_free_block(Memory mem) const
+    //--------------------------------------------------------------------------
+    {
+      return runtime->runtime->sample_largest_free_block(mem);
+    }
+
     //--------------------------------------------------------------------------
     unsigned Mapper::sample_allocated_instances(Memory mem) const
     //--------------------------------------------------------------------------
@@ -2598,6 +2598,17 @@ namespace LegionRuntime {
        */
       size_t sample_free_space(Memory m) const;
 
+      /**
+       * Take a sample of the largest contiguous block of free
+       * memory in a specific memory.  Comparing this against
+       * the result of sample_free_space gives a measure of
+       * how fragmented the memory is.  Like the other samples
+       * this may return different values in consecutive calls.
+       * @param m the memory to be sampled
+       * @return size in bytes of the largest free block in the memory
+       */
+      size_t sample_largest_free_block(Memory m) const;
+
       /**
        * Take a sample of the number of instances allocated in
        * a specific memory. Note that this is just a sample and
@@ -4074,11 +4085,59 @@ namespace LegionRuntime {
        *              per-pair-of-node RDMA buffers in the low-level
        *              runtime.  Default value is 4K which should guarantee
        *              medium sized active messages on Infiniband clusters.
+       * -hl:aggregate <int> Number of bytes of messages to accumulate
+       *              for a node before honoring a flush request.  Messages
+       *              held back are sent once the previous message to the
+       *              node has been handled, or with the next message
+       *              to the node after the deadline given by 
+       *              -hl:msgdeadline.  Default is 0 which sends
+       *              messages as soon as they are flushed.
+       * -hl:msgdeadline <int> Number of microseconds after which held
+       *              back messages go out with the next message to the
+       *              node.  Setting this to 0 disables aggregation.
+       *              Default 100.
+       * -hl:msgstats Report per-node message counts, bytes, and batch
+       *              sizes for each kind of message at shutdown.
        * ---------------------
        *  Dependence Analysis
        * ---------------------
        * -hl:filter <int> Maximum number of tasks allowed in logical
        *              or physical epochs.  Default value is 32.
+       * -hl:userindex <int> Number of users in a logical epoch list 
+       *              above which the users are indexed by field so
+       *              dependence analysis only visits users of the
+       *              fields being accessed.  Zero disables the index.
+       *              Default value is 0.
+       * -hl:intercache <int> Maximum number of intersection and 
+       *              dominance results cached on each index space or
+       *              partition.  Zero is unbounded.  Default is 1024.
+       * -hl:interference <int> Aliased partitions with at most this
+       *              many subspaces have the interference between
+       *              their subspaces computed in the background when
+       *              created.  Zero disables.  Default is 4096.
+       * -hl:flatdepth <int> Composite views with at least this many
+       *              levels of nested composite views remember the
+       *              copies they issue for each destination so that
+       *              later updates of it skip walking the composite
+       *              tree and ranking copy sources.  Zero disables.
+       *              Default is 0.
+       * -hl:flatnodes <int> Same as -hl:flatdepth but for composite
+       *              views with at least this many composite nodes.
+       *              Zero disables.  Default is 0.
+       * -hl:flatcheck Issue no copies while walking the composite tree
+       *              to build a plan and replay the plan instead, so
+       *              every flattened update is done by a replay and
+       *              the results can be checked against a tree walk.
+       * -hl:compstats Report the depth and size of the composite
+       *              views made by closes and the average time to
+       *              issue copies from them at shutdown.
+       * -hl:footprint Report at shutdown the peak number of per-context
+       *              logical and physical states region tree nodes held
+       *              at once and the peak memory they took.
+       * -hl:depstats Report the number of operations, maximum queue
+       *              depth and average wait and analysis times for
+       *              each region tree's dependence analysis shard
+       *              on every processor at shutdown.
        * -hl:imprecise Enable imprecise filtering. This improves the
        *              effectiveness of the previous flag at the cost that
        *              it may add imprecision to the analysis and introduce
@@ -4092,6 +4151,17 @@ namespace LegionRuntime {
        *              the garbage collection but makes it more efficient.
        *              Decreasing the value reduces latency, but adds
        *              inefficiency to the collection.
+       * -hl:gcstats Report the number of garbage collection epochs,
+       *              their average size and latency, and how many
+       *              users and views they reclaimed at shutdown.
+       * -hl:metrics <int> Record runtime metrics (scheduler, dependence
+       *              analysis and mapping latencies, messages, DMAs
+       *              and allocations) and dump a snapshot of them every
+       *              <int> milliseconds and at shutdown.  Zero, the
+       *              default, disables metrics.
+       * -hl:metricsfile <prefix> Write the snapshots to
+       *              <prefix>_<node>.metrics instead of logging them
+       *              under the 'metrics' category.
        * ---------------------
        *  Resiliency
        * ---------------------
@@ -4125,6 +4195,18 @@ namespace LegionRuntime {
        *              all nodes are enabled.  Zero will disable all
        *              profiling while each number greater than zero will
        *              profile on that number of nodes.
+       * -hl:proffile <prefix> Stream profiling records in binary form
+       *              to <prefix>_<node>.prof while the application runs
+       *              instead of logging them as text at shutdown.  Pass
+       *              the files to tools/legion_prof.py as usual.
+       * -------------
+       *  Legion Spy
+       * -------------
+       * -hl:spyfile <prefix> Write Legion Spy records in a compact
+       *              binary form to <prefix>_<node>.spy instead of
+       *              logging them as text.  The runtime must be
+       *              compiled with the LEGION_SPY macro defined.  Pass
+       *              the files to tools/legion_spy.py as usual.
        *
        * @param argc the number of input arguments
        * @param argv pointer to an array of string arguments of size argc
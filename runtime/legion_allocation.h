@@ -113,6 +113,9 @@ namespace LegionRuntime {
       TASK_LOCAL_FIELD_ALLOC,
       TASK_INLINE_ALLOC,
       SEMANTIC_INFO_ALLOC,
+      OPERATION_EDGE_ALLOC,
+      LOGICAL_STATE_ALLOC,
+      PHYSICAL_STATE_ALLOC,
       LAST_ALLOC, // must be last
     };
 
@@ -310,6 +313,57 @@ namespace LegionRuntime {
       delete to_free;
     }
 
+    /**
+     * \class LegionNodeCache
+     * Keeps the small single-object allocations made by Legion
+     * containers (the nodes of the maps, sets, and lists that
+     * operations clear every time they are recycled) on per-thread
+     * free lists so that steady-state activate/deactivate cycles
+     * don't have to go back to the heap.  Each thread caches a
+     * bounded number of nodes of each size class; anything beyond
+     * that goes back to the heap.
+     */
+    class LegionNodeCache {
+    public:
+      static const size_t GRANULE_SIZE = 16;
+      static const size_t MAX_NODE_SIZE = 128;
+      static const unsigned NUM_SIZE_CLASSES = MAX_NODE_SIZE / GRANULE_SIZE;
+      static const unsigned MAX_CACHED_NODES = 1024;
+    public:
+      static inline void* allocate(size_t size)
+      {
+        const unsigned size_class = (size - 1) / GRANULE_SIZE;
+        FreeNode *result = free_nodes[size_class];
+        if (result != NULL)
+        {
+          free_nodes[size_class] = result->next;
+          num_free_nodes[size_class]--;
+          return result;
+        }
+        return ::operator new((size_class + 1) * GRANULE_SIZE);
+      }
+      static inline void release(void *ptr, size_t size)
+      {
+        const unsigned size_class = (size - 1) / GRANULE_SIZE;
+        if (num_free_nodes[size_class] == MAX_CACHED_NODES)
+        {
+          ::operator delete(ptr);
+          return;
+        }
+        FreeNode *node = static_cast<FreeNode*>(ptr);
+        node->next = free_nodes[size_class];
+        free_nodes[size_class] = node;
+        num_free_nodes[size_class]++;
+      }
+    private:
+      struct FreeNode {
+        FreeNode *next;
+      };
+      // Implementations in runtime.cc
+      static __thread FreeNode *free_nodes[NUM_SIZE_CLASSES];
+      static __thread unsigned num_free_nodes[NUM_SIZE_CLASSES];
+    };
+
     /**
      * \class LegionAllocator
      * A custom Legion allocator for tracing memory usage in STL
@@ -359,13 +413,19 @@ namespace LegionRuntime {
 #ifdef TRACE_ALLOCATION
         LegionAllocation::trace_allocation(runtime, A, sizeof(T), cnt);
 #endif
+        if ((cnt == 1) && (sizeof(T) <= LegionNodeCache::MAX_NODE_SIZE))
+          return reinterpret_cast<pointer>(
+                    LegionNodeCache::allocate(alloc_size));
         return reinterpret_cast<pointer>(::operator new(alloc_size));
       }
       inline void deallocate(pointer p, size_type size) {
 #ifdef TRACE_ALLOCATION
         LegionAllocation::trace_free(runtime, A, sizeof(T), size);
 #endif
-        ::operator delete(p);
+        if ((size == 1) && (sizeof(T) <= LegionNodeCache::MAX_NODE_SIZE))
+          LegionNodeCache::release(p, sizeof(T));
+        else
+          ::operator delete(p);
       }
     public:
       inline size_type max_size(void) const {
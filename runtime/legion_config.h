@@ -103,6 +103,24 @@
 #ifndef DEFAULT_MAX_MESSAGE_SIZE
 #define DEFAULT_MAX_MESSAGE_SIZE        16384
 #endif
+// Message aggregation policy: explicitly flushed messages are held
+// back until at least this many bytes are waiting for the same node
+// (zero sends them right away).  Held messages are flushed by a
+// background task once the previous message to the node has been
+// handled, and once they are older than the deadline in microseconds
+// the next message to the node takes them along (zero disables
+// aggregation)
+#ifndef DEFAULT_MESSAGE_AGGREGATION_BYTES
+#define DEFAULT_MESSAGE_AGGREGATION_BYTES 0
+#endif
+#ifndef DEFAULT_MESSAGE_FLUSH_DEADLINE
+#define DEFAULT_MESSAGE_FLUSH_DEADLINE  100
+#endif
+// Number of free buffers of each size class that the runtime keeps
+// for reassembling messages that were broken into several pieces
+#ifndef DEFAULT_MESSAGE_BUFFER_POOL
+#define DEFAULT_MESSAGE_BUFFER_POOL     4
+#endif
 // Maximum number of tasks in logical region node before consolidation
 #ifndef DEFAULT_MAX_FILTER_SIZE
 #define DEFAULT_MAX_FILTER_SIZE         0
@@ -114,6 +132,37 @@
 #ifndef DEFAULT_LOGICAL_USER_TIMEOUT
 #define DEFAULT_LOGICAL_USER_TIMEOUT    32
 #endif
+// Number of users in a logical epoch list beyond which
+// the users are indexed by field for dependence analysis
+// Setting the value to zero always does linear scans
+#ifndef DEFAULT_LOGICAL_INDEX_THRESHOLD
+#define DEFAULT_LOGICAL_INDEX_THRESHOLD 0
+#endif
+// Maximum number of intersection and dominance answers
+// each index tree node caches, zero is unbounded
+#ifndef DEFAULT_INTERSECTION_CACHE_SIZE
+#define DEFAULT_INTERSECTION_CACHE_SIZE 1024
+#endif
+// Aliased partitions with at most this many children
+// get an interference graph computed when created
+#ifndef DEFAULT_MAX_INTERFERENCE_COLORS
+#define DEFAULT_MAX_INTERFERENCE_COLORS 4096
+#endif
+// Composite views with at least this many levels of nested
+// composite views, or at least this many composite nodes,
+// remember the copies they issue for each destination so
+// later updates don't walk the tree again.  Zero disables.
+#ifndef DEFAULT_FLATTEN_DEPTH
+#define DEFAULT_FLATTEN_DEPTH           0
+#endif
+#ifndef DEFAULT_FLATTEN_NODES
+#define DEFAULT_FLATTEN_NODES           0
+#endif
+// Maximum number of destinations each composite view
+// remembers flattened copies for
+#ifndef DEFAULT_MAX_FLAT_PLANS
+#define DEFAULT_MAX_FLAT_PLANS          8
+#endif
 // Number of events to place in each GC epoch
 // Large counts improve efficiency but add latency to
 // garbage collection.  Smaller count reduce efficiency
@@ -122,6 +171,40 @@
 #define DEFAULT_GC_EPOCH_SIZE           64
 #endif
 
+// Number of recycled operations of each kind that a processor keeps
+// for itself before handing them back to the runtime-wide free lists,
+// and how many operations move between the two at a time
+#ifndef DEFAULT_OPERATION_CACHE_SIZE
+#define DEFAULT_OPERATION_CACHE_SIZE    64
+#endif
+#ifndef DEFAULT_OPERATION_CACHE_BATCH
+#define DEFAULT_OPERATION_CACHE_BATCH   16
+#endif
+
+// Size in bytes of the ring buffer each processor uses for
+// binary LegionProf records (must be a power of 2), and how
+// often in microseconds the writer thread drains them to disk
+#ifndef DEFAULT_PROF_BUFFER_SIZE
+#define DEFAULT_PROF_BUFFER_SIZE        (1 << 20)
+#endif
+#ifndef DEFAULT_PROF_FLUSH_INTERVAL
+#define DEFAULT_PROF_FLUSH_INTERVAL     10000
+#endif
+
+// Size in bytes of the blocks each thread fills with binary
+// LegionSpy records, how many filled blocks can wait for the
+// writer thread before loggers stall, and how many recently
+// used events each thread remembers (must be a power of 2)
+#ifndef DEFAULT_SPY_BLOCK_SIZE
+#define DEFAULT_SPY_BLOCK_SIZE          (1 << 16)
+#endif
+#ifndef DEFAULT_SPY_QUEUED_BLOCKS
+#define DEFAULT_SPY_QUEUED_BLOCKS       64
+#endif
+#ifndef DEFAULT_SPY_EVENT_CACHE_SIZE
+#define DEFAULT_SPY_EVENT_CACHE_SIZE    1024
+#endif
+
 // Used for debugging memory leaks
 // How often tracing information is dumped
 // based on the number of scheduler invocations
@@ -277,6 +360,8 @@ typedef enum legion_error_t {
   ERROR_INCONSISTENT_SEMANTIC_TAG = 121,
   ERROR_INVALID_SEMANTIC_TAG = 122,
   ERROR_DUMMY_CONTEXT_OPERATION = 123,
+  ERROR_INVALID_PROFILING_FILE = 124,
+  ERROR_INVALID_SPY_FILE = 125,
 }  legion_error_t;
 
 // enum and namepsaces don't really get along well
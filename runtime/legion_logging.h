@@ -1324,6 +1324,18 @@ namespace LegionRuntime {
         }
       }
 
+      // Thread-safe
+      // Called in RegionTreeNode::issue_update_copies in region_tree.cc
+      static inline void log_event_dependences(Processor p,
+                        const std::vector<Event> &preconditions, Event result)
+      {
+        for (std::vector<Event>::const_iterator it = preconditions.begin();
+              it != preconditions.end(); it++)
+        {
+          log_event_dependence(p, *it, result);
+        }
+      }
+
       // Thread-safe
       // Called in MapOp::trigger_execution in legion_ops.cc
       // Called in CloseOp::trigger_execution in legion_ops.cc
@@ -301,6 +301,13 @@ namespace LegionRuntime {
       assert(false);
     }
 
+    //--------------------------------------------------------------------------
+    void Operation::find_dependence_trees(std::set<RegionTreeID> &trees)
+    //--------------------------------------------------------------------------
+    {
+      // By default operations don't touch any region trees
+    }
+
     //--------------------------------------------------------------------------
     void Operation::complete_mapping(void)
     //--------------------------------------------------------------------------
@@ -310,7 +317,8 @@ namespace LegionRuntime {
       // even after we have mapped.
       bool need_resolution = false;
       bool need_complete = false;
-      std::map<Operation*,GenerationID> outgoing_copy;
+      LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::map
+                                                              outgoing_copy;
       bool use_copy;
       {
         AutoLock o_lock(op_lock);
@@ -339,7 +347,8 @@ namespace LegionRuntime {
         trigger_complete();
       if (use_copy)
       {
-        for (std::map<Operation*,GenerationID>::const_iterator it = 
+        for (LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::
+              map::const_iterator it = 
               outgoing_copy.begin(); it != outgoing_copy.end(); it++)
         {
           it->first->notify_mapping_dependence(it->second);
@@ -347,7 +356,8 @@ namespace LegionRuntime {
       }
       else
       {
-        for (std::map<Operation*,GenerationID>::const_iterator it = 
+        for (LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::
+              map::const_iterator it = 
               outgoing.begin(); it != outgoing.end(); it++)
         {
           it->first->notify_mapping_dependence(it->second);
@@ -403,7 +413,8 @@ namespace LegionRuntime {
       // Mark that we are mapped and make a copy of the outgoing
       // edges that we can read since people can still be adding
       // outgoing dependences even after we have resolved.
-      std::map<Operation*,GenerationID> outgoing_copy;
+      LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::map
+                                                              outgoing_copy;
       bool use_copy;
       bool need_trigger = false;
       {
@@ -423,7 +434,8 @@ namespace LegionRuntime {
       }
       if (use_copy)
       {
-        for (std::map<Operation*,GenerationID>::const_iterator it =
+        for (LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::
+              map::const_iterator it = 
               outgoing_copy.begin(); it != outgoing_copy.end(); it++)
         {
           it->first->notify_speculation_dependence(it->second);
@@ -431,7 +443,8 @@ namespace LegionRuntime {
       }
       else
       {
-        for (std::map<Operation*,GenerationID>::const_iterator it =
+        for (LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::
+              map::const_iterator it = 
               outgoing.begin(); it != outgoing.end(); it++)
         {
           it->first->notify_speculation_dependence(it->second);
@@ -519,7 +532,8 @@ namespace LegionRuntime {
       if (must_epoch != NULL)
         must_epoch->notify_subop_commit(this);
       // Finally tell any incoming edges that we've now committed
-      for (std::map<Operation*,GenerationID>::const_iterator it = 
+      for (LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::
+            map::const_iterator it = 
             incoming.begin(); it != incoming.end(); it++)
       {
         it->first->notify_commit_dependence(it->second);
@@ -684,7 +698,7 @@ namespace LegionRuntime {
                                                 outstanding_speculation_deps,
                                                 all_mapped);
       if (all_mapped.exists())
-        dependent_children_mapped.insert(all_mapped);
+        dependent_children_mapped.push_back(all_mapped);
       if (registered_dependence)
         incoming[target] = target_gen;
       if (tracing)
@@ -747,7 +761,7 @@ namespace LegionRuntime {
                                                 outstanding_speculation_deps,
                                                 all_mapped);
         if (all_mapped.exists())
-          dependent_children_mapped.insert(all_mapped);
+          dependent_children_mapped.push_back(all_mapped);
       }
       if (registered_dependence)
         incoming[target] = target_gen;
@@ -809,7 +823,7 @@ namespace LegionRuntime {
                                                 outstanding_speculation_deps,
                                                 all_mapped);
         if (all_mapped.exists())
-          dependent_children_mapped.insert(all_mapped);
+          dependent_children_mapped.push_back(all_mapped);
       }
       if (registered_dependence)
       {
@@ -853,7 +867,8 @@ namespace LegionRuntime {
         assert(outstanding_mapping_references > 0);
 #endif
         // Check to see if we've already recorded this dependence
-        std::map<Operation*,GenerationID>::const_iterator finder = 
+        LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::map::
+          const_iterator finder = 
           outgoing.find(op);
         if (finder == outgoing.end())
         {
@@ -1816,6 +1831,13 @@ namespace LegionRuntime {
 #endif
     }
 
+    //--------------------------------------------------------------------------
+    void MapOp::find_dependence_trees(std::set<RegionTreeID> &trees)
+    //--------------------------------------------------------------------------
+    {
+      trees.insert(requirement.parent.get_tree_id());
+    }
+
     //--------------------------------------------------------------------------
     bool MapOp::trigger_execution(void)
     //--------------------------------------------------------------------------
@@ -2581,6 +2603,16 @@ namespace LegionRuntime {
 #endif
     }
 
+    //--------------------------------------------------------------------------
+    void CopyOp::find_dependence_trees(std::set<RegionTreeID> &trees)
+    //--------------------------------------------------------------------------
+    {
+      for (unsigned idx = 0; idx < src_requirements.size(); idx++)
+        trees.insert(src_requirements[idx].parent.get_tree_id());
+      for (unsigned idx = 0; idx < dst_requirements.size(); idx++)
+        trees.insert(dst_requirements[idx].parent.get_tree_id());
+    }
+
     //--------------------------------------------------------------------------
     void CopyOp::resolve_true(void)
     //--------------------------------------------------------------------------
@@ -2739,18 +2771,19 @@ namespace LegionRuntime {
         Event sync_precondition = Event::NO_EVENT;
         if (!wait_barriers.empty() || !grants.empty())
         {
-          std::set<Event> preconditions;
+          std::vector<Event> preconditions;
+          preconditions.reserve(wait_barriers.size() + grants.size());
           for (std::vector<PhaseBarrier>::const_iterator it = 
                 wait_barriers.begin(); it != wait_barriers.end(); it++)
           {
             Event e = it->phase_barrier.get_previous_phase(); 
-            preconditions.insert(e);
+            preconditions.push_back(e);
           }
           for (std::vector<Grant>::const_iterator it = grants.begin();
                 it != grants.end(); it++)
           {
             Event e = it->impl->acquire_grant();
-            preconditions.insert(e);
+            preconditions.push_back(e);
           }
           sync_precondition = Event::merge_events(preconditions);
 #if defined(LEGION_LOGGING) || defined(LEGION_SPY)
@@ -3334,7 +3367,8 @@ namespace LegionRuntime {
         // that we are mapped and therefore our set of input dependences
         // have been fixed so we can read them without holding the lock.
         std::set<Event> trigger_events;
-        for (std::map<Operation*,GenerationID>::const_iterator it = 
+        for (LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::
+              map::const_iterator it = 
               incoming.begin(); it != incoming.end(); it++)
         {
           Event complete = it->first->get_completion_event();
@@ -3476,7 +3510,8 @@ namespace LegionRuntime {
       // that we are mapped and therefore our set of input dependences
       // have been fixed so we can read them without holding the lock.
       std::set<Event> trigger_events;
-      for (std::map<Operation*,GenerationID>::const_iterator it = 
+      for (LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::
+            map::const_iterator it = 
             incoming.begin(); it != incoming.end(); it++)
       {
         Event complete = it->first->get_completion_event();
@@ -4249,6 +4284,13 @@ namespace LegionRuntime {
       end_dependence_analysis();
     }
 
+    //--------------------------------------------------------------------------
+    void AcquireOp::find_dependence_trees(std::set<RegionTreeID> &trees)
+    //--------------------------------------------------------------------------
+    {
+      trees.insert(requirement.parent.get_tree_id());
+    }
+
     //--------------------------------------------------------------------------
     void AcquireOp::resolve_true(void)
     //--------------------------------------------------------------------------
@@ -4774,6 +4816,13 @@ namespace LegionRuntime {
       end_dependence_analysis();
     }
 
+    //--------------------------------------------------------------------------
+    void ReleaseOp::find_dependence_trees(std::set<RegionTreeID> &trees)
+    //--------------------------------------------------------------------------
+    {
+      trees.insert(requirement.parent.get_tree_id());
+    }
+
     //--------------------------------------------------------------------------
     void ReleaseOp::resolve_true(void)
     //--------------------------------------------------------------------------
@@ -67,6 +67,7 @@ namespace LegionRuntime {
       inline bool is_tracing(void) const { return tracing; }
       inline bool already_traced(void) const 
         { return ((trace != NULL) && !tracing); }
+      inline LegionTrace* get_trace(void) const { return trace; }
     public:
       // Be careful using this call as it is only valid when the operation
       // actually has a parent task.  Right now the only place it is used
@@ -129,6 +130,11 @@ namespace LegionRuntime {
       // A helper method for deciding what to do when we have
       // aliased region requirements for an operation
       virtual void report_aliased_requirements(unsigned idx1, unsigned idx2);
+      // Find the region trees touched by the dependence analysis for
+      // this operation so it only needs to be ordered with earlier 
+      // operations in its context on the same trees.  Operations that
+      // don't find any trees are ordered with everything.
+      virtual void find_dependence_trees(std::set<RegionTreeID> &trees);
     public:
       // The following are sets of calls that we can use to 
       // indicate mapping, execution, resolution, completion, and commit
@@ -227,9 +233,11 @@ namespace LegionRuntime {
       GenerationID gen;
       UniqueID unique_op_id;
       // Operations on which this operation depends
-      std::map<Operation*,GenerationID> incoming;
+      LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::map 
+                                                                  incoming;
       // Operations which depend on this operation
-      std::map<Operation*,GenerationID> outgoing;
+      LegionKeyValue<Operation*,GenerationID,OPERATION_EDGE_ALLOC>::map 
+                                                                  outgoing;
       // Number of outstanding mapping dependences before triggering map
       unsigned outstanding_mapping_deps;
       // Number of outstanding speculation dependences 
@@ -246,7 +254,7 @@ namespace LegionRuntime {
       std::map<Operation*,std::set<unsigned> > verify_regions;
       // Set of events from operations we depend that describe when
       // all of their children have mapped
-      std::set<Event> dependent_children_mapped;
+      std::vector<Event> dependent_children_mapped;
       // Whether this operation has mapped, once it has mapped then
       // the set of incoming dependences is fixed
       bool mapped;
@@ -433,6 +441,7 @@ namespace LegionRuntime {
       virtual const char* get_logging_name(void);
     public:
       virtual void trigger_dependence_analysis(void);
+      virtual void find_dependence_trees(std::set<RegionTreeID> &trees);
       virtual bool trigger_execution(void);
     public:
       virtual MappableKind get_mappable_kind(void) const;
@@ -478,6 +487,7 @@ namespace LegionRuntime {
       virtual const char* get_logging_name(void);
     public:
       virtual void trigger_dependence_analysis(void);
+      virtual void find_dependence_trees(std::set<RegionTreeID> &trees);
       virtual bool trigger_execution(void);
       virtual void deferred_complete(void);
       virtual void report_aliased_requirements(unsigned idx1, unsigned idx2);
@@ -681,6 +691,7 @@ namespace LegionRuntime {
       virtual const char* get_logging_name(void); 
     public:
       virtual void trigger_dependence_analysis(void);
+      virtual void find_dependence_trees(std::set<RegionTreeID> &trees);
       virtual bool trigger_execution(void);
       virtual void resolve_true(void);
       virtual void resolve_false(void);
@@ -730,6 +741,7 @@ namespace LegionRuntime {
       virtual const char* get_logging_name(void);
     public:
       virtual void trigger_dependence_analysis(void);
+      virtual void find_dependence_trees(std::set<RegionTreeID> &trees);
       virtual bool trigger_execution(void);
       virtual void resolve_true(void);
       virtual void resolve_false(void);
@@ -0,0 +1,224 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "legion.h"
+#include "legion_utilities.h"
+#include "legion_profiling.h"
+
+#ifdef LEGION_PROF
+#include <pthread.h>
+#include <sys/time.h>
+#endif
+
+namespace LegionRuntime {
+  namespace HighLevel {
+#ifdef LEGION_PROF
+    namespace LegionProf {
+      Logger::Category log_prof("legion_prof");
+      ProcessorProfiler *legion_prof_table =
+        new ProcessorProfiler[MAX_NUM_PROCS + 1];
+      bool profiling_enabled;
+      bool binary_profiling = false;
+
+      // Field layouts of each record kind, written into the header of
+      // every binary file.  Each line is '<kind> <name> <field>:<type>*'
+      // where a trailing 'str' field takes up the rest of the record.
+      static const char *const binary_layouts =
+        "0 processor proc_id:u64 utility:u32 kind:u32\n"
+        "1 memory mem:u64 kind:u32\n"
+        "2 task_variant task_id:u32 name:str\n"
+        "3 unique_task proc_id:u64 uid:u64 task_id:u32 dim:u32 "
+          "p0:i32 p1:i32 p2:i32\n"
+        "4 unique_map proc_id:u64 uid:u64 parent_uid:u64\n"
+        "5 unique_close proc_id:u64 uid:u64 parent_uid:u64\n"
+        "6 unique_copy proc_id:u64 uid:u64 parent_uid:u64\n"
+        "7 event proc_id:u64 uid:u64 time:u64 kind_id:u32\n"
+        "8 create_instance iid:u32 mem:u32 redop:u32 bf:u64 time:u64\n"
+        "9 instance_field iid:u32 fid:u32 size:u64\n"
+        "10 destroy_instance iid:u32 time:u64\n"
+        "11 intersection_cache hits:u64 misses:u64 evictions:u64 "
+          "graph_hits:u64 graphs:u64\n";
+
+      // State of the writer thread that streams processor buffers
+      // to the per-node file while the application runs
+      struct BinaryWriter {
+      public:
+        FILE *file;
+        char file_name[256];
+        pthread_t thread;
+        pthread_mutex_t file_lock;
+        pthread_cond_t wakeup;
+        unsigned users;
+        volatile bool shutdown;
+        unsigned long long bytes_written;
+      };
+      static BinaryWriter binary_writer = { NULL, { 0 }, pthread_t(),
+        PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, false, 0 };
+
+      //------------------------------------------------------------------------
+      static void drain_processor_buffers(void)
+      //------------------------------------------------------------------------
+      {
+        // Must be holding the file lock
+        for (unsigned idx = 0; idx < (MAX_NUM_PROCS+1); idx++)
+        {
+          ProcessorProfiler &prof = legion_prof_table[idx];
+          if (!prof.proc.exists() || (prof.buffer.data == NULL))
+            continue;
+          binary_writer.bytes_written += prof.buffer.drain(binary_writer.file);
+        }
+      }
+
+      //------------------------------------------------------------------------
+      static void* binary_writer_loop(void *args)
+      //------------------------------------------------------------------------
+      {
+        pthread_mutex_lock(&binary_writer.file_lock);
+        while (!binary_writer.shutdown)
+        {
+          drain_processor_buffers();
+          struct timeval now;
+          gettimeofday(&now, NULL);
+          unsigned long long wake_us = now.tv_usec +
+                                       DEFAULT_PROF_FLUSH_INTERVAL;
+          struct timespec deadline;
+          deadline.tv_sec = now.tv_sec + (wake_us / 1000000);
+          deadline.tv_nsec = (wake_us % 1000000) * 1000;
+          pthread_cond_timedwait(&binary_writer.wakeup,
+                                 &binary_writer.file_lock, &deadline);
+        }
+        pthread_mutex_unlock(&binary_writer.file_lock);
+        return NULL;
+      }
+
+      //------------------------------------------------------------------------
+      void start_binary_profiling(const char *prefix, AddressSpaceID space)
+      //------------------------------------------------------------------------
+      {
+        pthread_mutex_lock(&binary_writer.file_lock);
+        // Separate runtime instances in the same process share a file
+        if (binary_writer.users++ > 0)
+        {
+          pthread_mutex_unlock(&binary_writer.file_lock);
+          return;
+        }
+        snprintf(binary_writer.file_name, sizeof(binary_writer.file_name),
+                 "%s_%d.prof", prefix, space);
+        binary_writer.file = fopen(binary_writer.file_name, "wb");
+        if (binary_writer.file == NULL)
+        {
+          log_prof(LEVEL_ERROR,"Unable to open binary profiling file %s",
+                   binary_writer.file_name);
+          assert(false);
+          exit(ERROR_INVALID_PROFILING_FILE);
+        }
+        // Header: magic, version, address space, then the layouts
+        char magic[8];
+        memset(magic, 0, sizeof(magic));
+        strncpy(magic, LEGION_PROF_BINARY_MAGIC, sizeof(magic)-1);
+        fwrite(magic, 1, sizeof(magic), binary_writer.file);
+        uint32_t header[3];
+        header[0] = LEGION_PROF_BINARY_VERSION;
+        header[1] = space;
+        header[2] = strlen(binary_layouts);
+        fwrite(header, sizeof(uint32_t), 3, binary_writer.file);
+        fwrite(binary_layouts, 1, header[2], binary_writer.file);
+        binary_writer.bytes_written = sizeof(magic) +
+                                      sizeof(header) + header[2];
+        binary_writer.shutdown = false;
+        binary_profiling = true;
+        pthread_create(&binary_writer.thread, NULL, binary_writer_loop, NULL);
+        pthread_mutex_unlock(&binary_writer.file_lock);
+      }
+
+      //------------------------------------------------------------------------
+      void write_binary_record(unsigned kind, const void *payload,
+                               size_t size, const void *extra /*= NULL*/,
+                               size_t extra_size /*= 0*/)
+      //------------------------------------------------------------------------
+      {
+        ProfRecordHeader header;
+        header.kind = kind;
+        header.size = size + extra_size;
+        pthread_mutex_lock(&binary_writer.file_lock);
+        if (binary_writer.file != NULL)
+        {
+          fwrite(&header, sizeof(header), 1, binary_writer.file);
+          fwrite(payload, 1, size, binary_writer.file);
+          if (extra_size > 0)
+            fwrite(extra, 1, extra_size, binary_writer.file);
+          binary_writer.bytes_written += sizeof(header) + size + extra_size;
+        }
+        pthread_mutex_unlock(&binary_writer.file_lock);
+      }
+
+      //------------------------------------------------------------------------
+      void wake_binary_writer(void)
+      //------------------------------------------------------------------------
+      {
+        // No lock so producers never wait on the writer, the timed
+        // wait in the writer bounds the cost of a missed signal
+        pthread_cond_signal(&binary_writer.wakeup);
+      }
+
+      //------------------------------------------------------------------------
+      void flush_binary_profiling(void)
+      //------------------------------------------------------------------------
+      {
+        pthread_mutex_lock(&binary_writer.file_lock);
+        if (binary_writer.file != NULL)
+        {
+          drain_processor_buffers();
+          fflush(binary_writer.file);
+        }
+        pthread_mutex_unlock(&binary_writer.file_lock);
+      }
+
+      //------------------------------------------------------------------------
+      void stop_binary_profiling(void)
+      //------------------------------------------------------------------------
+      {
+        pthread_mutex_lock(&binary_writer.file_lock);
+        assert(binary_writer.users > 0);
+        if (--binary_writer.users > 0)
+        {
+          pthread_mutex_unlock(&binary_writer.file_lock);
+          return;
+        }
+        binary_writer.shutdown = true;
+        pthread_cond_signal(&binary_writer.wakeup);
+        pthread_mutex_unlock(&binary_writer.file_lock);
+        pthread_join(binary_writer.thread, NULL);
+        // Pick up anything written after the last pass
+        pthread_mutex_lock(&binary_writer.file_lock);
+        drain_processor_buffers();
+        unsigned long long stalls = 0;
+        for (unsigned idx = 0; idx < (MAX_NUM_PROCS+1); idx++)
+          stalls += legion_prof_table[idx].buffer.stalls;
+        log_prof(LEVEL_INFO,"Wrote %llu bytes of binary profiling data to %s "
+                 "(%llu stalls on full buffers)", binary_writer.bytes_written,
+                 binary_writer.file_name, stalls);
+        fclose(binary_writer.file);
+        binary_writer.file = NULL;
+        pthread_mutex_unlock(&binary_writer.file_lock);
+      }
+    };
+#endif
+  }; // namespace HighLevel
+}; // namespace LegionRuntime
+
+// EOF
+
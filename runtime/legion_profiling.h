@@ -23,7 +23,9 @@
 #include "legion_utilities.h"
 
 #include <cassert>
+#include <cstdio>
 #include <deque>
+#include <sched.h>
 
 namespace LegionRuntime {
   namespace HighLevel {
@@ -58,6 +60,206 @@ namespace LegionRuntime {
  
     namespace LegionProf {
 
+      // Binary profiling (-hl:proffile) writes each record as a
+      // ProfRecordHeader followed by one of the packed payloads below.
+      // Every file starts with a header that names the fields of each
+      // record kind so tools/legion_prof.py can decode them without
+      // knowing these structs.  Bump the version on any layout change.
+#define LEGION_PROF_BINARY_MAGIC        "LGNPROF"
+#define LEGION_PROF_BINARY_VERSION      1
+      enum ProfRecordKind {
+        PROF_RECORD_PROCESSOR = 0,
+        PROF_RECORD_MEMORY = 1,
+        PROF_RECORD_TASK_VARIANT = 2,
+        PROF_RECORD_UNIQUE_TASK = 3,
+        PROF_RECORD_UNIQUE_MAP = 4,
+        PROF_RECORD_UNIQUE_CLOSE = 5,
+        PROF_RECORD_UNIQUE_COPY = 6,
+        PROF_RECORD_EVENT = 7,
+        PROF_RECORD_CREATE_INSTANCE = 8,
+        PROF_RECORD_INSTANCE_FIELD = 9,
+        PROF_RECORD_DESTROY_INSTANCE = 10,
+        PROF_RECORD_INTERSECTION_CACHE = 11,
+        PROF_RECORD_LAST = 12,
+      };
+
+      struct ProfRecordHeader {
+        uint16_t kind;
+        uint16_t size; // bytes of payload that follow
+      } __attribute__((packed));
+
+      struct ProfProcessorRecord {
+        uint64_t proc_id;
+        uint32_t utility;
+        uint32_t kind;
+      } __attribute__((packed));
+
+      struct ProfMemoryRecord {
+        uint64_t mem;
+        uint32_t kind;
+      } __attribute__((packed));
+
+      // followed by the characters of the name
+      struct ProfTaskVariantRecord {
+        uint32_t task_id;
+      } __attribute__((packed));
+
+      struct ProfUniqueTaskRecord {
+        uint64_t proc_id;
+        uint64_t uid;
+        uint32_t task_id;
+        uint32_t dim;
+        int32_t p0, p1, p2;
+      } __attribute__((packed));
+
+      // maps, closes, and copies
+      struct ProfUniqueOpRecord {
+        uint64_t proc_id;
+        uint64_t uid;
+        uint64_t parent_uid;
+      } __attribute__((packed));
+
+      struct ProfEventRecord {
+        uint64_t proc_id;
+        uint64_t uid;
+        uint64_t time;
+        uint32_t kind_id;
+      } __attribute__((packed));
+
+      struct ProfCreateInstanceRecord {
+        uint32_t iid;
+        uint32_t mem;
+        uint32_t redop;
+        uint64_t bf;
+        uint64_t time;
+      } __attribute__((packed));
+
+      struct ProfInstanceFieldRecord {
+        uint32_t iid;
+        uint32_t fid;
+        uint64_t size;
+      } __attribute__((packed));
+
+      struct ProfDestroyInstanceRecord {
+        uint32_t iid;
+        uint64_t time;
+      } __attribute__((packed));
+
+      struct ProfIntersectionRecord {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t graph_hits;
+        uint64_t graphs;
+      } __attribute__((packed));
+
+      // Wakes up the writer thread when a buffer is filling up
+      extern void wake_binary_writer(void);
+
+      /**
+       * \class ProfilingBuffer
+       * A fixed-size ring buffer of binary records for one processor.
+       * The thread running on the processor is the only producer and
+       * the writer thread is the only consumer so neither side needs
+       * a lock.  A full buffer stalls the producer until the writer
+       * has drained it rather than dropping records.
+       */
+      class ProfilingBuffer {
+      public:
+        ProfilingBuffer(void)
+          : data(NULL), capacity(0), head(0), tail(0), 
+            wake_requested(false), stalls(0) { }
+        ~ProfilingBuffer(void)
+        {
+          if (data != NULL)
+            free(data);
+        }
+      public:
+        inline void append(unsigned kind, const void *payload, size_t size,
+                           const void *extra = NULL, size_t extra_size = 0)
+        {
+          if (data == NULL)
+          {
+            capacity = DEFAULT_PROF_BUFFER_SIZE;
+            data = (char*)malloc(capacity);
+          }
+          ProfRecordHeader header;
+          header.kind = kind;
+          header.size = size + extra_size;
+          const size_t needed = sizeof(header) + size + extra_size;
+          assert(needed <= capacity);
+          if ((head + needed - tail) > capacity)
+          {
+            stalls++;
+            while ((head + needed - tail) > capacity)
+            {
+              wake_binary_writer();
+              sched_yield();
+            }
+          }
+          size_t offset = head;
+          copy_in(offset, &header, sizeof(header));
+          offset += sizeof(header);
+          copy_in(offset, payload, size);
+          offset += size;
+          if (extra_size > 0)
+            copy_in(offset, extra, extra_size);
+          // Make the record visible before publishing it
+          __sync_synchronize();
+          head += needed;
+          if (!wake_requested && ((head - tail) > (capacity >> 1)))
+          {
+            wake_requested = true;
+            wake_binary_writer();
+          }
+        }
+        // Only called by the writer thread
+        inline size_t drain(FILE *f)
+        {
+          const size_t end = head;
+          __sync_synchronize();
+          const size_t start = tail;
+          if (start == end)
+            return 0;
+          const size_t first = start & (capacity - 1);
+          const size_t bytes = end - start;
+          if ((first + bytes) <= capacity)
+            fwrite(data + first, 1, bytes, f);
+          else
+          {
+            fwrite(data + first, 1, capacity - first, f);
+            fwrite(data, 1, bytes - (capacity - first), f);
+          }
+          __sync_synchronize();
+          tail = end;
+          wake_requested = false;
+          return bytes;
+        }
+      private:
+        inline void copy_in(size_t offset, const void *src, size_t size)
+        {
+          const size_t first = offset & (capacity - 1);
+          if ((first + size) <= capacity)
+            memcpy(data + first, src, size);
+          else
+          {
+            const size_t split = capacity - first;
+            memcpy(data + first, src, split);
+            memcpy(data, ((const char*)src) + split, size - split);
+          }
+        }
+      public:
+        char *data;
+        size_t capacity;
+        // monotonically increasing byte counts, wrapped on access
+        volatile size_t head, tail;
+        volatile bool wake_requested;
+        unsigned long long stalls;
+      };
+
+      // Indicator for when records go to the binary file
+      extern bool binary_profiling;
+
       struct ProfilingEvent {
       public:
         ProfilingEvent(unsigned k, UniqueID uid, unsigned long long t)
@@ -117,17 +319,106 @@ namespace LegionRuntime {
             init_time(TimeStamp::get_current_time_in_micros()) { }
       public:
         inline void add_event(const ProfilingEvent &event) 
-                          { proc_events.push_back(event); }
+        {
+          if (binary_profiling)
+          {
+            assert(event.time >= init_time);
+            ProfEventRecord record;
+            record.proc_id = proc.id;
+            record.uid = event.unique_id;
+            record.time = event.time - init_time;
+            record.kind_id = event.kind;
+            buffer.append(PROF_RECORD_EVENT, &record, sizeof(record));
+          }
+          else
+            proc_events.push_back(event);
+        }
         inline void add_event(const MemoryEvent &event) 
-                          { mem_events.push_back(event); }
+        {
+          if (binary_profiling)
+          {
+            assert(event.time >= init_time);
+            if (event.creation)
+            {
+              ProfCreateInstanceRecord record;
+              record.iid = event.inst_id;
+              record.mem = event.memory;
+              record.redop = event.redop;
+              record.bf = event.blocking_factor;
+              record.time = event.time - init_time;
+              buffer.append(PROF_RECORD_CREATE_INSTANCE, 
+                            &record, sizeof(record));
+              for (std::map<unsigned,size_t>::const_iterator it = 
+                    event.field_infos.begin(); it != 
+                    event.field_infos.end(); it++)
+              {
+                ProfInstanceFieldRecord field;
+                field.iid = event.inst_id;
+                field.fid = it->first;
+                field.size = it->second;
+                buffer.append(PROF_RECORD_INSTANCE_FIELD, 
+                              &field, sizeof(field));
+              }
+            }
+            else
+            {
+              ProfDestroyInstanceRecord record;
+              record.iid = event.inst_id;
+              record.time = event.time - init_time;
+              buffer.append(PROF_RECORD_DESTROY_INSTANCE, 
+                            &record, sizeof(record));
+            }
+          }
+          else
+            mem_events.push_back(event);
+        }
         inline void add_task(const TaskInstance &inst)
-                          { tasks.push_back(inst); }
+        {
+          if (binary_profiling)
+          {
+            ProfUniqueTaskRecord record;
+            record.proc_id = proc.id;
+            record.uid = inst.unique_id;
+            record.task_id = inst.task_id;
+            record.dim = inst.point.get_dim();
+            record.p0 = inst.point.point_data[0];
+            record.p1 = inst.point.point_data[1];
+            record.p2 = inst.point.point_data[2];
+            buffer.append(PROF_RECORD_UNIQUE_TASK, &record, sizeof(record));
+          }
+          else
+            tasks.push_back(inst);
+        }
         inline void add_map(const OpInstance &inst)
-                          { mappings.push_back(inst); }
+        {
+          if (binary_profiling)
+            add_op(PROF_RECORD_UNIQUE_MAP, inst);
+          else
+            mappings.push_back(inst);
+        }
         inline void add_close(const OpInstance &inst)
-                          { closes.push_back(inst); }
+        {
+          if (binary_profiling)
+            add_op(PROF_RECORD_UNIQUE_CLOSE, inst);
+          else
+            closes.push_back(inst);
+        }
         inline void add_copy(const OpInstance &inst)
-                          { copies.push_back(inst); }
+        {
+          if (binary_profiling)
+            add_op(PROF_RECORD_UNIQUE_COPY, inst);
+          else
+            copies.push_back(inst);
+        }
+      protected:
+        inline void add_op(ProfRecordKind kind, const OpInstance &inst)
+        {
+          ProfUniqueOpRecord record;
+          record.proc_id = proc.id;
+          record.uid = inst.unique_id;
+          record.parent_uid = inst.parent_id;
+          buffer.append(kind, &record, sizeof(record));
+        }
       private:
 	// no copy constructor or assignment
 	ProcessorProfiler(const ProcessorProfiler& copy_from) 
@@ -146,6 +437,8 @@ namespace LegionRuntime {
         std::deque<OpInstance> mappings;
         std::deque<OpInstance> closes;
         std::deque<OpInstance> copies;
+        // only used for binary profiling
+        ProfilingBuffer buffer;
       };
 
       extern Logger::Category log_prof;
@@ -154,6 +447,17 @@ namespace LegionRuntime {
       // Indicator for when profiling is enabled and disabled
       extern bool profiling_enabled;
 
+      // Binary profiling backend (see legion_profiling.cc)
+      extern void start_binary_profiling(const char *prefix, 
+                                         AddressSpaceID space);
+      // Records that aren't issued by a processor thread go
+      // straight to the file
+      extern void write_binary_record(unsigned kind, const void *payload,
+                                      size_t size, const void *extra = NULL,
+                                      size_t extra_size = 0);
+      extern void flush_binary_profiling(void);
+      extern void stop_binary_profiling(void);
+
       static inline ProcessorProfiler& get_profiler(Processor proc)
       {
         return legion_prof_table[proc.local_id()];
@@ -162,7 +466,16 @@ namespace LegionRuntime {
       static inline void register_task_variant(unsigned task_id, 
                                                const char *name)
       {
-        if (profiling_enabled)
+        if (!profiling_enabled)
+          return;
+        if (binary_profiling)
+        {
+          ProfTaskVariantRecord record;
+          record.task_id = task_id;
+          write_binary_record(PROF_RECORD_TASK_VARIANT, &record, 
+                              sizeof(record), name, strlen(name));
+        }
+        else
           log_prof(LEVEL_INFO,"Prof Task Variant %u %s", task_id, name);
       }
 
@@ -175,11 +488,28 @@ namespace LegionRuntime {
 	p.utility = util;
 	p.kind = kind;
 	p.init_time = TimeStamp::get_current_time_in_micros();
+        if (profiling_enabled && binary_profiling)
+        {
+          ProfProcessorRecord record;
+          record.proc_id = proc.id;
+          record.utility = util;
+          record.kind = kind;
+          write_binary_record(PROF_RECORD_PROCESSOR, &record, sizeof(record));
+        }
       }
 
       static inline void initialize_memory(Memory mem, Memory::Kind kind)
       {
-        if (profiling_enabled)
+        if (!profiling_enabled)
+          return;
+        if (binary_profiling)
+        {
+          ProfMemoryRecord record;
+          record.mem = mem.id;
+          record.kind = kind;
+          write_binary_record(PROF_RECORD_MEMORY, &record, sizeof(record));
+        }
+        else
           log_prof(LEVEL_INFO,"Prof Memory " IDFMT " %u", mem.id, kind);
       }
 
@@ -190,6 +520,9 @@ namespace LegionRuntime {
         // Someone else has already dumped this processor
         if (perform_dump > 0)
           return;
+        // Binary records were streamed out while running
+        if (binary_profiling)
+          return;
         if (profiling_enabled)
           log_prof(LEVEL_INFO,"Prof Processor " IDFMT " %u %u", 
                     proc.id, prof.utility, prof.kind);
@@ -332,6 +665,31 @@ namespace LegionRuntime {
         }
       }
 
+      static inline void register_intersection_cache(
+                                  unsigned long long hits,
+                                  unsigned long long misses,
+                                  unsigned long long evictions,
+                                  unsigned long long graph_hits,
+                                  unsigned long long graphs_built)
+      {
+        if (!profiling_enabled)
+          return;
+        if (binary_profiling)
+        {
+          ProfIntersectionRecord record;
+          record.hits = hits;
+          record.misses = misses;
+          record.evictions = evictions;
+          record.graph_hits = graph_hits;
+          record.graphs = graphs_built;
+          write_binary_record(PROF_RECORD_INTERSECTION_CACHE, 
+                              &record, sizeof(record));
+        }
+        else
+          log_prof(LEVEL_INFO,"Prof Intersection Cache %llu %llu %llu %llu %llu",
+                   hits, misses, evictions, graph_hits, graphs_built);
+      }
+
       static inline void enable_profiling(void)
       {
         profiling_enabled = true;        
@@ -344,6 +702,11 @@ namespace LegionRuntime {
 
       static inline void dump_profiling(void)
       {
+        if (binary_profiling)
+        {
+          flush_binary_profiling();
+          return;
+        }
         for (unsigned idx = 0; idx < (MAX_NUM_PROCS+1); idx++)
         {
           Processor proc = legion_prof_table[idx].proc;
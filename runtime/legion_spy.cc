@@ -19,6 +19,11 @@
 #include "legion_spy.h"
 #include "runtime.h"
 
+#ifdef LEGION_SPY
+#include <pthread.h>
+#include <deque>
+#endif
+
 namespace LegionRuntime {
   namespace HighLevel {
 
@@ -259,6 +264,292 @@ namespace LegionRuntime {
       }
     }
 
+#ifdef LEGION_SPY
+    namespace LegionSpy {
+      bool binary_spy = false;
+
+      // Record layouts, written into the header of every binary file.
+      // Each line is '<kind> <State method> <field>:<type>*' where the
+      // types are u (varint), b (varint bool), s (varint length and
+      // bytes) and e (an event through the encoder's event cache).
+      static const char *const binary_layouts =
+        "0 add_utility pid:u\n"
+        "1 add_processor pid:u kind:u\n"
+        "2 add_memory mid:u capacity:u\n"
+        "3 set_proc_mem pid:u mid:u band:u lat:u\n"
+        "4 set_mem_mem mone:u mtwo:u band:u lat:u\n"
+        "5 add_index_space uid:u\n"
+        "6 add_index_space_name uid:u name:s\n"
+        "7 add_index_partition pid:u uid:u disjoint:b color:u\n"
+        "8 add_index_partition_name uid:u name:s\n"
+        "9 add_index_subspace pid:u uid:u color:u\n"
+        "10 add_field_space uid:u\n"
+        "11 add_field_space_name uid:u name:s\n"
+        "12 add_field uid:u fid:u\n"
+        "13 add_field_name uid:u fid:u name:s\n"
+        "14 add_region iid:u fid:u tid:u\n"
+        "15 add_region_name iid:u fid:u tid:u name:s\n"
+        "16 add_partition_name iid:u fid:u tid:u name:s\n"
+        "17 add_top_task tid:u uid:u name:s\n"
+        "18 add_single_task ctx:u tid:u uid:u name:s\n"
+        "19 add_index_task ctx:u tid:u uid:u name:s\n"
+        "20 add_mapping ctx:u uid:u\n"
+        "21 add_close ctx:u uid:u\n"
+        "22 add_fence ctx:u uid:u\n"
+        "23 add_copy_op ctx:u uid:u\n"
+        "24 add_acquire_op ctx:u uid:u\n"
+        "25 add_release_op ctx:u uid:u\n"
+        "26 add_deletion ctx:u uid:u\n"
+        "27 add_index_slice index:u slice:u\n"
+        "28 add_slice_slice slice1:u slice2:u\n"
+        "29 add_slice_point slice:u point:u dim:u val1:u val2:u val3:u\n"
+        "30 add_point_point point1:u point2:u\n"
+        "31 add_phase_barrier uid:u\n"
+        "32 add_requirement uid:u index:u is_reg:b ispace:u fspace:u "
+          "tid:u priv:u coher:u redop:u\n"
+        "33 add_req_field uid:u index:u fid:u\n"
+        "34 add_mapping_dependence ctx:u prev_id:u pidx:u next_id:u "
+          "nidx:u dtype:u\n"
+        "35 add_instance_requirement uid:u idx:u index:u\n"
+        "36 add_event_dependence one:e two:e\n"
+        "37 add_implicit_dependence one:e two:e\n"
+        "38 add_op_events uid:u start:e term:e\n"
+        "39 add_copy_events srcman:u dstman:u index:u field:u tree:u "
+          "start:e term:e redop:u\n"
+        "40 add_copy_field_to_copy_event start:e term:e fid:u\n"
+        "41 add_physical_instance iid:u mid:u index:u field:u tid:u\n"
+        "42 add_reduction_instance iid:u mid:u index:u field:u tid:u "
+          "fold:b indirect:u\n"
+        "43 add_op_user uid:u idx:u iid:u\n"
+        "44 add_op_proc_user uid:u pid:u\n";
+
+      struct SpyBlock {
+      public:
+        unsigned char *data;
+        size_t size;
+      };
+
+      // State of the writer thread that streams filled blocks to
+      // the per-node file while the application runs
+      struct SpyWriter {
+      public:
+        FILE *file;
+        char file_name[256];
+        pthread_t thread;
+        pthread_mutex_t queue_lock;
+        pthread_cond_t work_ready;
+        pthread_cond_t space_ready;
+        std::deque<SpyBlock> *queue;
+        SpyEncoder *encoder;
+        unsigned users;
+        bool shutdown;
+      };
+      static SpyWriter spy_writer = { NULL, { 0 }, pthread_t(),
+        PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+        PTHREAD_COND_INITIALIZER, NULL, NULL, 0, false };
+
+      //------------------------------------------------------------------------
+      static void write_varint(unsigned long long value)
+      //------------------------------------------------------------------------
+      {
+        unsigned char buffer[10];
+        unsigned length = 0;
+        while (value >= 0x80)
+        {
+          buffer[length++] = (value & 0x7f) | 0x80;
+          value >>= 7;
+        }
+        buffer[length++] = value;
+        fwrite(buffer, 1, length, spy_writer.file);
+      }
+
+      //------------------------------------------------------------------------
+      static void write_frame(const unsigned char *data, size_t size)
+      //------------------------------------------------------------------------
+      {
+        // Each block is prefixed with its size so the parser can read
+        // and decode the file one block at a time
+        write_varint(size);
+        fwrite(data, 1, size, spy_writer.file);
+      }
+
+      //------------------------------------------------------------------------
+      static void* spy_writer_loop(void *args)
+      //------------------------------------------------------------------------
+      {
+        pthread_mutex_lock(&spy_writer.queue_lock);
+        while (true)
+        {
+          if (spy_writer.queue->empty())
+          {
+            if (spy_writer.shutdown)
+              break;
+            pthread_cond_wait(&spy_writer.work_ready, &spy_writer.queue_lock);
+            continue;
+          }
+          SpyBlock next = spy_writer.queue->front();
+          spy_writer.queue->pop_front();
+          pthread_cond_broadcast(&spy_writer.space_ready);
+          pthread_mutex_unlock(&spy_writer.queue_lock);
+          write_frame(next.data, next.size);
+          free(next.data);
+          pthread_mutex_lock(&spy_writer.queue_lock);
+        }
+        pthread_mutex_unlock(&spy_writer.queue_lock);
+        return NULL;
+      }
+
+      //------------------------------------------------------------------------
+      SpyEncoder::SpyEncoder(void)
+        : capacity(DEFAULT_SPY_BLOCK_SIZE), used(0), published(0),
+          encoder_lock(true/*initialize*/)
+      //------------------------------------------------------------------------
+      {
+        block = (unsigned char*)malloc(capacity);
+        for (unsigned idx = 0; idx < DEFAULT_SPY_EVENT_CACHE_SIZE; idx++)
+          event_cache[idx] = Event::NO_EVENT;
+      }
+
+      //------------------------------------------------------------------------
+      SpyEncoder::SpyEncoder(const SpyEncoder &rhs)
+      //------------------------------------------------------------------------
+      {
+        // should never be called
+        assert(false);
+      }
+
+      //------------------------------------------------------------------------
+      SpyEncoder::~SpyEncoder(void)
+      //------------------------------------------------------------------------
+      {
+        free(block);
+        encoder_lock.destroy();
+      }
+
+      //------------------------------------------------------------------------
+      SpyEncoder& SpyEncoder::operator=(const SpyEncoder &rhs)
+      //------------------------------------------------------------------------
+      {
+        // should never be called
+        assert(false);
+        return *this;
+      }
+
+      //------------------------------------------------------------------------
+      void SpyEncoder::grow(size_t needed)
+      //------------------------------------------------------------------------
+      {
+        const size_t partial = used - published;
+        size_t new_capacity = DEFAULT_SPY_BLOCK_SIZE;
+        while (new_capacity < (partial + needed))
+          new_capacity *= 2;
+        unsigned char *new_block = (unsigned char*)malloc(new_capacity);
+        if (partial > 0)
+          memcpy(new_block, block + published, partial);
+        SpyBlock full;
+        full.data = block;
+        full.size = published;
+        block = new_block;
+        capacity = new_capacity;
+        used = partial;
+        published = 0;
+        if (full.size == 0)
+        {
+          free(full.data);
+          return;
+        }
+        // Called with the encoder lock held so blocks reach the
+        // queue in the same order as the records in them
+        pthread_mutex_lock(&spy_writer.queue_lock);
+        // Stall the logging thread rather than letting the queue
+        // grow without bound when the disk cannot keep up
+        while (spy_writer.queue->size() >= DEFAULT_SPY_QUEUED_BLOCKS)
+          pthread_cond_wait(&spy_writer.space_ready, &spy_writer.queue_lock);
+        spy_writer.queue->push_back(full);
+        pthread_cond_signal(&spy_writer.work_ready);
+        pthread_mutex_unlock(&spy_writer.queue_lock);
+      }
+
+      //------------------------------------------------------------------------
+      SpyEncoder& get_spy_encoder(void)
+      //------------------------------------------------------------------------
+      {
+        return *spy_writer.encoder;
+      }
+
+      //------------------------------------------------------------------------
+      void start_binary_spy(const char *prefix, AddressSpaceID space)
+      //------------------------------------------------------------------------
+      {
+        pthread_mutex_lock(&spy_writer.queue_lock);
+        // Separate runtime instances in the same process share a file
+        if (spy_writer.users++ > 0)
+        {
+          pthread_mutex_unlock(&spy_writer.queue_lock);
+          return;
+        }
+        snprintf(spy_writer.file_name, sizeof(spy_writer.file_name),
+                 "%s_%d.spy", prefix, space);
+        spy_writer.file = fopen(spy_writer.file_name, "wb");
+        if (spy_writer.file == NULL)
+        {
+          log_spy(LEVEL_ERROR,"Unable to open binary spy file %s",
+                  spy_writer.file_name);
+          assert(false);
+          exit(ERROR_INVALID_SPY_FILE);
+        }
+        // Header: magic, version, address space, event cache size
+        // and then the record layouts
+        char magic[8];
+        memset(magic, 0, sizeof(magic));
+        strncpy(magic, LEGION_SPY_BINARY_MAGIC, sizeof(magic)-1);
+        fwrite(magic, 1, sizeof(magic), spy_writer.file);
+        uint32_t header[4];
+        header[0] = LEGION_SPY_BINARY_VERSION;
+        header[1] = space;
+        header[2] = DEFAULT_SPY_EVENT_CACHE_SIZE;
+        header[3] = strlen(binary_layouts);
+        fwrite(header, sizeof(uint32_t), 4, spy_writer.file);
+        fwrite(binary_layouts, 1, header[3], spy_writer.file);
+        spy_writer.queue = new std::deque<SpyBlock>();
+        spy_writer.encoder = new SpyEncoder();
+        spy_writer.shutdown = false;
+        binary_spy = true;
+        pthread_create(&spy_writer.thread, NULL, spy_writer_loop, NULL);
+        pthread_mutex_unlock(&spy_writer.queue_lock);
+      }
+
+      //------------------------------------------------------------------------
+      void stop_binary_spy(void)
+      //------------------------------------------------------------------------
+      {
+        pthread_mutex_lock(&spy_writer.queue_lock);
+        assert(spy_writer.users > 0);
+        if (--spy_writer.users > 0)
+        {
+          pthread_mutex_unlock(&spy_writer.queue_lock);
+          return;
+        }
+        binary_spy = false;
+        spy_writer.shutdown = true;
+        pthread_cond_signal(&spy_writer.work_ready);
+        pthread_mutex_unlock(&spy_writer.queue_lock);
+        pthread_join(spy_writer.thread, NULL);
+        // The writer has drained the queue, so all that is left are
+        // the records sitting in the encoder's current block
+        SpyEncoder *encoder = spy_writer.encoder;
+        if (encoder->published > 0)
+          write_frame(encoder->block, encoder->published);
+        delete encoder;
+        spy_writer.encoder = NULL;
+        delete spy_writer.queue;
+        spy_writer.queue = NULL;
+        fclose(spy_writer.file);
+        spy_writer.file = NULL;
+      }
+    };
+#endif
+
   }; // namespace HighLevel
 }; // namespace LegionRuntime
 
@@ -36,123 +36,421 @@ namespace LegionRuntime {
 
       extern Logger::Category log_spy;
 
+      // Set when -hl:spyfile is given, in which case the calls below
+      // append compact binary records to a per-thread block instead of
+      // formatting text lines for the logger.  The record layouts are
+      // written into the header of each file; see spy_parser.py.
+      extern bool binary_spy;
+
+#define LEGION_SPY_BINARY_MAGIC         "LGNSPY"
+#define LEGION_SPY_BINARY_VERSION       1
+
+      enum SpyRecordKind {
+        SPY_UTILITY_PROCESSOR,
+        SPY_PROCESSOR,
+        SPY_MEMORY,
+        SPY_PROC_MEM_AFFINITY,
+        SPY_MEM_MEM_AFFINITY,
+        SPY_TOP_INDEX_SPACE,
+        SPY_INDEX_SPACE_NAME,
+        SPY_INDEX_PARTITION,
+        SPY_INDEX_PARTITION_NAME,
+        SPY_INDEX_SUBSPACE,
+        SPY_FIELD_SPACE,
+        SPY_FIELD_SPACE_NAME,
+        SPY_FIELD_CREATION,
+        SPY_FIELD_NAME,
+        SPY_TOP_REGION,
+        SPY_LOGICAL_REGION_NAME,
+        SPY_LOGICAL_PARTITION_NAME,
+        SPY_TOP_LEVEL_TASK,
+        SPY_INDIVIDUAL_TASK,
+        SPY_INDEX_TASK,
+        SPY_MAPPING_OPERATION,
+        SPY_CLOSE_OPERATION,
+        SPY_FENCE_OPERATION,
+        SPY_COPY_OPERATION,
+        SPY_ACQUIRE_OPERATION,
+        SPY_RELEASE_OPERATION,
+        SPY_DELETION_OPERATION,
+        SPY_INDEX_SLICE,
+        SPY_SLICE_SLICE,
+        SPY_SLICE_POINT,
+        SPY_POINT_POINT,
+        SPY_PHASE_BARRIER,
+        SPY_LOGICAL_REQUIREMENT,
+        SPY_REQUIREMENT_FIELD,
+        SPY_MAPPING_DEPENDENCE,
+        SPY_TASK_INSTANCE_REQUIREMENT,
+        SPY_EVENT_DEPENDENCE,
+        SPY_IMPLICIT_DEPENDENCE,
+        SPY_OP_EVENTS,
+        SPY_COPY_EVENTS,
+        SPY_COPY_FIELD,
+        SPY_PHYSICAL_INSTANCE,
+        SPY_PHYSICAL_REDUCTION,
+        SPY_OP_USER,
+        SPY_OP_PROC_USER,
+      };
+
+      /**
+       * \class SpyEncoder
+       * Builds binary records in a block that is handed to the writer
+       * thread when it fills.  Records go through a single encoder so
+       * they keep the global order the text logger gives them, which
+       * the checks in legion_spy.py depend on.  Integers are written as
+       * varints and events are interned through a small direct-mapped
+       * cache so the many repeated references to the same event cost
+       * one or two bytes instead of a full id and generation.
+       */
+      class SpyEncoder {
+      public:
+        SpyEncoder(void);
+        SpyEncoder(const SpyEncoder &rhs);
+        ~SpyEncoder(void);
+      public:
+        SpyEncoder& operator=(const SpyEncoder &rhs);
+      public:
+        inline void begin(SpyRecordKind kind)
+        {
+          encoder_lock.lock();
+          put((unsigned long long)kind);
+        }
+        inline void put(unsigned long long value)
+        {
+          if ((used + 10) > capacity)
+            grow(10);
+          while (value >= 0x80)
+          {
+            block[used++] = (value & 0x7f) | 0x80;
+            value >>= 7;
+          }
+          block[used++] = value;
+        }
+        inline void put(const char *str)
+        {
+          size_t length = strlen(str);
+          put((unsigned long long)length);
+          if ((used + length) > capacity)
+            grow(length);
+          memcpy(block + used, str, length);
+          used += length;
+        }
+        inline void put(Event event)
+        {
+          unsigned slot = (event.id ^ (event.gen * 0x9e3779b1U)) & 
+                          (DEFAULT_SPY_EVENT_CACHE_SIZE - 1);
+          if (event_cache[slot] == event)
+          {
+            put((unsigned long long)((slot << 1) | 1));
+            return;
+          }
+          event_cache[slot] = event;
+          put((unsigned long long)(slot << 1));
+          put((unsigned long long)event.id);
+          put((unsigned long long)event.gen);
+        }
+        inline void end(void)
+        {
+          published = used;
+          encoder_lock.unlock();
+        }
+      protected:
+        // Hands the completed records to the writer and moves the
+        // record being built to a new block with room for needed bytes
+        void grow(size_t needed);
+      public:
+        unsigned char *block;
+        size_t capacity, used, published;
+      protected:
+        ImmovableLock encoder_lock;
+        Event event_cache[DEFAULT_SPY_EVENT_CACHE_SIZE];
+      };
+
+      SpyEncoder& get_spy_encoder(void);
+      void start_binary_spy(const char *prefix, AddressSpaceID space);
+      void stop_binary_spy(void);
+
       static int next_point_id = 0;
 
       // Logger calls for the machine architecture
       static inline void log_utility_processor(IDType unique_id)
       {
-        log_spy(LEVEL_INFO, "Utility " IDFMT "", 
-                unique_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_UTILITY_PROCESSOR);
+          encoder.put(unique_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO, "Utility " IDFMT "", 
+                  unique_id);
       }
 
       static inline void log_processor(IDType unique_id, unsigned kind)
       {
-        log_spy(LEVEL_INFO, "Processor " IDFMT " %u", 
-                unique_id, kind);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_PROCESSOR);
+          encoder.put(unique_id);
+          encoder.put(kind);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO, "Processor " IDFMT " %u", 
+                  unique_id, kind);
       }
 
       static inline void log_memory(IDType unique_id, size_t capacity)
       {
-        log_spy(LEVEL_INFO, "Memory " IDFMT " %lu", 
-                unique_id, capacity);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_MEMORY);
+          encoder.put(unique_id);
+          encoder.put(capacity);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO, "Memory " IDFMT " %lu", 
+                  unique_id, capacity);
       }
 
       static inline void log_proc_mem_affinity(IDType proc_id, 
             IDType mem_id, unsigned bandwidth, unsigned latency)
       {
-        log_spy(LEVEL_INFO, "Processor Memory " IDFMT " " IDFMT " %u %u", 
-                  proc_id, mem_id, bandwidth, latency);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_PROC_MEM_AFFINITY);
+          encoder.put(proc_id);
+          encoder.put(mem_id);
+          encoder.put(bandwidth);
+          encoder.put(latency);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO, "Processor Memory " IDFMT " " IDFMT " %u %u", 
+                    proc_id, mem_id, bandwidth, latency);
       }
 
       static inline void log_mem_mem_affinity(IDType mem1, 
           IDType mem2, unsigned bandwidth, unsigned latency)
       {
-        log_spy(LEVEL_INFO, "Memory Memory " IDFMT " " IDFMT " %u %u", 
-                          mem1, mem2, bandwidth, latency);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_MEM_MEM_AFFINITY);
+          encoder.put(mem1);
+          encoder.put(mem2);
+          encoder.put(bandwidth);
+          encoder.put(latency);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO, "Memory Memory " IDFMT " " IDFMT " %u %u", 
+                            mem1, mem2, bandwidth, latency);
       }
 
       // Logger calls for the shape of region trees
       static inline void log_top_index_space(IDType unique_id)
       {
-        log_spy(LEVEL_INFO,"Index Space " IDFMT "", unique_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_TOP_INDEX_SPACE);
+          encoder.put(unique_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Index Space " IDFMT "", unique_id);
       }
 
       static inline void log_index_space_name(IDType unique_id,
                                               const char* name)
       {
-        log_spy(LEVEL_INFO,"Index Space Name " IDFMT " %s",
-            unique_id, name);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_INDEX_SPACE_NAME);
+          encoder.put(unique_id);
+          encoder.put(name);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Index Space Name " IDFMT " %s",
+              unique_id, name);
       }
 
       static inline void log_index_partition(IDType parent_id, 
                 IDType unique_id, bool disjoint, unsigned color)
       {
-        log_spy(LEVEL_INFO,"Index Partition " IDFMT " " IDFMT " %u %u", 
-                    parent_id, unique_id, disjoint, color);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_INDEX_PARTITION);
+          encoder.put(parent_id);
+          encoder.put(unique_id);
+          encoder.put(disjoint);
+          encoder.put(color);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Index Partition " IDFMT " " IDFMT " %u %u", 
+                      parent_id, unique_id, disjoint, color);
       }
 
       static inline void log_index_partition_name(IDType unique_id,
                                                   const char* name)
       {
-        log_spy(LEVEL_INFO,"Index Partition Name " IDFMT " %s",
-            unique_id, name);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_INDEX_PARTITION_NAME);
+          encoder.put(unique_id);
+          encoder.put(name);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Index Partition Name " IDFMT " %s",
+              unique_id, name);
       }
 
       static inline void log_index_subspace(IDType parent_id, 
                               IDType unique_id, unsigned color)
       {
-        log_spy(LEVEL_INFO,"Index Subspace " IDFMT " " IDFMT " %u", 
-                          parent_id, unique_id, color);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_INDEX_SUBSPACE);
+          encoder.put(parent_id);
+          encoder.put(unique_id);
+          encoder.put(color);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Index Subspace " IDFMT " " IDFMT " %u", 
+                            parent_id, unique_id, color);
       }
 
       static inline void log_field_space(unsigned unique_id)
       {
-        log_spy(LEVEL_INFO,"Field Space %u", unique_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_FIELD_SPACE);
+          encoder.put(unique_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Field Space %u", unique_id);
       }
 
       static inline void log_field_space_name(unsigned unique_id,
                                               const char* name)
       {
-        log_spy(LEVEL_INFO,"Field Space Name %u %s",
-            unique_id, name);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_FIELD_SPACE_NAME);
+          encoder.put(unique_id);
+          encoder.put(name);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Field Space Name %u %s",
+              unique_id, name);
       }
 
       static inline void log_field_creation(unsigned unique_id, 
                                             unsigned field_id)
       {
-        log_spy(LEVEL_INFO,"Field Creation %u %u", 
-                            unique_id, field_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_FIELD_CREATION);
+          encoder.put(unique_id);
+          encoder.put(field_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Field Creation %u %u", 
+                              unique_id, field_id);
       }
 
       static inline void log_field_name(unsigned unique_id,
                                         unsigned field_id,
                                         const char* name)
       {
-        log_spy(LEVEL_INFO,"Field Name %u %u %s",
-            unique_id, field_id, name);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_FIELD_NAME);
+          encoder.put(unique_id);
+          encoder.put(field_id);
+          encoder.put(name);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Field Name %u %u %s",
+              unique_id, field_id, name);
       }
 
       static inline void log_top_region(IDType index_space, 
                       unsigned field_space, unsigned tree_id)
       {
-        log_spy(LEVEL_INFO,"Region " IDFMT " %u %u", 
-              index_space, field_space, tree_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_TOP_REGION);
+          encoder.put(index_space);
+          encoder.put(field_space);
+          encoder.put(tree_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Region " IDFMT " %u %u", 
+                index_space, field_space, tree_id);
       }
 
       static inline void log_logical_region_name(IDType index_space, 
                       unsigned field_space, unsigned tree_id,
                       const char* name)
       {
-        log_spy(LEVEL_INFO,"Logical Region Name " IDFMT " %u %u %s", 
-              index_space, field_space, tree_id, name);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_LOGICAL_REGION_NAME);
+          encoder.put(index_space);
+          encoder.put(field_space);
+          encoder.put(tree_id);
+          encoder.put(name);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Logical Region Name " IDFMT " %u %u %s", 
+                index_space, field_space, tree_id, name);
       }
 
       static inline void log_logical_partition_name(IDType index_partition,
                       unsigned field_space, unsigned tree_id,
                       const char* name)
       {
-        log_spy(LEVEL_INFO,"Logical Partition Name " IDFMT " %u %u %s", 
-              index_partition, field_space, tree_id, name);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_LOGICAL_PARTITION_NAME);
+          encoder.put(index_partition);
+          encoder.put(field_space);
+          encoder.put(tree_id);
+          encoder.put(name);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Logical Partition Name " IDFMT " %u %u %s", 
+                index_partition, field_space, tree_id, name);
       }
 
       // Logger calls for operations 
@@ -160,8 +458,18 @@ namespace LegionRuntime {
                                             UniqueID unique_id,
                                             const char *name)
       {
-        log_spy(LEVEL_INFO,"Top Task %u %llu %s", 
-            task_id, unique_id, name);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_TOP_LEVEL_TASK);
+          encoder.put(task_id);
+          encoder.put(unique_id);
+          encoder.put(name);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Top Task %u %llu %s", 
+              task_id, unique_id, name);
       }
 
       static inline void log_individual_task(UniqueID context,
@@ -169,8 +477,19 @@ namespace LegionRuntime {
                                              Processor::TaskFuncID task_id,
                                              const char *name)
       {
-        log_spy(LEVEL_INFO,"Individual Task %llu %u %llu %s", 
-            context, task_id, unique_id, name);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_INDIVIDUAL_TASK);
+          encoder.put(context);
+          encoder.put(task_id);
+          encoder.put(unique_id);
+          encoder.put(name);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Individual Task %llu %u %llu %s", 
+              context, task_id, unique_id, name);
       }
 
       static inline void log_index_task(UniqueID context,
@@ -178,81 +497,195 @@ namespace LegionRuntime {
                                         Processor::TaskFuncID task_id,
                                         const char *name)
       {
-        log_spy(LEVEL_INFO,"Index Task %llu %u %llu %s",
-            context, task_id, unique_id, name);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_INDEX_TASK);
+          encoder.put(context);
+          encoder.put(task_id);
+          encoder.put(unique_id);
+          encoder.put(name);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Index Task %llu %u %llu %s",
+              context, task_id, unique_id, name);
       }
 
       static inline void log_mapping_operation(UniqueID context,
                                                UniqueID unique_id)
       {
-        log_spy(LEVEL_INFO,"Mapping Operation %llu %llu",
-            context, unique_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_MAPPING_OPERATION);
+          encoder.put(context);
+          encoder.put(unique_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Mapping Operation %llu %llu",
+              context, unique_id);
       }
 
       static inline void log_close_operation(UniqueID context,
                                              UniqueID unique_id)
       {
-        log_spy(LEVEL_INFO,"Close Operation %llu %llu",
-            context, unique_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_CLOSE_OPERATION);
+          encoder.put(context);
+          encoder.put(unique_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Close Operation %llu %llu",
+              context, unique_id);
       }
 
       static inline void log_fence_operation(UniqueID context,
                                              UniqueID unique_id)
       {
-        log_spy(LEVEL_INFO,"Fence Operation %llu %llu",
-            context, unique_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_FENCE_OPERATION);
+          encoder.put(context);
+          encoder.put(unique_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Fence Operation %llu %llu",
+              context, unique_id);
       }
 
       static inline void log_copy_operation(UniqueID context,
                                             UniqueID unique_id)
       {
-        log_spy(LEVEL_INFO,"Copy Operation %llu %llu",
-            context, unique_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_COPY_OPERATION);
+          encoder.put(context);
+          encoder.put(unique_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Copy Operation %llu %llu",
+              context, unique_id);
       }
 
       static inline void log_acquire_operation(UniqueID context,
                                                UniqueID unique_id)
       {
-        log_spy(LEVEL_INFO,"Acquire Operation %llu %llu",
-            context, unique_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_ACQUIRE_OPERATION);
+          encoder.put(context);
+          encoder.put(unique_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Acquire Operation %llu %llu",
+              context, unique_id);
       }
 
       static inline void log_release_operation(UniqueID context,
                                                UniqueID unique_id)
       {
-        log_spy(LEVEL_INFO,"Release Operation %llu %llu",
-            context, unique_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_RELEASE_OPERATION);
+          encoder.put(context);
+          encoder.put(unique_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Release Operation %llu %llu",
+              context, unique_id);
       }
 
       static inline void log_deletion_operation(UniqueID context,
                                                 UniqueID deletion)
       {
-        log_spy(LEVEL_INFO,"Deletion Operation %llu %llu",
-            context, deletion);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_DELETION_OPERATION);
+          encoder.put(context);
+          encoder.put(deletion);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Deletion Operation %llu %llu",
+              context, deletion);
       }
 
       static inline void log_index_slice(UniqueID index_id, UniqueID slice_id)
       {
-        log_spy(LEVEL_INFO,"Index Slice %llu %llu", index_id, slice_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_INDEX_SLICE);
+          encoder.put(index_id);
+          encoder.put(slice_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Index Slice %llu %llu", index_id, slice_id);
       }
 
       static inline void log_slice_slice(UniqueID slice_one, UniqueID slice_two)
       {
-        log_spy(LEVEL_INFO,"Slice Slice %llu %llu", slice_one, slice_two);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_SLICE_SLICE);
+          encoder.put(slice_one);
+          encoder.put(slice_two);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Slice Slice %llu %llu", slice_one, slice_two);
       }
 
       static inline void log_slice_point(UniqueID slice_id, UniqueID point_id,
                                          const DomainPoint &point)
       {
-        log_spy(LEVEL_INFO,"Slice Point %llu %llu %u %u %u %u", 
-            slice_id, point_id,
-            point.dim, point.point_data[0],
-            point.point_data[1], point.point_data[2]);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_SLICE_POINT);
+          encoder.put(slice_id);
+          encoder.put(point_id);
+          encoder.put(point.dim);
+          encoder.put(unsigned(point.point_data[0]));
+          encoder.put(unsigned(point.point_data[1]));
+          encoder.put(unsigned(point.point_data[2]));
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Slice Point %llu %llu %u %u %u %u", 
+              slice_id, point_id,
+              point.dim, point.point_data[0],
+              point.point_data[1], point.point_data[2]);
       }
 
       static inline void log_point_point(UniqueID p1, UniqueID p2)
       {
-        log_spy(LEVEL_INFO,"Point Point %llu %llu", p1, p2);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_POINT_POINT);
+          encoder.put(p1);
+          encoder.put(p2);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Point Point %llu %llu", p1, p2);
       }
 
       // Logger calls for mapping dependence analysis 
@@ -261,9 +694,25 @@ namespace LegionRuntime {
           unsigned field_component, unsigned tree_id, unsigned privilege, 
           unsigned coherence, unsigned redop)
       {
-        log_spy(LEVEL_INFO,"Logical Requirement %llu %u %u " IDFMT " %u %u %u %u %u", 
-            unique_id, index, region, index_component,
-            field_component, tree_id, privilege, coherence, redop);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_LOGICAL_REQUIREMENT);
+          encoder.put(unique_id);
+          encoder.put(index);
+          encoder.put(region);
+          encoder.put(index_component);
+          encoder.put(field_component);
+          encoder.put(tree_id);
+          encoder.put(privilege);
+          encoder.put(coherence);
+          encoder.put(redop);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Logical Requirement %llu %u %u " IDFMT " %u %u %u %u %u", 
+              unique_id, index, region, index_component,
+              field_component, tree_id, privilege, coherence, redop);
       }
 
       static inline void log_requirement_fields(UniqueID unique_id, 
@@ -272,8 +721,18 @@ namespace LegionRuntime {
         for (std::set<unsigned>::const_iterator it = logical_fields.begin();
               it != logical_fields.end(); it++)
         {
-          log_spy(LEVEL_INFO,"Logical Requirement Field %llu %u %u", 
-                              unique_id, index, *it);
+          if (binary_spy)
+          {
+            SpyEncoder &encoder = get_spy_encoder();
+            encoder.begin(SPY_REQUIREMENT_FIELD);
+            encoder.put(unique_id);
+            encoder.put(index);
+            encoder.put(*it);
+            encoder.end();
+          }
+          else
+            log_spy(LEVEL_INFO,"Logical Requirement Field %llu %u %u", 
+                                unique_id, index, *it);
         }
       }
 
@@ -281,22 +740,55 @@ namespace LegionRuntime {
                 UniqueID prev_id, unsigned prev_idx, UniqueID next_id, 
                 unsigned next_idx, unsigned dep_type)
       {
-        log_spy(LEVEL_INFO,"Mapping Dependence %llu %llu %u %llu %u %d", 
-            context, prev_id, prev_idx, next_id, next_idx, dep_type);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_MAPPING_DEPENDENCE);
+          encoder.put(context);
+          encoder.put(prev_id);
+          encoder.put(prev_idx);
+          encoder.put(next_id);
+          encoder.put(next_idx);
+          encoder.put(dep_type);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Mapping Dependence %llu %llu %u %llu %u %d", 
+              context, prev_id, prev_idx, next_id, next_idx, dep_type);
       }
 
       // Logger calls for physical dependence analysis
       static inline void log_task_instance_requirement(UniqueID unique_id, 
                                   unsigned idx, unsigned index)
       {
-        log_spy(LEVEL_INFO,"Task Instance Requirement %llu %u %u", 
-                            unique_id, idx, index);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_TASK_INSTANCE_REQUIREMENT);
+          encoder.put(unique_id);
+          encoder.put(idx);
+          encoder.put(index);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Task Instance Requirement %llu %u %u", 
+                              unique_id, idx, index);
       }
 
       // Logger calls for events
       static inline void log_event_dependence(Event one, Event two)
       {
-        if (one != two)
+        if (one == two)
+          return;
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_EVENT_DEPENDENCE);
+          encoder.put(one);
+          encoder.put(two);
+          encoder.end();
+        }
+        else
           log_spy(LEVEL_INFO,"Event Event " IDFMT " %u " IDFMT " %u", 
                           one.id, one.gen, two.id, two.gen);
       }
@@ -306,16 +798,30 @@ namespace LegionRuntime {
       {
         for (std::set<Event>::const_iterator it = preconditions.begin();
               it != preconditions.end(); it++)
-        {
-          if (*it != result)
-            log_spy(LEVEL_INFO,"Event Event " IDFMT " %u " IDFMT " %u", 
-                    it->id, it->gen, result.id, result.gen);
-        }
+          log_event_dependence(*it, result);
+      }
+
+      static inline void log_event_dependences(
+          const std::vector<Event> &preconditions, Event result)
+      {
+        for (std::vector<Event>::const_iterator it = preconditions.begin();
+              it != preconditions.end(); it++)
+          log_event_dependence(*it, result);
       }
 
       static inline void log_implicit_dependence(Event one, Event two)
       {
-        if (one != two)
+        if (one == two)
+          return;
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_IMPLICIT_DEPENDENCE);
+          encoder.put(one);
+          encoder.put(two);
+          encoder.end();
+        }
+        else
           log_spy(LEVEL_INFO,"Implicit Event " IDFMT " %u " IDFMT " %u",
               one.id, one.gen, two.id, two.gen);
       }
@@ -323,9 +829,19 @@ namespace LegionRuntime {
       static inline void log_op_events(UniqueID uid, Event start_event,
                                        Event term_event)
       {
-        log_spy(LEVEL_INFO,"Op Events %llu " IDFMT " %u " IDFMT " %u",
-            uid, start_event.id, start_event.gen, 
-            term_event.id, term_event.gen);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_OP_EVENTS);
+          encoder.put(uid);
+          encoder.put(start_event);
+          encoder.put(term_event);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Op Events %llu " IDFMT " %u " IDFMT " %u",
+              uid, start_event.id, start_event.gen, 
+              term_event.id, term_event.gen);
       }
 
       static inline void log_copy_operation(IDType src_inst,
@@ -339,6 +855,30 @@ namespace LegionRuntime {
                                             std::set<FieldID> fields)
                                             //const char *mask)
       {
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_COPY_EVENTS);
+          encoder.put(src_inst);
+          encoder.put(dst_inst);
+          encoder.put(index_handle);
+          encoder.put(field_handle);
+          encoder.put(tree_id);
+          encoder.put(start_event);
+          encoder.put(term_event);
+          encoder.put(redop);
+          encoder.end();
+          for (std::set<FieldID>::iterator it = fields.begin();
+               it != fields.end(); ++it)
+          {
+            encoder.begin(SPY_COPY_FIELD);
+            encoder.put(start_event);
+            encoder.put(term_event);
+            encoder.put(*it);
+            encoder.end();
+          }
+          return;
+        }
         log_spy(LEVEL_INFO,"Copy Events " IDFMT " " IDFMT " " IDFMT 
                            " %u %u " IDFMT " %u " IDFMT " %u %u",
             src_inst, dst_inst, index_handle, field_handle,
@@ -355,39 +895,92 @@ namespace LegionRuntime {
                          IDType mem_id, IDType index_handle, 
                          unsigned field_handle, unsigned tree_id)
       {
-        log_spy(LEVEL_INFO, "Physical Instance " IDFMT " " IDFMT " " 
-                            IDFMT " %u %u", 
-            inst_id, mem_id, index_handle, field_handle, tree_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_PHYSICAL_INSTANCE);
+          encoder.put(inst_id);
+          encoder.put(mem_id);
+          encoder.put(index_handle);
+          encoder.put(field_handle);
+          encoder.put(tree_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO, "Physical Instance " IDFMT " " IDFMT " " 
+                              IDFMT " %u %u", 
+              inst_id, mem_id, index_handle, field_handle, tree_id);
       }
 
       static inline void log_physical_reduction(IDType inst_id, 
           IDType mem_id, IDType index_handle, unsigned field_handle, 
           unsigned tree_id, bool fold, unsigned indirect_id = 0)
       {
-        log_spy(LEVEL_INFO, "Reduction Instance " IDFMT " " IDFMT " " 
-                            IDFMT " %u %u %u %u", 
-                             inst_id, mem_id, index_handle, field_handle, 
-                             tree_id, fold, indirect_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_PHYSICAL_REDUCTION);
+          encoder.put(inst_id);
+          encoder.put(mem_id);
+          encoder.put(index_handle);
+          encoder.put(field_handle);
+          encoder.put(tree_id);
+          encoder.put(fold);
+          encoder.put(indirect_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO, "Reduction Instance " IDFMT " " IDFMT " " 
+                              IDFMT " %u %u %u %u", 
+                               inst_id, mem_id, index_handle, field_handle, 
+                               tree_id, fold, indirect_id);
       }
 
       static inline void log_op_user(UniqueID user,
                                      unsigned idx, 
                                      IDType inst_id)
       {
-        log_spy(LEVEL_INFO, "Op Instance User %llu %u " IDFMT "", 
-                              user, idx, inst_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_OP_USER);
+          encoder.put(user);
+          encoder.put(idx);
+          encoder.put(inst_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO, "Op Instance User %llu %u " IDFMT "", 
+                                user, idx, inst_id);
       }
 
       static inline void log_phase_barrier(Barrier barrier)
       {
-        log_spy(LEVEL_INFO,"Phase Barrier " IDFMT, barrier.id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_PHASE_BARRIER);
+          encoder.put(barrier.id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO,"Phase Barrier " IDFMT, barrier.id);
       }
 
       static inline void log_op_proc_user(UniqueID user,
                                           IDType proc_id)
       {
-        log_spy(LEVEL_INFO, "Op Processor User %llu " IDFMT "",
-                              user, proc_id);
+        if (binary_spy)
+        {
+          SpyEncoder &encoder = get_spy_encoder();
+          encoder.begin(SPY_OP_PROC_USER);
+          encoder.put(user);
+          encoder.put(proc_id);
+          encoder.end();
+        }
+        else
+          log_spy(LEVEL_INFO, "Op Processor User %llu " IDFMT "",
+                                user, proc_id);
       }
 
     };
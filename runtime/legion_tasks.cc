@@ -538,6 +538,14 @@ namespace LegionRuntime {
       return runtime->invoke_mapper_speculate(exec_proc, this, value);
     }
 
+    //--------------------------------------------------------------------------
+    void TaskOp::find_dependence_trees(std::set<RegionTreeID> &trees)
+    //--------------------------------------------------------------------------
+    {
+      for (unsigned idx = 0; idx < regions.size(); idx++)
+        trees.insert(regions[idx].parent.get_tree_id());
+    }
+
     //--------------------------------------------------------------------------
     void TaskOp::activate_outstanding_task(void)
     //--------------------------------------------------------------------------
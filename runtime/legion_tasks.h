@@ -82,6 +82,7 @@ namespace LegionRuntime {
       virtual void resolve_true(void);
       virtual void resolve_false(void) = 0;
       virtual bool speculate(bool &value);
+      virtual void find_dependence_trees(std::set<RegionTreeID> &trees);
     public:
       virtual bool premap_task(void) = 0;
       virtual bool prepare_steal(void) = 0;
@@ -114,6 +114,8 @@ namespace LegionRuntime {
       HLR_DEFERRED_FUTURE_MAP_SET_ID,
       HLR_RESOLVE_FUTURE_PRED_ID,
       HLR_MPI_RANK_ID,
+      HLR_MESSAGE_FLUSH_ID,
+      HLR_PARTITION_INTERFERENCE_ID,
     };
 
     // Forward declarations for user level objects
@@ -291,6 +293,7 @@ namespace LegionRuntime {
     template<unsigned int MAX> class AVXBitMask;
     template<unsigned int MAX> class AVXTLBitMask;
 #endif
+    template<typename DENSE, unsigned int MAX> class HybridBitMask;
     template<typename T, unsigned LOG2MAX> class BitPermutation;
 
     // legion_logging.h
@@ -364,6 +367,11 @@ namespace LegionRuntime {
     // aligned backing store on the heap.  While correct, this
     // will disable many compiler optimizations due to GCC and
     // other C compilers being awful at alias analysis.
+    // Building with -DHYBRID_FIELD_MASKS keeps masks with only
+    // a few fields set in a compact sparse form and only falls
+    // back to one of the dense masks (allocated on the heap, so
+    // AVX masks are safe to use) when more fields are set.  This
+    // saves a lot of memory when MAX_FIELDS is large.
 
 // The folowing macros are used in the FieldMask instantiation of BitMask
 // If you change one you probably have to change the others too
@@ -372,7 +380,24 @@ namespace LegionRuntime {
 #define FIELD_MASK          0x3F
 #define FIELD_ALL_ONES      0xFFFFFFFFFFFFFFFF
 
-#if defined(DYNAMIC_FIELD_MASKS) && defined(__AVX__)
+#if defined(HYBRID_FIELD_MASKS)
+#if defined(__AVX__) && (MAX_FIELDS > 256)
+    typedef AVXTLBitMask<MAX_FIELDS> DenseFieldMask;
+#elif defined(__AVX__) && (MAX_FIELDS > 128)
+    typedef AVXBitMask<MAX_FIELDS> DenseFieldMask;
+#elif defined(__SSE2__) && (MAX_FIELDS > 128)
+    typedef SSETLBitMask<MAX_FIELDS> DenseFieldMask;
+#elif defined(__SSE2__) && (MAX_FIELDS > 64)
+    typedef SSEBitMask<MAX_FIELDS> DenseFieldMask;
+#elif (MAX_FIELDS > 64)
+    typedef TLBitMask<FIELD_TYPE,MAX_FIELDS,FIELD_SHIFT,FIELD_MASK> 
+                                                              DenseFieldMask;
+#else
+    typedef BitMask<FIELD_TYPE,MAX_FIELDS,FIELD_SHIFT,FIELD_MASK> 
+                                                              DenseFieldMask;
+#endif
+    typedef HybridBitMask<DenseFieldMask,MAX_FIELDS> FieldMask;
+#elif defined(DYNAMIC_FIELD_MASKS) && defined(__AVX__)
 #if (MAX_FIELDS > 256)
     typedef AVXTLBitMask<MAX_FIELDS> FieldMask;
 #elif (MAX_FIELDS > 128)
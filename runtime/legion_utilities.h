@@ -20,6 +20,7 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <new>
 
 #include "legion_types.h"
 #include "legion.h"
@@ -845,6 +846,99 @@ namespace LegionRuntime {
     };
 #endif // __AVX__
 
+    /////////////////////////////////////////////////////////////
+    // Hybrid Bit Mask  
+    /////////////////////////////////////////////////////////////
+    /*
+     * This is a bit mask for large MAX values where most masks
+     * only have a few bits set.  Up to SPARSE_MAX set bits are
+     * stored inline as a sorted list of indices which keeps the
+     * mask no bigger than a pointer and two words.  Once more
+     * bits are set the mask switches over to a heap allocated
+     * DENSE bit mask (one of the masks above) and all the
+     * operations are handed off to it.  Operations that can
+     * only remove bits switch back to the sparse form whenever
+     * the result is small enough.  It supports the same
+     * operations as the other bit masks except for the raw
+     * word and vector accessors since the words of a sparse
+     * mask don't exist in memory; operator[] returns words
+     * by value instead.
+     */
+    template<typename DENSE, unsigned int MAX>
+    class HybridBitMask {
+    public:
+      // Fills out three words with the size
+      static const unsigned SPARSE_MAX = 11;
+    public:
+      explicit HybridBitMask(uint64_t init = 0);
+      HybridBitMask(const HybridBitMask &rhs);
+      ~HybridBitMask(void);
+    public:
+      inline void set_bit(unsigned bit);
+      inline void unset_bit(unsigned bit);
+      inline void assign_bit(unsigned bit, bool val);
+      inline bool is_set(unsigned bit) const;
+      inline int find_first_set(void) const;
+      inline void clear(void);
+    public:
+      inline bool operator==(const HybridBitMask &rhs) const;
+      inline bool operator<(const HybridBitMask &rhs) const;
+      inline bool operator!=(const HybridBitMask &rhs) const;
+    public:
+      inline uint64_t operator[](const unsigned &idx) const;
+      inline HybridBitMask& operator=(const HybridBitMask &rhs);
+    public:
+      inline HybridBitMask operator~(void) const;
+      inline HybridBitMask operator|(const HybridBitMask &rhs) const;
+      inline HybridBitMask operator&(const HybridBitMask &rhs) const;
+      inline HybridBitMask operator^(const HybridBitMask &rhs) const;
+    public:
+      inline HybridBitMask& operator|=(const HybridBitMask &rhs);
+      inline HybridBitMask& operator&=(const HybridBitMask &rhs);
+      inline HybridBitMask& operator^=(const HybridBitMask &rhs);
+    public:
+      // Use * for disjointness testing
+      inline bool operator*(const HybridBitMask &rhs) const;
+      // Set difference
+      inline HybridBitMask operator-(const HybridBitMask &rhs) const;
+      inline HybridBitMask& operator-=(const HybridBitMask &rhs);
+      // Test to see if everything is zeros
+      inline bool operator!(void) const;
+    public:
+      inline HybridBitMask operator<<(unsigned shift) const;
+      inline HybridBitMask operator>>(unsigned shift) const;
+    public:
+      inline HybridBitMask& operator<<=(unsigned shift);
+      inline HybridBitMask& operator>>=(unsigned shift);
+    public:
+      inline uint64_t get_hash_key(void) const;
+      inline bool is_dense(void) const;
+      inline void serialize(Serializer &rez) const;
+      inline void deserialize(Deserializer &derez);
+    public:
+      // Allocates memory that becomes owned by the caller
+      inline char* to_string(void) const;
+    public:
+      static inline int pop_count(const HybridBitMask<DENSE,MAX> &mask);
+    protected:
+      inline void make_dense(void);
+      inline void compact(void);
+      static inline DENSE* allocate_dense(uint64_t init);
+      static inline DENSE* allocate_dense(const DENSE &rhs);
+      static inline void free_dense(DENSE *dense);
+    protected:
+      // The size is DENSE_SIZE when the bits are in the dense mask.
+      // It comes after the indices so it never overlaps the pointer.
+      static const uint16_t DENSE_SIZE = 0xFFFF;
+      union {
+        DENSE *dense;
+        struct {
+          uint16_t indices[SPARSE_MAX];
+          uint16_t size;
+        } sparse;
+      } bits;
+    };
+
     /////////////////////////////////////////////////////////////
     // Bit Permutation 
     /////////////////////////////////////////////////////////////
@@ -912,7 +1006,9 @@ namespace LegionRuntime {
     {
       while ((index + sizeof(T)) > total_bytes)
         resize();
-      *((T*)(buffer+index)) = element;
+      // The buffer has no alignment to speak of, so don't let the
+      // compiler use aligned stores for types like the SSE bit masks
+      memcpy(buffer+index, &element, sizeof(T));
       index += sizeof(T);
 #ifdef DEBUG_HIGH_LEVEL
       context_bytes += sizeof(T);
@@ -1015,7 +1111,7 @@ namespace LegionRuntime {
       // Check to make sure we don't read past the end
       assert((index+sizeof(T)) <= total_bytes);
 #endif
-      element = *((const T*)(buffer+index));
+      memcpy(&element, buffer+index, sizeof(T));
       index += sizeof(T);
 #ifdef DEBUG_HIGH_LEVEL
       context_bytes += sizeof(T);
@@ -1735,7 +1831,7 @@ namespace LegionRuntime {
           result[idx] = bit_vector[idx+range];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           result[idx] = 0;
       }
       else
@@ -1810,7 +1906,7 @@ namespace LegionRuntime {
           bit_vector[idx] = bit_vector[idx+range];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           bit_vector[idx] = 0;
       }
       else
@@ -2376,7 +2472,7 @@ namespace LegionRuntime {
           result.sum_mask |= result[idx];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           result[idx] = 0;
       }
       else
@@ -2459,7 +2555,7 @@ namespace LegionRuntime {
           sum_mask |= bit_vector[idx];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           bit_vector[idx] = 0;
       }
       else
@@ -2998,7 +3094,7 @@ namespace LegionRuntime {
           result[idx] = bits.bit_vector[idx+range];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           result[idx] = 0;
       }
       else
@@ -3071,7 +3167,7 @@ namespace LegionRuntime {
           bits.bit_vector[idx] = bits.bit_vector[idx+range];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           bits.bit_vector[idx] = 0;
       }
       else
@@ -3624,7 +3720,7 @@ namespace LegionRuntime {
           result.sum_mask |= result[idx];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           result[idx] = 0;
       }
       else
@@ -3705,7 +3801,7 @@ namespace LegionRuntime {
           sum_mask |= bits.bit_vector[idx];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           bits.bit_vector[idx] = 0;
       }
       else
@@ -4358,7 +4454,7 @@ namespace LegionRuntime {
           result[idx] = bits.bit_vector[idx+range];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           result[idx] = 0;
       }
       else
@@ -4431,7 +4527,7 @@ namespace LegionRuntime {
           bits.bit_vector[idx] = bits.bit_vector[idx+range];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           bits.bit_vector[idx] = 0;
       }
       else
@@ -5135,7 +5231,7 @@ namespace LegionRuntime {
           result.sum_mask |= result[idx];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           result[idx] = 0;
       }
       else
@@ -5216,7 +5312,7 @@ namespace LegionRuntime {
           sum_mask |= bits.bit_vector[idx];
         }
         // Fill in everything else with zeros
-        for (unsigned idx = (BIT_ELMTS-range); idx < (BIT_ELMTS-1); idx++)
+        for (unsigned idx = (BIT_ELMTS-range); idx < BIT_ELMTS; idx++)
           bits.bit_vector[idx] = 0;
       }
       else
@@ -5351,6 +5447,740 @@ namespace LegionRuntime {
 #undef AVX_ELMTS
 #endif // __AVX__
 
+#define BIT_ELMTS (MAX/64)
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    HybridBitMask<DENSE,MAX>::HybridBitMask(uint64_t init /*= 0*/)
+    //-------------------------------------------------------------------------
+    {
+      LEGION_STATIC_ASSERT(MAX < DENSE_SIZE);
+      if (init != 0)
+      {
+        bits.dense = allocate_dense(init);
+        bits.sparse.size = DENSE_SIZE;
+      }
+      else
+        bits.sparse.size = 0;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    HybridBitMask<DENSE,MAX>::HybridBitMask(const HybridBitMask &rhs)
+    //-------------------------------------------------------------------------
+    {
+      bits.sparse.size = rhs.bits.sparse.size;
+      if (rhs.is_dense())
+        bits.dense = allocate_dense(*rhs.bits.dense);
+      else
+      {
+        for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+          bits.sparse.indices[idx] = rhs.bits.sparse.indices[idx];
+      }
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    HybridBitMask<DENSE,MAX>::~HybridBitMask(void)
+    //-------------------------------------------------------------------------
+    {
+      if (is_dense())
+        free_dense(bits.dense);
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline void HybridBitMask<DENSE,MAX>::set_bit(unsigned bit)
+    //-------------------------------------------------------------------------
+    {
+#ifdef DEBUG_HIGH_LEVEL
+      assert(bit < MAX);
+#endif
+      if (is_dense())
+      {
+        bits.dense->set_bit(bit);
+        return;
+      }
+      // Find where it goes in the sorted list
+      unsigned pos = 0;
+      while ((pos < bits.sparse.size) && (bits.sparse.indices[pos] < bit))
+        pos++;
+      if ((pos < bits.sparse.size) && (bits.sparse.indices[pos] == bit))
+        return;
+      if (bits.sparse.size == SPARSE_MAX)
+      {
+        make_dense();
+        bits.dense->set_bit(bit);
+        return;
+      }
+      for (unsigned idx = bits.sparse.size; idx > pos; idx--)
+        bits.sparse.indices[idx] = bits.sparse.indices[idx-1];
+      bits.sparse.indices[pos] = bit;
+      bits.sparse.size++;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline void HybridBitMask<DENSE,MAX>::unset_bit(unsigned bit)
+    //-------------------------------------------------------------------------
+    {
+#ifdef DEBUG_HIGH_LEVEL
+      assert(bit < MAX);
+#endif
+      // Don't bother going back to sparse here since masks
+      // that have bits unset tend to get bits set again
+      if (is_dense())
+      {
+        bits.dense->unset_bit(bit);
+        return;
+      }
+      for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+      {
+        if (bits.sparse.indices[idx] == bit)
+        {
+          bits.sparse.size--;
+          for ( ; idx < bits.sparse.size; idx++)
+            bits.sparse.indices[idx] = bits.sparse.indices[idx+1];
+          return;
+        }
+      }
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline void HybridBitMask<DENSE,MAX>::assign_bit(unsigned bit, bool val)
+    //-------------------------------------------------------------------------
+    {
+      if (val)
+        set_bit(bit);
+      else
+        unset_bit(bit);
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline bool HybridBitMask<DENSE,MAX>::is_set(unsigned bit) const
+    //-------------------------------------------------------------------------
+    {
+#ifdef DEBUG_HIGH_LEVEL
+      assert(bit < MAX);
+#endif
+      if (is_dense())
+        return bits.dense->is_set(bit);
+      for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+      {
+        if (bits.sparse.indices[idx] == bit)
+          return true;
+      }
+      return false;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline int HybridBitMask<DENSE,MAX>::find_first_set(void) const
+    //-------------------------------------------------------------------------
+    {
+      if (is_dense())
+        return bits.dense->find_first_set();
+      if (bits.sparse.size > 0)
+        return bits.sparse.indices[0];
+      return -1;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline void HybridBitMask<DENSE,MAX>::clear(void)
+    //-------------------------------------------------------------------------
+    {
+      if (is_dense())
+        free_dense(bits.dense);
+      bits.sparse.size = 0;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline bool HybridBitMask<DENSE,MAX>::operator==(
+                                               const HybridBitMask &rhs) const
+    //-------------------------------------------------------------------------
+    {
+      if (is_dense() && rhs.is_dense())
+        return (*bits.dense == *rhs.bits.dense);
+      if (!is_dense() && !rhs.is_dense())
+      {
+        if (bits.sparse.size != rhs.bits.sparse.size)
+          return false;
+        for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+        {
+          if (bits.sparse.indices[idx] != rhs.bits.sparse.indices[idx])
+            return false;
+        }
+        return true;
+      }
+      // Dense masks can still hold only a few bits so compare words
+      for (unsigned idx = 0; idx < BIT_ELMTS; idx++)
+      {
+        if ((*this)[idx] != rhs[idx])
+          return false;
+      }
+      return true;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline bool HybridBitMask<DENSE,MAX>::operator<(
+                                               const HybridBitMask &rhs) const
+    //-------------------------------------------------------------------------
+    {
+      if (is_dense() && rhs.is_dense())
+        return (*bits.dense < *rhs.bits.dense);
+      // Same word order as the other bit masks
+      for (unsigned idx = 0; idx < BIT_ELMTS; idx++)
+      {
+        const uint64_t left = (*this)[idx];
+        const uint64_t right = rhs[idx];
+        if (left < right)
+          return true;
+        else if (left > right)
+          return false;
+      }
+      // Otherwise they are equal so false
+      return false;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline bool HybridBitMask<DENSE,MAX>::operator!=(
+                                               const HybridBitMask &rhs) const
+    //-------------------------------------------------------------------------
+    {
+      return !(*this == rhs);
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline uint64_t HybridBitMask<DENSE,MAX>::operator[](
+                                                  const unsigned &idx) const
+    //-------------------------------------------------------------------------
+    {
+      if (is_dense())
+        return (*bits.dense)[idx];
+      uint64_t result = 0;
+      for (unsigned i = 0; i < bits.sparse.size; i++)
+      {
+        if ((unsigned(bits.sparse.indices[i]) >> 6) == idx)
+          result |= (1UL << (bits.sparse.indices[i] & 0x3F));
+      }
+      return result;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX>& HybridBitMask<DENSE,MAX>::operator=(
+                                                     const HybridBitMask &rhs)
+    //-------------------------------------------------------------------------
+    {
+      if (this == &rhs)
+        return *this;
+      if (rhs.is_dense())
+      {
+        if (is_dense())
+          *bits.dense = *rhs.bits.dense;
+        else
+        {
+          bits.dense = allocate_dense(*rhs.bits.dense);
+          bits.sparse.size = DENSE_SIZE;
+        }
+      }
+      else
+      {
+        if (is_dense())
+          free_dense(bits.dense);
+        bits.sparse.size = rhs.bits.sparse.size;
+        for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+          bits.sparse.indices[idx] = rhs.bits.sparse.indices[idx];
+      }
+      return *this;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX> HybridBitMask<DENSE,MAX>::operator~(
+                                                                    void) const
+    //-------------------------------------------------------------------------
+    {
+      // Start with all ones and take away our bits without
+      // ever making a dense mask on the stack
+      HybridBitMask<DENSE,MAX> result(0xFFFFFFFFFFFFFFFF);
+      result -= *this;
+      return result;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX> HybridBitMask<DENSE,MAX>::operator|(
+                                               const HybridBitMask &rhs) const
+    //-------------------------------------------------------------------------
+    {
+      HybridBitMask<DENSE,MAX> result(*this);
+      result |= rhs;
+      return result;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX> HybridBitMask<DENSE,MAX>::operator&(
+                                               const HybridBitMask &rhs) const
+    //-------------------------------------------------------------------------
+    {
+      HybridBitMask<DENSE,MAX> result;
+      if (!is_dense() || !rhs.is_dense())
+      {
+        // The result is no bigger than the sparse side
+        // so we can build it directly in sparse form
+        const HybridBitMask &small = is_dense() ? rhs : *this;
+        const HybridBitMask &other = is_dense() ? *this : rhs;
+        for (unsigned idx = 0; idx < small.bits.sparse.size; idx++)
+        {
+          if (other.is_set(small.bits.sparse.indices[idx]))
+            result.bits.sparse.indices[result.bits.sparse.size++] = 
+              small.bits.sparse.indices[idx];
+        }
+        return result;
+      }
+      result = *this;
+      result &= rhs;
+      return result;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX> HybridBitMask<DENSE,MAX>::operator^(
+                                               const HybridBitMask &rhs) const
+    //-------------------------------------------------------------------------
+    {
+      HybridBitMask<DENSE,MAX> result(*this);
+      result ^= rhs;
+      return result;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX>& HybridBitMask<DENSE,MAX>::operator|=(
+                                                     const HybridBitMask &rhs)
+    //-------------------------------------------------------------------------
+    {
+      if (!rhs.is_dense())
+      {
+        for (unsigned idx = 0; idx < rhs.bits.sparse.size; idx++)
+          set_bit(rhs.bits.sparse.indices[idx]);
+      }
+      else if (is_dense())
+        *bits.dense |= *rhs.bits.dense;
+      else
+      {
+        // Start from a copy of the right side and add our bits
+        DENSE *next = allocate_dense(*rhs.bits.dense);
+        for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+          next->set_bit(bits.sparse.indices[idx]);
+        bits.dense = next;
+        bits.sparse.size = DENSE_SIZE;
+      }
+      return *this;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX>& HybridBitMask<DENSE,MAX>::operator&=(
+                                                     const HybridBitMask &rhs)
+    //-------------------------------------------------------------------------
+    {
+      if (!is_dense())
+      {
+        unsigned next = 0;
+        for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+        {
+          if (rhs.is_set(bits.sparse.indices[idx]))
+            bits.sparse.indices[next++] = bits.sparse.indices[idx];
+        }
+        bits.sparse.size = next;
+      }
+      else if (!rhs.is_dense())
+      {
+        // Result is a subset of the right side so it is sparse
+        DENSE *old = bits.dense;
+        bits.sparse.size = 0;
+        for (unsigned idx = 0; idx < rhs.bits.sparse.size; idx++)
+        {
+          if (old->is_set(rhs.bits.sparse.indices[idx]))
+            bits.sparse.indices[bits.sparse.size++] = rhs.bits.sparse.indices[idx];
+        }
+        free_dense(old);
+      }
+      else
+      {
+        *bits.dense &= *rhs.bits.dense;
+        compact();
+      }
+      return *this;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX>& HybridBitMask<DENSE,MAX>::operator^=(
+                                                     const HybridBitMask &rhs)
+    //-------------------------------------------------------------------------
+    {
+      if (!rhs.is_dense())
+      {
+        for (unsigned idx = 0; idx < rhs.bits.sparse.size; idx++)
+        {
+          const unsigned bit = rhs.bits.sparse.indices[idx];
+          if (is_set(bit))
+            unset_bit(bit);
+          else
+            set_bit(bit);
+        }
+        compact();
+      }
+      else if (is_dense())
+      {
+        *bits.dense ^= *rhs.bits.dense;
+        compact();
+      }
+      else
+      {
+        // Start from a copy of the right side and flip our bits
+        DENSE *next = allocate_dense(*rhs.bits.dense);
+        for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+        {
+          const unsigned bit = bits.sparse.indices[idx];
+          if (next->is_set(bit))
+            next->unset_bit(bit);
+          else
+            next->set_bit(bit);
+        }
+        bits.dense = next;
+        bits.sparse.size = DENSE_SIZE;
+        compact();
+      }
+      return *this;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline bool HybridBitMask<DENSE,MAX>::operator*(
+                                               const HybridBitMask &rhs) const
+    //-------------------------------------------------------------------------
+    {
+      if (is_dense() && rhs.is_dense())
+        return (*bits.dense * *rhs.bits.dense);
+      const HybridBitMask &small = is_dense() ? rhs : *this;
+      const HybridBitMask &other = is_dense() ? *this : rhs;
+      for (unsigned idx = 0; idx < small.bits.sparse.size; idx++)
+      {
+        if (other.is_set(small.bits.sparse.indices[idx]))
+          return false;
+      }
+      return true;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX> HybridBitMask<DENSE,MAX>::operator-(
+                                               const HybridBitMask &rhs) const
+    //-------------------------------------------------------------------------
+    {
+      if (!is_dense())
+      {
+        HybridBitMask<DENSE,MAX> result;
+        for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+        {
+          if (!rhs.is_set(bits.sparse.indices[idx]))
+            result.bits.sparse.indices[result.bits.sparse.size++] = bits.sparse.indices[idx];
+        }
+        return result;
+      }
+      HybridBitMask<DENSE,MAX> result(*this);
+      result -= rhs;
+      return result;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX>& HybridBitMask<DENSE,MAX>::operator-=(
+                                                     const HybridBitMask &rhs)
+    //-------------------------------------------------------------------------
+    {
+      if (!is_dense())
+      {
+        unsigned next = 0;
+        for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+        {
+          if (!rhs.is_set(bits.sparse.indices[idx]))
+            bits.sparse.indices[next++] = bits.sparse.indices[idx];
+        }
+        bits.sparse.size = next;
+      }
+      else
+      {
+        if (rhs.is_dense())
+          *bits.dense -= *rhs.bits.dense;
+        else
+        {
+          for (unsigned idx = 0; idx < rhs.bits.sparse.size; idx++)
+            bits.dense->unset_bit(rhs.bits.sparse.indices[idx]);
+        }
+        compact();
+      }
+      return *this;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline bool HybridBitMask<DENSE,MAX>::operator!(void) const
+    //-------------------------------------------------------------------------
+    {
+      if (is_dense())
+        return !(*bits.dense);
+      return (bits.sparse.size == 0);
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX> HybridBitMask<DENSE,MAX>::operator<<(
+                                                          unsigned shift) const
+    //-------------------------------------------------------------------------
+    {
+      HybridBitMask<DENSE,MAX> result(*this);
+      result <<= shift;
+      return result;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX> HybridBitMask<DENSE,MAX>::operator>>(
+                                                          unsigned shift) const
+    //-------------------------------------------------------------------------
+    {
+      HybridBitMask<DENSE,MAX> result(*this);
+      result >>= shift;
+      return result;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX>& HybridBitMask<DENSE,MAX>::operator<<=(
+                                                                unsigned shift)
+    //-------------------------------------------------------------------------
+    {
+      if (is_dense())
+      {
+        *bits.dense <<= shift;
+        compact();
+        return *this;
+      }
+      // Bits shifted past the end fall off
+      unsigned next = 0;
+      for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+      {
+        if ((bits.sparse.indices[idx] + shift) < MAX)
+          bits.sparse.indices[next++] = bits.sparse.indices[idx] + shift;
+      }
+      bits.sparse.size = next;
+      return *this;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline HybridBitMask<DENSE,MAX>& HybridBitMask<DENSE,MAX>::operator>>=(
+                                                                unsigned shift)
+    //-------------------------------------------------------------------------
+    {
+      if (is_dense())
+      {
+        *bits.dense >>= shift;
+        compact();
+        return *this;
+      }
+      // Bits shifted below zero fall off
+      unsigned next = 0;
+      for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+      {
+        if (bits.sparse.indices[idx] >= shift)
+          bits.sparse.indices[next++] = bits.sparse.indices[idx] - shift;
+      }
+      bits.sparse.size = next;
+      return *this;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline uint64_t HybridBitMask<DENSE,MAX>::get_hash_key(void) const
+    //-------------------------------------------------------------------------
+    {
+      // Always the exact OR of all the words so a set hashes the
+      // same in either form (two-level masks only keep a summary)
+      uint64_t result = 0;
+      if (is_dense())
+      {
+        for (unsigned idx = 0; idx < BIT_ELMTS; idx++)
+          result |= (*bits.dense)[idx];
+        return result;
+      }
+      for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+        result |= (1UL << (bits.sparse.indices[idx] & 0x3F));
+      return result;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline bool HybridBitMask<DENSE,MAX>::is_dense(void) const
+    //-------------------------------------------------------------------------
+    {
+      return (bits.sparse.size == DENSE_SIZE);
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline void HybridBitMask<DENSE,MAX>::serialize(Serializer &rez) const
+    //-------------------------------------------------------------------------
+    {
+      rez.serialize(bits.sparse.size);
+      if (is_dense())
+        bits.dense->serialize(rez);
+      else
+        rez.serialize(bits.sparse.indices, 
+                      bits.sparse.size * sizeof(uint16_t));
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline void HybridBitMask<DENSE,MAX>::deserialize(Deserializer &derez)
+    //-------------------------------------------------------------------------
+    {
+      uint16_t next_size;
+      derez.deserialize(next_size);
+      if (next_size == DENSE_SIZE)
+      {
+        if (!is_dense())
+        {
+          bits.dense = allocate_dense(0);
+          bits.sparse.size = DENSE_SIZE;
+        }
+        bits.dense->deserialize(derez);
+      }
+      else
+      {
+        if (is_dense())
+          free_dense(bits.dense);
+        bits.sparse.size = next_size;
+        derez.deserialize(bits.sparse.indices, 
+                          bits.sparse.size * sizeof(uint16_t));
+      }
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline char* HybridBitMask<DENSE,MAX>::to_string(void) const
+    //-------------------------------------------------------------------------
+    {
+      char *result = (char*)malloc((MAX+1)*sizeof(char));
+      for (int idx = (BIT_ELMTS-1); idx >= 0; idx--)
+      {
+        if (idx == (BIT_ELMTS-1))
+          sprintf(result,"%16.16lx",(*this)[idx]);
+        else
+        {
+          char temp[65];
+          sprintf(temp,"%16.16lx",(*this)[idx]);
+          strcat(result,temp);
+        }
+      }
+      return result;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    /*static*/ inline int HybridBitMask<DENSE,MAX>::pop_count(
+                                       const HybridBitMask<DENSE,MAX> &mask)
+    //-------------------------------------------------------------------------
+    {
+      if (mask.is_dense())
+        return DENSE::pop_count(*mask.bits.dense);
+      return mask.bits.sparse.size;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline void HybridBitMask<DENSE,MAX>::make_dense(void)
+    //-------------------------------------------------------------------------
+    {
+#ifdef DEBUG_HIGH_LEVEL
+      assert(!is_dense());
+#endif
+      DENSE *next = allocate_dense(0);
+      for (unsigned idx = 0; idx < bits.sparse.size; idx++)
+        next->set_bit(bits.sparse.indices[idx]);
+      bits.dense = next;
+      bits.sparse.size = DENSE_SIZE;
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    inline void HybridBitMask<DENSE,MAX>::compact(void)
+    //-------------------------------------------------------------------------
+    {
+      if (!is_dense() || (DENSE::pop_count(*bits.dense) > int(SPARSE_MAX)))
+        return;
+      DENSE *old = bits.dense;
+      bits.sparse.size = 0;
+      for (unsigned idx = 0; idx < BIT_ELMTS; idx++)
+      {
+        uint64_t word = (*old)[idx];
+        while (word)
+        {
+          bits.sparse.indices[bits.sparse.size++] = idx*64 + __builtin_ctzl(word);
+          word &= (word - 1);
+        }
+      }
+      free_dense(old);
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    /*static*/ inline DENSE* HybridBitMask<DENSE,MAX>::allocate_dense(
+                                                                uint64_t init)
+    //-------------------------------------------------------------------------
+    {
+      // Heap allocations are aligned for the vector types which
+      // avoids the stack alignment problems with AVX masks
+      void *ptr = NULL;
+      if (posix_memalign(&ptr, 32, sizeof(DENSE)) != 0)
+        assert(false); // out of memory
+      return new (ptr) DENSE(init);
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    /*static*/ inline DENSE* HybridBitMask<DENSE,MAX>::allocate_dense(
+                                                             const DENSE &rhs)
+    //-------------------------------------------------------------------------
+    {
+      void *ptr = NULL;
+      if (posix_memalign(&ptr, 32, sizeof(DENSE)) != 0)
+        assert(false); // out of memory
+      return new (ptr) DENSE(rhs);
+    }
+
+    //-------------------------------------------------------------------------
+    template<typename DENSE, unsigned int MAX>
+    /*static*/ inline void HybridBitMask<DENSE,MAX>::free_dense(DENSE *dense)
+    //-------------------------------------------------------------------------
+    {
+      dense->~DENSE();
+      free(dense);
+    }
+#undef BIT_ELMTS
+
     //-------------------------------------------------------------------------
     template<typename BITMASK, unsigned LOG2MAX>
     BitPermutation<BITMASK,LOG2MAX>::BitPermutation(void)
@@ -29,12 +29,20 @@ using namespace LegionRuntime::Accessor;
 #endif
 
 #include "lowlevel_dma.h"
+#include "metrics.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/file.h>
 #include <fcntl.h>
 #include <dirent.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
 
 #ifdef DEADLOCK_TRACE
 #include <signal.h>
@@ -948,6 +956,7 @@ namespace LegionRuntime {
       //printf("[%d] MUTEX INIT %p\n", gasnet_mynode(), mutex);
       gasnet_hsl_init(mutex);
       remote_waiters.clear();
+      local_waiters = 0;
       base_arrival_count = current_arrival_count = 0;
     }
 
@@ -1052,22 +1061,21 @@ namespace LegionRuntime {
 	  AutoHSLLock a2(e->mutex);
 
 	  // print anything with either local or remote waiters
-	  if(e->local_waiters.empty() && e->remote_waiters.empty())
+	  // (the local list can change underneath us - this is just for
+	  //  debugging hangs, where it won't)
+	  if((e->local_waiters == 0) && e->remote_waiters.empty())
 	    continue;
 
+          size_t num_local = 0;
+          for(Event::Impl::EventWaiter *w = e->local_waiters; w; w = w->next_waiter)
+            num_local++;
           fprintf(f,"Event " IDFMT ": gen=%d subscr=%d local=%zd remote=%zd\n",
 		  e->me.id, e->generation, e->gen_subscribed, 
-		  e->local_waiters.size(), e->remote_waiters.size());
-	  for(std::map<Event::gen_t, std::vector<Event::Impl::EventWaiter *> >::iterator it = e->local_waiters.begin();
-	      it != e->local_waiters.end();
-	      it++) {
-	    for(std::vector<Event::Impl::EventWaiter *>::iterator it2 = it->second.begin();
-		it2 != it->second.end();
-		it2++) {
-	      fprintf(f, "  [%d] L:%p ", it->first, *it2);
-	      (*it2)->print_info(f);
-	    }
-	  }
+		  num_local, e->remote_waiters.size());
+          for(Event::Impl::EventWaiter *w = e->local_waiters; w; w = w->next_waiter) {
+            fprintf(f, "  [%d] L:%p ", w->wait_gen, w);
+            w->print_info(f);
+          }
 	  for(std::map<Event::gen_t, NodeMask>::const_iterator it = e->remote_waiters.begin();
 	      it != e->remote_waiters.end();
 	      it++) {
@@ -1111,21 +1119,105 @@ namespace LegionRuntime {
 
     // Perform our merging events in a lock free way
 #define LOCK_FREE_MERGED_EVENTS
-    class EventMerger : public Event::Impl::EventWaiter {
+    class EventMerger {
     public:
-      EventMerger(Event _finish_event)
-	: count_needed(1), finish_event(_finish_event)
+      // a merger waits on several events at once, but a waiter can only be
+      //  on one event's list, so each input gets its own little waiter
+      class MergeInput : public Event::Impl::EventWaiter {
+      public:
+        MergeInput(void) : merger(0) { }
+        virtual ~MergeInput(void) { }
+
+        virtual bool event_triggered(void)
+        {
+          // the merger owns us, so it has to do the recycling
+          if(merger->event_triggered())
+            EventMerger::free_merger(merger);
+          return false;
+        }
+
+        virtual void print_info(FILE *f)
+        {
+          merger->print_info(f);
+        }
+
+        EventMerger *merger;
+      };
+
+      static const size_t INLINE_INPUTS = 6;
+      // we keep at most this many idle mergers around, and don't keep
+      //  ones whose input arrays have grown beyond MAX_POOLED_INPUTS
+      static const size_t MAX_POOLED_MERGERS = 1024;
+      static const size_t MAX_POOLED_INPUTS = 64;
+
+    protected:
+      EventMerger(size_t max_inputs)
+	: count_needed(1), num_inputs(0), next_free(0)
       {
 #ifndef LOCK_FREE_MERGED_EVENTS
 	gasnet_hsl_init(&mutex);
 #endif
+        if(max_inputs > INLINE_INPUTS) {
+          inputs = new MergeInput[max_inputs];
+          max_inputs_allowed = max_inputs;
+        } else {
+          inputs = inline_inputs;
+          max_inputs_allowed = INLINE_INPUTS;
+        }
       }
 
-      virtual ~EventMerger(void)
+      ~EventMerger(void)
       {
 #ifndef LOCK_FREE_MERGED_EVENTS
         gasnet_hsl_destroy(&mutex);
 #endif
+        if(inputs != inline_inputs)
+          delete[] inputs;
+      }
+
+    public:
+      // mergers are recycled through a free list instead of being new'd
+      //  and deleted for every merge
+      static EventMerger *alloc_merger(Event finish_event, size_t max_inputs)
+      {
+        EventMerger *m = 0;
+        {
+          AutoHSLLock a(pool_mutex);
+          if(free_mergers) {
+            m = free_mergers;
+            free_mergers = m->next_free;
+            num_free_mergers--;
+          }
+        }
+        if(m) {
+          __sync_fetch_and_add(&stats.mergers_recycled, 1L);
+          if(max_inputs > m->max_inputs_allowed) {
+            if(m->inputs != m->inline_inputs)
+              delete[] m->inputs;
+            m->inputs = new MergeInput[max_inputs];
+            m->max_inputs_allowed = max_inputs;
+          }
+          m->count_needed = 1;
+          m->num_inputs = 0;
+          m->next_free = 0;
+        } else
+          m = new EventMerger(max_inputs);
+        m->finish_event = finish_event;
+        return m;
+      }
+
+      static void free_merger(EventMerger *m)
+      {
+        if(m->max_inputs_allowed <= MAX_POOLED_INPUTS) {
+          AutoHSLLock a(pool_mutex);
+          if(num_free_mergers < MAX_POOLED_MERGERS) {
+            m->next_free = free_mergers;
+            free_mergers = m;
+            num_free_mergers++;
+            return;
+          }
+        }
+        delete m;
       }
 
       void add_event(Event wait_for)
@@ -1145,32 +1237,40 @@ namespace LegionRuntime {
 #endif
 	}
 	// step 2: enqueue ourselves on the input event
-	wait_for.impl()->add_waiter(wait_for, this);
+#ifdef DEBUG_LOW_LEVEL
+        assert(num_inputs < max_inputs_allowed);
+#endif
+        MergeInput *input = &inputs[num_inputs++];
+        input->merger = this;
+	wait_for.impl()->add_waiter(wait_for, input);
       }
 
       // arms the merged event once you're done adding input events - just
       //  decrements the count for the implicit 'init done' event
       // return a boolean saying whether it triggered upon arming (which
-      //  means the caller should delete this EventMerger)
+      //  means the caller should free this EventMerger)
       bool arm(void)
       {
 	bool nuke = event_triggered();
         return nuke;
       }
 
-      virtual bool event_triggered(void)
+      bool event_triggered(void)
       {
+        // copy this out first - once our decrement is done, the last
+        //  trigger can recycle us out from under the other inputs
+        Event finish = finish_event;
 	bool last_trigger = false;
 #ifdef LOCK_FREE_MERGED_EVENTS
 	unsigned count_left = __sync_fetch_and_add(&count_needed, -1);
 	log_event(LEVEL_INFO, "recevied trigger merged event " IDFMT "/%d (%d)",
-		  finish_event.id, finish_event.gen, count_left);
+		  finish.id, finish.gen, count_left);
 	last_trigger = (count_left == 1);
 #else
 	{
 	  AutoHSLLock a(mutex);
 	  log_event(LEVEL_INFO, "recevied trigger merged event " IDFMT "/%d (%d)",
-		    finish_event.id, finish_event.gen, count_needed);
+		    finish.id, finish.gen, count_needed);
 	  count_needed--;
 	  if(count_needed == 0) last_trigger = true;
 	}
@@ -1183,88 +1283,197 @@ namespace LegionRuntime {
 	  Event::Impl *i;
 	  {
 	    //TimeStamp ts("foo5", true);
-	    i = finish_event.impl();
+	    i = finish.impl();
 	  }
 	  {
 	    //TimeStamp ts("foo6", true);
-	    i->trigger(finish_event.gen, gasnet_mynode());
+	    i->trigger(finish.gen, gasnet_mynode());
 	  }
 	}
 
-        // caller can delete us if this was the last trigger
+        // caller can free us if this was the last trigger
         return last_trigger;
       }
 
-      virtual void print_info(FILE *f)
+      void print_info(FILE *f)
       {
 	fprintf(f,"event merger: " IDFMT "/%d\n", finish_event.id, finish_event.gen);
       }
 
+    public:
+      // counters for the merges we managed to avoid - reported at shutdown
+      //  with -ll:mergestats
+      struct MergeStats {
+        long merges_requested;
+        long merges_elided;
+        long inputs_requested;
+        long inputs_elided;
+        long mergers_recycled;
+      };
+      static MergeStats stats;
+
     protected:
       unsigned count_needed;
       Event finish_event;
 #ifndef LOCK_FREE_MERGED_EVENTS
       gasnet_hsl_t mutex;
 #endif
+      MergeInput *inputs;
+      size_t num_inputs, max_inputs_allowed;
+      MergeInput inline_inputs[INLINE_INPUTS];
+      EventMerger *next_free;
+
+      static gasnet_hsl_t pool_mutex;
+      static EventMerger *free_mergers;
+      static size_t num_free_mergers;
     };
 
-    // creates an event that won't trigger until all input events have
-    /*static*/ Event Event::Impl::merge_events(const std::set<Event>& wait_for)
+    /*static*/ EventMerger::MergeStats EventMerger::stats = { 0, 0, 0, 0, 0 };
+    /*static*/ gasnet_hsl_t EventMerger::pool_mutex = GASNET_HSL_INITIALIZER;
+    /*static*/ EventMerger *EventMerger::free_mergers = 0;
+    /*static*/ size_t EventMerger::num_free_mergers = 0;
+
+    static bool show_merge_stats = false;
+
+    void report_merge_stats(FILE *f = stdout)
     {
-      if (wait_for.empty())
-        return Event::NO_EVENT;
-      // scan through events to see how many exist/haven't fired - we're
-      //  interested in counts of 0, 1, or 2+ - also remember the first
-      //  event we saw for the count==1 case
-      int wait_count = 0;
-      Event first_wait;
-      for(std::set<Event>::const_iterator it = wait_for.begin();
-	  (it != wait_for.end()) && (wait_count < 2);
-	  it++)
-	if(!(*it).has_triggered()) {
-	  if(!wait_count) first_wait = *it;
-	  wait_count++;
-	}
-      log_event(LEVEL_INFO, "merging events - at least %d not triggered",
-		wait_count);
+      const EventMerger::MergeStats &s = EventMerger::stats;
+      fprintf(f,"EVENT MERGE STATISTICS (node %d):\n", gasnet_mynode());
+      fprintf(f,"  merges requested: %ld (%ld elided, %ld built)\n",
+              s.merges_requested, s.merges_elided,
+              s.merges_requested - s.merges_elided);
+      fprintf(f,"  inputs requested: %ld (%ld elided)\n",
+              s.inputs_requested, s.inputs_elided);
+      fprintf(f,"  mergers recycled: %ld\n", s.mergers_recycled);
+    }
 
-      // Avoid these optimizations if we are doing event graph tracing
-#ifndef EVENT_GRAPH_TRACE
-      // counts of 0 or 1 don't require any merging
-      if(wait_count == 0) return Event::NO_EVENT;
-      if(wait_count == 1) return first_wait;
-#else
-      if (wait_for.size() == 1)
-        return *(wait_for.begin());
-#endif
-      // counts of 2+ require building a new event and a merger to trigger it
+    // builds the merged event for a list of inputs that have already been
+    //  filtered down to 2+ distinct untriggered events
+    static Event build_merged_event(const Event *wait_for, size_t num_events)
+    {
       Event finish_event = Event::Impl::create_event();
-      EventMerger *m = new EventMerger(finish_event);
+      EventMerger *m = EventMerger::alloc_merger(finish_event, num_events);
 #ifdef EVENT_GRAPH_TRACE
       log_event_graph.info("Event Merge: (" IDFMT ",%d) %ld", 
-                          finish_event.id, finish_event.gen, wait_for.size());
+                          finish_event.id, finish_event.gen, num_events);
 #endif
 
-      for(std::set<Event>::const_iterator it = wait_for.begin();
-	  it != wait_for.end();
-	  it++) {
+      for(size_t i = 0; i < num_events; i++) {
 	log_event(LEVEL_INFO, "merged event " IDFMT "/%d waiting for " IDFMT "/%d",
-		  finish_event.id, finish_event.gen, (*it).id, (*it).gen);
-	m->add_event(*it);
+		  finish_event.id, finish_event.gen, wait_for[i].id, wait_for[i].gen);
+	m->add_event(wait_for[i]);
 #ifdef EVENT_GRAPH_TRACE
         log_event_graph.info("Event Precondition: (" IDFMT ",%d) (" IDFMT ",%d)",
                              finish_event.id, finish_event.gen,
-                             it->id, it->gen);
+                             wait_for[i].id, wait_for[i].gen);
 #endif
       }
 
       // once they're all added - arm the thing (it might go off immediately)
       if(m->arm())
-        delete m;
+        EventMerger::free_merger(m);
 
       return finish_event;
     }
 
+    // creates an event that won't trigger until all input events have
+    /*static*/ Event Event::Impl::merge_events(const std::set<Event>& wait_for)
+    {
+      if (wait_for.empty())
+        return Event::NO_EVENT;
+      __sync_fetch_and_add(&EventMerger::stats.merges_requested, 1L);
+      __sync_fetch_and_add(&EventMerger::stats.inputs_requested,
+                           (long)wait_for.size());
+      // the set has already taken care of duplicates, so all that's left
+      //  is to drop events that have already triggered
+      std::vector<Event> pending;
+      pending.reserve(wait_for.size());
+      for(std::set<Event>::const_iterator it = wait_for.begin();
+	  it != wait_for.end();
+	  it++) {
+#ifndef EVENT_GRAPH_TRACE
+	if((*it).has_triggered()) continue;
+#else
+        // Avoid this optimization if we are doing event graph tracing
+        if(!(*it).exists()) continue;
+#endif
+        pending.push_back(*it);
+      }
+      log_event(LEVEL_INFO, "merging events - %zd not triggered",
+		pending.size());
+
+      // counts of 0 or 1 don't require any merging
+      __sync_fetch_and_add(&EventMerger::stats.inputs_elided,
+                           (long)(wait_for.size() - pending.size()));
+      if(pending.size() < 2) {
+        __sync_fetch_and_add(&EventMerger::stats.merges_elided, 1L);
+        return(pending.empty() ? Event::NO_EVENT : pending[0]);
+      }
+
+      // counts of 2+ require building a new event and a merger to trigger it
+      return build_merged_event(&pending[0], pending.size());
+    }
+
+    // past this many inputs, duplicates are found by sorting rather than
+    //  by comparing against every event we've kept so far
+    static const size_t LINEAR_DEDUP_LIMIT = 16;
+
+    /*static*/ Event Event::Impl::merge_events(const Event *wait_for,
+                                               size_t num_events)
+    {
+      if(num_events == 0)
+        return Event::NO_EVENT;
+      __sync_fetch_and_add(&EventMerger::stats.merges_requested, 1L);
+      __sync_fetch_and_add(&EventMerger::stats.inputs_requested,
+                           (long)num_events);
+
+      // filter into a stack buffer for the common small case
+      Event local_pending[LINEAR_DEDUP_LIMIT];
+      std::vector<Event> heap_pending;
+      Event *pending = local_pending;
+      if(num_events > LINEAR_DEDUP_LIMIT) {
+        heap_pending.resize(num_events);
+        pending = &heap_pending[0];
+      }
+      size_t num_pending = 0;
+      for(size_t i = 0; i < num_events; i++) {
+        const Event &e = wait_for[i];
+#ifndef EVENT_GRAPH_TRACE
+	if(e.has_triggered()) continue;
+#else
+        // Avoid this optimization if we are doing event graph tracing
+        if(!e.exists()) continue;
+#endif
+        if(num_events <= LINEAR_DEDUP_LIMIT) {
+          bool duplicate = false;
+          for(size_t j = 0; j < num_pending; j++)
+            if(pending[j] == e) {
+              duplicate = true;
+              break;
+            }
+          if(duplicate) continue;
+        }
+        pending[num_pending++] = e;
+      }
+      if(num_events > LINEAR_DEDUP_LIMIT) {
+        std::sort(pending, pending + num_pending);
+        num_pending = std::unique(pending, pending + num_pending) - pending;
+      }
+      log_event(LEVEL_INFO, "merging events - %zd of %zd not triggered",
+		num_pending, num_events);
+
+      // counts of 0 or 1 don't require any merging
+      __sync_fetch_and_add(&EventMerger::stats.inputs_elided,
+                           (long)(num_events - num_pending));
+      if(num_pending < 2) {
+        __sync_fetch_and_add(&EventMerger::stats.merges_elided, 1L);
+        return((num_pending == 0) ? Event::NO_EVENT : pending[0]);
+      }
+
+      // counts of 2+ require building a new event and a merger to trigger it
+      return build_merged_event(pending, num_pending);
+    }
+
     /*static*/ Event Event::Impl::merge_events(Event ev1, Event ev2,
 					       Event ev3 /*= NO_EVENT*/, Event ev4 /*= NO_EVENT*/,
 					       Event ev5 /*= NO_EVENT*/, Event ev6 /*= NO_EVENT*/)
@@ -1281,9 +1490,16 @@ namespace LegionRuntime {
       if(!ev2.has_triggered()) { first_wait = ev2; wait_count++; }
       if(!ev1.has_triggered()) { first_wait = ev1; wait_count++; }
 
+      __sync_fetch_and_add(&EventMerger::stats.merges_requested, 1L);
+      __sync_fetch_and_add(&EventMerger::stats.inputs_requested, 6L);
+
       // Avoid these optimizations if we are doing event graph tracing
 #ifndef EVENT_GRAPH_TRACE
       // counts of 0 or 1 don't require any merging
+      __sync_fetch_and_add(&EventMerger::stats.inputs_elided,
+                           (long)(6 - wait_count));
+      if(wait_count < 2)
+        __sync_fetch_and_add(&EventMerger::stats.merges_elided, 1L);
       if(wait_count == 0) return Event::NO_EVENT;
       if(wait_count == 1) return first_wait;
 #else
@@ -1309,7 +1525,8 @@ namespace LegionRuntime {
 
       // counts of 2+ require building a new event and a merger to trigger it
       Event finish_event = Event::Impl::create_event();
-      EventMerger *m = new EventMerger(finish_event);
+      EventMerger *m = EventMerger::alloc_merger(finish_event,
+                                                 EventMerger::INLINE_INPUTS);
 
       m->add_event(ev1);
       m->add_event(ev2);
@@ -1343,7 +1560,7 @@ namespace LegionRuntime {
 
       // once they're all added - arm the thing (it might go off immediately)
       if(m->arm())
-        delete m;
+        EventMerger::free_merger(m);
 
       return finish_event;
     }
@@ -1355,6 +1572,12 @@ namespace LegionRuntime {
       return Event::Impl::merge_events(wait_for);
     }
 
+    /*static*/ Event Event::merge_events(const Event *wait_for, size_t num_events)
+    {
+      DetailedTimer::ScopedPush sp(TIME_LOW_LEVEL);
+      return Event::Impl::merge_events(wait_for, num_events);
+    }
+
     /*static*/ Event Event::merge_events(Event ev1, Event ev2,
 					 Event ev3 /*= NO_EVENT*/, Event ev4 /*= NO_EVENT*/,
 					 Event ev5 /*= NO_EVENT*/, Event ev6 /*= NO_EVENT*/)
@@ -1512,43 +1735,108 @@ namespace LegionRuntime {
         item.action = EventTraceItem::ACT_WAIT;
       }
 #endif
-      bool trigger_now = false;
-
-      int subscribe_owner = -1;
-      EventSubscribeArgs args;
-
-      {
-	AutoHSLLock a(mutex);
+      // early out - event we are interested in has already triggered!
+      if(event.gen <= generation) {
+	bool nuke = waiter->event_triggered();
+        if(nuke)
+          delete waiter;
+        return;
+      }
 
-	if(event.gen > generation) {
-	  log_event(LEVEL_DEBUG, "event not ready: event=" IDFMT "/%d owner=%d gen=%d subscr=%d",
-		    event.id, event.gen, owner, generation, gen_subscribed);
-	  // we haven't triggered the needed generation yet - add to list of
-	  //  waiters, and subscribe if we're not the owner
-	  local_waiters[event.gen].push_back(waiter);
-	  //printf("LOCAL WAITERS CHECK: %zd\n", local_waiters.size());
+      // subscriptions still need the mutex, but only for remote events
+      if(owner != gasnet_mynode()) {
+        int subscribe_owner = -1;
+        EventSubscribeArgs args;
+        {
+          AutoHSLLock a(mutex);
 
-	  if((owner != gasnet_mynode()) && (event.gen > gen_subscribed)) {
-	    args.node = gasnet_mynode();
-	    args.event = event;
+          if((event.gen > generation) && (event.gen > gen_subscribed)) {
+            args.node = gasnet_mynode();
+            args.event = event;
             args.previous_subscribe_gen = 
               (gen_subscribed > generation ? gen_subscribed : generation);
-	    subscribe_owner = owner;
-	    gen_subscribed = event.gen;
-	  }
-	} else {
-	  // event we are interested in has already triggered!
-	  trigger_now = true; // actually do trigger outside of mutex
-	}
+            subscribe_owner = owner;
+            gen_subscribed = event.gen;
+          }
+        }
+
+        if((subscribe_owner != -1) && !pre_subscribed)
+          EventSubscribeMessage::request(owner, args);
       }
 
-      if((subscribe_owner != -1) && !pre_subscribed)
-	EventSubscribeMessage::request(owner, args);
+      log_event(LEVEL_DEBUG, "event not ready: event=" IDFMT "/%d owner=%d gen=%d subscr=%d",
+                event.id, event.gen, owner, generation, gen_subscribed);
+      // we haven't triggered the needed generation yet - add to list of
+      //  waiters
+      waiter->wait_gen = event.gen;
+      push_waiters(waiter, waiter);
 
-      if(trigger_now) {
-	bool nuke = waiter->event_triggered();
-        if(nuke)
-          delete waiter;
+      // the push is a full barrier, so either a trigger that raced with us
+      //  saw our waiter on the list, or we see its new generation here and
+      //  have to do the waking ourselves (don't touch 'waiter' - it may
+      //  already be gone)
+      if(event.gen <= generation)
+        wake_ready_waiters();
+    }
+
+    void Event::Impl::push_waiters(EventWaiter *first, EventWaiter *last)
+    {
+      while(1) {
+        EventWaiter *head = local_waiters;
+        last->next_waiter = head;
+        if(__sync_bool_compare_and_swap(&local_waiters, head, first))
+          return;
+      }
+    }
+
+    void Event::Impl::wake_ready_waiters(void)
+    {
+      while(1) {
+        // take ownership of the entire list - nobody else can see these
+        //  waiters until we put them back
+        EventWaiter *list;
+        do {
+          list = local_waiters;
+          if(!list) return;
+        } while(!__sync_bool_compare_and_swap(&local_waiters, list, 
+                                              (EventWaiter *)0));
+
+        // split into ready and not-ready waiters - the list is in LIFO
+        //  order, so prepending to 'ready' gives us back FIFO order
+        Event::gen_t gen = generation;
+        EventWaiter *ready = 0;
+        EventWaiter *pending = 0, *pending_tail = 0;
+        while(list) {
+          EventWaiter *w = list;
+          list = w->next_waiter;
+          if(w->wait_gen <= gen) {
+            w->next_waiter = ready;
+            ready = w;
+          } else {
+            w->next_waiter = pending;
+            pending = w;
+            if(!pending_tail)
+              pending_tail = w;
+          }
+        }
+
+        if(pending)
+          push_waiters(pending, pending_tail);
+
+        // now that nobody else can see them, notify the ready waiters - grab
+        //  the next pointer first since the waiter may delete itself
+        while(ready) {
+          EventWaiter *w = ready;
+          ready = w->next_waiter;
+          bool nuke = w->event_triggered();
+          if(nuke)
+            delete w;
+        }
+
+        // if the generation moved while we held the pending waiters, the
+        //  trigger that moved it may not have seen them, so go around again
+        if(!pending || (generation == gen))
+          return;
       }
     }
 
@@ -1568,7 +1856,7 @@ namespace LegionRuntime {
     class PthreadCondWaiter : public Event::Impl::EventWaiter {
     public:
       PthreadCondWaiter(Event::Impl *i)
-        : impl(i)
+        : impl(i), triggered(false)
       {
         gasnett_cond_init(&cond);
       }
@@ -1580,7 +1868,8 @@ namespace LegionRuntime {
       virtual bool event_triggered(void)
       {
         // Need to hold the lock to avoid the race
-        AutoHSLLock(impl->mutex);
+        AutoHSLLock a(impl->mutex);
+        triggered = true;
         gasnett_cond_signal(&cond);
         // we're allocated on caller's stack, so deleting would be bad
         return false;
@@ -1590,26 +1879,29 @@ namespace LegionRuntime {
     public:
       gasnett_cond_t cond;
       Event::Impl *impl;
+      bool triggered;
     };
 
     void Event::Impl::external_wait(Event::gen_t gen_needed)
     {
-      PthreadCondWaiter w(this);
-      {
-	AutoHSLLock a(mutex);
-
-	if(gen_needed > generation) {
-	  local_waiters[gen_needed].push_back(&w);
-    
-	  if((owner != gasnet_mynode()) && (gen_needed > gen_subscribed)) {
-	    printf("AAAH!  Can't subscribe to another node's event in external_wait()!\n");
-	    exit(1);
-	  }
+      if(gen_needed <= generation) return;
 
-	  // now just sleep on the condition variable - hope we wake up
-          gasnett_cond_wait(&w.cond, &mutex->lock);
-	}
+      if((owner != gasnet_mynode()) && (gen_needed > gen_subscribed)) {
+        printf("AAAH!  Can't subscribe to another node's event in external_wait()!\n");
+        exit(1);
       }
+
+      PthreadCondWaiter w(this);
+      Event e = me;
+      e.gen = gen_needed;
+      // can't hold the mutex while adding the waiter - it might trigger
+      //  right away
+      add_waiter(e, &w);
+
+      AutoHSLLock a(mutex);
+      // now just sleep on the condition variable - hope we wake up
+      while(!w.triggered)
+        gasnett_cond_wait(&w.cond, &mutex->lock);
     }
 
     class DeferredEventTrigger : public Event::Impl::EventWaiter {
@@ -1662,7 +1954,6 @@ namespace LegionRuntime {
       }
 #endif
       //printf("[%d] TRIGGER " IDFMT "/%d\n", gasnet_mynode(), me.id, gen_triggered);
-      std::deque<EventWaiter *> to_wake;
       bool release_event = false;
       {
 	//TimeStamp ts("foo", true);
@@ -1681,15 +1972,6 @@ namespace LegionRuntime {
 	if(generation == free_generation)
 	  release_event = true;
 
-	//printf("[%d] LOCAL WAITERS: %zd\n", gasnet_mynode(), local_waiters.size());
-	std::map<Event::gen_t, std::vector<EventWaiter *> >::iterator it = local_waiters.begin();
-	while((it != local_waiters.end()) && (it->first <= gen_triggered)) {
-	  //printf("[%d] LOCAL WAIT: %d (%zd)\n", gasnet_mynode(), it->first, it->second.size());
-	  to_wake.insert(to_wake.end(), it->second.begin(), it->second.end());
-	  local_waiters.erase(it);
-	  it = local_waiters.begin();
-	}
-
 	// notify remote waiters and/or event's actual owner
 	if(owner == gasnet_mynode()) {
 	  // send notifications to every other node that has subscribed
@@ -1743,15 +2025,7 @@ namespace LegionRuntime {
 	//TimeStamp ts("foo3", true);
 	// now that we've let go of the lock, notify all the waiters who wanted
 	//  this event generation (or an older one)
-	for(std::deque<EventWaiter *>::iterator it = to_wake.begin();
-	    it != to_wake.end();
-	    it++) {
-	  bool nuke = (*it)->event_triggered();
-          if(nuke) {
-            //printf("deleting: "); (*it)->print_info(); fflush(stdout);
-            delete (*it);
-          }
-        }
+        wake_ready_waiters();
       }
 
       {
@@ -2811,6 +3085,22 @@ namespace LegionRuntime {
     // make bad offsets really obvious (+1 PB)
     static const off_t ZERO_SIZE_INSTANCE_OFFSET = 1ULL << 50;
 
+    void Memory::Impl::init_allocator(void)
+    {
+      assert(allocator == 0);
+      allocator = MemoryAllocator::create_allocator(MemoryAllocator::default_kind,
+                                                    size);
+    }
+
+    bool Memory::Impl::get_alloc_stats(Machine::MemoryAllocStats& stats)
+    {
+      AutoHSLLock al(mutex);
+      if(!allocator)
+        return false;
+      allocator->get_stats(stats);
+      return true;
+    }
+
     off_t Memory::Impl::alloc_bytes_local(size_t size)
     {
       AutoHSLLock al(mutex);
@@ -2832,30 +3122,17 @@ namespace LegionRuntime {
       //  the end of their allocations
       size += 0;
 
-      for(std::map<off_t, off_t>::iterator it = free_blocks.begin();
-	  it != free_blocks.end();
-	  it++) {
-	if(it->second == (off_t)size) {
-	  // perfect match
-	  off_t retval = it->first;
-	  free_blocks.erase(it);
-	  log_malloc.info("alloc full block: mem=" IDFMT " size=%zd ofs=%zd", me.id, size, retval);
-	  return retval;
-	}
-	
-	if(it->second > (off_t)size) {
-	  // some left over
-	  off_t leftover = it->second - size;
-	  off_t retval = it->first + leftover;
-	  it->second = leftover;
-	  log_malloc.info("alloc partial block: mem=" IDFMT " size=%zd ofs=%zd", me.id, size, retval);
-	  return retval;
-	}
+      assert(allocator != 0);
+      off_t retval = allocator->alloc(size);
+      if(retval >= 0) {
+        log_malloc.info("alloc block: mem=" IDFMT " size=%zd ofs=%zd", me.id, size, retval);
+        Metrics::increment(Metrics::METRIC_ALLOCATIONS);
+        Metrics::adjust(Metrics::METRIC_ALLOCATED_BYTES, size);
+      } else {
+        log_malloc.info("alloc FAILED: mem=" IDFMT " size=%zd", me.id, size);
+        Metrics::increment(Metrics::METRIC_FAILED_ALLOCATIONS);
       }
-
-      // no blocks large enough - boo hoo
-      log_malloc.info("alloc FAILED: mem=" IDFMT " size=%zd", me.id, size);
-      return -1;
+      return retval;
     }
 
     void Memory::Impl::free_bytes_local(off_t offset, size_t size)
@@ -2878,60 +3155,9 @@ namespace LegionRuntime {
 	}
       }
 
-      if(free_blocks.size() > 0) {
-	// find the first existing block that comes _after_ us
-	std::map<off_t, off_t>::iterator after = free_blocks.lower_bound(offset);
-	if(after != free_blocks.end()) {
-	  // found one - is it the first one?
-	  if(after == free_blocks.begin()) {
-	    // yes, so no "before"
-	    assert((offset + (off_t)size) <= after->first); // no overlap!
-	    if((offset + (off_t)size) == after->first) {
-	      // merge the ranges by eating the "after"
-	      size += after->second;
-	      free_blocks.erase(after);
-	    }
-	    free_blocks[offset] = size;
-	  } else {
-	    // no, get range that comes before us too
-	    std::map<off_t, off_t>::iterator before = after; before--;
-
-	    // if we're adjacent to the after, merge with it
-	    assert((offset + (off_t)size) <= after->first); // no overlap!
-	    if((offset + (off_t)size) == after->first) {
-	      // merge the ranges by eating the "after"
-	      size += after->second;
-	      free_blocks.erase(after);
-	    }
-
-	    // if we're adjacent with the before, grow it instead of adding
-	    //  a new range
-	    assert((before->first + before->second) <= offset);
-	    if((before->first + before->second) == offset) {
-	      before->second += size;
-	    } else {
-	      free_blocks[offset] = size;
-	    }
-	  }
-	} else {
-	  // nothing's after us, so just see if we can merge with the range
-	  //  that's before us
-
-	  std::map<off_t, off_t>::iterator before = after; before--;
-
-	  // if we're adjacent with the before, grow it instead of adding
-	  //  a new range
-	  assert((before->first + before->second) <= offset);
-	  if((before->first + before->second) == offset) {
-	    before->second += size;
-	  } else {
-	    free_blocks[offset] = size;
-	  }
-	}
-      } else {
-	// easy case - nothing was free, so now just our block is
-	free_blocks[offset] = size;
-      }
+      assert(allocator != 0);
+      allocator->free(offset, size);
+      Metrics::adjust(Metrics::METRIC_ALLOCATED_BYTES, -(long long)size);
     }
 
     off_t Memory::Impl::alloc_bytes_remote(size_t size)
@@ -2963,14 +3189,29 @@ namespace LegionRuntime {
       static const size_t ALIGNMENT = 256;
 
       LocalCPUMemory(Memory _me, size_t _size,
-		     void *prealloc_base = 0, bool _registered = false) 
+		     void *prealloc_base = 0, bool _registered = false,
+		     int _numa_node = -1) 
 	: Memory::Impl(_me, _size, MKIND_SYSMEM, ALIGNMENT, 
-            (_registered ? Memory::REGDMA_MEM : Memory::SYSTEM_MEM))
+            (_registered ? Memory::REGDMA_MEM : Memory::SYSTEM_MEM)),
+	  numa_node(_numa_node), mapped(false)
       {
 	if(prealloc_base) {
 	  base = (char *)prealloc_base;
 	  prealloced = true;
 	  registered = _registered;
+	} else if(numa_node >= 0) {
+	  // map our own pages (page alignment is plenty) and ask the kernel
+	  //  to back them with memory from the right NUMA node as they are
+	  //  first touched
+	  assert(!_registered);
+	  base_orig = (char *)mmap(0, _size, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	  assert(base_orig != MAP_FAILED);
+	  base = base_orig;
+	  prealloced = false;
+	  registered = false;
+	  mapped = true;
+	  bind_to_numa_node();
 	} else {
 	  // allocate our own space
 	  // enforce alignment on the whole memory range
@@ -2987,15 +3228,37 @@ namespace LegionRuntime {
 	}
 	log_copy.debug("CPU memory at %p, size = %zd%s%s", base, _size, 
 		       prealloced ? " (prealloced)" : "", registered ? " (registered)" : "");
-	free_blocks[0] = _size;
+	init_allocator();
       }
 
       virtual ~LocalCPUMemory(void)
       {
-	if(!prealloced)
+	if(mapped)
+	  munmap(base_orig, size);
+	else if(!prealloced)
 	  delete[] base_orig;
       }
 
+      void bind_to_numa_node(void)
+      {
+#if defined(__linux__) && defined(SYS_mbind)
+	const int MPOL_BIND_POLICY = 2; // MPOL_BIND from numaif.h
+	const size_t BITS_PER_WORD = 8 * sizeof(unsigned long);
+	unsigned long nodemask[16];
+	memset(nodemask, 0, sizeof(nodemask));
+	assert((size_t)numa_node < (16 * BITS_PER_WORD));
+	nodemask[numa_node / BITS_PER_WORD] = 1UL << (numa_node % BITS_PER_WORD);
+	long ret = syscall(SYS_mbind, base_orig, size, MPOL_BIND_POLICY,
+			   nodemask, 16 * BITS_PER_WORD, 0);
+	if(ret != 0)
+	  log_malloc.warning("mbind of CPU memory to NUMA node %d failed - "
+			     "pages will be placed on first touch", numa_node);
+#else
+	log_malloc.warning("no mbind on this platform - CPU memory for NUMA "
+			   "node %d will be placed on first touch", numa_node);
+#endif
+      }
+
 #ifdef USE_CUDA
       // For pinning CPU memories for use with asynchronous
       // GPU copies
@@ -3059,6 +3322,8 @@ namespace LegionRuntime {
     public: //protected:
       char *base, *base_orig;
       bool prealloced, registered;
+      int numa_node;
+      bool mapped;
     };
 
     class RemoteMemory : public Memory::Impl {
@@ -3800,7 +4065,9 @@ namespace LegionRuntime {
       size = size_per_node * num_nodes;
       memory_stride = MEMORY_STRIDE;
       
-      free_blocks[0] = size;
+      // only node 0 hands out space in the global memory
+      if(gasnet_mynode() == 0)
+        init_allocator();
     }
 
     GASNetMemory::~GASNetMemory(void)
@@ -4367,7 +4634,8 @@ namespace LegionRuntime {
     }
 
     Processor::Impl::Impl(Processor _me, Processor::Kind _kind, Processor _util /*= Processor::NO_PROC*/)
-      : me(_me), kind(_kind), util(_util), util_proc(0), run_counter(0)
+      : me(_me), kind(_kind), util(_util), util_proc(0), run_counter(0),
+        num_groups(0)
     {
     }
 
@@ -4375,6 +4643,38 @@ namespace LegionRuntime {
     {
     }
 
+    bool Processor::Impl::add_to_group(ProcessorGroup *group)
+    {
+      // groups are only ever created by one thread at a time on the
+      //  owner node, so we only have to worry about concurrent readers
+      int idx = num_groups;
+      if(idx >= MAX_GROUPS_PER_PROC)
+        return false;
+      groups[idx] = group;
+      __sync_synchronize();
+      num_groups = idx + 1;
+      return true;
+    }
+
+    Task *Processor::Impl::steal_group_task(void)
+    {
+      int count = num_groups;
+      for(int i = 0; i < count; i++) {
+        Task *task = groups[i]->task_queue.pop();
+        if(task) return task;
+      }
+      return 0;
+    }
+
+    bool Processor::Impl::has_group_tasks(void)
+    {
+      int count = num_groups;
+      for(int i = 0; i < count; i++)
+        if(!groups[i]->task_queue.empty())
+          return true;
+      return false;
+    }
+
     void Processor::Impl::set_utility_processor(UtilityProcessor *_util_proc)
     {
       if(is_idle_task_enabled()) {
@@ -4419,6 +4719,10 @@ namespace LegionRuntime {
 	  it++) {
 	Processor::Impl *m_impl = (*it).impl();
 	members.push_back(m_impl);
+        if(m_impl->can_steal_group_tasks() && m_impl->add_to_group(this))
+          stealing_members.push_back(m_impl);
+        else
+          replicated_members.push_back(m_impl);
       }
 
       members_requested = true;
@@ -4446,8 +4750,19 @@ namespace LegionRuntime {
 
     void ProcessorGroup::enqueue_task(Task *task)
     {
-      for (std::vector<Processor::Impl *>::const_iterator it = members.begin();
-            it != members.end(); it++)
+      // a single copy goes in our queue for all the members that can steal
+      //  it, the rest get their own copy - the task's run_count makes sure
+      //  only one of them actually runs it
+      if(!stealing_members.empty()) {
+        task_queue.insert(task, task->priority);
+        for (std::vector<Processor::Impl *>::const_iterator it = 
+              stealing_members.begin(); it != stealing_members.end(); it++)
+        {
+          (*it)->tasks_available(task->priority);
+        }
+      }
+      for (std::vector<Processor::Impl *>::const_iterator it = 
+            replicated_members.begin(); it != replicated_members.end(); it++)
       {
         (*it)->enqueue_task(task);
       }
@@ -4460,8 +4775,10 @@ namespace LegionRuntime {
 						int priority)
     {
       // create a task object and insert it into the queue
+      int expected_count = replicated_members.size() +
+                            (stealing_members.empty() ? 0 : 1);
       Task *task = new Task(me, func_id, args, arglen, 
-                            finish_event, priority, members.size());
+                            finish_event, priority, expected_count);
 
       if (start_event.has_triggered())
         enqueue_task(task);
@@ -4649,8 +4966,10 @@ namespace LegionRuntime {
 	      // plan B - if there's a ready task, we can run it while
 	      //   we're waiting (unless 'block' is set)
 	      if(!block) {
-                if(!proc->task_queue.empty()) {
-		  Task *newtask = proc->task_queue.pop();
+                Task *newtask = proc->task_queue.pop();
+                if(!newtask)
+                  newtask = proc->steal_group_task();
+                if(newtask) {
 		  log_task.info("thread %p (proc " IDFMT ") running task %p instead of sleeping",
 			        this, proc->me.id, newtask);
 
@@ -4812,10 +5131,11 @@ namespace LegionRuntime {
 	    // first priority - try to run a task if one is available and
 	    //   we're not at the active thread count limit
 	    if(proc->active_thread_count < proc->max_active_threads) {
-              Task *newtask = 0;
-              if(!proc->task_queue.empty()) {
-                newtask = proc->task_queue.pop();
-              }
+              Task *newtask = proc->task_queue.pop();
+              // nothing of our own to do, so see if a group we belong
+              //  to has something
+              if(!newtask)
+                newtask = proc->steal_group_task();
               if(newtask) {
                 // Keep holding the lock until we are sure we're
                 // going to run this task
@@ -4957,11 +5277,10 @@ namespace LegionRuntime {
 
       virtual void enqueue_task(Task *task)
       {
-	// modifications to task/thread lists require mutex
-	AutoHSLLock a(mutex);
-
 	// special case: if task->func_id is 0, that's a shutdown request
 	if(task->func_id == 0) {
+	  // modifications to task/thread lists require mutex
+	  AutoHSLLock a(mutex);
 	  log_task(LEVEL_INFO, "shutdown request received!");
 	  shutdown_requested = true;
 	  shutdown_event = task->finish_event;
@@ -4976,8 +5295,14 @@ namespace LegionRuntime {
 	  return;
 	}
 
+        // the queue doesn't need the mutex, but we have to take it after
+        //  the insert to make sure a thread that is about to go to sleep
+        //  either sees the task or is on the avail_threads list
         task_queue.insert(task, task->priority); 
 
+	// modifications to task/thread lists require mutex
+	AutoHSLLock a(mutex);
+
 	log_task.info("pushing ready task %p onto list for proc " IDFMT " (active=%d, idle=%zd, preempt=%zd)",
 		      task, me.id, active_thread_count,
 		      avail_threads.size(), preemptable_threads.size());
@@ -5007,7 +5332,7 @@ namespace LegionRuntime {
 
       virtual void tasks_available(int priority)
       {
-	log_task.warning("tasks available: priority = %d", priority);
+	log_task.debug("tasks available: priority = %d", priority);
         AutoHSLLock a(mutex);
 
 	if(active_thread_count < max_active_threads) {
@@ -5132,9 +5457,14 @@ namespace LegionRuntime {
 	return idle_task_enabled;
       }
 
+      virtual bool can_steal_group_tasks(void) const
+      {
+        return true;
+      }
+
     protected:
       int core_id;
-      JobQueue<Task> task_queue;
+      LockFreeJobQueue<Task> task_queue;
       int total_threads, active_thread_count, max_active_threads;
       std::list<Thread *> avail_threads;
       std::list<Thread *> resumable_threads;
@@ -5240,23 +5570,19 @@ namespace LegionRuntime {
         
         while(!impl->has_triggered(wait_for.gen)) {
           if (!block) {
-            gasnet_hsl_lock(&proc->mutex);
-            if(!proc->task_queue.empty())
-	    {
-	      Task *task = proc->task_queue.pop();
-	      if(task) {
-		gasnet_hsl_unlock(&proc->mutex);
-		log_util.info("running task %p (%d) in utility thread", task, task->func_id);
-                if (__sync_fetch_and_add(&(task->run_count),1) == 0)
-                  run_task(task, proc->me);
-		log_util.info("done with task %p (%d) in utility thread", task, task->func_id);
-                if (__sync_add_and_fetch(&(task->finish_count),-1) == 0)
-                  delete task;
-		// Continue since we no longer hold the lock
-		continue;
-	      }
-	    }
-            gasnet_hsl_unlock(&proc->mutex);
+            // the task queue doesn't need the lock
+            Task *task = proc->task_queue.pop();
+            if(!task)
+              task = proc->steal_group_task();
+            if(task) {
+              log_util.info("running task %p (%d) in utility thread", task, task->func_id);
+              if (__sync_fetch_and_add(&(task->run_count),1) == 0)
+                run_task(task, proc->me);
+              log_util.info("done with task %p (%d) in utility thread", task, task->func_id);
+              if (__sync_add_and_fetch(&(task->finish_count),-1) == 0)
+                delete task;
+              continue;
+            }
           }
 #ifdef __SSE2__
           _mm_pause();
@@ -5305,10 +5631,14 @@ namespace LegionRuntime {
 	log_util.info("utility worker thread started, proc=" IDFMT "", proc->me.id);
 
 	while(!proc->shutdown_requested) {
-	  // try to run tasks from the runnable queue
-	  while(!proc->task_queue.empty()) {
-
+	  // try to run tasks from the runnable queue, and then from any
+	  //  groups we belong to
+	  while(1) {
 	    Task *task = proc->task_queue.pop();
+            if(!task)
+              task = proc->steal_group_task();
+            if(!task)
+              break;
 
 	    // is it the shutdown task?
 	    if(task->func_id == 0) {
@@ -5367,12 +5697,18 @@ namespace LegionRuntime {
 	    }
 	  }
 	  
-	  // if we really have nothing to do, it's ok to go to sleep
-	  if(proc->task_queue.empty() && (proc->idle_procs.size() == 0) &&
-	     !proc->shutdown_requested) {
-	    log_util.info("utility thread going to sleep (%p, %p)", this, proc);
-	    gasnett_cond_wait(&proc->condvar, &proc->mutex.lock);
-	    log_util.info("utility thread awake again");
+	  // if we really have nothing to do, it's ok to go to sleep - 
+          //  producers don't take the lock unless they see a sleeping
+          //  thread, so we have to advertise that we're going to sleep 
+          //  before checking the queues one last time
+	  if((proc->idle_procs.size() == 0) && !proc->shutdown_requested) {
+            __sync_fetch_and_add(&proc->sleeping_threads, 1);
+            if(proc->task_queue.empty() && !proc->has_group_tasks()) {
+              log_util.info("utility thread going to sleep (%p, %p)", this, proc);
+              gasnett_cond_wait(&proc->condvar, &proc->mutex.lock);
+              log_util.info("utility thread awake again");
+            }
+            __sync_fetch_and_add(&proc->sleeping_threads, -1);
 	  }
 	}
 
@@ -5402,7 +5738,8 @@ namespace LegionRuntime {
                                        int _core_id /*=-1*/,
 				       int _num_worker_threads /*= 1*/)
       : Processor::Impl(_me, Processor::UTIL_PROC, Processor::NO_PROC),
-	core_id(_core_id), num_worker_threads(_num_worker_threads), shutdown_requested(false)
+	core_id(_core_id), num_worker_threads(_num_worker_threads), shutdown_requested(false),
+        sleeping_threads(0)
     {
       gasnet_hsl_init(&mutex);
       gasnett_cond_init(&condvar);
@@ -5458,15 +5795,19 @@ namespace LegionRuntime {
 
     void UtilityProcessor::tasks_available(int priority)
     {
-      AutoHSLLock al(mutex);
-      gasnett_cond_signal(&condvar);
+      // the new tasks are already visible, so we only need to wake
+      //  somebody up if a thread is (or is about to be) asleep
+      __sync_synchronize();
+      if(sleeping_threads > 0) {
+        AutoHSLLock al(mutex);
+        gasnett_cond_signal(&condvar);
+      }
     }
 
     void UtilityProcessor::enqueue_task(Task *task)
     {
-      AutoHSLLock al(mutex);
       task_queue.insert(task, task->priority);
-      gasnett_cond_signal(&condvar);
+      tasks_available(task->priority);
     }
 
     void UtilityProcessor::enable_idle_task(Processor::Impl *proc)
@@ -5639,8 +5980,49 @@ namespace LegionRuntime {
 	SpawnTaskMessage::request(ID(me).node(), msgargs, args, arglen,
 				  PAYLOAD_COPY);
       }
+
+      virtual void spawn_task(Processor::TaskFuncID func_id,
+			      const SpanList& arg_spans, size_t arglen,
+			      Event start_event, Event finish_event,
+                              int priority)
+      {
+	log_task(LEVEL_DEBUG, "spawning remote task: proc=" IDFMT " task=%d start=" IDFMT "/%d finish=" IDFMT "/%d spans=%zd",
+		 me.id, func_id, 
+		 start_event.id, start_event.gen,
+		 finish_event.id, finish_event.gen, arg_spans.size());
+	SpawnTaskArgs msgargs;
+	msgargs.proc = me;
+	msgargs.func_id = func_id;
+	msgargs.start_event = start_event;
+	msgargs.finish_event = finish_event;
+        msgargs.priority = priority;
+	// the spans are gathered straight into the message payload
+	SpawnTaskMessage::request(ID(me).node(), msgargs, arg_spans, arglen,
+				  PAYLOAD_COPY);
+      }
     };
 
+    void Processor::Impl::spawn_task(Processor::TaskFuncID func_id,
+				     const SpanList& arg_spans, size_t arglen,
+				     Event start_event, Event finish_event,
+				     int priority)
+    {
+      // local tasks keep their own copy of the arguments, so just gather
+      //  the spans and spawn normally
+      char *args = (char *)malloc(arglen);
+      assert((args != 0) || (arglen == 0));
+      size_t offset = 0;
+      for(SpanList::const_iterator it = arg_spans.begin();
+	  it != arg_spans.end();
+	  it++) {
+	memcpy(args + offset, it->first, it->second);
+	offset += it->second;
+      }
+      assert(offset == arglen);
+      spawn_task(func_id, args, arglen, start_event, finish_event, priority);
+      free(args);
+    }
+
     /*static*/ Processor Processor::create_group(const std::vector<Processor>& members)
     {
       // are we creating a local group?
@@ -5715,6 +6097,23 @@ namespace LegionRuntime {
       return finish_event;
     }
 
+    Event Processor::spawn(TaskFuncID func_id,
+			   const std::vector<ArgSpan>& arg_spans,
+			   Event wait_on, int priority) const
+    {
+      DetailedTimer::ScopedPush sp(TIME_LOW_LEVEL);
+      Processor::Impl *p = impl();
+      Event finish_event = Event::Impl::create_event();
+      size_t arglen = 0;
+      for(std::vector<ArgSpan>::const_iterator it = arg_spans.begin();
+	  it != arg_spans.end();
+	  it++)
+	arglen += it->second;
+      p->spawn_task(func_id, arg_spans, arglen,
+		    wait_on, finish_event, priority);
+      return finish_event;
+    }
+
     Processor Processor::get_utility_processor(void) const
     {
       Processor u = impl()->util;
@@ -6136,7 +6535,10 @@ namespace LegionRuntime {
 
       size_t inst_bytes = elem_size * num_elements;
 
-      RegionInstance i = m_impl->create_instance(get_index_space(), linearization_bits, inst_bytes,
+      // rectangles have no index space behind them, and the linearization
+      //  carries everything the instance needs to know about its shape
+      IndexSpace is = ((get_dim() > 0) ? IndexSpace::NO_SPACE : get_index_space());
+      RegionInstance i = m_impl->create_instance(is, linearization_bits, inst_bytes,
 						 block_size, elem_size, field_sizes,
 						 redop_id,
 						 -1 /*list size*/,
@@ -8101,6 +8503,9 @@ namespace LegionRuntime {
 	return;
       }
       
+      for(SystemProcMap::const_iterator it1 = proc_map.begin(); it1 != proc_map.end(); it1++)
+	numa_node_ids.push_back(it1->first);
+
       // pick cores for each local proc - try to round-robin across nodes
       SystemProcMap::iterator curnode = proc_map.end();
       memcpy(&leftover_procs, &cset, sizeof(cset));  // subtract from cset to get leftovers
@@ -8119,6 +8524,7 @@ namespace LegionRuntime {
 	
 	// take the first cpu id for this core and add it to the local proc assignments
 	local_proc_assignments.push_back(curcore->second[0]);
+	local_proc_domains.push_back(std::distance(proc_map.begin(), curnode));
 	
 	// and remove ALL cpu ids for this core from the leftover set
 	for(std::vector<int>::const_iterator it = curcore->second.begin(); it != curcore->second.end(); it++)
@@ -8128,6 +8534,17 @@ namespace LegionRuntime {
 	curnode->second.erase(curcore);
       }
 
+      // remember which leftover cores belong to which NUMA domain
+      for(SystemProcMap::const_iterator it1 = proc_map.begin(); it1 != proc_map.end(); it1++) {
+	if(it1->second.empty()) continue;
+	cpu_set_t nset;
+	CPU_ZERO(&nset);
+	for(NodeProcMap::const_iterator it2 = it1->second.begin(); it2 != it1->second.end(); it2++)
+	  for(std::vector<int>::const_iterator it = it2->second.begin(); it != it2->second.end(); it++)
+	    CPU_SET(*it, &nset);
+	numa_leftover_procs.push_back(nset);
+      }
+
       // we now have a valid set of bindings
       valid = true;
 
@@ -8186,6 +8603,29 @@ namespace LegionRuntime {
       }
     }
 
+    int ProcessorAssignment::get_proc_domain(int core_id) const
+    {
+      if(!valid || (core_id < 0) || (core_id >= num_local_procs))
+	return -1;
+      return local_proc_domains[core_id];
+    }
+
+    void ProcessorAssignment::bind_thread_to_numa_domain(int domain, pthread_attr_t *attr,
+							 const char *debug_name /*= 0*/)
+    {
+      // without per-domain information, just use the leftovers
+      if(!valid || numa_leftover_procs.empty()) {
+	bind_thread(-1, attr, debug_name);
+	return;
+      }
+
+      const cpu_set_t& cset = numa_leftover_procs[domain % numa_leftover_procs.size()];
+      if(attr)
+	CHECK_PTHREAD( pthread_attr_setaffinity_np(attr, sizeof(cset), &cset) );
+      else
+	CHECK_PTHREAD( pthread_setaffinity_np(pthread_self(), sizeof(cset), &cset) );
+    }
+
 #ifdef DEADLOCK_TRACE
     void sigterm_catch(int signal) {
       assert((signal == SIGTERM) || (signal == SIGINT));
@@ -8295,6 +8735,7 @@ namespace LegionRuntime {
       // low-level runtime parameters
       size_t gasnet_mem_size_in_mb = 256;
       size_t cpu_mem_size_in_mb = 512;
+      size_t numa_mem_size_in_mb = 0; // per NUMA domain, 0 = none
       size_t reg_mem_size_in_mb = 0;
       size_t zc_mem_size_in_mb = 64;
       size_t fb_mem_size_in_mb = 256;
@@ -8306,6 +8747,7 @@ namespace LegionRuntime {
       unsigned num_util_procs = 1;
       unsigned cpu_worker_threads = 1;
       unsigned dma_worker_threads = 1;
+      unsigned dma_small_copy_kb = 64;
       unsigned active_msg_worker_threads = 1;
       bool     active_msg_sender_threads = false;
       bool     gpu_dma_thread = true;
@@ -8336,6 +8778,7 @@ namespace LegionRuntime {
 
 	INT_ARG("-ll:gsize", gasnet_mem_size_in_mb);
 	INT_ARG("-ll:csize", cpu_mem_size_in_mb);
+	INT_ARG("-ll:nsize", numa_mem_size_in_mb);
 	INT_ARG("-ll:rsize", reg_mem_size_in_mb);
 	INT_ARG("-ll:fsize", fb_mem_size_in_mb);
 	INT_ARG("-ll:zsize", zc_mem_size_in_mb);
@@ -8345,12 +8788,25 @@ namespace LegionRuntime {
 	INT_ARG("-ll:util", num_util_procs);
 	INT_ARG("-ll:workers", cpu_worker_threads);
 	INT_ARG("-ll:dma", dma_worker_threads);
+	INT_ARG("-ll:dmasmall", dma_small_copy_kb);
 	INT_ARG("-ll:amsg", active_msg_worker_threads);
         BOOL_ARG("-ll:gpudma", gpu_dma_thread);
         BOOL_ARG("-ll:senders", active_msg_sender_threads);
+        BOOL_ARG("-ll:mergestats", show_merge_stats);
 	INT_ARG("-ll:bind", bind_localproc_threads);
         INT_ARG("-ll:pin", pin_sysmem_for_gpu);
 
+	if(!strcmp((*argv)[i], "-ll:alloc")) {
+	  const char *kind = (*argv)[++i];
+	  if(!strcmp(kind, "firstfit"))
+	    MemoryAllocator::default_kind = MemoryAllocator::ALLOC_FIRST_FIT;
+	  else if(!strcmp(kind, "tlsf"))
+	    MemoryAllocator::default_kind = MemoryAllocator::ALLOC_TLSF;
+	  else
+	    fprintf(stderr, "WARNING: unknown allocator '%s' - using default\n", kind);
+	  continue;
+	}
+
 	if(!strcmp((*argv)[i], "-ll:eventtrace")) {
 #ifdef EVENT_TRACING
 	  event_trace_file = strdup((*argv)[++i]);
@@ -8431,7 +8887,7 @@ namespace LegionRuntime {
       // initialize barrier timestamp
       barrier_adjustment_timestamp = (((Barrier::timestamp_t)(gasnet_mynode())) << BARRIER_TIMESTAMP_NODEID_SHIFT) + 1;
 
-      Logger::init(*argc, (const char **)*argv);
+      Logger::init(*argc, (const char **)*argv, gasnet_mynode());
 
       gasnet_handlerentry_t handlers[128];
       int hcount = 0;
@@ -8496,7 +8952,8 @@ namespace LegionRuntime {
       
       start_polling_threads(active_msg_worker_threads);
 
-      start_dma_worker_threads(dma_worker_threads);
+      start_dma_worker_threads(dma_worker_threads,
+                               size_t(dma_small_copy_kb) << 10);
 
       if (active_msg_sender_threads)
         start_sending_threads();
@@ -8527,15 +8984,29 @@ namespace LegionRuntime {
       Node *n = &r->nodes[gasnet_mynode()];
 
       NodeAnnounceData announce_data;
-      const unsigned ADATA_SIZE = 4096;
-      size_t adata[ADATA_SIZE];
-      unsigned apos = 0;
+      // grows as processors, memories and affinities are added - the
+      //  affinity lists are quadratic in the number of processors and
+      //  memories, so no fixed size is safe
+      std::vector<size_t> adata;
 
       announce_data.node_id = gasnet_mynode();
       announce_data.num_procs = num_local_cpus + num_local_gpus + num_util_procs;
+      // one extra system memory per NUMA domain if requested - this needs
+      //  the processor assignment to know which cores live where
+      unsigned num_numa_mems = 0;
+      if((numa_mem_size_in_mb > 0) && proc_assignment)
+	num_numa_mems = proc_assignment->num_memory_domains();
+      else if(numa_mem_size_in_mb > 0)
+	log_machine.warning("-ll:nsize ignored - NUMA memories need bound "
+			    "processor threads");
       announce_data.num_memories = (1 + 
 				    (reg_mem_size_in_mb > 0 ? 1 : 0) + 
+				    num_numa_mems +
 				    2 * num_local_gpus);
+      // 4 words per processor, 5 per memory and 5 per affinity
+      adata.reserve(1 + 4 * announce_data.num_procs +
+		    5 * announce_data.num_memories *
+		    (1 + announce_data.num_procs + announce_data.num_memories));
 
       // create utility processors (if any)
       explicit_utility_procs = (num_util_procs > 0);
@@ -8549,10 +9020,10 @@ namespace LegionRuntime {
 
           n->processors.push_back(up);
           local_util_procs.push_back(up);
-          adata[apos++] = NODE_ANNOUNCE_PROC;
-          adata[apos++] = up->me.id;
-          adata[apos++] = Processor::UTIL_PROC;
-          adata[apos++] = up->util.id;
+          adata.push_back(NODE_ANNOUNCE_PROC);
+          adata.push_back(up->me.id);
+          adata.push_back(Processor::UTIL_PROC);
+          adata.push_back(up->util.id);
         }
       }
 
@@ -8634,10 +9105,10 @@ namespace LegionRuntime {
 	}
 	n->processors.push_back(lp);
 	local_cpus.push_back(lp);
-	adata[apos++] = NODE_ANNOUNCE_PROC;
-	adata[apos++] = lp->me.id;
-	adata[apos++] = Processor::LOC_PROC;
-	adata[apos++] = lp->util.id;
+	adata.push_back(NODE_ANNOUNCE_PROC);
+	adata.push_back(lp->me.id);
+	adata.push_back(Processor::LOC_PROC);
+	adata.push_back(lp->util.id);
 	//local_procs[i]->start();
 	//machine->add_processor(new LocalProcessor(local_procs[i]));
       }
@@ -8653,11 +9124,11 @@ namespace LegionRuntime {
 #ifdef USE_CUDA
         local_mems.push_back(cpumem);
 #endif
-	adata[apos++] = NODE_ANNOUNCE_MEM;
-	adata[apos++] = cpumem->me.id;
-        adata[apos++] = Memory::SYSTEM_MEM;
-	adata[apos++] = cpumem->size;
-	adata[apos++] = 0; // not registered
+	adata.push_back(NODE_ANNOUNCE_MEM);
+	adata.push_back(cpumem->me.id);
+        adata.push_back(Memory::SYSTEM_MEM);
+	adata.push_back(cpumem->size);
+	adata.push_back(0); // not registered
       } else
 	cpumem = 0;
 
@@ -8677,40 +9148,71 @@ namespace LegionRuntime {
 #ifdef USE_CUDA
         local_mems.push_back(regmem);
 #endif
-	adata[apos++] = NODE_ANNOUNCE_MEM;
-	adata[apos++] = regmem->me.id;
-        adata[apos++] = Memory::REGDMA_MEM;
-	adata[apos++] = regmem->size;
-	adata[apos++] = (size_t)(regmem->base);
+	adata.push_back(NODE_ANNOUNCE_MEM);
+	adata.push_back(regmem->me.id);
+        adata.push_back(Memory::REGDMA_MEM);
+	adata.push_back(regmem->size);
+	adata.push_back((size_t)(regmem->base));
       } else
 	regmem = 0;
 
+      // NUMA-local system memories - pages are bound to the domain's node
+      std::vector<LocalCPUMemory *> numa_mems;
+      for(unsigned d = 0; d < num_numa_mems; d++) {
+	LocalCPUMemory *nm = new LocalCPUMemory(ID(ID::ID_MEMORY,
+						   gasnet_mynode(),
+						   n->memories.size(), 0).convert<Memory>(),
+						numa_mem_size_in_mb << 20,
+						0, false,
+						proc_assignment->get_numa_node(d));
+	n->memories.push_back(nm);
+	numa_mems.push_back(nm);
+#ifdef USE_CUDA
+        local_mems.push_back(nm);
+#endif
+	adata.push_back(NODE_ANNOUNCE_MEM);
+	adata.push_back(nm->me.id);
+        adata.push_back(Memory::SYSTEM_MEM);
+	adata.push_back(nm->size);
+	adata.push_back(0); // not registered
+      }
+
       // list affinities between local CPUs / memories
       for(std::vector<UtilityProcessor *>::iterator it = local_util_procs.begin();
 	  it != local_util_procs.end();
 	  it++) {
 	if(cpu_mem_size_in_mb > 0) {
-	  adata[apos++] = NODE_ANNOUNCE_PMA;
-	  adata[apos++] = (*it)->me.id;
-	  adata[apos++] = cpumem->me.id;
-	  adata[apos++] = 100;  // "large" bandwidth
-	  adata[apos++] = 1;    // "small" latency
+	  adata.push_back(NODE_ANNOUNCE_PMA);
+	  adata.push_back((*it)->me.id);
+	  adata.push_back(cpumem->me.id);
+	  adata.push_back(100);  // "large" bandwidth
+	  adata.push_back(1);    // "small" latency
 	}
 
 	if(reg_mem_size_in_mb > 0) {
-	  adata[apos++] = NODE_ANNOUNCE_PMA;
-	  adata[apos++] = (*it)->me.id;
-	  adata[apos++] = regmem->me.id;
-	  adata[apos++] = 80;  // "large" bandwidth
-	  adata[apos++] = 5;    // "small" latency
+	  adata.push_back(NODE_ANNOUNCE_PMA);
+	  adata.push_back((*it)->me.id);
+	  adata.push_back(regmem->me.id);
+	  adata.push_back(80);  // "large" bandwidth
+	  adata.push_back(5);    // "small" latency
 	}
 
 	if(r->global_memory) {
-	  adata[apos++] = NODE_ANNOUNCE_PMA;
-	  adata[apos++] = (*it)->me.id;
-	  adata[apos++] = r->global_memory->me.id;
-	  adata[apos++] = 10;  // "lower" bandwidth
-	  adata[apos++] = 50;    // "higher" latency
+	  adata.push_back(NODE_ANNOUNCE_PMA);
+	  adata.push_back((*it)->me.id);
+	  adata.push_back(r->global_memory->me.id);
+	  adata.push_back(10);  // "lower" bandwidth
+	  adata.push_back(50);    // "higher" latency
+	}
+
+	// utility threads aren't bound to a domain, so every NUMA memory
+	//  looks the same to them
+	for(unsigned d = 0; d < numa_mems.size(); d++) {
+	  adata.push_back(NODE_ANNOUNCE_PMA);
+	  adata.push_back((*it)->me.id);
+	  adata.push_back(numa_mems[d]->me.id);
+	  adata.push_back(80);  // "large" bandwidth
+	  adata.push_back(2);    // "small" latency
 	}
       }
 
@@ -8719,36 +9221,82 @@ namespace LegionRuntime {
 	  it != local_cpus.end();
 	  it++) {
 	if(cpu_mem_size_in_mb > 0) {
-	  adata[apos++] = NODE_ANNOUNCE_PMA;
-	  adata[apos++] = (*it)->me.id;
-	  adata[apos++] = cpumem->me.id;
-	  adata[apos++] = 100;  // "large" bandwidth
-	  adata[apos++] = 1;    // "small" latency
+	  adata.push_back(NODE_ANNOUNCE_PMA);
+	  adata.push_back((*it)->me.id);
+	  adata.push_back(cpumem->me.id);
+	  adata.push_back(100);  // "large" bandwidth
+	  // the node-wide memory's pages can be anywhere, so it ranks behind
+	  //  the processor's own NUMA memory when there is one
+	  adata.push_back(numa_mems.empty() ? 1 : 2);    // "small" latency
+	}
+
+	if(!numa_mems.empty()) {
+	  // local procs were created with core ids matching their position
+	  int local_domain = 
+	    proc_assignment->get_proc_domain(it - local_cpus.begin());
+	  for(unsigned d = 0; d < numa_mems.size(); d++) {
+	    adata.push_back(NODE_ANNOUNCE_PMA);
+	    adata.push_back((*it)->me.id);
+	    adata.push_back(numa_mems[d]->me.id);
+	    if((int)d == local_domain) {
+	      adata.push_back(120);  // "larger" bandwidth
+	      adata.push_back(1);    // "small" latency
+	    } else {
+	      adata.push_back(60);   // crosses the socket interconnect
+	      adata.push_back(3);
+	    }
+	  }
 	}
 
 	if(reg_mem_size_in_mb > 0) {
-	  adata[apos++] = NODE_ANNOUNCE_PMA;
-	  adata[apos++] = (*it)->me.id;
-	  adata[apos++] = regmem->me.id;
-	  adata[apos++] = 80;  // "large" bandwidth
-	  adata[apos++] = 5;    // "small" latency
+	  adata.push_back(NODE_ANNOUNCE_PMA);
+	  adata.push_back((*it)->me.id);
+	  adata.push_back(regmem->me.id);
+	  adata.push_back(80);  // "large" bandwidth
+	  adata.push_back(5);    // "small" latency
 	}
 
 	if(r->global_memory) {
-	  adata[apos++] = NODE_ANNOUNCE_PMA;
-	  adata[apos++] = (*it)->me.id;
-	  adata[apos++] = r->global_memory->me.id;
-	  adata[apos++] = 10;  // "lower" bandwidth
-	  adata[apos++] = 50;    // "higher" latency
+	  adata.push_back(NODE_ANNOUNCE_PMA);
+	  adata.push_back((*it)->me.id);
+	  adata.push_back(r->global_memory->me.id);
+	  adata.push_back(10);  // "lower" bandwidth
+	  adata.push_back(50);    // "higher" latency
 	}
       }
 
       if((cpu_mem_size_in_mb > 0) && r->global_memory) {
-	adata[apos++] = NODE_ANNOUNCE_MMA;
-	adata[apos++] = cpumem->me.id;
-	adata[apos++] = r->global_memory->me.id;
-	adata[apos++] = 30;  // "lower" bandwidth
-	adata[apos++] = 25;    // "higher" latency
+	adata.push_back(NODE_ANNOUNCE_MMA);
+	adata.push_back(cpumem->me.id);
+	adata.push_back(r->global_memory->me.id);
+	adata.push_back(30);  // "lower" bandwidth
+	adata.push_back(25);    // "higher" latency
+      }
+
+      for(unsigned d = 0; d < numa_mems.size(); d++) {
+	if(cpu_mem_size_in_mb > 0) {
+	  adata.push_back(NODE_ANNOUNCE_MMA);
+	  adata.push_back(numa_mems[d]->me.id);
+	  adata.push_back(cpumem->me.id);
+	  adata.push_back(80);  // "large" bandwidth
+	  adata.push_back(2);    // "small" latency
+	}
+
+	for(unsigned d2 = d + 1; d2 < numa_mems.size(); d2++) {
+	  adata.push_back(NODE_ANNOUNCE_MMA);
+	  adata.push_back(numa_mems[d]->me.id);
+	  adata.push_back(numa_mems[d2]->me.id);
+	  adata.push_back(60);  // crosses the socket interconnect
+	  adata.push_back(3);
+	}
+
+	if(r->global_memory) {
+	  adata.push_back(NODE_ANNOUNCE_MMA);
+	  adata.push_back(numa_mems[d]->me.id);
+	  adata.push_back(r->global_memory->me.id);
+	  adata.push_back(30);  // "lower" bandwidth
+	  adata.push_back(25);    // "higher" latency
+	}
       }
 
 #ifdef USE_CUDA
@@ -8814,10 +9362,10 @@ namespace LegionRuntime {
 	  n->processors.push_back(gp);
 	  local_gpus.push_back(gp);
 
-	  adata[apos++] = NODE_ANNOUNCE_PROC;
-	  adata[apos++] = p.id;
-	  adata[apos++] = Processor::TOC_PROC;
-	  adata[apos++] = gp->util.id;
+	  adata.push_back(NODE_ANNOUNCE_PROC);
+	  adata.push_back(p.id);
+	  adata.push_back(Processor::TOC_PROC);
+	  adata.push_back(gp->util.id);
 
 	  Memory m = ID(ID::ID_MEMORY,
 			gasnet_mynode(),
@@ -8825,18 +9373,18 @@ namespace LegionRuntime {
 	  GPUFBMemory *fbm = new GPUFBMemory(m, gp);
 	  n->memories.push_back(fbm);
 
-	  adata[apos++] = NODE_ANNOUNCE_MEM;
-	  adata[apos++] = m.id;
-          adata[apos++] = Memory::GPU_FB_MEM;
-	  adata[apos++] = fbm->size;
-	  adata[apos++] = 0; // not registered
+	  adata.push_back(NODE_ANNOUNCE_MEM);
+	  adata.push_back(m.id);
+          adata.push_back(Memory::GPU_FB_MEM);
+	  adata.push_back(fbm->size);
+	  adata.push_back(0); // not registered
 
 	  // FB has very good bandwidth and ok latency to GPU
-	  adata[apos++] = NODE_ANNOUNCE_PMA;
-	  adata[apos++] = p.id;
-	  adata[apos++] = m.id;
-	  adata[apos++] = 200; // "big" bandwidth
-	  adata[apos++] = 5;   // "ok" latency
+	  adata.push_back(NODE_ANNOUNCE_PMA);
+	  adata.push_back(p.id);
+	  adata.push_back(m.id);
+	  adata.push_back(200); // "big" bandwidth
+	  adata.push_back(5);   // "ok" latency
 
 	  Memory m2 = ID(ID::ID_MEMORY,
 			 gasnet_mynode(),
@@ -8844,28 +9392,28 @@ namespace LegionRuntime {
 	  GPUZCMemory *zcm = new GPUZCMemory(m2, gp);
 	  n->memories.push_back(zcm);
 
-	  adata[apos++] = NODE_ANNOUNCE_MEM;
-	  adata[apos++] = m2.id;
-          adata[apos++] = Memory::Z_COPY_MEM;
-	  adata[apos++] = zcm->size;
-	  adata[apos++] = 0; // not registered
+	  adata.push_back(NODE_ANNOUNCE_MEM);
+	  adata.push_back(m2.id);
+          adata.push_back(Memory::Z_COPY_MEM);
+	  adata.push_back(zcm->size);
+	  adata.push_back(0); // not registered
 
 	  // ZC has medium bandwidth and bad latency to GPU
-	  adata[apos++] = NODE_ANNOUNCE_PMA;
-	  adata[apos++] = p.id;
-	  adata[apos++] = m2.id;
-	  adata[apos++] = 20;
-	  adata[apos++] = 200;
+	  adata.push_back(NODE_ANNOUNCE_PMA);
+	  adata.push_back(p.id);
+	  adata.push_back(m2.id);
+	  adata.push_back(20);
+	  adata.push_back(200);
 
 	  // ZC also accessible to all the local CPUs
 	  for(std::vector<LocalProcessor *>::iterator it = local_cpus.begin();
 	      it != local_cpus.end();
 	      it++) {
-	    adata[apos++] = NODE_ANNOUNCE_PMA;
-	    adata[apos++] = (*it)->me.id;
-	    adata[apos++] = m2.id;
-	    adata[apos++] = 40;
-	    adata[apos++] = 3;
+	    adata.push_back(NODE_ANNOUNCE_PMA);
+	    adata.push_back((*it)->me.id);
+	    adata.push_back(m2.id);
+	    adata.push_back(40);
+	    adata.push_back(3);
 	  }
 	}
         // Now pin any CPU memories
@@ -8907,13 +9455,12 @@ namespace LegionRuntime {
       }
 #endif
 
-      adata[apos++] = NODE_ANNOUNCE_DONE;
-      assert(apos < ADATA_SIZE);
+      adata.push_back(NODE_ANNOUNCE_DONE);
 
       // parse our own data (but don't create remote proc/mem objects)
       {
 	AutoHSLLock al(announcement_mutex);
-	parse_node_announce_data(adata, apos*sizeof(adata[0]), 
+	parse_node_announce_data(&adata[0], adata.size()*sizeof(adata[0]), 
 				 announce_data, false);
       }
 
@@ -8921,7 +9468,7 @@ namespace LegionRuntime {
       for(int i = 0; i < gasnet_nodes(); i++)
 	if(i != gasnet_mynode())
 	  NodeAnnounceMessage::request(i, announce_data, 
-				       adata, apos*sizeof(adata[0]),
+				       &adata[0], adata.size()*sizeof(adata[0]),
 				       PAYLOAD_COPY);
 
       // wait until we hear from everyone else?
@@ -8996,6 +9543,7 @@ namespace LegionRuntime {
         lock_trace_file = 0;
       }
 #endif
+      Logger::finalize_async_logging();
       gasnet_exit(0);
     }
 
@@ -9021,6 +9569,11 @@ namespace LegionRuntime {
       return m.impl()->size;
     }
 
+    bool Machine::get_memory_alloc_stats(Memory m, MemoryAllocStats& stats) const
+    {
+      return m.impl()->get_alloc_stats(stats);
+    }
+
     size_t Machine::get_address_space_count(void) const
     {
       return gasnet_nodes();
@@ -9185,6 +9738,8 @@ namespace LegionRuntime {
         show_event_waiters(log_file);
       }
 #endif
+      if(show_merge_stats)
+        report_merge_stats(stdout);
 #if defined(ORDERED_LOGGING) || defined(NODE_LOGGING)
       Logger::finalize();
 #endif
@@ -9196,6 +9751,8 @@ namespace LegionRuntime {
       GPUProcessor::stop_gpu_dma_threads();
 #endif
       stop_activemsg_threads();
+      // only drain the log once nothing else can be writing to it
+      Logger::finalize_async_logging();
       
       // if we are running as a background thread, just terminate this thread
       // if not, do a full process exit - gasnet may have started some threads we don't have handles for,
@@ -9317,6 +9874,11 @@ namespace LegionRuntime {
       allocated = true;
     }
     strcat(buffer, "\n");
+    if (async_log(buffer, strlen(buffer))) {
+      if (allocated)
+        free(buffer);
+      return;
+    }
 #ifdef ORDERED_LOGGING 
     // Update the length to reflect the newline character
     len = strlen(buffer);
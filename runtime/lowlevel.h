@@ -28,6 +28,7 @@
 #include "utilities.h"
 #include "accessor.h"
 #include "arrays.h"
+#include "lowlevel_reduction.h"
 
 #ifndef __GNUC__
 #include "atomics.h" // for __sync_fetch_and_add
@@ -88,6 +89,13 @@ namespace LegionRuntime {
 
       // creates an event that won't trigger until all input events have
       static Event merge_events(const std::set<Event>& wait_for);
+      // array/vector versions drop triggered and duplicate events without
+      //  building a set - prefer these when accumulating preconditions
+      static Event merge_events(const Event *wait_for, size_t num_events);
+      static Event merge_events(const std::vector<Event>& wait_for)
+      {
+        return merge_events(wait_for.empty() ? 0 : &wait_for[0], wait_for.size());
+      }
       static Event merge_events(Event ev1, Event ev2,
 				Event ev3 = NO_EVENT, Event ev4 = NO_EVENT,
 				Event ev5 = NO_EVENT, Event ev6 = NO_EVENT);
@@ -207,6 +215,14 @@ namespace LegionRuntime {
 
       Event spawn(TaskFuncID func_id, const void *args, size_t arglen,
 		  Event wait_on = Event::NO_EVENT, int priority = 0) const;
+
+      // scatter-gather form of spawn - the task's arguments are the
+      //  concatenation of the (pointer, length) spans, so callers don't
+      //  have to pack them into a single buffer first (for remote
+      //  processors the spans go straight into the outgoing message)
+      typedef std::pair<const void *, size_t> ArgSpan;
+      Event spawn(TaskFuncID func_id, const std::vector<ArgSpan>& arg_spans,
+		  Event wait_on = Event::NO_EVENT, int priority = 0) const;
     };
 
     class Memory {
@@ -406,6 +422,8 @@ namespace LegionRuntime {
       virtual void apply(void *lhs_ptr, const void *rhs_ptr, size_t count,
 			 bool exclusive = false) const
       {
+	if(ReductionVectorDispatch<REDOP>::reduce(lhs_ptr, rhs_ptr, count, exclusive))
+	  return;
 	typename REDOP::LHS *lhs = (typename REDOP::LHS *)lhs_ptr;
 	const typename REDOP::RHS *rhs = (const typename REDOP::RHS *)rhs_ptr;
 	if(exclusive) {
@@ -421,6 +439,10 @@ namespace LegionRuntime {
 				 off_t lhs_stride, off_t rhs_stride, size_t count,
 				 bool exclusive = false) const
       {
+	if(ReductionVectorDispatch<REDOP>::reduce_strided(lhs_ptr, rhs_ptr,
+							  lhs_stride, rhs_stride,
+							  count, exclusive))
+	  return;
 	char *lhs = (char *)lhs_ptr;
 	const char *rhs = (const char *)rhs_ptr;
 	if(exclusive) {
@@ -443,6 +465,8 @@ namespace LegionRuntime {
       virtual void fold(void *rhs1_ptr, const void *rhs2_ptr, size_t count,
 			bool exclusive = false) const
       {
+	if(ReductionVectorDispatch<REDOP>::reduce(rhs1_ptr, rhs2_ptr, count, exclusive))
+	  return;
 	typename REDOP::RHS *rhs1 = (typename REDOP::RHS *)rhs1_ptr;
 	const typename REDOP::RHS *rhs2 = (const typename REDOP::RHS *)rhs2_ptr;
 	if(exclusive) {
@@ -458,6 +482,10 @@ namespace LegionRuntime {
 				off_t lhs_stride, off_t rhs_stride, size_t count,
 				bool exclusive = false) const
       {
+	if(ReductionVectorDispatch<REDOP>::reduce_strided(lhs_ptr, rhs_ptr,
+							  lhs_stride, rhs_stride,
+							  count, exclusive))
+	  return;
 	char *lhs = (char *)lhs_ptr;
 	const char *rhs = (const char *)rhs_ptr;
 	if(exclusive) {
@@ -1622,6 +1650,21 @@ namespace LegionRuntime {
 			       Memory restrict_mem1 = Memory::NO_MEMORY,
 			       Memory restrict_mem2 = Memory::NO_MEMORY);
 
+      struct MemoryAllocStats {
+        size_t total_bytes;
+        size_t used_bytes;
+        size_t peak_used_bytes;
+        size_t free_bytes;
+        size_t largest_free_block;
+        size_t num_free_blocks;
+        size_t num_allocs;
+        size_t num_failed_allocs;
+      };
+
+      // samples the state of the allocator for a memory - returns false if
+      //  allocations in that memory aren't managed by this node
+      bool get_memory_alloc_stats(Memory m, MemoryAllocStats& stats) const;
+
     protected:
       std::set<Processor> procs;
       std::set<Memory> memories;
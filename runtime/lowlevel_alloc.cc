@@ -0,0 +1,434 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lowlevel_alloc.h"
+
+#include <assert.h>
+
+namespace LegionRuntime {
+  namespace LowLevel {
+
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // class MemoryAllocator
+    //
+
+    /*static*/ MemoryAllocator::AllocatorKind MemoryAllocator::default_kind = MemoryAllocator::ALLOC_FIRST_FIT;
+
+    /*static*/ MemoryAllocator *MemoryAllocator::create_allocator(AllocatorKind kind,
+                                                                 size_t size)
+    {
+      switch(kind) {
+      case ALLOC_FIRST_FIT: return new FirstFitAllocator(size);
+      case ALLOC_TLSF: return new TLSFAllocator(size);
+      }
+      assert(0);
+      return 0;
+    }
+
+    FirstFitAllocator::FirstFitAllocator(size_t _size)
+      : total_size(_size), bytes_used(0), peak_used(0),
+        num_allocs(0), num_failed(0)
+    {
+      if(_size > 0)
+        free_blocks[0] = _size;
+    }
+
+    off_t FirstFitAllocator::alloc(size_t size)
+    {
+      for(std::map<off_t, off_t>::iterator it = free_blocks.begin();
+	  it != free_blocks.end();
+	  it++) {
+	if(it->second == (off_t)size) {
+	  // perfect match
+	  off_t retval = it->first;
+	  free_blocks.erase(it);
+          bytes_used += size;
+          if(bytes_used > peak_used) peak_used = bytes_used;
+          num_allocs++;
+	  return retval;
+	}
+	
+	if(it->second > (off_t)size) {
+	  // some left over
+	  off_t leftover = it->second - size;
+	  off_t retval = it->first + leftover;
+	  it->second = leftover;
+          bytes_used += size;
+          if(bytes_used > peak_used) peak_used = bytes_used;
+          num_allocs++;
+	  return retval;
+	}
+      }
+
+      // no blocks large enough - boo hoo
+      num_failed++;
+      return -1;
+    }
+
+    void FirstFitAllocator::free(off_t offset, size_t size)
+    {
+      bytes_used -= size;
+
+      if(free_blocks.size() > 0) {
+	// find the first existing block that comes _after_ us
+	std::map<off_t, off_t>::iterator after = free_blocks.lower_bound(offset);
+	if(after != free_blocks.end()) {
+	  // found one - is it the first one?
+	  if(after == free_blocks.begin()) {
+	    // yes, so no "before"
+	    assert((offset + (off_t)size) <= after->first); // no overlap!
+	    if((offset + (off_t)size) == after->first) {
+	      // merge the ranges by eating the "after"
+	      size += after->second;
+	      free_blocks.erase(after);
+	    }
+	    free_blocks[offset] = size;
+	  } else {
+	    // no, get range that comes before us too
+	    std::map<off_t, off_t>::iterator before = after; before--;
+
+	    // if we're adjacent to the after, merge with it
+	    assert((offset + (off_t)size) <= after->first); // no overlap!
+	    if((offset + (off_t)size) == after->first) {
+	      // merge the ranges by eating the "after"
+	      size += after->second;
+	      free_blocks.erase(after);
+	    }
+
+	    // if we're adjacent with the before, grow it instead of adding
+	    //  a new range
+	    assert((before->first + before->second) <= offset);
+	    if((before->first + before->second) == offset) {
+	      before->second += size;
+	    } else {
+	      free_blocks[offset] = size;
+	    }
+	  }
+	} else {
+	  // nothing's after us, so just see if we can merge with the range
+	  //  that's before us
+
+	  std::map<off_t, off_t>::iterator before = after; before--;
+
+	  // if we're adjacent with the before, grow it instead of adding
+	  //  a new range
+	  assert((before->first + before->second) <= offset);
+	  if((before->first + before->second) == offset) {
+	    before->second += size;
+	  } else {
+	    free_blocks[offset] = size;
+	  }
+	}
+      } else {
+	// easy case - nothing was free, so now just our block is
+	free_blocks[offset] = size;
+      }
+    }
+
+    void FirstFitAllocator::get_stats(Machine::MemoryAllocStats& stats) const
+    {
+      stats.total_bytes = total_size;
+      stats.used_bytes = bytes_used;
+      stats.peak_used_bytes = peak_used;
+      stats.free_bytes = total_size - bytes_used;
+      stats.largest_free_block = 0;
+      for(std::map<off_t, off_t>::const_iterator it = free_blocks.begin();
+          it != free_blocks.end();
+          it++)
+        if((size_t)(it->second) > stats.largest_free_block)
+          stats.largest_free_block = it->second;
+      stats.num_free_blocks = free_blocks.size();
+      stats.num_allocs = num_allocs;
+      stats.num_failed_allocs = num_failed;
+    }
+
+    TLSFAllocator::TLSFAllocator(size_t _size)
+      : bytes_used(0), peak_used(0), num_allocs(0), num_failed(0),
+        num_free_blocks(0), fl_bitmap(0), phys_head(0), spare_blocks(0),
+        hash_bits(6), num_hashed(0)
+    {
+      for(unsigned i = 0; i < FL_COUNT; i++) {
+        sl_bitmap[i] = 0;
+        for(unsigned j = 0; j < SL_COUNT; j++)
+          bins[i][j] = 0;
+      }
+      hash_buckets.resize(1 << hash_bits, 0);
+
+      // anything past the last whole granule is unusable
+      total_size = _size & ~((size_t(1) << GRANULE_SHIFT) - 1);
+      if(total_size > 0) {
+        phys_head = new_block();
+        phys_head->offset = 0;
+        phys_head->size = total_size;
+        phys_head->prev_phys = 0;
+        phys_head->next_phys = 0;
+        insert_free(phys_head);
+      }
+    }
+
+    TLSFAllocator::~TLSFAllocator(void)
+    {
+      while(phys_head) {
+        Block *next = phys_head->next_phys;
+        delete phys_head;
+        phys_head = next;
+      }
+      while(spare_blocks) {
+        Block *next = spare_blocks->next_free;
+        delete spare_blocks;
+        spare_blocks = next;
+      }
+    }
+
+    /*static*/ void TLSFAllocator::map_size(size_t size, unsigned& fl, unsigned& sl)
+    {
+      size_t units = size >> GRANULE_SHIFT;
+      if(units < SL_COUNT) {
+        // small sizes get a bin each in the first row
+        fl = 0;
+        sl = units;
+      } else {
+        unsigned msb = 63 - __builtin_clzll(units);
+        fl = msb - SL_SHIFT + 1;
+        sl = (units >> (msb - SL_SHIFT)) - SL_COUNT;
+      }
+    }
+
+    void TLSFAllocator::insert_free(Block *b)
+    {
+      unsigned fl, sl;
+      map_size(b->size, fl, sl);
+      b->is_free = true;
+      b->prev_free = 0;
+      b->next_free = bins[fl][sl];
+      if(b->next_free)
+        b->next_free->prev_free = b;
+      bins[fl][sl] = b;
+      sl_bitmap[fl] |= (1U << sl);
+      fl_bitmap |= (1ULL << fl);
+      num_free_blocks++;
+    }
+
+    void TLSFAllocator::remove_free(Block *b)
+    {
+      unsigned fl, sl;
+      map_size(b->size, fl, sl);
+      if(b->prev_free)
+        b->prev_free->next_free = b->next_free;
+      else
+        bins[fl][sl] = b->next_free;
+      if(b->next_free)
+        b->next_free->prev_free = b->prev_free;
+      if(!bins[fl][sl]) {
+        sl_bitmap[fl] &= ~(1U << sl);
+        if(!sl_bitmap[fl])
+          fl_bitmap &= ~(1ULL << fl);
+      }
+      b->is_free = false;
+      num_free_blocks--;
+    }
+
+    TLSFAllocator::Block *TLSFAllocator::find_free(size_t size)
+    {
+      // round the request up to the next bin boundary so that any block in
+      //  the bin we pick is guaranteed to be big enough
+      size_t units = size >> GRANULE_SHIFT;
+      if(units >= SL_COUNT) {
+        unsigned msb = 63 - __builtin_clzll(units);
+        units += (size_t(1) << (msb - SL_SHIFT)) - 1;
+      }
+      unsigned fl, sl;
+      map_size(units << GRANULE_SHIFT, fl, sl);
+      if(fl < FL_COUNT) {
+        unsigned sl_map = sl_bitmap[fl] & (~0U << sl);
+        if(!sl_map) {
+          unsigned long long fl_map = ((fl + 1) < FL_COUNT) ? 
+                                        (fl_bitmap & (~0ULL << (fl + 1))) : 0;
+          if(fl_map) {
+            fl = __builtin_ctzll(fl_map);
+            sl_map = sl_bitmap[fl];
+          }
+        }
+        if(sl_map) {
+          sl = __builtin_ctz(sl_map);
+          return bins[fl][sl];
+        }
+      }
+
+      // the rounding may have skipped a big enough block in the request's
+      //  own bin (or pushed it past the last row) - worth a look before
+      //  giving up
+      unsigned efl, esl;
+      map_size(size, efl, esl);
+      if(efl >= FL_COUNT)
+        return 0;
+      for(Block *b = bins[efl][esl]; b; b = b->next_free)
+        if(b->size >= size)
+          return b;
+      return 0;
+    }
+
+    TLSFAllocator::Block *TLSFAllocator::new_block(void)
+    {
+      if(spare_blocks) {
+        Block *b = spare_blocks;
+        spare_blocks = b->next_free;
+        return b;
+      }
+      return new Block;
+    }
+
+    void TLSFAllocator::delete_block(Block *b)
+    {
+      b->next_free = spare_blocks;
+      spare_blocks = b;
+    }
+
+    static inline size_t hash_offset(off_t offset, unsigned bits)
+    {
+      return (size_t)(((unsigned long long)offset * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+    }
+
+    void TLSFAllocator::hash_insert(Block *b)
+    {
+      if(num_hashed >= hash_buckets.size())
+        grow_hash();
+      size_t idx = hash_offset(b->offset, hash_bits);
+      b->next_hash = hash_buckets[idx];
+      hash_buckets[idx] = b;
+      num_hashed++;
+    }
+
+    TLSFAllocator::Block *TLSFAllocator::hash_remove(off_t offset)
+    {
+      Block **ptr = &hash_buckets[hash_offset(offset, hash_bits)];
+      while(*ptr) {
+        Block *b = *ptr;
+        if(b->offset == offset) {
+          *ptr = b->next_hash;
+          num_hashed--;
+          return b;
+        }
+        ptr = &(b->next_hash);
+      }
+      return 0;
+    }
+
+    void TLSFAllocator::grow_hash(void)
+    {
+      std::vector<Block *> old_buckets(hash_buckets.size() * 2, 0);
+      old_buckets.swap(hash_buckets);
+      hash_bits++;
+      for(size_t i = 0; i < old_buckets.size(); i++) {
+        Block *b = old_buckets[i];
+        while(b) {
+          Block *next = b->next_hash;
+          size_t idx = hash_offset(b->offset, hash_bits);
+          b->next_hash = hash_buckets[idx];
+          hash_buckets[idx] = b;
+          b = next;
+        }
+      }
+    }
+
+    off_t TLSFAllocator::alloc(size_t size)
+    {
+      size_t granule = size_t(1) << GRANULE_SHIFT;
+      size = (size + granule - 1) & ~(granule - 1);
+
+      Block *b = find_free(size);
+      if(!b) {
+        num_failed++;
+        return -1;
+      }
+      remove_free(b);
+
+      // split off whatever we don't need as a new free block
+      if(b->size > size) {
+        Block *rest = new_block();
+        rest->offset = b->offset + size;
+        rest->size = b->size - size;
+        rest->prev_phys = b;
+        rest->next_phys = b->next_phys;
+        if(rest->next_phys)
+          rest->next_phys->prev_phys = rest;
+        b->next_phys = rest;
+        b->size = size;
+        insert_free(rest);
+      }
+
+      hash_insert(b);
+      bytes_used += size;
+      if(bytes_used > peak_used) peak_used = bytes_used;
+      num_allocs++;
+      return b->offset;
+    }
+
+    void TLSFAllocator::free(off_t offset, size_t size)
+    {
+      Block *b = hash_remove(offset);
+      assert(b != 0);
+#ifdef DEBUG_LOW_LEVEL
+      size_t granule = size_t(1) << GRANULE_SHIFT;
+      assert(b->size == ((size + granule - 1) & ~(granule - 1)));
+#endif
+      bytes_used -= b->size;
+
+      // coalesce with free neighbors - the earlier block always survives
+      Block *next = b->next_phys;
+      if(next && next->is_free) {
+        remove_free(next);
+        b->size += next->size;
+        b->next_phys = next->next_phys;
+        if(b->next_phys)
+          b->next_phys->prev_phys = b;
+        delete_block(next);
+      }
+      Block *prev = b->prev_phys;
+      if(prev && prev->is_free) {
+        remove_free(prev);
+        prev->size += b->size;
+        prev->next_phys = b->next_phys;
+        if(prev->next_phys)
+          prev->next_phys->prev_phys = prev;
+        delete_block(b);
+        b = prev;
+      }
+      insert_free(b);
+    }
+
+    void TLSFAllocator::get_stats(Machine::MemoryAllocStats& stats) const
+    {
+      stats.total_bytes = total_size;
+      stats.used_bytes = bytes_used;
+      stats.peak_used_bytes = peak_used;
+      stats.free_bytes = total_size - bytes_used;
+      stats.largest_free_block = 0;
+      if(fl_bitmap) {
+        // the largest block is somewhere in the highest non-empty bin
+        unsigned fl = 63 - __builtin_clzll(fl_bitmap);
+        unsigned sl = 31 - __builtin_clz(sl_bitmap[fl]);
+        for(const Block *b = bins[fl][sl]; b; b = b->next_free)
+          if(b->size > stats.largest_free_block)
+            stats.largest_free_block = b->size;
+      }
+      stats.num_free_blocks = num_free_blocks;
+      stats.num_allocs = num_allocs;
+      stats.num_failed_allocs = num_failed;
+    }
+
+  }; // namespace LowLevel
+}; // namespace LegionRuntime
@@ -0,0 +1,129 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOWLEVEL_ALLOC_H
+#define LOWLEVEL_ALLOC_H
+
+// Allocators for the byte ranges of a low-level Memory.  These only
+//  depend on the public low-level interface so they can be built and
+//  measured outside of the runtime (see apps/benchmarks/mem_alloc).
+
+#include "lowlevel.h"
+
+#include <sys/types.h>
+
+#include <map>
+#include <vector>
+
+namespace LegionRuntime {
+  namespace LowLevel {
+
+    // A MemoryAllocator hands out byte ranges within a Memory::Impl.  The
+    //  caller is responsible for locking (Memory::Impl holds its mutex) and
+    //  for rounding sizes to the memory's alignment.  Both alloc and free
+    //  must be given the same (rounded) size.
+    class MemoryAllocator {
+    public:
+      enum AllocatorKind {
+        ALLOC_FIRST_FIT, // sorted free list, first fit (the original scheme)
+        ALLOC_TLSF,      // two-level segregated fit, O(1) alloc/free
+      };
+
+      virtual ~MemoryAllocator(void) { }
+
+      // returns -1 if no block is large enough
+      virtual off_t alloc(size_t size) = 0;
+      virtual void free(off_t offset, size_t size) = 0;
+
+      virtual void get_stats(Machine::MemoryAllocStats& stats) const = 0;
+
+      static MemoryAllocator *create_allocator(AllocatorKind kind, size_t size);
+
+      // chosen with -ll:alloc (first fit unless 'tlsf' is given)
+      static AllocatorKind default_kind;
+    };
+
+    class FirstFitAllocator : public MemoryAllocator {
+    public:
+      FirstFitAllocator(size_t _size);
+
+      virtual off_t alloc(size_t size);
+      virtual void free(off_t offset, size_t size);
+      virtual void get_stats(Machine::MemoryAllocStats& stats) const;
+
+    protected:
+      size_t total_size, bytes_used, peak_used;
+      size_t num_allocs, num_failed;
+      std::map<off_t, off_t> free_blocks;
+    };
+
+    // Two-level segregated fit: free blocks are binned by power of two
+    //  (first level) and then linearly within each power of two (second
+    //  level), with a bitmap per level so finding a big enough bin is a
+    //  couple of find-first-set operations.  Block headers live outside
+    //  the memory being managed since it may not be CPU-addressable.
+    class TLSFAllocator : public MemoryAllocator {
+    public:
+      TLSFAllocator(size_t _size);
+      virtual ~TLSFAllocator(void);
+
+      virtual off_t alloc(size_t size);
+      virtual void free(off_t offset, size_t size);
+      virtual void get_stats(Machine::MemoryAllocStats& stats) const;
+
+    protected:
+      static const unsigned GRANULE_SHIFT = 4; // 16 byte granules
+      static const unsigned SL_SHIFT = 5;      // 32 second-level bins
+      static const unsigned SL_COUNT = 1 << SL_SHIFT;
+      static const unsigned FL_COUNT = 64 - GRANULE_SHIFT - SL_SHIFT + 1;
+
+      struct Block {
+        off_t offset;
+        size_t size;
+        bool is_free;
+        Block *prev_phys, *next_phys;   // address order neighbors
+        Block *prev_free, *next_free;   // bin list (or spare list)
+        Block *next_hash;               // allocated block lookup
+      };
+
+      static void map_size(size_t size, unsigned& fl, unsigned& sl);
+
+      void insert_free(Block *b);
+      void remove_free(Block *b);
+      Block *find_free(size_t size);
+
+      Block *new_block(void);
+      void delete_block(Block *b);
+
+      void hash_insert(Block *b);
+      Block *hash_remove(off_t offset);
+      void grow_hash(void);
+
+      size_t total_size, bytes_used, peak_used;
+      size_t num_allocs, num_failed, num_free_blocks;
+      unsigned long long fl_bitmap;
+      unsigned sl_bitmap[FL_COUNT];
+      Block *bins[FL_COUNT][SL_COUNT];
+      Block *phys_head;                 // never merged away
+      Block *spare_blocks;
+      std::vector<Block *> hash_buckets;
+      unsigned hash_bits;
+      size_t num_hashed;
+    };
+
+  }; // namespace LowLevel
+}; // namespace LegionRuntime
+
+#endif
@@ -18,6 +18,7 @@
 #include "lowlevel_gpu.h"
 #endif
 #include "accessor.h"
+#include "metrics.h"
 
 #include <queue>
 
@@ -61,9 +62,16 @@ namespace LegionRuntime {
 
     class DmaRequest;
 
+    // requests are queued per (src,dst) memory pair so that copies between
+    //  unrelated memories don't wait behind each other - workers take turns
+    //  across the pairs, and within a pair higher priorities go first and
+    //  small copies may bypass large ones of the same priority (but only
+    //  MAX_SMALL_BYPASS times in a row, so the large ones still make progress)
     class DmaRequestQueue {
     public:
-      DmaRequestQueue(void);
+      static const unsigned MAX_SMALL_BYPASS = 16;
+
+      DmaRequestQueue(size_t _small_copy_bytes);
 
       void enqueue_request(DmaRequest *r);
 
@@ -72,9 +80,28 @@ namespace LegionRuntime {
       void shutdown_queue(void);
 
     protected:
+      struct PairQueue {
+        PairQueue(void) : bypass_count(0), active(false) {}
+
+        // priorities are negated so that the highest logical priority
+        //  comes first
+        std::map<int, std::deque<DmaRequest *> > small_reqs, large_reqs;
+        unsigned bypass_count;
+        bool active; // on the active_pairs list?
+
+        bool empty(void) const { return small_reqs.empty() && large_reqs.empty(); }
+        int best_priority(void) const;
+        DmaRequest *pop(void);
+      };
+
+      static DmaRequest *pop_front(std::map<int, std::deque<DmaRequest *> >& reqs);
+
       gasnet_hsl_t queue_mutex;
       gasnett_cond_t queue_condvar;
-      std::map<int, std::list<DmaRequest *> *> queues;
+      size_t small_copy_bytes;
+      std::map<MemPair, PairQueue> pair_queues;
+      std::list<PairQueue *> active_pairs; // in round-robin order
+      size_t num_queued;
       int queue_sleepers;
       bool shutdown_flag;
     };
@@ -92,6 +119,11 @@ namespace LegionRuntime {
 
       virtual void perform_dma(void) = 0;
 
+      // used by the queue for scheduling, once the request is ready (and
+      //  therefore has all the metadata it needs)
+      virtual MemPair memory_pair(void) = 0;
+      virtual size_t estimated_bytes(void) = 0;
+
       enum State {
 	STATE_INIT,
 	STATE_METADATA_FETCH,
@@ -154,6 +186,9 @@ namespace LegionRuntime {
 
       virtual bool handler_safe(void) { return(false); }
 
+      virtual MemPair memory_pair(void);
+      virtual size_t estimated_bytes(void);
+
       Domain domain;
       OASByInst *oas_by_inst;
       Event before_copy;
@@ -194,6 +229,9 @@ namespace LegionRuntime {
 
       virtual bool handler_safe(void) { return(false); }
 
+      virtual MemPair memory_pair(void);
+      virtual size_t estimated_bytes(void);
+
       Domain domain;
       std::vector<Domain::CopySrcDstField> srcs;
       Domain::CopySrcDstField dst;
@@ -205,10 +243,12 @@ namespace LegionRuntime {
       Waiter waiter; // if we need to wait on events
     };
 
-    DmaRequestQueue::DmaRequestQueue(void)
+    DmaRequestQueue::DmaRequestQueue(size_t _small_copy_bytes)
+      : small_copy_bytes(_small_copy_bytes)
     {
       gasnet_hsl_init(&queue_mutex);
       gasnett_cond_init(&queue_condvar);
+      num_queued = 0;
       queue_sleepers = 0;
       shutdown_flag = false;
     }
@@ -217,7 +257,7 @@ namespace LegionRuntime {
     {
       gasnet_hsl_lock(&queue_mutex);
 
-      assert(queues.empty());
+      assert(num_queued == 0);
 
       // set the shutdown flag and wake up any sleepers
       shutdown_flag = true;
@@ -229,21 +269,24 @@ namespace LegionRuntime {
 
     void DmaRequestQueue::enqueue_request(DmaRequest *r)
     {
-      gasnet_hsl_lock(&queue_mutex);
-
-      // there's a queue per priority level
+      // figure out where this goes before we take the lock
+      MemPair pair = r->memory_pair();
+      bool is_small = (r->estimated_bytes() <= small_copy_bytes);
       // priorities are negated so that the highest logical priority comes first
       int p = -r->priority;
-      std::map<int, std::list<DmaRequest *> *>::iterator it = queues.find(p);
-      if(it == queues.end()) {
-	// nothing at this priority level - make a new list
-	std::list<DmaRequest *> *l = new std::list<DmaRequest *>;
-	l->push_back(r);
-	queues[p] = l;
-      } else {
-	// push ourselves onto the back of the existing queue
-	it->second->push_back(r);
+
+      gasnet_hsl_lock(&queue_mutex);
+
+      PairQueue& pq = pair_queues[pair];
+      if(is_small)
+	pq.small_reqs[p].push_back(r);
+      else
+	pq.large_reqs[p].push_back(r);
+      if(!pq.active) {
+	pq.active = true;
+	active_pairs.push_back(&pq);
       }
+      num_queued++;
 
       // if anybody was sleeping, wake them up
       if(queue_sleepers > 0) {
@@ -254,12 +297,55 @@ namespace LegionRuntime {
       gasnet_hsl_unlock(&queue_mutex);
     }
 
+    int DmaRequestQueue::PairQueue::best_priority(void) const
+    {
+      // remember these are negated priorities, so smaller is better
+      int p = INT_MAX;
+      if(!small_reqs.empty()) p = small_reqs.begin()->first;
+      if(!large_reqs.empty() && (large_reqs.begin()->first < p))
+	p = large_reqs.begin()->first;
+      return p;
+    }
+
+    /*static*/ DmaRequest *DmaRequestQueue::pop_front(std::map<int, std::deque<DmaRequest *> >& reqs)
+    {
+      std::map<int, std::deque<DmaRequest *> >::iterator it = reqs.begin();
+      assert(!it->second.empty());
+      DmaRequest *r = it->second.front();
+      it->second.pop_front();
+      // if queue is empty, delete from list
+      if(it->second.empty())
+	reqs.erase(it);
+      return r;
+    }
+
+    DmaRequest *DmaRequestQueue::PairQueue::pop(void)
+    {
+      if(large_reqs.empty())
+	return pop_front(small_reqs);
+      if(small_reqs.empty()) {
+	bypass_count = 0;
+	return pop_front(large_reqs);
+      }
+
+      int p_small = small_reqs.begin()->first;
+      int p_large = large_reqs.begin()->first;
+      if(p_small < p_large)
+	return pop_front(small_reqs);
+      if((p_small == p_large) && (bypass_count < MAX_SMALL_BYPASS)) {
+	bypass_count++;
+	return pop_front(small_reqs);
+      }
+      bypass_count = 0;
+      return pop_front(large_reqs);
+    }
+
     DmaRequest *DmaRequestQueue::dequeue_request(bool sleep /*= true*/)
     {
       gasnet_hsl_lock(&queue_mutex);
 
       // quick check - are there any requests at all?
-      while(queues.empty()) {
+      while(num_queued == 0) {
 	if(!sleep || shutdown_flag) {
 	  gasnet_hsl_unlock(&queue_mutex);
 	  return 0;
@@ -270,18 +356,32 @@ namespace LegionRuntime {
 	gasnett_cond_wait(&queue_condvar, &queue_mutex.lock);
       }
 
-      // grab the first request from the highest-priority queue there is
-      // priorities are negated so that the highest logical priority comes first
-      std::map<int, std::list<DmaRequest *> *>::iterator it = queues.begin();
-      assert(!it->second->empty());
-      DmaRequest *r = it->second->front();
-      it->second->pop_front();
-      // if queue is empty, delete from list
-      if(it->second->empty()) {
-	delete it->second;
-	queues.erase(it);
+      // pick the memory pair with the highest-priority request - ties go
+      //  to whichever pair has waited longest for a turn
+      std::list<PairQueue *>::iterator best = active_pairs.begin();
+      assert(best != active_pairs.end());
+      int best_p = (*best)->best_priority();
+      for(std::list<PairQueue *>::iterator it = active_pairs.begin();
+	  it != active_pairs.end();
+	  it++) {
+	int p = (*it)->best_priority();
+	if(p < best_p) {
+	  best = it;
+	  best_p = p;
+	}
       }
 
+      PairQueue *pq = *best;
+      DmaRequest *r = pq->pop();
+      num_queued--;
+
+      // this pair goes to the back of the line (if it has anything left)
+      active_pairs.erase(best);
+      if(pq->empty())
+	pq->active = false;
+      else
+	active_pairs.push_back(pq);
+
       gasnet_hsl_unlock(&queue_mutex);
       
       return r;
@@ -441,6 +541,23 @@ namespace LegionRuntime {
 	      req, req->after_copy.id, req->after_copy.gen);
     }
 
+    MemPair CopyRequest::memory_pair(void)
+    {
+      // copy requests are built per memory pair, so any instance pair will do
+      OASByInst::const_iterator it = oas_by_inst->begin();
+      return MemPair(it->first.first.impl()->memory,
+		     it->first.second.impl()->memory);
+    }
+
+    size_t CopyRequest::estimated_bytes(void)
+    {
+      size_t bytes_per_element = 0;
+      for(OASByInst::const_iterator it = oas_by_inst->begin(); it != oas_by_inst->end(); it++)
+	for(OASVec::const_iterator it2 = it->second.begin(); it2 != it->second.end(); it2++)
+	  bytes_per_element += it2->size;
+      return bytes_per_element * domain.get_volume();
+    }
+
     bool CopyRequest::check_readiness(bool just_check, DmaRequestQueue *rq)
     {
       if(state == STATE_INIT)
@@ -1069,6 +1186,10 @@ namespace LegionRuntime {
 
       virtual ~SpanBasedInstPairCopier(void) { }
 
+      // working set size for the per-field passes of a transposing copy
+      static const size_t TRANSPOSE_TILE_BYTES = 32768;
+      static const int MIN_TRANSPOSE_TILE = 16;
+
       virtual void copy_field(int src_index, int dst_index, int elem_count,
                               unsigned offset_index)
       {
@@ -1091,11 +1212,21 @@ namespace LegionRuntime {
 	// if both source and dest fill up an entire field, we might be able to copy whole ranges at the same time
 	if((src_field_start == src_offset) && (src_field_size == bytes) &&
 	   (dst_field_start == dst_offset) && (dst_field_size == bytes)) {
-	  // let's see how many we can copy
+	  // within a block, consecutive elements of a field are 'bytes' apart,
+	  //  but with a block size of 1 (i.e. AOS) they're a whole element
+	  //  apart and there's no block boundary to stop at - when the two
+	  //  strides differ, we're transposing and hand the span copier a
+	  //  2D copy with one element per line
+	  off_t src_estride = ((src_idata->block_size == 1) ? src_idata->elmt_size : bytes);
+	  off_t dst_estride = ((dst_idata->block_size == 1) ? dst_idata->elmt_size : bytes);
 	  int done = 0;
 	  while(done < elem_count) {
-	    int src_in_this_block = src_idata->block_size - ((src_index + done) % src_idata->block_size);
-	    int dst_in_this_block = dst_idata->block_size - ((dst_index + done) % dst_idata->block_size);
+	    int src_in_this_block = ((src_idata->block_size == 1) ?
+				       (elem_count - done) :
+				       (src_idata->block_size - ((src_index + done) % src_idata->block_size)));
+	    int dst_in_this_block = ((dst_idata->block_size == 1) ?
+				       (elem_count - done) :
+				       (dst_idata->block_size - ((dst_index + done) % dst_idata->block_size)));
 	    int todo = min(elem_count - done, min(src_in_this_block, dst_in_this_block));
 
 	    //printf("copying range of %d elements (%d, %d, %d)\n", todo, src_index, dst_index, done);
@@ -1107,20 +1238,25 @@ namespace LegionRuntime {
 					   dst_field_start, dst_field_size, dst_idata->elmt_size,
 					   dst_idata->block_size, dst_index + done);
 
-	    // sanity check that the range we calculated really is contiguous
+	    // sanity check that the range we calculated really is evenly strided
 	    assert(calc_mem_loc(src_idata->alloc_offset + (src_offset - src_field_start),
 				src_field_start, src_field_size, src_idata->elmt_size,
 				src_idata->block_size, src_index + done + todo - 1) == 
-		   (src_start + (todo - 1) * bytes));
+		   (src_start + (todo - 1) * src_estride));
 	    assert(calc_mem_loc(dst_idata->alloc_offset + (dst_offset - dst_field_start),
 				dst_field_start, dst_field_size, dst_idata->elmt_size,
 				dst_idata->block_size, dst_index + done + todo - 1) == 
-		   (dst_start + (todo - 1) * bytes));
+		   (dst_start + (todo - 1) * dst_estride));
 
 #ifdef NEW2D_DEBUG
-	    printf("ZZZ: %zd %zd %d\n", src_start, dst_start, bytes * todo);
+	    printf("ZZZ: %zd %zd %d (%zd %zd)\n", src_start, dst_start, bytes * todo,
+		   src_estride, dst_estride);
 #endif
-	    span_copier->copy_span(src_start, dst_start, bytes * todo);
+	    if((todo == 1) || ((src_estride == bytes) && (dst_estride == bytes)))
+	      span_copier->copy_span(src_start, dst_start, bytes * todo);
+	    else
+	      span_copier->copy_span(src_start, dst_start, bytes,
+				     src_estride, dst_estride, todo);
 	    //src_mem->get_bytes(src_start, buffer, bytes * todo);
 	    //dst_mem->put_bytes(dst_start, buffer, bytes * todo);
 
@@ -1146,6 +1282,24 @@ namespace LegionRuntime {
 	}
       }
 
+      // copies each field separately, but a tile of elements at a time so
+      //  that the element-major side (e.g. an AOS instance) stays in cache
+      //  while we go through its fields
+      void copy_fields_tiled(int src_index, int dst_index, int elem_count,
+			     size_t src_elmt_size, size_t dst_elmt_size)
+      {
+	size_t max_elmt_size = ((src_elmt_size > dst_elmt_size) ? 
+				  src_elmt_size : dst_elmt_size);
+	int tile = (max_elmt_size > 0) ? (int)(TRANSPOSE_TILE_BYTES / max_elmt_size) : elem_count;
+	if((tile < MIN_TRANSPOSE_TILE) || (oas_vec.size() == 1))
+	  tile = elem_count;
+	for(int done = 0; done < elem_count; done += tile) {
+	  int todo = min(tile, elem_count - done);
+	  for(unsigned i = 0; i < oas_vec.size(); i++)
+	    copy_field(src_index + done, dst_index + done, todo, i);
+	}
+      }
+
       virtual void copy_all_fields(int src_index, int dst_index, int elem_count)
       {
 	// first check - if the span we're copying straddles a block boundary
@@ -1159,9 +1313,9 @@ namespace LegionRuntime {
 	if(((src_bsize == 1) != (dst_bsize == 1)) ||
 	   ((src_bsize > 1) && ((src_index / src_bsize) != ((src_index + elem_count - 1) / src_bsize))) ||
 	   ((dst_bsize > 1) && ((dst_index / dst_bsize) != ((dst_index + elem_count - 1) / dst_bsize)))) {
-	  printf("copy straddles block boundaries - falling back\n");
-	  for(unsigned i = 0; i < oas_vec.size(); i++)
-	    copy_field(src_index, dst_index, elem_count, i);
+	  log_dma.debug("copy straddles block boundaries - transposing by field");
+	  copy_fields_tiled(src_index, dst_index, elem_count,
+			    src_idata->elmt_size, dst_idata->elmt_size);
 	  return;
 	}
 
@@ -1182,7 +1336,7 @@ namespace LegionRuntime {
 	  int dst_field_size = dst_size[field_idx];
 
 	  if(partial_field[field_idx]) {
-	    printf("not a full field - falling back\n");
+	    log_dma.debug("not a full field - falling back");
 	    copy_field(src_index, dst_index, elem_count, field_idx);
 	    field_idx++;
 	    continue;
@@ -1283,11 +1437,11 @@ namespace LegionRuntime {
 	if(((src_bsize == 1) != (dst_bsize == 1)) ||
 	   ((src_bsize > 1) && ((src_index / src_bsize) != (src_last / src_bsize))) ||
 	   ((dst_bsize > 1) && ((dst_index / dst_bsize) != (dst_last / dst_bsize)))) {
-	  printf("copy straddles block boundaries - falling back\n");
-	  for(unsigned i = 0; i < oas_vec.size(); i++)
-	    for(int l = 0; l < lines; l++)
-	      copy_field(src_index + l * src_stride, 
-			 dst_index + l * dst_stride, count_per_line, i);
+	  log_dma.debug("copy straddles block boundaries - transposing by field");
+	  for(int l = 0; l < lines; l++)
+	    copy_fields_tiled(src_index + l * src_stride, 
+			      dst_index + l * dst_stride, count_per_line,
+			      src_idata->elmt_size, dst_idata->elmt_size);
 	  return;
 	}
 
@@ -1308,7 +1462,7 @@ namespace LegionRuntime {
 	  int dst_field_size = dst_size[field_idx];
 
 	  if(partial_field[field_idx]) {
-	    printf("not a full field - falling back\n");
+	    log_dma.debug("not a full field - falling back");
 	    copy_field(src_index, dst_index, count_per_line, field_idx);
 	    field_idx++;
 	    continue;
@@ -1596,14 +1750,56 @@ namespace LegionRuntime {
 #endif
       }
 
-      // default behavior of 2D copy is to unroll to 1D copies
+      // short lines come from transposing copies (one element per line), so
+      //  the common element sizes get a fixed-size move the compiler can
+      //  turn into a single load/store instead of a memcpy call per element
+      template <size_t BYTES>
+      static void copy_lines(char *dst, const char *src,
+			     off_t src_stride, off_t dst_stride, size_t lines)
+      {
+	while(lines >= 4) {
+	  memcpy(dst, src, BYTES);
+	  memcpy(dst + dst_stride, src + src_stride, BYTES);
+	  memcpy(dst + 2 * dst_stride, src + 2 * src_stride, BYTES);
+	  memcpy(dst + 3 * dst_stride, src + 3 * src_stride, BYTES);
+	  src += 4 * src_stride;
+	  dst += 4 * dst_stride;
+	  lines -= 4;
+	}
+	while(lines-- > 0) {
+	  memcpy(dst, src, BYTES);
+	  src += src_stride;
+	  dst += dst_stride;
+	}
+      }
+
       void copy_span(off_t src_offset, off_t dst_offset, size_t bytes,
 		     off_t src_stride, off_t dst_stride, size_t lines)
       {
-	while(lines-- > 0) {
-	  copy_span(src_offset, dst_offset, bytes);
-	  src_offset += src_stride;
-	  dst_offset += dst_stride;
+	if((src_stride == (off_t)bytes) && (dst_stride == (off_t)bytes)) {
+	  copy_span(src_offset, dst_offset, bytes * lines);
+	  return;
+	}
+
+#ifdef EVENT_GRAPH_TRACE
+        record_bytes(bytes * lines);
+#endif
+	char *dst = dst_base + dst_offset;
+	const char *src = src_base + src_offset;
+	switch(bytes) {
+	case 1: copy_lines<1>(dst, src, src_stride, dst_stride, lines); break;
+	case 2: copy_lines<2>(dst, src, src_stride, dst_stride, lines); break;
+	case 4: copy_lines<4>(dst, src, src_stride, dst_stride, lines); break;
+	case 8: copy_lines<8>(dst, src, src_stride, dst_stride, lines); break;
+	case 12: copy_lines<12>(dst, src, src_stride, dst_stride, lines); break;
+	case 16: copy_lines<16>(dst, src, src_stride, dst_stride, lines); break;
+	case 32: copy_lines<32>(dst, src, src_stride, dst_stride, lines); break;
+	default:
+	  while(lines-- > 0) {
+	    memcpy(dst, src, bytes);
+	    src += src_stride;
+	    dst += dst_stride;
+	  }
 	}
       }
 
@@ -1659,10 +1855,10 @@ namespace LegionRuntime {
 	if(bytes == redop->sizeof_rhs) {
 	  if(fold)
 	    redop->fold_strided(dst_base + dst_offset, src_base + src_offset,
-				src_stride, dst_stride, lines, false /*non-exclusive*/);
+				dst_stride, src_stride, lines, false /*non-exclusive*/);
 	  else
 	    redop->apply_strided(dst_base + dst_offset, src_base + src_offset,
-				 src_stride, dst_stride, lines, false /*non-exclusive*/);
+				 dst_stride, src_stride, lines, false /*non-exclusive*/);
 	  return;
 	}
 
@@ -3073,6 +3269,17 @@ namespace LegionRuntime {
       return msglen;
     }
 
+    MemPair ReduceRequest::memory_pair(void)
+    {
+      return MemPair(srcs[0].inst.impl()->memory, dst.inst.impl()->memory);
+    }
+
+    size_t ReduceRequest::estimated_bytes(void)
+    {
+      const ReductionOpUntyped *redop = reduce_op_table[redop_id];
+      return redop->sizeof_rhs * domain.get_volume();
+    }
+
     bool ReduceRequest::check_readiness(bool just_check, DmaRequestQueue *rq)
     {
       if(state == STATE_INIT)
@@ -3583,7 +3790,7 @@ namespace LegionRuntime {
     static int num_threads = 0;
     static pthread_t *worker_threads = 0;
 
-    // for now we use a single queue for all (local) dmas
+    // a single queue (with per-memory-pair lists inside) for all (local) dmas
     static DmaRequestQueue *dma_queue = 0;
     
     static void *dma_worker_thread_loop(void *arg)
@@ -3597,7 +3804,11 @@ namespace LegionRuntime {
 	DmaRequest *r = rq->dequeue_request(true);
 
 	if(r) {
-	  r->perform_dma();
+	  Metrics::record(Metrics::METRIC_DMA_BYTES, r->estimated_bytes());
+	  {
+	    Metrics::ScopedTimer timer(Metrics::METRIC_DMA_TIME);
+	    r->perform_dma();
+	  }
 	  delete r;
 	}
       }
@@ -3607,18 +3818,20 @@ namespace LegionRuntime {
       return 0;
     }
     
-    void start_dma_worker_threads(int count)
+    void start_dma_worker_threads(int count, size_t small_copy_bytes)
     {
-      dma_queue = new DmaRequestQueue;
+      dma_queue = new DmaRequestQueue(small_copy_bytes);
       num_threads = count;
 
       worker_threads = new pthread_t[count];
       for(int i = 0; i < count; i++) {
 	pthread_attr_t attr;
 	CHECK_PTHREAD( pthread_attr_init(&attr) );
+	// spread the workers across the NUMA domains so each socket has
+	//  somebody close by to do its copies
 	if(proc_assignment)
-	  proc_assignment->bind_thread(-1, &attr, "DMA worker");
-	CHECK_PTHREAD( pthread_create(&worker_threads[i], 0, 
+	  proc_assignment->bind_thread_to_numa_domain(i, &attr, "DMA worker");
+	CHECK_PTHREAD( pthread_create(&worker_threads[i], &attr, 
 				      dma_worker_thread_loop, dma_queue) );
 	CHECK_PTHREAD( pthread_attr_destroy(&attr) );
 #ifdef DEADLOCK_TRACE
@@ -40,7 +40,8 @@ namespace LegionRuntime {
 
     extern void init_dma_handler(void);
 
-    extern void start_dma_worker_threads(int count);
+    // copies of at most 'small_copy_bytes' can bypass larger ones
+    extern void start_dma_worker_threads(int count, size_t small_copy_bytes);
     extern void stop_dma_worker_threads(void);
 
     /*
@@ -1321,7 +1321,7 @@ namespace LegionRuntime {
 	gpu(_gpu)
     {
       base = (char *)(gpu->get_fbmem_gpu_base());
-      free_blocks[0] = size;
+      init_allocator();
     }
 
     GPUFBMemory::~GPUFBMemory(void) {}
@@ -1350,7 +1350,7 @@ namespace LegionRuntime {
 	gpu(_gpu)
     {
       cpu_base = (char *)(gpu->get_zcmem_cpu_base());
-      free_blocks[0] = size;
+      init_allocator();
     }
 
     GPUZCMemory::~GPUZCMemory(void) {}
@@ -29,6 +29,8 @@
 #endif
 
 #include "lowlevel.h"
+#include "lowlevel_queue.h"
+#include "lowlevel_alloc.h"
 
 #include <assert.h>
 
@@ -43,6 +45,7 @@ GASNETT_THREADKEY_DECLARE(cur_thread);
 
 #include <pthread.h>
 #include <string.h>
+#include <limits.h>
 
 #include <vector>
 #include <deque>
@@ -599,6 +602,7 @@ namespace LegionRuntime {
 
       // creates an event that won't trigger until all input events have
       static Event merge_events(const std::set<Event>& wait_for);
+      static Event merge_events(const Event *wait_for, size_t num_events);
       static Event merge_events(Event ev1, Event ev2,
 				Event ev3 = NO_EVENT, Event ev4 = NO_EVENT,
 				Event ev5 = NO_EVENT, Event ev6 = NO_EVENT);
@@ -614,19 +618,34 @@ namespace LegionRuntime {
 
       class EventWaiter {
       public:
-        EventWaiter(void) { }
+        EventWaiter(void) : next_waiter(0), wait_gen(0) { }
         virtual ~EventWaiter(void) { }
       public:
 	virtual bool event_triggered(void) = 0;
 	virtual void print_info(FILE *f) = 0;
+      public:
+        // waiters are linked directly into an event's waiter list, so a
+        //  waiter can only be waiting on one event at a time
+        EventWaiter *next_waiter;
+        Event::gen_t wait_gen;
       };
 
       void add_waiter(Event event, EventWaiter *waiter, bool pre_subscribed = false);
 
+    protected:
+      // lock-free push of a chain of waiters onto the waiter list
+      void push_waiters(EventWaiter *first, EventWaiter *last);
+
+      // takes the whole waiter list, notifies everybody whose generation
+      //  has triggered, and puts the rest back
+      void wake_ready_waiters(void);
+
     public: //protected:
       Event me;
       unsigned owner;
-      Event::gen_t generation, gen_subscribed, free_generation;
+      // generation is read without the mutex by has_triggered and add_waiter
+      volatile Event::gen_t generation;
+      Event::gen_t gen_subscribed, free_generation;
       Event::Impl *next_free;
       //static Event::Impl *first_free;
       //static gasnet_hsl_t freelist_mutex;
@@ -634,7 +653,9 @@ namespace LegionRuntime {
       gasnet_hsl_t *mutex; // controls which local thread has access to internal data (not runtime-visible event)
 
       std::map<Event::gen_t,NodeMask> remote_waiters;
-      std::map<Event::gen_t, std::vector<EventWaiter *> > local_waiters; // set of local threads that are waiting on event (keyed by generation)
+      // local waiters (on any generation) - updated only with atomics, so
+      //  neither adding a waiter nor triggering needs the mutex or allocates
+      EventWaiter * volatile local_waiters;
 
       // for barriers
       unsigned base_arrival_count, current_arrival_count;
@@ -804,6 +825,19 @@ namespace LegionRuntime {
       // binds a thread to the right set of cores based (-1 = not a local proc)
       void bind_thread(int core_id, pthread_attr_t *attr, const char *debug_name = 0);
 
+      // binds a helper thread to the leftover cores of one NUMA domain
+      //  (domains are chosen round-robin, so any index is fine)
+      void bind_thread_to_numa_domain(int domain, pthread_attr_t *attr,
+				      const char *debug_name = 0);
+
+      int num_numa_domains(void) const { return numa_leftover_procs.size(); }
+
+      // NUMA domains that local procs were bound to, and the domain each
+      //  local proc ended up in (-1 if binding is disabled)
+      int num_memory_domains(void) const { return valid ? numa_node_ids.size() : 0; }
+      int get_numa_node(int domain) const { return numa_node_ids[domain]; }
+      int get_proc_domain(int core_id) const;
+
     protected:
       // physical configuration of processors
       typedef std::map<int, std::vector<int> > NodeProcMap;
@@ -812,7 +846,10 @@ namespace LegionRuntime {
       int num_local_procs;
       bool valid;
       std::vector<int> local_proc_assignments;
+      std::vector<int> local_proc_domains;
+      std::vector<int> numa_node_ids;
       cpu_set_t leftover_procs;
+      std::vector<cpu_set_t> numa_leftover_procs;
     };
     extern ProcessorAssignment *proc_assignment;
 
@@ -863,6 +900,13 @@ namespace LegionRuntime {
 			      Event start_event, Event finish_event,
                               int priority) = 0;
 
+      // default gathers the spans into one buffer - remote processors
+      //  hand them to the active message layer instead
+      virtual void spawn_task(Processor::TaskFuncID func_id,
+			      const SpanList& arg_spans, size_t arglen,
+			      Event start_event, Event finish_event,
+                              int priority);
+
       void finished(void)
       {
 	if(run_counter)
@@ -875,69 +919,33 @@ namespace LegionRuntime {
       virtual void disable_idle_task(void) { assert(0); }
       virtual bool is_idle_task_enabled(void) { return(false); }
 
+      // processors that return true here will pull tasks for any groups
+      //  they belong to out of the group's shared queue when they run
+      //  out of their own work, otherwise the group will enqueue a copy
+      //  of every task directly on the processor
+      virtual bool can_steal_group_tasks(void) const { return false; }
+
+      // returns false if the processor is already in too many groups
+      bool add_to_group(ProcessorGroup *group);
+
+      // try to take a ready task from one of our groups
+      Task *steal_group_task(void);
+      bool has_group_tasks(void);
+
+      static const int MAX_GROUPS_PER_PROC = 16;
+
     public:
       Processor me;
       Processor::Kind kind;
       Processor util;
       UtilityProcessor *util_proc;
       Atomic<int> *run_counter;
+      // slots are filled in before num_groups is bumped, so readers
+      //  never need a lock
+      ProcessorGroup *groups[MAX_GROUPS_PER_PROC];
+      volatile int num_groups;
     }; 
 
-    // generic way of keeping a prioritized queue of stuff to do
-    // Needs to be protected by owner lock
-    template <typename JOBTYPE>
-    class JobQueue {
-    public:
-      JobQueue(void);
-
-      bool empty(void) const;
-
-      void insert(JOBTYPE *job, int priority);
-
-      JOBTYPE *pop(void);
-
-      std::map<int, std::deque<JOBTYPE*> > ready;
-    };
-
-    template <typename JOBTYPE>
-    JobQueue<JOBTYPE>::JobQueue(void)
-    {
-    }
-
-    template<typename JOBTYPES>
-    bool JobQueue<JOBTYPES>::empty(void) const
-    {
-      return ready.empty();
-    }
-
-    template <typename JOBTYPE>
-    void JobQueue<JOBTYPE>::insert(JOBTYPE *job, int priority)
-    {
-      std::deque<JOBTYPE *>& dq = ready[-priority];
-      dq.push_back(job);
-    }
-
-    template <typename JOBTYPE>
-    JOBTYPE *JobQueue<JOBTYPE>::pop(void)
-    {
-      if(ready.empty()) return 0;
-
-      // get the sublist with the highest priority (remember, we negate before lookup)
-      typename std::map<int, std::deque<JOBTYPE *> >::iterator it = ready.begin();
-
-      // any deque that's present better be non-empty
-      assert(!(it->second.empty()));
-      JOBTYPE *job = it->second.front();
-      it->second.pop_front();
-
-      // if the list is now empty, remove it and update the new max priority
-      if(it->second.empty()) {
-	ready.erase(it);
-      }
-
-      return job;
-    }
-
     class ProcessorGroup : public Processor::Impl {
     public:
       ProcessorGroup(void);
@@ -966,6 +974,10 @@ namespace LegionRuntime {
       bool members_valid;
       bool members_requested;
       std::vector<Processor::Impl *> members;
+      // members that pull tasks from our queue vs. ones that need a copy
+      std::vector<Processor::Impl *> stealing_members;
+      std::vector<Processor::Impl *> replicated_members;
+      LockFreeJobQueue<Task> task_queue;
       Reservation::Impl lock;
       ProcessorGroup *next_free;
 
@@ -1038,6 +1050,8 @@ namespace LegionRuntime {
       void enable_idle_task(Processor::Impl *proc);
       void disable_idle_task(Processor::Impl *proc);
 
+      virtual bool can_steal_group_tasks(void) const { return true; }
+
       void wait_for_shutdown(void);
 
       class UtilityThread;
@@ -1059,7 +1073,10 @@ namespace LegionRuntime {
 
       std::set<UtilityThread *> threads;
 
-      JobQueue<Task> task_queue;
+      // producers don't need the mutex to add tasks - they only take it
+      //  to signal the condvar when a worker thread might be asleep
+      LockFreeJobQueue<Task> task_queue;
+      volatile int sleeping_threads;
 
       std::set<Processor::Impl *> idle_procs;
       std::set<Processor::Impl *> procs_in_idle_task;
@@ -1079,11 +1096,22 @@ namespace LegionRuntime {
       };
 
     Impl(Memory _me, size_t _size, MemoryKind _kind, size_t _alignment, Kind _lowlevel_kind)
-      : me(_me), size(_size), kind(_kind), alignment(_alignment), lowlevel_kind(_lowlevel_kind)
+      : me(_me), size(_size), kind(_kind), alignment(_alignment), lowlevel_kind(_lowlevel_kind),
+        allocator(0)
       {
 	gasnet_hsl_init(&mutex);
       }
 
+      virtual ~Impl(void)
+      {
+        if(allocator)
+          delete allocator;
+      }
+
+      // called once the size of the memory is known - memories that can
+      //  allocate locally must call this before anything is allocated
+      void init_allocator(void);
+
       unsigned add_instance(RegionInstance::Impl *i);
 
       RegionInstance::Impl *get_instance(RegionInstance i);
@@ -1147,6 +1175,9 @@ namespace LegionRuntime {
 
       Memory::Kind get_kind(void) const;
 
+      // returns false if allocations for this memory aren't done here
+      bool get_alloc_stats(Machine::MemoryAllocStats& stats);
+
     public:
       Memory me;
       size_t size;
@@ -1155,7 +1186,7 @@ namespace LegionRuntime {
       Kind lowlevel_kind;
       gasnet_hsl_t mutex; // protection for resizing vectors
       std::vector<RegionInstance::Impl *> instances;
-      std::map<off_t, off_t> free_blocks;
+      MemoryAllocator *allocator;
     };
 
     class GASNetMemory : public Memory::Impl {
@@ -1205,7 +1236,6 @@ namespace LegionRuntime {
       int num_nodes;
       off_t memory_stride;
       gasnet_seginfo_t *seginfos;
-      //std::map<off_t, off_t> free_blocks;
     };
 
     class RegionInstance::Impl {
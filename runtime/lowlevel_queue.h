@@ -0,0 +1,335 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOWLEVEL_QUEUE_H
+#define LOWLEVEL_QUEUE_H
+
+// Job queues used by the low-level processors.  These only depend on
+//  pthreads so they can be built and measured outside of the runtime
+//  (see apps/benchmarks/job_queue).
+
+#include "utilities.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <sys/types.h>
+
+#include <deque>
+#include <map>
+
+namespace LegionRuntime {
+  namespace LowLevel {
+
+    // generic way of keeping a prioritized queue of stuff to do
+    // Needs to be protected by owner lock
+    template <typename JOBTYPE>
+    class JobQueue {
+    public:
+      JobQueue(void);
+
+      bool empty(void) const;
+
+      void insert(JOBTYPE *job, int priority);
+
+      JOBTYPE *pop(void);
+
+      std::map<int, std::deque<JOBTYPE*> > ready;
+    };
+
+    template <typename JOBTYPE>
+    JobQueue<JOBTYPE>::JobQueue(void)
+    {
+    }
+
+    template<typename JOBTYPES>
+    bool JobQueue<JOBTYPES>::empty(void) const
+    {
+      return ready.empty();
+    }
+
+    template <typename JOBTYPE>
+    void JobQueue<JOBTYPE>::insert(JOBTYPE *job, int priority)
+    {
+      std::deque<JOBTYPE *>& dq = ready[-priority];
+      dq.push_back(job);
+    }
+
+    template <typename JOBTYPE>
+    JOBTYPE *JobQueue<JOBTYPE>::pop(void)
+    {
+      if(ready.empty()) return 0;
+
+      // get the sublist with the highest priority (remember, we negate before lookup)
+      typename std::map<int, std::deque<JOBTYPE *> >::iterator it = ready.begin();
+
+      // any deque that's present better be non-empty
+      assert(!(it->second.empty()));
+      JOBTYPE *job = it->second.front();
+      it->second.pop_front();
+
+      // if the list is now empty, remove it and update the new max priority
+      if(it->second.empty()) {
+	ready.erase(it);
+      }
+
+      return job;
+    }
+
+    // lock-free version of the JobQueue above that can be used without
+    //  holding the owner's lock - each priority in [0, NUM_BUCKETS) gets
+    //  its own bounded multi-producer/multi-consumer ring, and any other
+    //  priority goes into a JobQueue protected by a private lock
+    //
+    // jobs of the same priority still come out in FIFO order: when a ring
+    //  fills up its jobs spill into a list behind the private lock, and
+    //  new jobs of that priority keep going to the spill list until it has
+    //  drained, so everything in the ring is always older than everything
+    //  in the spill list (only jobs whose inserts overlap in time can be
+    //  reordered, just as they can race for the owner's lock)
+    template <typename JOBTYPE>
+    class LockFreeJobQueue {
+    public:
+      static const int NUM_BUCKETS = 4;
+      static const size_t BUCKET_SIZE = 1024; // must be a power of 2
+
+      LockFreeJobQueue(void);
+      ~LockFreeJobQueue(void);
+
+      bool empty(void) const;
+
+      void insert(JOBTYPE *job, int priority);
+
+      JOBTYPE *pop(void);
+
+    protected:
+      struct Slot {
+        volatile size_t sequence;
+        JOBTYPE *job;
+      };
+
+      // bounded queue in the style of Vyukov - every slot carries a
+      //  sequence number that tells producers and consumers whose turn it
+      //  is, so the only synchronization is a CAS on the position counters
+      struct Bucket {
+      public:
+        void init(void);
+        bool empty(void) const;
+        bool push(JOBTYPE *job);
+        JOBTYPE *pop(void);
+      protected:
+        volatile size_t enqueue_pos;
+        char pad1[64 - sizeof(size_t)]; // keep producers and consumers
+        volatile size_t dequeue_pos;    //  on separate cache lines
+        char pad2[64 - sizeof(size_t)];
+        Slot slots[BUCKET_SIZE];
+      };
+
+      // returns the highest priority in the overflow queue, or INT_MIN
+      int overflow_priority(void);
+      JOBTYPE *pop_overflow(void);
+      JOBTYPE *pop_spill(int bucket);
+
+      Bucket buckets[NUM_BUCKETS];
+      ImmovableLock overflow_lock;
+      // jobs for priorities that don't have a bucket
+      JobQueue<JOBTYPE> overflow;
+      volatile int overflow_count;
+      // jobs that didn't fit in their bucket's ring, in insertion order
+      std::deque<JOBTYPE*> spills[NUM_BUCKETS];
+      volatile int spill_counts[NUM_BUCKETS];
+    };
+
+    template <typename JOBTYPE>
+    void LockFreeJobQueue<JOBTYPE>::Bucket::init(void)
+    {
+      for(size_t i = 0; i < BUCKET_SIZE; i++) {
+        slots[i].sequence = i;
+        slots[i].job = 0;
+      }
+      enqueue_pos = 0;
+      dequeue_pos = 0;
+    }
+
+    template <typename JOBTYPE>
+    bool LockFreeJobQueue<JOBTYPE>::Bucket::empty(void) const
+    {
+      return (dequeue_pos == enqueue_pos);
+    }
+
+    template <typename JOBTYPE>
+    bool LockFreeJobQueue<JOBTYPE>::Bucket::push(JOBTYPE *job)
+    {
+      size_t pos = enqueue_pos;
+      while(1) {
+        Slot *slot = &slots[pos & (BUCKET_SIZE - 1)];
+        size_t seq = slot->sequence;
+        ssize_t diff = (ssize_t)seq - (ssize_t)pos;
+        if(diff == 0) {
+          // slot is free for this position - try to claim it
+          if(__sync_bool_compare_and_swap(&enqueue_pos, pos, pos + 1)) {
+            slot->job = job;
+            __sync_synchronize();
+            slot->sequence = pos + 1;
+            return true;
+          }
+          pos = enqueue_pos;
+        } else if(diff < 0) {
+          // ring is full
+          return false;
+        } else
+          pos = enqueue_pos;
+      }
+    }
+
+    template <typename JOBTYPE>
+    JOBTYPE *LockFreeJobQueue<JOBTYPE>::Bucket::pop(void)
+    {
+      size_t pos = dequeue_pos;
+      while(1) {
+        Slot *slot = &slots[pos & (BUCKET_SIZE - 1)];
+        size_t seq = slot->sequence;
+        ssize_t diff = (ssize_t)seq - (ssize_t)(pos + 1);
+        if(diff == 0) {
+          if(__sync_bool_compare_and_swap(&dequeue_pos, pos, pos + 1)) {
+            JOBTYPE *job = slot->job;
+            __sync_synchronize();
+            // hand the slot back to producers for the next lap
+            slot->sequence = pos + BUCKET_SIZE;
+            return job;
+          }
+          pos = dequeue_pos;
+        } else if(diff < 0) {
+          // ring is empty
+          return 0;
+        } else
+          pos = dequeue_pos;
+      }
+    }
+
+    template <typename JOBTYPE>
+    LockFreeJobQueue<JOBTYPE>::LockFreeJobQueue(void)
+      : overflow_lock(true), overflow_count(0)
+    {
+      for(int i = 0; i < NUM_BUCKETS; i++) {
+        buckets[i].init();
+        spill_counts[i] = 0;
+      }
+    }
+
+    template <typename JOBTYPE>
+    LockFreeJobQueue<JOBTYPE>::~LockFreeJobQueue(void)
+    {
+      overflow_lock.destroy();
+    }
+
+    template <typename JOBTYPE>
+    bool LockFreeJobQueue<JOBTYPE>::empty(void) const
+    {
+      if(overflow_count > 0) return false;
+      for(int i = 0; i < NUM_BUCKETS; i++)
+        if((spill_counts[i] > 0) || !buckets[i].empty()) return false;
+      return true;
+    }
+
+    template <typename JOBTYPE>
+    void LockFreeJobQueue<JOBTYPE>::insert(JOBTYPE *job, int priority)
+    {
+      if((priority >= 0) && (priority < NUM_BUCKETS)) {
+        // once a ring has spilled, stay out of it until the spill list
+        //  drains so that older spilled jobs aren't passed by newer ones
+        if((spill_counts[priority] == 0) && buckets[priority].push(job))
+          return;
+        overflow_lock.lock();
+        spills[priority].push_back(job);
+        __sync_fetch_and_add(&spill_counts[priority], 1);
+        overflow_lock.unlock();
+        return;
+      }
+
+      overflow_lock.lock();
+      overflow.insert(job, priority);
+      __sync_fetch_and_add(&overflow_count, 1);
+      overflow_lock.unlock();
+    }
+
+    template <typename JOBTYPE>
+    int LockFreeJobQueue<JOBTYPE>::overflow_priority(void)
+    {
+      if(overflow_count == 0) return INT_MIN;
+      int priority = INT_MIN;
+      overflow_lock.lock();
+      // remember that the JobQueue negates priorities
+      if(!overflow.empty())
+        priority = -(overflow.ready.begin()->first);
+      overflow_lock.unlock();
+      return priority;
+    }
+
+    template <typename JOBTYPE>
+    JOBTYPE *LockFreeJobQueue<JOBTYPE>::pop_overflow(void)
+    {
+      if(overflow_count == 0) return 0;
+      overflow_lock.lock();
+      JOBTYPE *job = overflow.pop();
+      if(job)
+        __sync_fetch_and_add(&overflow_count, -1);
+      overflow_lock.unlock();
+      return job;
+    }
+
+    template <typename JOBTYPE>
+    JOBTYPE *LockFreeJobQueue<JOBTYPE>::pop_spill(int bucket)
+    {
+      if(spill_counts[bucket] == 0) return 0;
+      JOBTYPE *job = 0;
+      overflow_lock.lock();
+      // the ring can look empty to pop while a producer is still
+      //  publishing into it, or refill with jobs inserted before the
+      //  spilled ones while we are delayed, so check that it really is
+      //  empty while holding the lock that spilling producers need
+      if(buckets[bucket].empty() && !spills[bucket].empty()) {
+        job = spills[bucket].front();
+        spills[bucket].pop_front();
+        __sync_fetch_and_add(&spill_counts[bucket], -1);
+      }
+      overflow_lock.unlock();
+      return job;
+    }
+
+    template <typename JOBTYPE>
+    JOBTYPE *LockFreeJobQueue<JOBTYPE>::pop(void)
+    {
+      // the overflow queue only holds priorities without a bucket, so
+      //  checking it before each lower bucket keeps priorities in order
+      int ov_priority = overflow_priority();
+      for(int i = NUM_BUCKETS - 1; i >= 0; i--) {
+        if(ov_priority > i) {
+          JOBTYPE *job = pop_overflow();
+          if(job) return job;
+          ov_priority = INT_MIN;
+        }
+        // the ring holds the oldest jobs of this priority
+        JOBTYPE *job = buckets[i].pop();
+        if(job) return job;
+        job = pop_spill(i);
+        if(job) return job;
+      }
+      return pop_overflow();
+    }
+
+  }; // namespace LowLevel
+}; // namespace LegionRuntime
+
+#endif
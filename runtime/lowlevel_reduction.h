@@ -0,0 +1,252 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RUNTIME_LOWLEVEL_REDUCTION_H
+#define RUNTIME_LOWLEVEL_REDUCTION_H
+
+// Vectorized kernels for the common reduction operators - ReductionOp
+//  (in lowlevel.h) uses these instead of calling REDOP::apply/fold one
+//  element at a time when the operator opts in through
+//  ReductionVectorTraits
+
+#include <cstring>
+#include <stdint.h>
+#include <sys/types.h>
+
+// width of the vectors the kernels work on - the compiler maps these onto
+//  SSE or AVX registers (or splits them up if it has to)
+#ifdef __AVX__
+#define LEGION_REDOP_VECTOR_BYTES 32
+#else
+#define LEGION_REDOP_VECTOR_BYTES 16
+#endif
+
+namespace LegionRuntime {
+  namespace LowLevel {
+
+    enum ReductionVectorKind {
+      REDOP_VECTOR_NONE,
+      REDOP_VECTOR_SUM,   // lhs = lhs + rhs
+      REDOP_VECTOR_PROD,  // lhs = lhs * rhs
+      REDOP_VECTOR_MIN,   // lhs = (rhs < lhs) ? rhs : lhs
+      REDOP_VECTOR_MAX,   // lhs = (rhs > lhs) ? rhs : lhs
+    };
+
+    // A reduction operator opts in to the vectorized kernels by
+    //  specializing this trait.  It's only valid when LHS and RHS are the
+    //  same type (float, double, int32_t or int64_t) and both apply and
+    //  fold compute exactly the KIND above, e.g.:
+    //
+    //  namespace LegionRuntime { namespace LowLevel {
+    //    template <> struct ReductionVectorTraits<MySumOp> {
+    //      static const ReductionVectorKind KIND = REDOP_VECTOR_SUM;
+    //    };
+    //  }; };
+    template <class REDOP>
+    struct ReductionVectorTraits {
+      static const ReductionVectorKind KIND = REDOP_VECTOR_NONE;
+    };
+
+    template <size_t BYTES> struct ReductionBitsType;
+    template <> struct ReductionBitsType<4> { typedef int32_t type; };
+    template <> struct ReductionBitsType<8> { typedef int64_t type; };
+
+    template <class T, ReductionVectorKind KIND> struct ReductionCombine;
+
+    template <class T>
+    struct ReductionCombine<T, REDOP_VECTOR_SUM> {
+      template <class V>
+      static V combine(V lhs, V rhs) { return lhs + rhs; }
+    };
+
+    template <class T>
+    struct ReductionCombine<T, REDOP_VECTOR_PROD> {
+      template <class V>
+      static V combine(V lhs, V rhs) { return lhs * rhs; }
+    };
+
+    // min and max select with a comparison mask so the same code works for
+    //  both scalars and vectors of floating point or integer types
+    template <class T>
+    struct ReductionCombine<T, REDOP_VECTOR_MIN> {
+      static T combine(T lhs, T rhs) { return (rhs < lhs) ? rhs : lhs; }
+
+      template <class V>
+      static V combine(V lhs, V rhs)
+      {
+        typedef typename ReductionBitsType<sizeof(T)>::type BITS;
+        typedef BITS VBITS __attribute__((vector_size(sizeof(V))));
+        VBITS mask = (VBITS)(rhs < lhs);
+        return (V)((mask & (VBITS)rhs) | (~mask & (VBITS)lhs));
+      }
+    };
+
+    template <class T>
+    struct ReductionCombine<T, REDOP_VECTOR_MAX> {
+      static T combine(T lhs, T rhs) { return (rhs > lhs) ? rhs : lhs; }
+
+      template <class V>
+      static V combine(V lhs, V rhs)
+      {
+        typedef typename ReductionBitsType<sizeof(T)>::type BITS;
+        typedef BITS VBITS __attribute__((vector_size(sizeof(V))));
+        VBITS mask = (VBITS)(rhs > lhs);
+        return (V)((mask & (VBITS)rhs) | (~mask & (VBITS)lhs));
+      }
+    };
+
+    // exclusive reduction of contiguous arrays - whole vectors first, then
+    //  the leftovers one at a time (unaligned loads/stores are fine)
+    template <class T, ReductionVectorKind KIND>
+    inline void reduce_contiguous(T *lhs, const T *rhs, size_t count)
+    {
+      typedef T VT __attribute__((vector_size(LEGION_REDOP_VECTOR_BYTES)));
+      const size_t LANES = LEGION_REDOP_VECTOR_BYTES / sizeof(T);
+      size_t i = 0;
+      for( ; (i + LANES) <= count; i += LANES) {
+        VT a, b;
+        memcpy(&a, lhs + i, sizeof(VT));
+        memcpy(&b, rhs + i, sizeof(VT));
+        a = ReductionCombine<T, KIND>::combine(a, b);
+        memcpy(lhs + i, &a, sizeof(VT));
+      }
+      for( ; i < count; i++)
+        lhs[i] = ReductionCombine<T, KIND>::combine(lhs[i], rhs[i]);
+    }
+
+    template <class T, ReductionVectorKind KIND>
+    inline void reduce_sparse(char *lhs, const char *rhs,
+                               off_t lhs_stride, off_t rhs_stride, size_t count)
+    {
+      for(size_t i = 0; i < count; i++) {
+        T *l = (T *)lhs;
+        *l = ReductionCombine<T, KIND>::combine(*l, *(const T *)rhs);
+        lhs += lhs_stride;
+        rhs += rhs_stride;
+      }
+    }
+
+    // non-exclusive reductions have to be atomic per element - there's no
+    //  vector form of that, but we can skip the compare-and-swap entirely
+    //  when the result wouldn't change (identity values in a reduction
+    //  instance, a min that's already smaller, ...)
+    template <class T, ReductionVectorKind KIND>
+    struct ReductionAtomic {
+      static void combine(T *ptr, T rhs)
+      {
+        typedef typename ReductionBitsType<sizeof(T)>::type BITS;
+        BITS *target = (BITS *)ptr;
+        BITS old_bits = *(volatile BITS *)target;
+        while(1) {
+          T old_val, new_val;
+          memcpy(&old_val, &old_bits, sizeof(T));
+          new_val = ReductionCombine<T, KIND>::combine(old_val, rhs);
+          BITS new_bits;
+          memcpy(&new_bits, &new_val, sizeof(T));
+          if(new_bits == old_bits)
+            return;
+          BITS prev = __sync_val_compare_and_swap(target, old_bits, new_bits);
+          if(prev == old_bits)
+            return;
+          old_bits = prev;
+        }
+      }
+    };
+
+    // integer sums have a native atomic
+    template <>
+    struct ReductionAtomic<int32_t, REDOP_VECTOR_SUM> {
+      static void combine(int32_t *ptr, int32_t rhs)
+      {
+        if(rhs != 0)
+          __sync_fetch_and_add(ptr, rhs);
+      }
+    };
+
+    template <>
+    struct ReductionAtomic<int64_t, REDOP_VECTOR_SUM> {
+      static void combine(int64_t *ptr, int64_t rhs)
+      {
+        if(rhs != 0)
+          __sync_fetch_and_add(ptr, rhs);
+      }
+    };
+
+    template <class T, ReductionVectorKind KIND>
+    inline void reduce_atomic(char *lhs, const char *rhs,
+                              off_t lhs_stride, off_t rhs_stride, size_t count)
+    {
+      for(size_t i = 0; i < count; i++) {
+        ReductionAtomic<T, KIND>::combine((T *)lhs, *(const T *)rhs);
+        lhs += lhs_stride;
+        rhs += rhs_stride;
+      }
+    }
+
+    // ReductionOp calls these first - they return false for operators that
+    //  haven't opted in, which then take the per-element REDOP path
+    template <class REDOP,
+              ReductionVectorKind KIND = ReductionVectorTraits<REDOP>::KIND>
+    struct ReductionVectorDispatch {
+      typedef typename REDOP::RHS T;
+
+      static bool reduce(void *lhs_ptr, const void *rhs_ptr, size_t count,
+                         bool exclusive)
+      {
+        if(exclusive)
+          reduce_contiguous<T, KIND>((T *)lhs_ptr, (const T *)rhs_ptr, count);
+        else
+          reduce_atomic<T, KIND>((char *)lhs_ptr, (const char *)rhs_ptr,
+                                 sizeof(T), sizeof(T), count);
+        return true;
+      }
+
+      static bool reduce_strided(void *lhs_ptr, const void *rhs_ptr,
+                                 off_t lhs_stride, off_t rhs_stride,
+                                 size_t count, bool exclusive)
+      {
+        if(!exclusive)
+          reduce_atomic<T, KIND>((char *)lhs_ptr, (const char *)rhs_ptr,
+                                 lhs_stride, rhs_stride, count);
+        else if((lhs_stride == (off_t)sizeof(T)) &&
+                (rhs_stride == (off_t)sizeof(T)))
+          reduce_contiguous<T, KIND>((T *)lhs_ptr, (const T *)rhs_ptr, count);
+        else
+          reduce_sparse<T, KIND>((char *)lhs_ptr, (const char *)rhs_ptr,
+                                 lhs_stride, rhs_stride, count);
+        return true;
+      }
+    };
+
+    template <class REDOP>
+    struct ReductionVectorDispatch<REDOP, REDOP_VECTOR_NONE> {
+      static bool reduce(void *lhs_ptr, const void *rhs_ptr, size_t count,
+                         bool exclusive)
+      {
+        return false;
+      }
+
+      static bool reduce_strided(void *lhs_ptr, const void *rhs_ptr,
+                                 off_t lhs_stride, off_t rhs_stride,
+                                 size_t count, bool exclusive)
+      {
+        return false;
+      }
+    };
+
+  }; // namespace LowLevel
+}; // namespace LegionRuntime
+
+#endif
@@ -0,0 +1,264 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "metrics.h"
+
+namespace LegionRuntime {
+  namespace Metrics {
+
+    Logger::Category log_metrics("metrics");
+
+    bool metrics_enabled = false;
+    __thread MetricShard *local_shard = NULL;
+
+    struct MetricInfo {
+    public:
+      const char *name;
+      MetricKind kind;
+    };
+
+    // Indexed by MetricID, histograms of times are in nanoseconds
+    static const MetricInfo metric_registry[NUM_METRICS] = {
+      { "scheduler_time_ns",            METRIC_HISTOGRAM },
+      { "dependence_analysis_time_ns",  METRIC_HISTOGRAM },
+      { "mapping_time_ns",              METRIC_HISTOGRAM },
+      { "mapping_retries",              METRIC_COUNTER   },
+      { "messages_sent",                METRIC_COUNTER   },
+      { "messages_batched",             METRIC_COUNTER   },
+      { "message_bytes",                METRIC_HISTOGRAM },
+      { "dma_time_ns",                  METRIC_HISTOGRAM },
+      { "dma_bytes",                    METRIC_HISTOGRAM },
+      { "allocations",                  METRIC_COUNTER   },
+      { "failed_allocations",           METRIC_COUNTER   },
+      { "allocated_bytes",              METRIC_GAUGE     },
+    };
+
+    // State of the thread that takes snapshots while the application runs
+    struct MetricsReporter {
+    public:
+      FILE *file;
+      pthread_t thread;
+      pthread_mutex_t lock;
+      pthread_cond_t wakeup;
+      MetricShard *shards;
+      unsigned interval_ms;
+      unsigned users;
+      unsigned snapshots;
+      unsigned long long start_time;
+      bool shutdown;
+    };
+    static MetricsReporter reporter = { NULL, pthread_t(),
+      PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL,
+      0, 0, 0, 0, false };
+
+    //--------------------------------------------------------------------------
+    MetricShard* create_local_shard(void)
+    //--------------------------------------------------------------------------
+    {
+      MetricShard *shard = (MetricShard*)calloc(1, sizeof(MetricShard));
+      pthread_mutex_lock(&reporter.lock);
+      shard->next = reporter.shards;
+      reporter.shards = shard;
+      pthread_mutex_unlock(&reporter.lock);
+      return shard;
+    }
+
+    //--------------------------------------------------------------------------
+    static unsigned long long bucket_bound(unsigned bucket)
+    //--------------------------------------------------------------------------
+    {
+      if (bucket == 0)
+        return 0;
+      if (bucket == 64)
+        return ~0ULL;
+      return (1ULL << bucket) - 1;
+    }
+
+    //--------------------------------------------------------------------------
+    static unsigned long long percentile(const unsigned long long *buckets,
+                                         unsigned long long count,
+                                         unsigned percent)
+    //--------------------------------------------------------------------------
+    {
+      // Upper bound of the bucket that holds the requested sample
+      const unsigned long long target = (count * percent + 99) / 100;
+      unsigned long long seen = 0;
+      for (unsigned idx = 0; idx < METRIC_BUCKETS; idx++)
+      {
+        seen += buckets[idx];
+        if ((seen >= target) && (seen > 0))
+          return bucket_bound(idx);
+      }
+      return 0;
+    }
+
+    //--------------------------------------------------------------------------
+    static void emit_line(const char *fmt, ...)
+    //--------------------------------------------------------------------------
+    {
+      char line[256];
+      va_list args;
+      va_start(args, fmt);
+      vsnprintf(line, sizeof(line), fmt, args);
+      va_end(args);
+      if (reporter.file != NULL)
+        fprintf(reporter.file, "%s\n", line);
+      else
+        log_metrics(LEVEL_PRINT, "%s", line);
+    }
+
+    //--------------------------------------------------------------------------
+    static void take_snapshot(void)
+    //--------------------------------------------------------------------------
+    {
+      // Must be holding the reporter lock.  Shards are read while their
+      // threads keep updating them so each value is current as of some
+      // point during the snapshot, which is all we need for rates.
+      MetricShard total;
+      memset(&total, 0, sizeof(total));
+      for (MetricShard *shard = reporter.shards;
+            shard != NULL; shard = shard->next)
+      {
+        for (unsigned id = 0; id < NUM_METRICS; id++)
+        {
+          total.values[id] += shard->values[id];
+          if (metric_registry[id].kind != METRIC_HISTOGRAM)
+            continue;
+          total.sums[id] += shard->sums[id];
+          for (unsigned idx = 0; idx < METRIC_BUCKETS; idx++)
+            total.buckets[id][idx] += shard->buckets[id][idx];
+        }
+      }
+      const unsigned long long elapsed =
+        (TimeStamp::get_current_time_in_micros() - reporter.start_time) / 1000;
+      emit_line("snapshot %u %llu ms", reporter.snapshots++, elapsed);
+      for (unsigned id = 0; id < NUM_METRICS; id++)
+      {
+        const MetricInfo &info = metric_registry[id];
+        switch (info.kind)
+        {
+          case METRIC_COUNTER:
+            {
+              emit_line("%s counter %llu", info.name, total.values[id]);
+              break;
+            }
+          case METRIC_GAUGE:
+            {
+              emit_line("%s gauge %lld", info.name,
+                        (long long)total.values[id]);
+              break;
+            }
+          case METRIC_HISTOGRAM:
+            {
+              const unsigned long long count = total.values[id];
+              emit_line("%s histogram count %llu sum %llu "
+                        "p50 %llu p90 %llu p99 %llu max %llu",
+                        info.name, count, total.sums[id],
+                        percentile(total.buckets[id], count, 50),
+                        percentile(total.buckets[id], count, 90),
+                        percentile(total.buckets[id], count, 99),
+                        percentile(total.buckets[id], count, 100));
+              break;
+            }
+          default:
+            assert(false);
+        }
+      }
+      if (reporter.file != NULL)
+        fflush(reporter.file);
+    }
+
+    //--------------------------------------------------------------------------
+    static void* reporter_loop(void *args)
+    //--------------------------------------------------------------------------
+    {
+      pthread_mutex_lock(&reporter.lock);
+      while (true)
+      {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        unsigned long long wake_us = now.tv_usec +
+          ((unsigned long long)reporter.interval_ms * 1000);
+        struct timespec deadline;
+        deadline.tv_sec = now.tv_sec + (wake_us / 1000000);
+        deadline.tv_nsec = (wake_us % 1000000) * 1000;
+        pthread_cond_timedwait(&reporter.wakeup, &reporter.lock, &deadline);
+        if (reporter.shutdown)
+          break;
+        take_snapshot();
+      }
+      pthread_mutex_unlock(&reporter.lock);
+      return NULL;
+    }
+
+    //--------------------------------------------------------------------------
+    void start_metrics(unsigned interval_ms, const char *prefix, unsigned node)
+    //--------------------------------------------------------------------------
+    {
+      pthread_mutex_lock(&reporter.lock);
+      // Separate runtime instances in the same process share a reporter
+      if (reporter.users++ > 0)
+      {
+        pthread_mutex_unlock(&reporter.lock);
+        return;
+      }
+      if (prefix != NULL)
+      {
+        char file_name[256];
+        snprintf(file_name, sizeof(file_name), "%s_%d.metrics", prefix, node);
+        reporter.file = fopen(file_name, "w");
+        if (reporter.file == NULL)
+          log_metrics(LEVEL_WARNING,"Unable to open metrics file %s, "
+                      "logging snapshots instead", file_name);
+      }
+      reporter.interval_ms = interval_ms;
+      reporter.snapshots = 0;
+      reporter.start_time = TimeStamp::get_current_time_in_micros();
+      reporter.shutdown = false;
+      metrics_enabled = true;
+      pthread_create(&reporter.thread, NULL, reporter_loop, NULL);
+      pthread_mutex_unlock(&reporter.lock);
+    }
+
+    //--------------------------------------------------------------------------
+    void stop_metrics(void)
+    //--------------------------------------------------------------------------
+    {
+      pthread_mutex_lock(&reporter.lock);
+      assert(reporter.users > 0);
+      if (--reporter.users > 0)
+      {
+        pthread_mutex_unlock(&reporter.lock);
+        return;
+      }
+      reporter.shutdown = true;
+      pthread_cond_signal(&reporter.wakeup);
+      pthread_mutex_unlock(&reporter.lock);
+      pthread_join(reporter.thread, NULL);
+      pthread_mutex_lock(&reporter.lock);
+      take_snapshot();
+      metrics_enabled = false;
+      if (reporter.file != NULL)
+      {
+        fclose(reporter.file);
+        reporter.file = NULL;
+      }
+      pthread_mutex_unlock(&reporter.lock);
+    }
+
+  }; // namespace Metrics
+}; // namespace LegionRuntime
+
+// EOF
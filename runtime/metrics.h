@@ -0,0 +1,147 @@
+/* Copyright 2014 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RUNTIME_METRICS_H__
+#define __RUNTIME_METRICS_H__
+
+#include "utilities.h"
+
+/**
+ * Runtime metrics that are always compiled in and turned on with
+ * the -hl:metrics flag.  Both the low-level and high-level runtimes
+ * record into the same registry.  Every thread updates its own shard
+ * without any synchronization and a background thread periodically
+ * sums the shards into a snapshot, so when metrics are disabled the
+ * cost of each call is a single predictable branch.
+ */
+
+namespace LegionRuntime {
+  namespace Metrics {
+
+    enum MetricKind {
+      METRIC_COUNTER,   // monotonically increasing total
+      METRIC_GAUGE,     // current value, adjusted up and down
+      METRIC_HISTOGRAM, // log2-bucketed distribution of samples
+    };
+
+    // Remember to add an entry to the registry in metrics.cc
+    // when adding a new metric
+    enum MetricID {
+      // High-level runtime
+      METRIC_SCHEDULER_TIME,
+      METRIC_DEPENDENCE_ANALYSIS_TIME,
+      METRIC_MAPPING_TIME,
+      METRIC_MAPPING_RETRIES,
+      METRIC_MESSAGES_SENT,
+      METRIC_MESSAGES_BATCHED,
+      METRIC_MESSAGE_BYTES,
+      // Low-level runtime
+      METRIC_DMA_TIME,
+      METRIC_DMA_BYTES,
+      METRIC_ALLOCATIONS,
+      METRIC_FAILED_ALLOCATIONS,
+      METRIC_ALLOCATED_BYTES,
+      NUM_METRICS,
+    };
+
+    // Bucket i of a histogram counts samples v with 2^(i-1) <= v < 2^i
+    enum {
+      METRIC_BUCKETS = 65,
+    };
+
+    struct MetricShard {
+    public:
+      // Counter and gauge values, or the sample count of a histogram
+      unsigned long long values[NUM_METRICS];
+      unsigned long long sums[NUM_METRICS];
+      unsigned long long buckets[NUM_METRICS][METRIC_BUCKETS];
+      MetricShard *next;
+    };
+
+    extern bool metrics_enabled;
+    extern __thread MetricShard *local_shard;
+
+    MetricShard* create_local_shard(void);
+
+    static inline MetricShard& get_local_shard(void)
+    {
+      if (local_shard == NULL)
+        local_shard = create_local_shard();
+      return *local_shard;
+    }
+
+    static inline void increment(MetricID id, unsigned long long amount = 1)
+    {
+      if (!metrics_enabled)
+        return;
+      get_local_shard().values[id] += amount;
+    }
+
+    static inline void adjust(MetricID id, long long delta)
+    {
+      if (!metrics_enabled)
+        return;
+      // Gauges wrap around in each shard but the sum is exact
+      get_local_shard().values[id] += (unsigned long long)delta;
+    }
+
+    static inline void record(MetricID id, unsigned long long sample)
+    {
+      if (!metrics_enabled)
+        return;
+      MetricShard &shard = get_local_shard();
+      const unsigned bucket = (sample == 0) ? 0 :
+                              (64 - __builtin_clzll(sample));
+      shard.values[id]++;
+      shard.sums[id] += sample;
+      shard.buckets[id][bucket]++;
+    }
+
+    /**
+     * \class ScopedTimer
+     * Records the nanoseconds between its construction and
+     * destruction into a histogram.  The clock is only read
+     * when metrics are enabled.
+     */
+    class ScopedTimer {
+    public:
+      ScopedTimer(MetricID m)
+        : id(m), start(metrics_enabled ?
+                       TimeStamp::get_current_time_in_nanos() : 0) { }
+      ~ScopedTimer(void)
+      {
+        if (start > 0)
+          record(id, TimeStamp::get_current_time_in_nanos() - start);
+      }
+    private:
+      ScopedTimer(const ScopedTimer &rhs);
+      ScopedTimer& operator=(const ScopedTimer &rhs);
+    private:
+      const MetricID id;
+      const unsigned long long start;
+    };
+
+    // Enables metrics and starts a thread that takes a snapshot every
+    // interval milliseconds.  Snapshots go to <prefix>_<node>.metrics
+    // or to the 'metrics' logger category if prefix is NULL.
+    void start_metrics(unsigned interval_ms, const char *prefix,
+                       unsigned node);
+    // Takes a final snapshot and stops the snapshot thread
+    void stop_metrics(void);
+
+  }; // namespace Metrics
+}; // namespace LegionRuntime
+
+#endif // __RUNTIME_METRICS_H__
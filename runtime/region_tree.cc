@@ -25,6 +25,8 @@
 #include "interval_tree.h"
 #include "rectangle_set.h"
 
+#include <algorithm>
+
 namespace LegionRuntime {
   namespace HighLevel {
 
@@ -150,9 +152,7 @@ namespace LegionRuntime {
 #ifdef LEGION_SPY
       LegionSpy::log_index_partition(parent.id, pid, disjoint, part_color);
 #endif
-#ifdef DYNAMIC_TESTS
       std::vector<IndexSpaceNode*> children; 
-#endif
       // Now do all the child nodes
       for (std::map<Color,Domain>::const_iterator it = coloring.begin();
             it != coloring.end(); it++)
@@ -169,18 +169,18 @@ namespace LegionRuntime {
         }
         Domain domain = it->second;
         domain.get_index_space(true/*create if necessary*/);
-#ifdef DYNAMIC_TESTS
-        IndexSpaceNode *child = 
-#endif
-        create_node(domain, new_part, it->first);
-#ifdef DYNAMIC_TESTS
+        IndexSpaceNode *child = create_node(domain, new_part, it->first);
         children.push_back(child);
-#endif
 #ifdef LEGION_SPY
         LegionSpy::log_index_subspace(pid, 
             domain.get_index_space().id, it->first);
 #endif
       } 
+      // Aliased partitions get an interference graph between their 
+      // children so we don't conservatively assume they all interfere
+      if (!disjoint && (children.size() > 1) && 
+          (children.size() <= Runtime::max_interference_colors))
+        new_part->build_interference_graph(children);
 #ifdef DYNAMIC_TESTS
       if (Runtime::dynamic_independence_tests)
       {
@@ -221,9 +221,7 @@ namespace LegionRuntime {
 #ifdef LEGION_SPY
       LegionSpy::log_index_partition(parent.id, pid, disjoint, part_color);
 #endif
-#ifdef DYNAMIC_TESTS
       std::vector<IndexSpaceNode*> children; 
-#endif
       // Now do all the child nodes
       std::map<Color,std::set<Domain> >::const_iterator comp_it = 
         component_domains.begin();
@@ -244,14 +242,17 @@ namespace LegionRuntime {
         hull.get_index_space(true/*create if necessary*/);
         IndexSpaceNode *child = create_node(hull, new_part, it->first);
         child->update_component_domains(comp_it->second);
-#ifdef DYNAMIC_TESTS
         children.push_back(child);
-#endif
 #ifdef LEGION_SPY
         LegionSpy::log_index_subspace(pid, 
             hull.get_index_space().id, it->first);
 #endif
       }
+      // Aliased partitions get an interference graph between their 
+      // children so we don't conservatively assume they all interfere
+      if (!disjoint && (children.size() > 1) && 
+          (children.size() <= Runtime::max_interference_colors))
+        new_part->build_interference_graph(children);
 #ifdef DYNAMIC_TESTS
       if (Runtime::dynamic_independence_tests)
       {
@@ -2766,6 +2767,152 @@ namespace LegionRuntime {
       }
     }
 
+    //--------------------------------------------------------------------------
+    static inline void update_statistics_peak(unsigned long long *peak,
+                                              unsigned long long value)
+    //--------------------------------------------------------------------------
+    {
+      unsigned long long old_peak = *peak;
+      while (old_peak < value)
+      {
+        unsigned long long prev = 
+          __sync_val_compare_and_swap(peak, old_peak, value);
+        if (prev == old_peak)
+          break;
+        old_peak = prev;
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void RegionTreeForest::record_state_creation(bool physical)
+    //--------------------------------------------------------------------------
+    {
+      unsigned long long *count = physical ? &state_footprint.physical_states
+                                           : &state_footprint.logical_states;
+      unsigned long long *peak = physical ? 
+                                    &state_footprint.peak_physical_states :
+                                    &state_footprint.peak_logical_states;
+      update_statistics_peak(peak, __sync_add_and_fetch(count, 1));
+      const unsigned long long bytes = physical ? sizeof(PhysicalState) :
+                                                  sizeof(LogicalState);
+      update_statistics_peak(&state_footprint.peak_state_bytes,
+          __sync_add_and_fetch(&state_footprint.state_bytes, bytes));
+    }
+
+    //--------------------------------------------------------------------------
+    void RegionTreeForest::record_state_deletion(bool physical)
+    //--------------------------------------------------------------------------
+    {
+      if (physical)
+      {
+        __sync_fetch_and_sub(&state_footprint.physical_states, 1);
+        __sync_fetch_and_sub(&state_footprint.state_bytes, 
+                             sizeof(PhysicalState));
+      }
+      else
+      {
+        __sync_fetch_and_sub(&state_footprint.logical_states, 1);
+        __sync_fetch_and_sub(&state_footprint.state_bytes, 
+                             sizeof(LogicalState));
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void RegionTreeForest::record_composite_view(unsigned depth, 
+                                                 unsigned nodes)
+    //--------------------------------------------------------------------------
+    {
+      __sync_fetch_and_add(&composite_stats.views, 1);
+      __sync_fetch_and_add(&composite_stats.total_depth, depth);
+      __sync_fetch_and_add(&composite_stats.total_nodes, nodes);
+      update_statistics_peak(&composite_stats.max_depth, depth);
+      update_statistics_peak(&composite_stats.max_nodes, nodes);
+    }
+
+    //--------------------------------------------------------------------------
+    void RegionTreeForest::record_composite_copies(unsigned long long time,
+                                                   bool replayed)
+    //--------------------------------------------------------------------------
+    {
+      if (replayed)
+      {
+        __sync_fetch_and_add(&composite_stats.plan_replays, 1);
+        __sync_fetch_and_add(&composite_stats.replay_time, time);
+      }
+      else
+      {
+        __sync_fetch_and_add(&composite_stats.copy_issues, 1);
+        __sync_fetch_and_add(&composite_stats.copy_time, time);
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void RegionTreeForest::report_composite_statistics(void)
+    //--------------------------------------------------------------------------
+    {
+      const CompositeStatistics &stats = composite_stats;
+      log_run.print("Composite views on node %d: %lld made by closes, "
+                    "average depth %.2f (max %lld), average nodes %.2f "
+                    "(max %lld)", runtime->address_space, stats.views,
+                    (stats.views == 0) ? 0.0 : 
+                      double(stats.total_depth) / stats.views,
+                    stats.max_depth, (stats.views == 0) ? 0.0 :
+                      double(stats.total_nodes) / stats.views,
+                    stats.max_nodes);
+      log_run.print("  tree walks: %lld, average %.2f us",
+                    stats.copy_issues, (stats.copy_issues == 0) ? 0.0 :
+                      double(stats.copy_time) / stats.copy_issues);
+      log_run.print("  flattened replays: %lld, average %.2f us",
+                    stats.plan_replays, (stats.plan_replays == 0) ? 0.0 :
+                      double(stats.replay_time) / stats.plan_replays);
+      log_run.print("  flattened plans: %lld built, %lld rejected "
+                    "(nested reductions)", stats.plans_built,
+                    stats.plans_rejected);
+    }
+
+    //--------------------------------------------------------------------------
+    void RegionTreeForest::report_state_footprint(void)
+    //--------------------------------------------------------------------------
+    {
+      size_t region_count, partition_count;
+      {
+        AutoLock l_lock(lookup_lock,1,false/*exclusive*/);
+        region_count = region_nodes.size();
+        partition_count = part_nodes.size();
+      }
+      const unsigned long long contexts = runtime->get_context_count();
+      const unsigned long long nodes = region_count + partition_count;
+      // Every node keeps a table with a pointer for each
+      // context in both its logical and physical stacks
+      const unsigned long long table_slots = 
+        (contexts + DEFAULT_CONTEXTS - 1) / DEFAULT_CONTEXTS * DEFAULT_CONTEXTS;
+      const unsigned long long table_bytes = 
+        nodes * 2 * table_slots * sizeof(void*);
+      // Contexts have released their states by the time this runs,
+      // so the interesting numbers are the high-water marks
+      const unsigned long long peak_bytes = table_bytes +
+        state_footprint.peak_state_bytes;
+      // What it would cost to have a state for every context on every node
+      const unsigned long long dense_bytes = nodes * contexts * 
+        (sizeof(LogicalState) + sizeof(PhysicalState));
+      log_run.print("Region tree state footprint on node %d: %lld region "
+                    "nodes, %lld partition nodes, %lld contexts",
+                    runtime->address_space, (long long)region_count, 
+                    (long long)partition_count, contexts);
+      log_run.print("  logical states: %lld peak resident, %lld still "
+                    "resident (%ld bytes each)", 
+                    state_footprint.peak_logical_states, 
+                    state_footprint.logical_states, sizeof(LogicalState));
+      log_run.print("  physical states: %lld peak resident, %lld still "
+                    "resident (%ld bytes each)", 
+                    state_footprint.peak_physical_states, 
+                    state_footprint.physical_states, sizeof(PhysicalState));
+      log_run.print("  state memory: %.2f KB peak resident including "
+                    "%.2f KB of context tables, %.2f KB if every context "
+                    "had a state on every node", peak_bytes / 1024.0,
+                    table_bytes / 1024.0, dense_bytes / 1024.0);
+    }
+
 #ifdef DEBUG_HIGH_LEVEL
     //--------------------------------------------------------------------------
     void RegionTreeForest::dump_logical_state(LogicalRegion region,
@@ -2996,6 +3143,7 @@ namespace LegionRuntime {
       AutoLock d_lock(dynamic_lock);
       dynamic_part_tests.push_back(test);
     }
+#endif // DYNAMIC_TESTS
 
     //--------------------------------------------------------------------------
     /*static*/ bool RegionTreeForest::are_disjoint(const Domain &left,
@@ -3106,6 +3254,7 @@ namespace LegionRuntime {
       return disjoint;
     }
 
+#ifdef DYNAMIC_TESTS
     //--------------------------------------------------------------------------
     RegionTreeForest::DynamicSpaceTest::DynamicSpaceTest(IndexPartNode *par,
                                                          IndexSpaceNode *l, 
@@ -3662,6 +3811,71 @@ namespace LegionRuntime {
     }
 #endif
 
+    /////////////////////////////////////////////////////////////
+    // Intersection Cache 
+    /////////////////////////////////////////////////////////////
+
+    //--------------------------------------------------------------------------
+    IntersectionCache::IntersectionCache(void)
+      : clock_hand(0)
+    //--------------------------------------------------------------------------
+    {
+    }
+
+    //--------------------------------------------------------------------------
+    bool IntersectionCache::find(IndexTreeNode *node, bool &result)
+    //--------------------------------------------------------------------------
+    {
+      std::map<IndexTreeNode*,unsigned>::const_iterator finder = 
+        entry_index.find(node);
+      if (finder == entry_index.end())
+        return false;
+      CacheEntry &entry = entries[finder->second];
+      entry.referenced = true;
+      result = entry.result;
+      return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool IntersectionCache::insert(IndexTreeNode *node, bool result,
+                                   size_t max_entries)
+    //--------------------------------------------------------------------------
+    {
+      // Check to see if we lost the race
+      std::map<IndexTreeNode*,unsigned>::const_iterator finder = 
+        entry_index.find(node);
+      if (finder != entry_index.end())
+      {
+        entries[finder->second].result = result;
+        return false;
+      }
+      if ((max_entries == 0) || (entries.size() < max_entries))
+      {
+        entry_index[node] = entries.size();
+        entries.push_back(CacheEntry(node, result));
+        return false;
+      }
+      // Sweep the clock hand until we find an entry which
+      // hasn't been referenced since the last time we passed it
+      while (true)
+      {
+        if (clock_hand >= entries.size())
+          clock_hand = 0;
+        CacheEntry &victim = entries[clock_hand];
+        if (victim.referenced)
+        {
+          victim.referenced = false;
+          clock_hand++;
+          continue;
+        }
+        entry_index.erase(victim.node);
+        entry_index[node] = clock_hand;
+        victim = CacheEntry(node, result);
+        clock_hand++;
+        return true;
+      }
+    }
+
     /////////////////////////////////////////////////////////////
     // Index Tree Node 
     /////////////////////////////////////////////////////////////
@@ -4088,6 +4302,116 @@ namespace LegionRuntime {
       return dominates;
     }
 
+    //--------------------------------------------------------------------------
+    /*static*/ bool IndexTreeNode::compute_intersects(
+                      const std::set<Domain> &left, const std::set<Domain> &right)
+    //--------------------------------------------------------------------------
+    {
+      for (std::set<Domain>::const_iterator lit = left.begin();
+            lit != left.end(); lit++)
+      {
+        for (std::set<Domain>::const_iterator rit = right.begin();
+              rit != right.end(); rit++)
+        {
+          if (!RegionTreeForest::are_disjoint(*lit, *rit))
+            return true;
+        }
+      }
+      return false;
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ bool IndexTreeNode::compute_intersects(
+                                const std::set<Domain> &left, const Domain &right)
+    //--------------------------------------------------------------------------
+    {
+      for (std::set<Domain>::const_iterator it = left.begin();
+            it != left.end(); it++)
+      {
+        if (!RegionTreeForest::are_disjoint(*it, right))
+          return true;
+      }
+      return false;
+    }
+
+    //--------------------------------------------------------------------------
+    bool IndexTreeNode::find_cached_intersection(IndexTreeNode *other,
+                                                 bool &result)
+    //--------------------------------------------------------------------------
+    {
+      bool found = false;
+      {
+        AutoLock n_lock(node_lock,1,false/*exclusive*/);
+        if (intersect_cache.find(other, result))
+          found = true;
+        else
+        {
+          // We may already know the intersection domains
+          std::map<IndexTreeNode*,IntersectInfo>::const_iterator finder = 
+            intersections.find(other);
+          if (finder != intersections.end())
+          {
+            result = finder->second.has_intersects;
+            found = true;
+          }
+        }
+      }
+#ifdef LEGION_PROF
+      if (found)
+        __sync_fetch_and_add(&context->intersection_stats.cache_hits, 1);
+      else
+        __sync_fetch_and_add(&context->intersection_stats.cache_misses, 1);
+#endif
+      return found;
+    }
+
+    //--------------------------------------------------------------------------
+    void IndexTreeNode::cache_intersection(IndexTreeNode *other, bool result)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock n_lock(node_lock);
+#ifdef LEGION_PROF
+      if (intersect_cache.insert(other, result, 
+                                 Runtime::max_intersection_cache))
+        __sync_fetch_and_add(&context->intersection_stats.cache_evictions, 1);
+#else
+      intersect_cache.insert(other, result, Runtime::max_intersection_cache);
+#endif
+    }
+
+    //--------------------------------------------------------------------------
+    bool IndexTreeNode::find_cached_dominator(IndexTreeNode *other, 
+                                              bool &result)
+    //--------------------------------------------------------------------------
+    {
+      bool found;
+      {
+        AutoLock n_lock(node_lock,1,false/*exclusive*/);
+        found = dominator_cache.find(other, result);
+      }
+#ifdef LEGION_PROF
+      if (found)
+        __sync_fetch_and_add(&context->intersection_stats.cache_hits, 1);
+      else
+        __sync_fetch_and_add(&context->intersection_stats.cache_misses, 1);
+#endif
+      return found;
+    }
+
+    //--------------------------------------------------------------------------
+    void IndexTreeNode::cache_dominator(IndexTreeNode *other, bool result)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock n_lock(node_lock);
+#ifdef LEGION_PROF
+      if (dominator_cache.insert(other, result, 
+                                 Runtime::max_intersection_cache))
+        __sync_fetch_and_add(&context->intersection_stats.cache_evictions, 1);
+#else
+      dominator_cache.insert(other, result, Runtime::max_intersection_cache);
+#endif
+    }
+
 
     /////////////////////////////////////////////////////////////
     // Index Space Node 
@@ -4355,59 +4679,28 @@ namespace LegionRuntime {
     //--------------------------------------------------------------------------
     {
       {
-        AutoLock n_lock(node_lock,1,false/*exclusive*/);
-        std::map<IndexTreeNode*,IntersectInfo>::const_iterator finder = 
-          intersections.find(other);
-        if (finder != intersections.end())
-          return finder->second.has_intersects;
+        bool cached;
+        if (find_cached_intersection(other, cached))
+          return cached;
       }
-      std::set<Domain> intersect;
-      bool result, own_results;
+      // Only need a yes or no answer so don't build the domains
+      bool result;
       if (component_domains.empty())
       { 
-#ifndef SHARED_LOWLEVEL
-        own_results = (domain.get_dim() == 0);
-#else
-        own_results = true;
-#endif
         if (other->has_component_domains())
-          result = compute_intersections(other->get_component_domains(),
-                                         domain, intersect);
+          result = compute_intersects(other->get_component_domains(), domain);
         else
-        {
-          Domain inter;
-          result = compute_intersection(domain, other->domain, inter);
-          if (result)
-            intersect.insert(inter);
-        }
+          result = !RegionTreeForest::are_disjoint(domain, other->domain);
       }
       else
       {
-#ifndef SHARED_LOWLEVEL
-        own_results = false;
-#else
-        own_results = true;
-#endif
         if (other->has_component_domains())
-          result = compute_intersections(component_domains,
-                        other->get_component_domains(), intersect);
+          result = compute_intersects(component_domains,
+                                      other->get_component_domains());
         else
-          result = compute_intersections(component_domains,
-                                         other->domain, intersect); 
-      }
-      AutoLock n_lock(node_lock);
-      if (result)
-      {
-        // Check to make sure we didn't lose the race
-        if (intersections.find(other) == intersections.end())
-        {
-          intersections[other] = IntersectInfo(true/*has intersects*/,
-                                               own_results, intersect);
-        }
+          result = compute_intersects(component_domains, other->domain);
       }
-      else
-        intersections[other] = IntersectInfo(false/*has intersects*/, 
-                                             false/*own*/);
+      cache_intersection(other, result);
       return result;
     }
 
@@ -4416,49 +4709,19 @@ namespace LegionRuntime {
     //--------------------------------------------------------------------------
     {
       {
-        AutoLock n_lock(node_lock,1,false/*exclusive*/);
-        std::map<IndexTreeNode*,IntersectInfo>::const_iterator finder = 
-          intersections.find(other);
-        if (finder != intersections.end())
-          return finder->second.has_intersects;
+        bool cached;
+        if (find_cached_intersection(other, cached))
+          return cached;
       }
       // Build up the set of domains for the partition
-      std::set<Domain> other_domains, intersect;
+      std::set<Domain> other_domains;
       other->get_subspace_domains(other_domains);
-      bool result, own_results;
+      bool result;
       if (component_domains.empty())
-      {
-        result = compute_intersections(other_domains, domain, intersect);
-        // If the dim is zero then we own the index space results
-#ifndef SHARED_LOWLEVEL
-        own_results = (domain.get_dim() == 0);
-#else
-        own_results = true;
-#endif
-      }
-      else
-      {
-        result = compute_intersections(component_domains, other_domains,
-                                       intersect);
-#ifndef SHARED_LOWLEVEL
-        own_results = false;
-#else
-        own_results = true;
-#endif
-      }
-      AutoLock n_lock(node_lock);
-      if (result)
-      {
-        // Check to make sure we didn't lose the race
-        if (intersections.find(other) == intersections.end())
-        {
-          intersections[other] = IntersectInfo(true/*has intersects*/,
-                                               own_results, intersect);
-        }
-      }
+        result = compute_intersects(other_domains, domain);
       else
-        intersections[other] = IntersectInfo(false/*has intersects*/,
-                                             false/*own*/);
+        result = compute_intersects(component_domains, other_domains);
+      cache_intersection(other, result);
       return result;
     }
 
@@ -4581,11 +4844,9 @@ namespace LegionRuntime {
     //--------------------------------------------------------------------------
     {
       {
-        AutoLock n_lock(node_lock,1,false/*exclusive*/);
-        std::map<IndexTreeNode*,bool>::const_iterator finder = 
-          dominators.find(other);
-        if (finder != dominators.end())
-          return finder->second;
+        bool cached;
+        if (find_cached_dominator(other, cached))
+          return cached;
       }
       bool result;
       if (component_domains.empty())
@@ -4616,8 +4877,7 @@ namespace LegionRuntime {
           result = compute_dominates(component_domains, other_doms);
         }
       }
-      AutoLock n_lock(node_lock);
-      dominators[other] = result;
+      cache_dominator(other, result);
       return result;
     }
 
@@ -4626,11 +4886,9 @@ namespace LegionRuntime {
     //--------------------------------------------------------------------------
     {
       {
-        AutoLock n_lock(node_lock,1,false/*exclusive*/);
-        std::map<IndexTreeNode*,bool>::const_iterator finder = 
-          dominators.find(other);
-        if (finder != dominators.end())
-          return finder->second;
+        bool cached;
+        if (find_cached_dominator(other, cached))
+          return cached;
       }
       bool result;
       std::set<Domain> other_doms;
@@ -4643,8 +4901,7 @@ namespace LegionRuntime {
       }
       else
         result = compute_dominates(component_domains, other_doms);
-      AutoLock n_lock(node_lock);
-      dominators[other] = result;
+      cache_dominator(other, result);
       return result;
     }
 
@@ -4806,7 +5063,8 @@ namespace LegionRuntime {
                                  Color c, Domain cspace, bool dis,
                                  RegionTreeForest *ctx)
       : IndexTreeNode(c, par->depth+1, ctx), handle(p), color_space(cspace),
-        parent(par), disjoint(dis), has_complete(false)
+        parent(par), disjoint(dis), has_complete(false),
+        pending_interference_tasks(0), interference_complete(false)
     //--------------------------------------------------------------------------
     { 
     }
@@ -4814,7 +5072,8 @@ namespace LegionRuntime {
     //--------------------------------------------------------------------------
     IndexPartNode::IndexPartNode(const IndexPartNode &rhs)
       : IndexTreeNode(), handle(0), color_space(Domain::NO_DOMAIN),
-        parent(NULL), disjoint(false), has_complete(false)
+        parent(NULL), disjoint(false), has_complete(false),
+        pending_interference_tasks(0), interference_complete(false)
     //--------------------------------------------------------------------------
     {
       // should never be called
@@ -4945,6 +5204,23 @@ namespace LegionRuntime {
         return false;
       if (disjoint)
         return true;
+      // Once the interference graph is built we can read it
+      // without the lock since no one is changing it anymore
+      if (interference_complete)
+      {
+        std::vector<Color>::const_iterator finder = 
+          std::lower_bound(interference_colors.begin(),
+                           interference_colors.end(), c1);
+        if ((finder != interference_colors.end()) && (*finder == c1))
+        {
+          const std::vector<Color> &row = 
+            interference_rows[finder - interference_colors.begin()];
+#ifdef LEGION_PROF
+          __sync_fetch_and_add(&context->intersection_stats.graph_hits, 1);
+#endif
+          return !std::binary_search(row.begin(), row.end(), c2);
+        }
+      }
       AutoLock n_lock(node_lock,1,false/*exclusive*/);
       if (disjoint_subspaces.find(std::pair<Color,Color>(c1,c2)) !=
           disjoint_subspaces.end())
@@ -4967,6 +5243,81 @@ namespace LegionRuntime {
       disjoint_subspaces.insert(std::pair<Color,Color>(c2,c1));
     }
 
+    //--------------------------------------------------------------------------
+    void IndexPartNode::build_interference_graph(
+                                  const std::vector<IndexSpaceNode*> &children)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_HIGH_LEVEL
+      assert(!disjoint);
+      assert(interference_nodes.empty());
+#endif
+      // Sort the children by color so we can binary search rows
+      std::map<Color,IndexSpaceNode*> sorted_children;
+      for (std::vector<IndexSpaceNode*>::const_iterator it = 
+            children.begin(); it != children.end(); it++)
+        sorted_children[(*it)->color] = *it;
+      interference_colors.reserve(sorted_children.size());
+      interference_nodes.reserve(sorted_children.size());
+      for (std::map<Color,IndexSpaceNode*>::const_iterator it = 
+            sorted_children.begin(); it != sorted_children.end(); it++)
+      {
+        interference_colors.push_back(it->first);
+        interference_nodes.push_back(it->second);
+      }
+      interference_rows.resize(interference_nodes.size());
+      // Compute the rows in parallel on the utility processors, 
+      // until they are done are_disjoint falls back to being precise
+      // only for pairs we've been told are disjoint
+      const unsigned num_rows = interference_nodes.size();
+      const unsigned num_tasks = 
+        (num_rows + INTERFERENCE_ROWS_PER_TASK - 1) / 
+          INTERFERENCE_ROWS_PER_TASK;
+      pending_interference_tasks = num_tasks;
+      Processor util_group = context->runtime->find_utility_group();
+      for (unsigned idx = 0; idx < num_tasks; idx++)
+      {
+        InterferenceArgs args;
+        args.hlr_id = HLR_PARTITION_INTERFERENCE_ID;
+        args.node = this;
+        args.start = idx * INTERFERENCE_ROWS_PER_TASK;
+        args.stop = args.start + INTERFERENCE_ROWS_PER_TASK;
+        if (args.stop > num_rows)
+          args.stop = num_rows;
+        util_group.spawn(HLR_TASK_ID, &args, sizeof(args));
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void IndexPartNode::compute_interference_rows(unsigned start, 
+                                                  unsigned stop)
+    //--------------------------------------------------------------------------
+    {
+      const unsigned num_rows = interference_nodes.size();
+      for (unsigned row = start; row < stop; row++)
+      {
+        // Each task owns its rows so no need for the lock
+        std::vector<Color> &interfering = interference_rows[row];
+        IndexSpaceNode *left = interference_nodes[row];
+        for (unsigned col = 0; col < num_rows; col++)
+        {
+          if (col == row)
+            continue;
+          if (!RegionTreeForest::are_disjoint(left, interference_nodes[col]))
+            interfering.push_back(interference_colors[col]);
+        }
+      }
+      // The last task to finish publishes the graph, the atomic
+      // also acts as a fence for all the rows written before it
+      if (__sync_sub_and_fetch(&pending_interference_tasks, 1) == 0)
+      {
+        interference_complete = true;
+#ifdef LEGION_PROF
+        __sync_fetch_and_add(&context->intersection_stats.graphs_built, 1);
+#endif
+      }
+    }
+
     //--------------------------------------------------------------------------
     bool IndexPartNode::is_complete(void)
     //--------------------------------------------------------------------------
@@ -5079,41 +5430,19 @@ namespace LegionRuntime {
     //--------------------------------------------------------------------------
     {
       {
-        AutoLock n_lock(node_lock,1,false/*exclusive*/);
-        std::map<IndexTreeNode*,IntersectInfo>::const_iterator finder = 
-          intersections.find(other);
-        if (finder != intersections.end())
-          return finder->second.has_intersects;
+        bool cached;
+        if (find_cached_intersection(other, cached))
+          return cached;
       }
-      std::set<Domain> local_domains, intersect;
-      bool result, own_results;
+      std::set<Domain> local_domains;
       get_subspace_domains(local_domains);
+      bool result;
       if (other->has_component_domains())
-      {
-        result = compute_intersections(local_domains, 
-                                     other->get_component_domains(), intersect);
-#ifndef SHARED_LOWLEVEL
-        own_results = false;
-#else
-        own_results = true;
-#endif
-      }
-      else
-      {
-        result = compute_intersections(local_domains, other->domain, intersect);
-#ifndef SHARED_LOWLEVEL
-        own_results = (other->domain.get_dim() == 0);
-#else
-        own_results = true;
-#endif
-      }
-      AutoLock n_lock(node_lock);
-      if (result)
-        intersections[other] = IntersectInfo(true/*has intersects*/,
-                                             own_results, intersect);
+        result = compute_intersects(local_domains, 
+                                    other->get_component_domains());
       else
-        intersections[other] = IntersectInfo(false/*own intersects*/,
-                                             false/*own*/);
+        result = compute_intersects(local_domains, other->domain);
+      cache_intersection(other, result);
       return result;
     }
 
@@ -5122,29 +5451,15 @@ namespace LegionRuntime {
     //--------------------------------------------------------------------------
     {
       {
-        AutoLock n_lock(node_lock,1,false/*exclusive*/);
-        std::map<IndexTreeNode*,IntersectInfo>::const_iterator finder = 
-          intersections.find(other);
-        if (finder != intersections.end())
-          return finder->second.has_intersects;
+        bool cached;
+        if (find_cached_intersection(other, cached))
+          return cached;
       }
-      std::set<Domain> local_domains, other_domains, intersect;
+      std::set<Domain> local_domains, other_domains;
       get_subspace_domains(local_domains);
       other->get_subspace_domains(other_domains);
-      bool result = compute_intersections(local_domains, other_domains, 
-                                          intersect);
-#ifndef SHARED_LOWLEVEL
-      bool own_results = (local_domains.begin()->get_dim() == 0);
-#else
-      bool own_results = true;
-#endif
-      AutoLock n_lock(node_lock);
-      if (result)
-        intersections[other] = IntersectInfo(true/*has intersects*/,
-                                             own_results, intersect);
-      else
-        intersections[other] = IntersectInfo(false/*own intersects*/,
-                                             false/*own*/);
+      bool result = compute_intersects(local_domains, other_domains);
+      cache_intersection(other, result);
       return result;
     }
 
@@ -5229,11 +5544,9 @@ namespace LegionRuntime {
     //--------------------------------------------------------------------------
     {
       {
-        AutoLock n_lock(node_lock,1,false/*exclusive*/);
-        std::map<IndexTreeNode*,bool>::const_iterator finder = 
-          dominators.find(other);
-        if (finder != dominators.end())
-          return finder->second;
+        bool cached;
+        if (find_cached_dominator(other, cached))
+          return cached;
       }
       std::set<Domain> local;
       get_subspace_domains(local);
@@ -5246,8 +5559,7 @@ namespace LegionRuntime {
         other_doms.insert(other->domain);
         result = compute_dominates(local, other_doms);
       }
-      AutoLock n_lock(node_lock);
-      dominators[other] = result;
+      cache_dominator(other, result);
       return result;
     }
 
@@ -5256,18 +5568,15 @@ namespace LegionRuntime {
     //--------------------------------------------------------------------------
     {
       {
-        AutoLock n_lock(node_lock,1,false/*exclusive*/);
-        std::map<IndexTreeNode*,bool>::const_iterator finder = 
-          dominators.find(other);
-        if (finder != dominators.end())
-          return finder->second;
+        bool cached;
+        if (find_cached_dominator(other, cached))
+          return cached;
       }
       std::set<Domain> local, other_doms;
       get_subspace_domains(local);
       other->get_subspace_domains(other_doms);
       bool result = compute_dominates(local, other_doms);
-      AutoLock n_lock(node_lock);
-      dominators[other] = result;
+      cache_dominator(other, result);
       return result;
     }
 
@@ -8375,6 +8684,287 @@ namespace LegionRuntime {
       user_level_coherence = FieldMask();
     }
 
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    LogicalUserStore<A>::LogicalUserStore(void)
+      : live_users(0), indexed(false), index_entries(0), erased_users(0),
+        current_stamp(0), sweep_cursor(0)
+    //--------------------------------------------------------------------------
+    {
+    }
+
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    LogicalUserStore<A>::LogicalUserStore(const LogicalUserStore<A> &rhs)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+    }
+
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    LogicalUserStore<A>::~LogicalUserStore(void)
+    //--------------------------------------------------------------------------
+    {
+      for (unsigned idx = 0; idx < free_candidates.size(); idx++)
+        delete free_candidates[idx];
+      free_candidates.clear();
+    }
+
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    LogicalUserStore<A>& LogicalUserStore<A>::operator=(
+                                                 const LogicalUserStore<A> &rhs)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+      return *this;
+    }
+
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    typename LogicalUserStore<A>::iterator LogicalUserStore<A>::begin(void)
+    //--------------------------------------------------------------------------
+    {
+      iterator result;
+      result.store = this;
+      result.next = 0;
+      advance(result);
+      return result;
+    }
+
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    typename LogicalUserStore<A>::iterator LogicalUserStore<A>::begin(
+                                                         const FieldMask &mask)
+    //--------------------------------------------------------------------------
+    {
+      if (!indexed)
+        return begin();
+      // Get a new stamp so we only record each slot once
+      current_stamp++;
+      if (current_stamp == 0)
+      {
+        for (unsigned idx = 0; idx < slots.size(); idx++)
+          slots[idx].stamp = 0;
+        current_stamp = 1;
+      }
+      CandidateList *list;
+      if (!free_candidates.empty())
+      {
+        list = free_candidates.back();
+        free_candidates.pop_back();
+        list->slots.clear();
+      }
+      else
+        list = new CandidateList();
+      std::vector<unsigned> &candidates = list->slots;
+      FieldMask query_mask = mask & indexed_fields;
+      if (!!query_mask)
+      {
+        for (int fidx = query_mask.find_first_set(); fidx >= 0; 
+              fidx = query_mask.find_first_set())
+        {
+          query_mask.unset_bit(fidx);
+          // Compact the bucket as we go, dropping entries for users
+          // that have been erased or no longer use the field
+          std::vector<IndexEntry> &bucket = field_buckets[fidx];
+          unsigned keep = 0;
+          for (unsigned idx = 0; idx < bucket.size(); idx++)
+          {
+            UserSlot &slot = slots[bucket[idx].slot];
+            if (!slot.valid || (slot.generation != bucket[idx].generation) ||
+                !slot.user.field_mask.is_set(fidx))
+              continue;
+            if (slot.stamp != current_stamp)
+            {
+              slot.stamp = current_stamp;
+              candidates.push_back(bucket[idx].slot);
+            }
+            if (keep != idx)
+              bucket[keep] = bucket[idx];
+            keep++;
+          }
+          index_entries -= (bucket.size() - keep);
+          bucket.resize(keep);
+          if (bucket.empty())
+            indexed_fields.unset_bit(fidx);
+        }
+      }
+      // Visit a few more slots so users of fields that are never
+      // queried still see their timeouts expire
+      for (unsigned idx = 0; (idx < SWEEP_SLOTS) && 
+            (idx < slots.size()); idx++)
+      {
+        if (sweep_cursor >= slots.size())
+          sweep_cursor = 0;
+        UserSlot &slot = slots[sweep_cursor];
+        if (slot.valid && (slot.stamp != current_stamp))
+        {
+          slot.stamp = current_stamp;
+          candidates.push_back(sweep_cursor);
+        }
+        sweep_cursor++;
+      }
+      // Visit candidates in slot order so traversals are deterministic
+      std::sort(candidates.begin(), candidates.end());
+      iterator result;
+      result.store = this;
+      result.candidates = list;
+      list->references = 1;
+      result.next = 0;
+      advance(result);
+      return result;
+    }
+
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    void LogicalUserStore<A>::advance(iterator &it)
+    //--------------------------------------------------------------------------
+    {
+      if (it.candidates != NULL)
+      {
+        const std::vector<unsigned> &candidates = it.candidates->slots;
+        while (it.next < candidates.size())
+        {
+          const unsigned slot = candidates[it.next++];
+          if (slots[slot].valid)
+          {
+            it.slot = slot;
+            return;
+          }
+        }
+      }
+      else
+      {
+        while (it.next < slots.size())
+        {
+          const unsigned slot = it.next++;
+          if (slots[slot].valid)
+          {
+            it.slot = slot;
+            return;
+          }
+        }
+      }
+      it.slot = INVALID_SLOT;
+    }
+
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    typename LogicalUserStore<A>::iterator LogicalUserStore<A>::erase(
+                                                                    iterator it)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_HIGH_LEVEL
+      assert(it.store == this);
+      assert(slots[it.slot].valid);
+#endif
+      UserSlot &slot = slots[it.slot];
+      slot.valid = false;
+      // Invalidates any index entries for this slot
+      slot.generation++;
+      free_slots.push_back(it.slot);
+      live_users--;
+      if (indexed)
+        erased_users++;
+      advance(it);
+      // Once everything is gone we can start over 
+      if ((live_users == 0) && (it.slot == INVALID_SLOT))
+        clear();
+      return it;
+    }
+
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    void LogicalUserStore<A>::push_back(const LogicalUser &user)
+    //--------------------------------------------------------------------------
+    {
+      unsigned slot_index;
+      if (!free_slots.empty())
+      {
+        slot_index = free_slots.back();
+        free_slots.pop_back();
+      }
+      else
+      {
+        slot_index = slots.size();
+        slots.push_back(UserSlot());
+      }
+      UserSlot &slot = slots[slot_index];
+      slot.user = user;
+      slot.stamp = 0;
+      slot.valid = true;
+      live_users++;
+      if (indexed)
+      {
+        // If more users have been erased than are still live then
+        // most of the index is stale so rebuild it from scratch
+        if (erased_users > (live_users + Runtime::logical_index_threshold))
+          build_index();
+        else
+          index_user(slot_index);
+      }
+      else if ((Runtime::logical_index_threshold > 0) &&
+               (live_users > Runtime::logical_index_threshold))
+        build_index();
+    }
+
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    void LogicalUserStore<A>::clear(void)
+    //--------------------------------------------------------------------------
+    {
+      slots.clear();
+      free_slots.clear();
+      live_users = 0;
+      indexed = false;
+      indexed_fields.clear();
+      field_buckets.clear();
+      index_entries = 0;
+      erased_users = 0;
+      current_stamp = 0;
+      sweep_cursor = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    void LogicalUserStore<A>::build_index(void)
+    //--------------------------------------------------------------------------
+    {
+      indexed = true;
+      indexed_fields.clear();
+      field_buckets.clear();
+      index_entries = 0;
+      erased_users = 0;
+      for (unsigned idx = 0; idx < slots.size(); idx++)
+      {
+        if (slots[idx].valid)
+          index_user(idx);
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    template<AllocationType A>
+    void LogicalUserStore<A>::index_user(unsigned slot_index)
+    //--------------------------------------------------------------------------
+    {
+      const UserSlot &slot = slots[slot_index];
+      FieldMask remaining = slot.user.field_mask;
+      indexed_fields |= remaining;
+      for (int fidx = remaining.find_first_set(); fidx >= 0; 
+            fidx = remaining.find_first_set())
+      {
+        remaining.unset_bit(fidx);
+        if (unsigned(fidx) >= field_buckets.size())
+          field_buckets.resize(fidx+1);
+        field_buckets[fidx].push_back(IndexEntry(slot_index, slot.generation));
+        index_entries++;
+      }
+    }
+
     //--------------------------------------------------------------------------
     LogicalDepAnalyzer::LogicalDepAnalyzer(const LogicalUser &u,
                                            const FieldMask &check_mask,
@@ -9109,6 +9699,12 @@ namespace LegionRuntime {
       {
         composite_view->update_reduction_views(it->first, it->second);
       }
+      if (Runtime::composite_statistics)
+      {
+        unsigned depth, nodes;
+        composite_view->get_shape(depth, nodes);
+        node->context->record_composite_view(depth, nodes);
+      }
       // Now update the state of the node
       node->update_valid_views(state,closed_mask,true/*dirty*/,composite_view);
       // Now we can remove the valid references that we hold on the reductions
@@ -9546,6 +10142,23 @@ namespace LegionRuntime {
       {
         legion_free(SEMANTIC_INFO_ALLOC, it->second.buffer, it->second.size);
       }
+      // Free any states from contexts that were never invalidated
+      for (unsigned idx = 0; idx < logical_states.size(); idx++)
+      {
+        if (logical_states[idx] != NULL)
+        {
+          legion_delete(logical_states[idx]);
+          context->record_state_deletion(false/*physical*/);
+        }
+      }
+      for (unsigned idx = 0; idx < physical_states.size(); idx++)
+      {
+        if (physical_states[idx] != NULL)
+        {
+          legion_delete(physical_states[idx]);
+          context->record_state_deletion(true/*physical*/);
+        }
+      }
     }
 
     //--------------------------------------------------------------------------
@@ -9557,9 +10170,11 @@ namespace LegionRuntime {
 #endif
       // Hold the lock to prevent races on multiple people
       // trying to update the reserve size.
-      // Also since deques don't copy objects when
-      // appending new ones, we can add states without affecting the
-      // already existing ones.
+      // Since the stacks never move their entries we can add
+      // slots without affecting the already existing ones.
+      // The states themselves are made the first time each
+      // context touches this node so all we grow here are
+      // the tables of pointers to them.
       AutoLock n_lock(node_lock);
 #ifdef DEBUG_HIGH_LEVEL
       assert(logical_states.size() <= num_contexts);
@@ -9570,15 +10185,6 @@ namespace LegionRuntime {
 #endif
       logical_states.append(num_contexts);
       physical_states.append(num_contexts);
-#ifdef DEBUG_HIGH_LEVEL
-      for (unsigned idx = physical_state_size; 
-            idx < (physical_state_size+num_contexts); idx++)
-        physical_states[idx] = PhysicalState(idx, this);
-#else
-      for (unsigned idx = physical_states.size()-num_contexts; 
-            idx < physical_states.size(); idx++)
-        physical_states[idx] = PhysicalState(idx);
-#endif
 #ifdef DEBUG_HIGH_LEVEL
       logical_state_size = logical_states.size();
       physical_state_size = physical_states.size();
@@ -9586,12 +10192,37 @@ namespace LegionRuntime {
     }
 
     //--------------------------------------------------------------------------
-    LogicalState& RegionTreeNode::get_logical_state(ContextID ctx)
+    LogicalState& RegionTreeNode::get_logical_state(ContextID ctx)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_HIGH_LEVEL
+      assert(ctx < logical_state_size);
+#endif
+      LogicalState *result = logical_states[ctx];
+      if (result != NULL)
+        return *result;
+      // First time this context has touched the node so make the state
+      AutoLock n_lock(node_lock);
+      // Check to see if we lost the race
+      result = logical_states[ctx];
+      if (result == NULL)
+      {
+        result = legion_new<LogicalState>();
+        // Make sure the state is built before anyone else can see it
+        __sync_synchronize();
+        logical_states[ctx] = result;
+        context->record_state_creation(false/*physical*/);
+      }
+      return *result;
+    }
+
+    //--------------------------------------------------------------------------
+    LogicalState* RegionTreeNode::find_logical_state(ContextID ctx)
     //--------------------------------------------------------------------------
     {
-#ifdef DEBUG_HIGH_LEVEL
-      assert(ctx < logical_state_size);
-#endif
+      // Returns NULL if the context has never touched this node
+      if (ctx >= logical_states.size())
+        return NULL;
       return logical_states[ctx];
     }
 
@@ -9603,11 +10234,40 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(ctx < physical_state_size);
 #endif
-      PhysicalState *result = &(physical_states[ctx]);
+      PhysicalState *result = physical_states[ctx];
+      if (result == NULL)
+      {
+        // First time this context has touched the node so make the state
+        AutoLock n_lock(node_lock);
+        // Check to see if we lost the race
+        result = physical_states[ctx];
+        if (result == NULL)
+        {
+#ifdef DEBUG_HIGH_LEVEL
+          result = legion_new<PhysicalState>(ctx, this);
+#else
+          result = legion_new<PhysicalState>(ctx);
+#endif
+          // Make sure the state is built before anyone else can see it
+          __sync_synchronize();
+          physical_states[ctx] = result;
+          context->record_state_creation(true/*physical*/);
+        }
+      }
       acquire_physical_state(result, exclusive);
       return result;
     }
 
+    //--------------------------------------------------------------------------
+    PhysicalState* RegionTreeNode::find_physical_state(ContextID ctx)
+    //--------------------------------------------------------------------------
+    {
+      // Returns NULL if the context has never touched this node
+      if (ctx >= physical_states.size())
+        return NULL;
+      return physical_states[ctx];
+    }
+
     //--------------------------------------------------------------------------
     void RegionTreeNode::acquire_physical_state(PhysicalState *state,
                                                  bool exclusive)
@@ -9803,7 +10463,7 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(ctx < logical_state_size);
 #endif
-      LogicalState &state = logical_states[ctx];
+      LogicalState &state = get_logical_state(ctx);
       unsigned depth = get_depth();
       // Before we start, record the "before" versions
       // of all our fields
@@ -9856,18 +10516,16 @@ namespace LegionRuntime {
           // Add the closed users to the prev epoch users, we already
           // registered mapping dependences on them as part of the
           // closing process so we don't need to do it again
-#ifndef LOGICAL_FIELD_TREE
-          state.prev_epoch_users.insert(state.prev_epoch_users.end(),
-                                        closer.closed_users.begin(),
-                                        closer.closed_users.end());
-#else
           for (std::deque<LogicalUser>::const_iterator it = 
                 closer.closed_users.begin(); it != 
                 closer.closed_users.end(); it++)
           {
+#ifndef LOGICAL_FIELD_TREE
+            state.prev_epoch_users.push_back(*it);
+#else
             state.prev_epoch_users->insert(*it);
-          }
 #endif
+          }
         }
         if (!closer.close_operations.empty())
           update_close_operations(state, closer.close_operations);
@@ -9923,18 +10581,16 @@ namespace LegionRuntime {
           // Add the closed users to the prev epoch users, we already
           // registered mapping dependences on them as part of the
           // closing process so we don't need to do it again
-#ifndef LOGICAL_FIELD_TREE
-          state.prev_epoch_users.insert(state.prev_epoch_users.end(),
-                                        closer.closed_users.begin(),
-                                        closer.closed_users.end());
-#else
           for (std::deque<LogicalUser>::const_iterator it = 
                 closer.closed_users.begin(); it != 
                 closer.closed_users.end(); it++)
           {
+#ifndef LOGICAL_FIELD_TREE
+            state.prev_epoch_users.push_back(*it);
+#else
             state.prev_epoch_users->insert(*it);
-          }
 #endif
+          }
         }
         
         if (!closer.close_operations.empty())
@@ -9964,7 +10620,7 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(ctx < logical_state_size);
 #endif
-      LogicalState &state = logical_states[ctx];
+      LogicalState &state = get_logical_state(ctx);
       unsigned depth = get_depth();
       // Before we start, record the "before" versions
       // of all our fields
@@ -10013,7 +10669,7 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(closer.ctx < logical_state_size);
 #endif
-      LogicalState &state = logical_states[closer.ctx];
+      LogicalState &state = get_logical_state(closer.ctx);
 
       // Perform closing checks on both the current epoch users
       // as well as the previous epoch users
@@ -10677,8 +11333,8 @@ namespace LegionRuntime {
       PerfTracer tracer(context, FILTER_PREV_EPOCH_CALL);
 #endif
 #ifndef LOGICAL_FIELD_TREE
-      for (std::list<LogicalUser>::iterator it = 
-            state.prev_epoch_users.begin(); it != 
+      for (LogicalUserStore<PREV_LOGICAL_ALLOC>::iterator it = 
+            state.prev_epoch_users.begin(field_mask); it != 
             state.prev_epoch_users.end(); /*nothing*/)
       {
         it->field_mask -= field_mask;
@@ -10706,8 +11362,8 @@ namespace LegionRuntime {
       PerfTracer tracer(context, FILTER_CURR_EPOCH_CALL);
 #endif
 #ifndef LOGICAL_FIELD_TREE
-      for (std::list<LogicalUser>::iterator it = 
-              state.curr_epoch_users.begin(); it !=
+      for (LogicalUserStore<CURR_LOGICAL_ALLOC>::iterator it = 
+              state.curr_epoch_users.begin(field_mask); it !=
               state.curr_epoch_users.end(); /*nothing*/)
       {
         FieldMask local_dom = it->field_mask & field_mask;
@@ -10715,8 +11371,9 @@ namespace LegionRuntime {
         {
           // Move a copy over to the previous epoch users for
           // the fields that were dominated
-          state.prev_epoch_users.push_back(*it);
-          state.prev_epoch_users.back().field_mask = local_dom;
+          LogicalUser dominated = *it;
+          dominated.field_mask = local_dom;
+          state.prev_epoch_users.push_back(dominated);
           // Add a mapping reference
           it->op->add_mapping_reference(it->gen);
         }
@@ -10846,18 +11503,22 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(ctx < logical_state_size);
 #endif
-      LogicalState &state = logical_states[ctx];
+      // States are made on demand so if there isn't one yet
+      // then there is nothing to initialize
+      LogicalState *state = find_logical_state(ctx);
+      if (state == NULL)
+        return;
 #ifdef DEBUG_HIGH_LEVEL
       // Technically these should already be empty
-      assert(state.field_versions.size() == 1);
-      assert(state.field_states.empty());
+      assert(state->field_versions.size() == 1);
+      assert(state->field_states.empty());
 #ifndef LOGICAL_FIELD_TREE
-      assert(state.curr_epoch_users.empty());
-      assert(state.prev_epoch_users.empty());
+      assert(state->curr_epoch_users.empty());
+      assert(state->prev_epoch_users.empty());
 #endif
-      assert(state.close_operations.empty());
+      assert(state->close_operations.empty());
 #endif
-      state.reset();
+      state->reset();
     }
 
     //--------------------------------------------------------------------------
@@ -10870,29 +11531,38 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(ctx < logical_state_size);
 #endif
-      LogicalState &state = logical_states[ctx];     
+      LogicalState *state = find_logical_state(ctx);
+      // Nothing to do if the context never touched this node
+      if (state == NULL)
+        return;
 #ifndef LOGICAL_FIELD_TREE
-      for (std::list<LogicalUser>::const_iterator it = 
-            state.curr_epoch_users.begin(); it != 
-            state.curr_epoch_users.end(); it++)
+      for (LogicalUserStore<CURR_LOGICAL_ALLOC>::iterator it = 
+            state->curr_epoch_users.begin(); it != 
+            state->curr_epoch_users.end(); it++)
       {
         it->op->remove_mapping_reference(it->gen); 
       }
-      for (std::list<LogicalUser>::const_iterator it = 
-            state.prev_epoch_users.begin(); it != 
-            state.prev_epoch_users.end(); it++)
+      for (LogicalUserStore<PREV_LOGICAL_ALLOC>::iterator it = 
+            state->prev_epoch_users.begin(); it != 
+            state->prev_epoch_users.end(); it++)
       {
         it->op->remove_mapping_reference(it->gen); 
       }
 #else
       LogicalFieldInvalidator invalidator;
       FieldMask all_ones(FIELD_ALL_ONES);
-      state.curr_epoch_users->
+      state->curr_epoch_users->
         analyze<LogicalFieldInvalidator>(all_ones, invalidator);
-      state.prev_epoch_users->
+      state->prev_epoch_users->
         analyze<LogicalFieldInvalidator>(all_ones, invalidator);
 #endif
-      state.reset();
+      // The context is done with this node so give back the state
+      {
+        AutoLock n_lock(node_lock);
+        logical_states[ctx] = NULL;
+      }
+      legion_delete(state);
+      context->record_state_deletion(false/*physical*/);
     }
 
     //--------------------------------------------------------------------------
@@ -10907,10 +11577,13 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(ctx < logical_state_size);
 #endif
-      LogicalState &state = logical_states[ctx];
+      LogicalState &state = get_logical_state(ctx);
 #ifndef LOGICAL_FIELD_TREE
-      for (std::list<LogicalUser>::iterator it = 
-            state.curr_epoch_users.begin(); it != 
+      // When dominating we have to visit every user since
+      // they are all removed, otherwise only the overlapping ones
+      for (LogicalUserStore<CURR_LOGICAL_ALLOC>::iterator it = DOMINATE ?
+            state.curr_epoch_users.begin() : 
+            state.curr_epoch_users.begin(field_mask); it != 
             state.curr_epoch_users.end(); /*nothing*/)
       {
         if (!(it->field_mask * field_mask))
@@ -10945,8 +11618,9 @@ namespace LegionRuntime {
         else
           it++;
       }
-      for (std::list<LogicalUser>::iterator it = 
-            state.prev_epoch_users.begin(); it != 
+      for (LogicalUserStore<PREV_LOGICAL_ALLOC>::iterator it = DOMINATE ?
+            state.prev_epoch_users.begin() :
+            state.prev_epoch_users.begin(field_mask); it != 
             state.prev_epoch_users.end(); /*nothing*/)
       {
         if (!(it->field_mask * field_mask))
@@ -10998,7 +11672,7 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(ctx < logical_state_size);
 #endif
-      LogicalState &state = logical_states[ctx];
+      LogicalState &state = get_logical_state(ctx);
       coherence_mask |= state.user_level_coherence;
     }
 
@@ -11010,7 +11684,7 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(ctx < logical_state_size);
 #endif
-      LogicalState &state = logical_states[ctx];
+      LogicalState &state = get_logical_state(ctx);
       state.user_level_coherence |= coherence_mask;
     }
 
@@ -11022,7 +11696,7 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(ctx < logical_state_size);
 #endif
-      LogicalState &state = logical_states[ctx];
+      LogicalState &state = get_logical_state(ctx);
       state.user_level_coherence -= coherence_mask;
     }
 
@@ -12318,6 +12992,9 @@ namespace LegionRuntime {
         std::list<PreconditionSet> &precondition_sets)
     //--------------------------------------------------------------------------
     {
+      // The preconditions are visited in event order and each event is
+      // added to a set at most once, so pushing onto the back keeps
+      // every set sorted and free of duplicates
       for (std::map<Event,FieldMask>::iterator pit = 
             preconditions.begin(); pit != preconditions.end(); pit++)
       {
@@ -12332,7 +13009,7 @@ namespace LegionRuntime {
           // Easy case, check for equality
           if (pit->second == it->pre_mask)
           {
-            it->preconditions.insert(pit->first);
+            it->preconditions.push_back(pit->first);
             inserted = true;
             break;
           }
@@ -12349,7 +13026,7 @@ namespace LegionRuntime {
             precondition_sets.push_back(PreconditionSet(overlap));
             PreconditionSet &last = precondition_sets.back();
             last.preconditions = it->preconditions;
-            last.preconditions.insert(pit->first);
+            last.preconditions.push_back(pit->first);
             inserted = true;
             break;
           }
@@ -12358,7 +13035,7 @@ namespace LegionRuntime {
           {
             // Add ourselves to the existing set and then
             // keep going for the remaining fields
-            it->preconditions.insert(pit->first);
+            it->preconditions.push_back(pit->first);
             pit->second -= overlap;
             // Can't consider ourselves added yet
             continue;
@@ -12368,10 +13045,10 @@ namespace LegionRuntime {
           // place and reduce scope, add new one at the
           // end for overlap, continue iterating for right one
           it->pre_mask -= overlap;
-          const std::set<Event> &temp_preconditions = it->preconditions;
+          const std::vector<Event> &temp_preconditions = it->preconditions;
           it = precondition_sets.insert(it, PreconditionSet(overlap));
           it->preconditions = temp_preconditions;
-          it->preconditions.insert(pit->first);
+          it->preconditions.push_back(pit->first);
           pit->second -= overlap;
           continue;
         }
@@ -12379,7 +13056,7 @@ namespace LegionRuntime {
         {
           precondition_sets.push_back(PreconditionSet(pit->second));
           PreconditionSet &last = precondition_sets.back();
-          last.preconditions.insert(pit->first);
+          last.preconditions.push_back(pit->first);
         }
       }
       // For any fields which need copies but don't have
@@ -12802,7 +13479,12 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(ctx < physical_state_size);
 #endif
-      PhysicalState *state = acquire_physical_state(ctx, true/*exclusive*/);
+      // States are made on demand so if there isn't one yet
+      // then there is nothing to initialize
+      PhysicalState *state = find_physical_state(ctx);
+      if (state == NULL)
+        return;
+      acquire_physical_state(state, true/*exclusive*/);
 #ifdef DEBUG_HIGH_LEVEL
       assert(!state->dirty_mask);
       assert(!state->reduction_mask);
@@ -12831,7 +13513,11 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(ctx < physical_state_size);
 #endif
-      PhysicalState *state = acquire_physical_state(ctx, true/*exclusive*/);
+      PhysicalState *state = find_physical_state(ctx);
+      // Nothing to do if the context never touched this node
+      if (state == NULL)
+        return;
+      acquire_physical_state(state, true/*exclusive*/);
 
       state->dirty_mask = FieldMask();
       state->reduction_mask = FieldMask();
@@ -12858,7 +13544,22 @@ namespace LegionRuntime {
           legion_delete(it->first);
       }
       state->reduction_views.clear();
-      release_physical_state(state);
+      // The context is done with this node so give back the state
+      // unless somebody else is still waiting to look at it
+      bool reclaim;
+      {
+        AutoLock n_lock(node_lock);
+        reclaim = (state->acquired_count == 1) && state->requests.empty();
+        if (reclaim)
+          physical_states[ctx] = NULL;
+      }
+      if (reclaim)
+      {
+        legion_delete(state);
+        context->record_state_deletion(true/*physical*/);
+      }
+      else
+        release_physical_state(state);
     }
 
     //--------------------------------------------------------------------------
@@ -13102,9 +13803,9 @@ namespace LegionRuntime {
 
 #ifndef LOGICAL_FIELD_TREE
     //--------------------------------------------------------------------------
-    template<typename ALLOC>
+    template<AllocationType ALLOC>
     FieldMask RegionTreeNode::perform_dependence_checks(
-        const LogicalUser &user, std::list<LogicalUser, ALLOC> &prev_users,
+        const LogicalUser &user, LogicalUserStore<ALLOC> &prev_users,
         const FieldMask &check_mask, bool validates_regions)
     //--------------------------------------------------------------------------
     {
@@ -13119,8 +13820,9 @@ namespace LegionRuntime {
       FieldMask observed_mask;
       FieldMask user_check_mask = user.field_mask & check_mask;
       const bool tracing = user.op->is_tracing();
-      for (std::list<LogicalUser>::iterator it = prev_users.begin();
-            it != prev_users.end(); /*nothing*/)
+      for (typename LogicalUserStore<ALLOC>::iterator it = 
+            prev_users.begin(user_check_mask); it != prev_users.end(); 
+            /*nothing*/)
       {
         if (!(user_check_mask * (it->field_mask & check_mask)))
         {
@@ -13261,9 +13963,9 @@ namespace LegionRuntime {
     }
 
     //--------------------------------------------------------------------------
-    template<typename ALLOC>
+    template<AllocationType ALLOC>
     void RegionTreeNode::perform_closing_checks(
-        LogicalCloser &closer, std::list<LogicalUser, ALLOC> &users, 
+        LogicalCloser &closer, LogicalUserStore<ALLOC> &users, 
         const FieldMask &check_mask)
     //--------------------------------------------------------------------------
     {
@@ -13278,8 +13980,8 @@ namespace LegionRuntime {
       // privilege to read-write to ensure that anyone that comes
       // later also records mapping dependences on the users.
       const FieldMask user_check_mask = closer.user.field_mask & check_mask; 
-      for (std::list<LogicalUser>::iterator it = users.begin();
-            it != users.end(); /*nothing*/)
+      for (typename LogicalUserStore<ALLOC>::iterator it = 
+            users.begin(user_check_mask); it != users.end(); /*nothing*/)
       {
         FieldMask overlap = user_check_mask & it->field_mask;
         if (!overlap)
@@ -14308,14 +15010,10 @@ namespace LegionRuntime {
           row_source->color, logger->get_depth());
       logger->down();
       std::map<Color,FieldMask> to_traverse;
-#ifdef DEBUG_HIGH_LEVEL
-      if (ctx < logical_state_size)
-#else
-      if (ctx < logical_states.size())
-#endif
+      LogicalState *state = find_logical_state(ctx);
+      if (state != NULL)
       {
-        LogicalState &state = logical_states[ctx];
-        print_logical_state(state, capture_mask, to_traverse, logger);  
+        print_logical_state(*state, capture_mask, to_traverse, logger);  
       }
       else
       {
@@ -14347,13 +15045,10 @@ namespace LegionRuntime {
           row_source->color, logger->get_depth());
       logger->down();
       std::map<Color,FieldMask> to_traverse;
-#ifdef DEBUG_HIGH_LEVEL
-      if (ctx < physical_state_size)
-#else
-      if (ctx < physical_states.size())
-#endif
+      PhysicalState *state = find_physical_state(ctx);
+      if (state != NULL)
       {
-        PhysicalState *state = acquire_physical_state(ctx, false/*exclusive*/);
+        acquire_physical_state(state, false/*exclusive*/);
         print_physical_state(state, capture_mask, to_traverse, logger);
         release_physical_state(state);
       }
@@ -14517,9 +15212,9 @@ namespace LegionRuntime {
           row_source->color, logger->get_depth(), this);
       logger->down();
       std::map<Color,FieldMask> to_traverse;
-      if (ctx < logical_state_size)
-        print_logical_state(logical_states[ctx], capture_mask,
-                            to_traverse, logger);
+      LogicalState *state = find_logical_state(ctx);
+      if (state != NULL)
+        print_logical_state(*state, capture_mask, to_traverse, logger);
       else
         logger->log("No state");
       logger->log("");
@@ -14548,9 +15243,9 @@ namespace LegionRuntime {
           row_source->color, logger->get_depth(), this);
       logger->down();
       std::map<Color,FieldMask> to_traverse;
-      if (ctx < physical_state_size)
-        print_physical_state(&(physical_states[ctx]), capture_mask,
-                             to_traverse, logger);
+      PhysicalState *state = find_physical_state(ctx);
+      if (state != NULL)
+        print_physical_state(state, capture_mask, to_traverse, logger);
       else
         logger->log("No state");
       logger->log("");
@@ -15095,14 +15790,10 @@ namespace LegionRuntime {
           row_source->color, disjoint, logger->get_depth());
       logger->down();
       std::map<Color,FieldMask> to_traverse;
-#ifdef DEBUG_HIGH_LEVEL
-      if (ctx < logical_state_size)
-#else
-      if (ctx < logical_states.size())
-#endif
+      LogicalState *state = find_logical_state(ctx);
+      if (state != NULL)
       {
-        LogicalState &state = logical_states[ctx];
-        print_logical_state(state, capture_mask, to_traverse, logger);    
+        print_logical_state(*state, capture_mask, to_traverse, logger);    
       }
       else
       {
@@ -15135,13 +15826,10 @@ namespace LegionRuntime {
           row_source->color, disjoint, logger->get_depth());
       logger->down();
       std::map<Color,FieldMask> to_traverse;
-#ifdef DEBUG_HIGH_LEVEL
-      if (ctx < physical_state_size)
-#else
-      if (ctx < physical_states.size())
-#endif
+      PhysicalState *state = find_physical_state(ctx);
+      if (state != NULL)
       {
-        PhysicalState *state = acquire_physical_state(ctx, false/*exclusive*/);
+        acquire_physical_state(state, false/*exclusive*/);
         print_physical_state(state, capture_mask, to_traverse, logger);
         release_physical_state(state);    
       }
@@ -15306,10 +15994,10 @@ namespace LegionRuntime {
           row_source->color, disjoint, logger->get_depth(), this);
       logger->down();
       std::map<Color,FieldMask> to_traverse;
-      if (ctx < logical_state_size)
+      LogicalState *state = find_logical_state(ctx);
+      if (state != NULL)
       {
-        LogicalState &state = logical_states[ctx];
-        print_logical_state(state, capture_mask, to_traverse, logger);
+        print_logical_state(*state, capture_mask, to_traverse, logger);
       }
       else
       {
@@ -15342,13 +16030,9 @@ namespace LegionRuntime {
           row_source->color, disjoint, logger->get_depth(), this);
       logger->down();
       std::map<Color,FieldMask> to_traverse;
-#ifdef DEBUG_HIGH_LEVEL
-      if (ctx < physical_state_size)
-#else
-      if (ctx < physical_states.size())
-#endif
+      PhysicalState *state = find_physical_state(ctx);
+      if (state != NULL)
       {
-        PhysicalState *state = &(physical_states[ctx]);
         print_physical_state(state, capture_mask, to_traverse, logger);
       }
       else
@@ -17031,8 +17715,10 @@ namespace LegionRuntime {
     }
  
     //--------------------------------------------------------------------------
-    /*static*/ void LogicalView::handle_deferred_collect(LogicalView *view,
-                                             const std::set<Event> &term_events)
+    /*static*/ void LogicalView::handle_deferred_collect(
+                  const std::map<LogicalView*,std::set<Event> > &collections,
+                  size_t &users_reclaimed, size_t &views_deleted,
+                  size_t &bytes_reclaimed)
     //--------------------------------------------------------------------------
     {
  #ifdef LEGION_PROF
@@ -17043,21 +17729,43 @@ namespace LegionRuntime {
                                       0 /* no unique id */,
                                       BEGIN_GC);
 #endif     
-      view->collect_users(term_events);
-      // Then remove the gc reference on the object
-      if (view->remove_gc_reference())
+      // Filter all the users first and then delete any views
+      // which are no longer needed together at the end
+      std::vector<LogicalView*> to_delete;
+      for (std::map<LogicalView*,std::set<Event> >::const_iterator it = 
+            collections.begin(); it != collections.end(); it++)
+      {
+        users_reclaimed += it->first->collect_users(it->second);
+        // Then remove the gc reference on the object
+        if (it->first->remove_gc_reference())
+          to_delete.push_back(it->first);
+      }
+      bytes_reclaimed += users_reclaimed * sizeof(PhysicalUser);
+      for (std::vector<LogicalView*>::const_iterator it = 
+            to_delete.begin(); it != to_delete.end(); it++)
       {
+        LogicalView *view = *it;
         if (view->is_reduction_view())
+        {
+          bytes_reclaimed += sizeof(ReductionView);
           legion_delete(view->as_reduction_view());
+        }
         else
         {
           InstanceView *inst_view = view->as_instance_view();
           if (inst_view->is_composite_view())
+          {
+            bytes_reclaimed += sizeof(CompositeView);
             legion_delete(inst_view->as_composite_view());
+          }
           else
+          {
+            bytes_reclaimed += sizeof(MaterializedView);
             legion_delete(inst_view->as_materialized_view());
+          }
         }
       }
+      views_deleted += to_delete.size();
 #ifdef LEGION_PROF
       LegionProf::register_event(0, PROF_END_GC);
 #endif
@@ -17665,9 +18373,10 @@ namespace LegionRuntime {
     }
 
     //--------------------------------------------------------------------------
-    void MaterializedView::collect_users(const std::set<Event> &term_events)
+    unsigned MaterializedView::collect_users(const std::set<Event> &term_events)
     //--------------------------------------------------------------------------
     {
+      unsigned collected = 0;
       {
         AutoLock v_lock(view_lock);
         bool has_local_events = false;
@@ -17688,13 +18397,14 @@ namespace LegionRuntime {
         if (has_local_events)
         {
           if (term_events.size() == 1)
-            filter_local_users(*(term_events.begin()));
+            collected = filter_local_users(*(term_events.begin()));
           else if (!term_events.empty())
-            filter_local_users(term_events);
+            collected = filter_local_users(term_events);
         }
       }
       if (parent != NULL)
-        parent->collect_users(term_events);
+        collected += parent->collect_users(term_events);
+      return collected;
     } 
 
     //--------------------------------------------------------------------------
@@ -18561,9 +19271,10 @@ namespace LegionRuntime {
     }
 
     //--------------------------------------------------------------------------
-    void MaterializedView::filter_local_users(Event term_event) 
+    unsigned MaterializedView::filter_local_users(Event term_event) 
     //--------------------------------------------------------------------------
     {
+      unsigned filtered = 0;
       // Don't do this if we are in Legion Spy since we want to see
       // all of the dependences on an instance
 #if !defined(LEGION_SPY) && !defined(LEGION_LOGGING) && \
@@ -18574,7 +19285,10 @@ namespace LegionRuntime {
             it != curr_epoch_users.end(); /*nothing*/)
       {
         if (it->term_event == term_event)
+        {
           it = curr_epoch_users.erase(it);
+          filtered++;
+        }
         else
           it++;
       }
@@ -18582,7 +19296,10 @@ namespace LegionRuntime {
             it != prev_epoch_users.end(); /*nothing*/)
       {
         if (it->term_event == term_event)
+        {
           it = prev_epoch_users.erase(it);
+          filtered++;
+        }
         else
           it++;
       }
@@ -18592,13 +19309,15 @@ namespace LegionRuntime {
       prev_epoch_users->analyze<PhysicalEventFilter>(term_mask, filter);
 #endif
 #endif
+      return filtered;
     }
 
     //--------------------------------------------------------------------------
-    void MaterializedView::filter_local_users(
+    unsigned MaterializedView::filter_local_users(
                                              const std::set<Event> &term_events)
     //--------------------------------------------------------------------------
     {
+      unsigned filtered = 0;
       // Don't do this if we are in Legion Spy since we want to see
       // all of the dependences on an instance
 #if !defined(LEGION_SPY) && !defined(LEGION_LOGGING) && \
@@ -18607,7 +19326,10 @@ namespace LegionRuntime {
             it != curr_epoch_users.end(); /*nothing*/)
       {
         if (term_events.find(it->term_event) != term_events.end())
+        {
           it = curr_epoch_users.erase(it);
+          filtered++;
+        }
         else
           it++;
       }
@@ -18615,11 +19337,15 @@ namespace LegionRuntime {
             it != prev_epoch_users.end(); /*nothing*/)
       {
         if (term_events.find(it->term_event) != term_events.end())
+        {
           it = prev_epoch_users.erase(it);
+          filtered++;
+        }
         else
           it++;
       }
 #endif
+      return filtered;
     }
 
     //--------------------------------------------------------------------------
@@ -19468,13 +20194,36 @@ namespace LegionRuntime {
     // CompositeView
     /////////////////////////////////////////////////////////////
 
+    //--------------------------------------------------------------------------
+    CompositeView::FlatCopyPlan::FlatCopyPlan(MaterializedView *d,
+                                              const FieldMask &m)
+      : dst(d), dst_node(d->logical_node), 
+        dst_instance(d->manager->get_instance()), copy_mask(m), 
+        flattenable(true), record_only(Runtime::check_flat_plans)
+    //--------------------------------------------------------------------------
+    {
+    }
+
+    //--------------------------------------------------------------------------
+    bool CompositeView::FlatCopyPlan::matches(MaterializedView *d,
+                                              const FieldMask &m) const
+    //--------------------------------------------------------------------------
+    {
+      // Views can be deleted and their memory reused so check 
+      // the node and the instance in addition to the pointer
+      return ((dst == d) && (dst_node == d->logical_node) &&
+              (dst_instance == d->manager->get_instance()) && 
+              (copy_mask == m));
+    }
+
     //--------------------------------------------------------------------------
     CompositeView::CompositeView(RegionTreeForest *ctx, DistributedID did,
                               AddressSpaceID owner_proc, RegionTreeNode *node,
                               DistributedID owner_did, const FieldMask &mask,
                               CompositeView *par/*= NULL*/)
       : InstanceView(ctx, did, owner_proc, owner_did, node), 
-        parent(par), valid_mask(mask)
+        parent(par), valid_mask(mask), shape_valid(false), 
+        composite_depth(0), composite_nodes(0)
     //--------------------------------------------------------------------------
     {
     }
@@ -19516,6 +20265,12 @@ namespace LegionRuntime {
           legion_delete(it->first);
       }
       valid_reductions.clear();
+      for (std::list<FlatCopyPlan*>::const_iterator it = 
+            flat_plans.begin(); it != flat_plans.end(); it++)
+      {
+        delete (*it);
+      }
+      flat_plans.clear();
     }
 
     //--------------------------------------------------------------------------
@@ -19661,11 +20416,12 @@ namespace LegionRuntime {
     }
 
     //--------------------------------------------------------------------------
-    void CompositeView::collect_users(const std::set<Event> &term_events) 
+    unsigned CompositeView::collect_users(const std::set<Event> &term_events) 
     //--------------------------------------------------------------------------
     {
       // This should never be called
       assert(false);
+      return 0;
     }
 
     //--------------------------------------------------------------------------
@@ -20127,28 +20883,93 @@ namespace LegionRuntime {
 #ifdef DEBUG_HIGH_LEVEL
       assert(!(copy_mask - valid_mask));
 #endif
+      unsigned long long start = 0;
+      if (Runtime::composite_statistics)
+        start = TimeStamp::get_current_time_in_micros();
       std::map<Event,FieldMask> preconditions;
       dst->find_copy_preconditions(0/*redop*/, false/*reading*/,
                                    copy_mask, preconditions);
       // Iterate over all the roots and issue copies to update the 
       // target instance from this particular view
       std::map<Event,FieldMask> postconditions;
-#ifdef DEBUG_HIGH_LEVEL
-      FieldMask accumulate_mask;
-#endif
-      for (std::map<CompositeNode*,FieldMask>::const_iterator it = 
-            roots.begin(); it != roots.end(); it++)
+      bool replayed = false;
+      if (should_flatten())
       {
-        FieldMask overlap = it->second & copy_mask;
-        if (!overlap)
-          continue;
-        it->first->issue_update_copies(info, dst, overlap, overlap,
-                                       preconditions, postconditions);
-#ifdef DEBUG_HIGH_LEVEL
-        assert(overlap * accumulate_mask);
-        accumulate_mask |= overlap;
-#endif
+        // See if we already flattened the copies for this destination,
+        // take a copy of the plan so we don't hold the view lock while
+        // issuing copies (and other threads can evict the plan)
+        FlatCopyPlan snapshot;
+        {
+          AutoLock v_lock(view_lock,1,false/*exclusive*/);
+          for (std::list<FlatCopyPlan*>::const_iterator it = 
+                flat_plans.begin(); it != flat_plans.end(); it++)
+          {
+            if (!(*it)->matches(dst, copy_mask))
+              continue;
+            snapshot = *(*it);
+            replayed = true;
+            break;
+          }
+        }
+        if (replayed)
+          replay_flat_copies(info, dst, snapshot, 
+                             preconditions, postconditions);
+        else
+        {
+          // Walk the tree as usual but remember the copies we issued
+          FlatCopyPlan *plan = new FlatCopyPlan(dst, copy_mask);
+          issue_root_copies(info, dst, copy_mask, 
+                            preconditions, postconditions, plan);
+          if (plan->record_only)
+          {
+            // The walk only recorded its copies, so either the plan
+            // does all the work or we walk again for real
+            if (plan->flattenable)
+            {
+              replay_flat_copies(info, dst, *plan, 
+                                 preconditions, postconditions);
+              replayed = true;
+            }
+            else
+              issue_root_copies(info, dst, copy_mask, 
+                                preconditions, postconditions, NULL/*plan*/);
+          }
+          if (plan->flattenable)
+          {
+            AutoLock v_lock(view_lock);
+            bool duplicate = false;
+            for (std::list<FlatCopyPlan*>::const_iterator it = 
+                  flat_plans.begin(); it != flat_plans.end(); it++)
+            {
+              if ((*it)->matches(dst, copy_mask))
+              {
+                duplicate = true;
+                break;
+              }
+            }
+            if (!duplicate)
+            {
+              flat_plans.push_front(plan);
+              if (flat_plans.size() > DEFAULT_MAX_FLAT_PLANS)
+              {
+                delete flat_plans.back();
+                flat_plans.pop_back();
+              }
+              __sync_fetch_and_add(&context->composite_stats.plans_built, 1);
+            }
+            else
+              delete plan;
+          }
+          else
+          {
+            __sync_fetch_and_add(&context->composite_stats.plans_rejected, 1);
+            delete plan;
+          }
+        }
       }
+      else
+        issue_root_copies(info, dst, copy_mask, 
+                          preconditions, postconditions, NULL/*plan*/);
       // Fun trick here, use the precondition set routine to get the
       // sets of fields which all have the same precondition events
       std::list<PreconditionSet> postcondition_sets;
@@ -20181,6 +21002,11 @@ namespace LegionRuntime {
                            post_set.pre_mask, false/*reading*/,
                            info->local_proc);
       }
+      if (Runtime::composite_statistics)
+      {
+        unsigned long long stop = TimeStamp::get_current_time_in_micros();
+        context->record_composite_copies(stop - start, replayed);
+      }
     }
 
     //--------------------------------------------------------------------------
@@ -20188,12 +21014,23 @@ namespace LegionRuntime {
                                                MaterializedView *dst,
                                                const FieldMask &copy_mask,
                                 const std::map<Event,FieldMask> &preconditions,
-                                      std::map<Event,FieldMask> &postconditions)
+                                      std::map<Event,FieldMask> &postconditions,
+                                               FlatCopyPlan *plan/*= NULL*/,
+                      const std::vector<unsigned> *antecedents/*= NULL*/)
     //--------------------------------------------------------------------------
     {
 #ifdef DEBUG_HIGH_LEVEL
       assert(!(copy_mask - valid_mask));
 #endif
+      // Reductions get flushed based on the postconditions of the
+      // walk which a flattened plan can't capture
+      if ((plan != NULL) && !valid_reductions.empty() && 
+          !(reduction_mask * copy_mask))
+        plan->flattenable = false;
+      // A plan that only records can stop here, it gets thrown
+      // away and the whole update is walked again
+      if ((plan != NULL) && plan->record_only && !plan->flattenable)
+        return;
       std::map<Event,FieldMask> local_postconditions;
 #ifdef DEBUG_HIGH_LEVEL
       FieldMask accumulate_mask;
@@ -20205,7 +21042,8 @@ namespace LegionRuntime {
         if (!overlap)
           continue;
         it->first->issue_update_copies(info, dst, overlap, overlap,
-                                       preconditions, local_postconditions);
+                                       preconditions, local_postconditions,
+                                       plan, antecedents);
 #ifdef DEBUG_HIGH_LEVEL
         assert(overlap * accumulate_mask);
         accumulate_mask |= overlap;
@@ -20249,6 +21087,151 @@ namespace LegionRuntime {
       }
     }
 
+    //--------------------------------------------------------------------------
+    void CompositeView::get_shape(unsigned &depth, unsigned &nodes)
+    //--------------------------------------------------------------------------
+    {
+      {
+        AutoLock v_lock(view_lock,1,false/*exclusive*/);
+        if (shape_valid)
+        {
+          depth = composite_depth;
+          nodes = composite_nodes;
+          return;
+        }
+      }
+      compute_shape();
+      AutoLock v_lock(view_lock,1,false/*exclusive*/);
+      depth = composite_depth;
+      nodes = composite_nodes;
+    }
+
+    //--------------------------------------------------------------------------
+    void CompositeView::compute_shape(void)
+    //--------------------------------------------------------------------------
+    {
+      unsigned nested_depth = 0;
+      unsigned nodes = 0;
+      for (std::map<CompositeNode*,FieldMask>::const_iterator it = 
+            roots.begin(); it != roots.end(); it++)
+      {
+        it->first->find_shape(nested_depth, nodes);
+      }
+      AutoLock v_lock(view_lock);
+      composite_depth = nested_depth + 1;
+      composite_nodes = nodes;
+      shape_valid = true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool CompositeView::should_flatten(void)
+    //--------------------------------------------------------------------------
+    {
+      if ((Runtime::flatten_depth == 0) && (Runtime::flatten_nodes == 0))
+        return false;
+      unsigned depth, nodes;
+      get_shape(depth, nodes);
+      if ((Runtime::flatten_depth > 0) && (depth >= Runtime::flatten_depth))
+        return true;
+      if ((Runtime::flatten_nodes > 0) && (nodes >= Runtime::flatten_nodes))
+        return true;
+      return false;
+    }
+
+    //--------------------------------------------------------------------------
+    void CompositeView::issue_root_copies(MappableInfo *info,
+                                          MaterializedView *dst,
+                                          const FieldMask &copy_mask,
+                                const std::map<Event,FieldMask> &preconditions,
+                                      std::map<Event,FieldMask> &postconditions,
+                                          FlatCopyPlan *plan)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_HIGH_LEVEL
+      FieldMask accumulate_mask;
+#endif
+      for (std::map<CompositeNode*,FieldMask>::const_iterator it = 
+            roots.begin(); it != roots.end(); it++)
+      {
+        FieldMask overlap = it->second & copy_mask;
+        if (!overlap)
+          continue;
+        it->first->issue_update_copies(info, dst, overlap, overlap,
+                                       preconditions, postconditions, plan);
+#ifdef DEBUG_HIGH_LEVEL
+        assert(overlap * accumulate_mask);
+        accumulate_mask |= overlap;
+#endif
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void CompositeView::replay_flat_copies(MappableInfo *info,
+                                           MaterializedView *dst,
+                                           const FlatCopyPlan &plan,
+                                const std::map<Event,FieldMask> &preconditions,
+                                      std::map<Event,FieldMask> &postconditions)
+    //--------------------------------------------------------------------------
+    {
+      // Issue the same copies the walk did, the sources still have to 
+      // be checked for new users but the destination preconditions 
+      // only come from the original preconditions and earlier steps
+      std::vector<std::map<Event,FieldMask> > step_postconditions(
+                                                          plan.steps.size());
+      for (unsigned idx = 0; idx < plan.steps.size(); idx++)
+      {
+        const FlatCopyStep &step = plan.steps[idx];
+        std::map<Event,FieldMask> update_preconditions;
+        for (std::map<MaterializedView*,FieldMask>::const_iterator it = 
+              step.src_instances.begin(); it != 
+              step.src_instances.end(); it++)
+        {
+          it->first->find_copy_preconditions(0/*redop*/, true/*reading*/,
+                                             it->second, update_preconditions);
+        }
+        for (std::map<Event,FieldMask>::const_iterator it = 
+              preconditions.begin(); it != preconditions.end(); it++)
+        {
+          FieldMask overlap = step.update_mask & it->second;
+          if (!overlap)
+            continue;
+          std::map<Event,FieldMask>::iterator finder = 
+            update_preconditions.find(it->first);
+          if (finder == update_preconditions.end())
+            update_preconditions[it->first] = overlap;
+          else
+            finder->second |= overlap;
+        }
+        for (std::vector<unsigned>::const_iterator ait = 
+              step.antecedents.begin(); ait != step.antecedents.end(); ait++)
+        {
+#ifdef DEBUG_HIGH_LEVEL
+          assert((*ait) < idx);
+#endif
+          const std::map<Event,FieldMask> &previous = 
+            step_postconditions[*ait];
+          for (std::map<Event,FieldMask>::const_iterator it = 
+                previous.begin(); it != previous.end(); it++)
+          {
+            FieldMask overlap = step.update_mask & it->second;
+            if (!overlap)
+              continue;
+            std::map<Event,FieldMask>::iterator finder = 
+              update_preconditions.find(it->first);
+            if (finder == update_preconditions.end())
+              update_preconditions[it->first] = overlap;
+            else
+              finder->second |= overlap;
+          }
+        }
+        RegionTreeNode::issue_grouped_copies(info, dst, update_preconditions,
+                                   step.update_mask, step.intersections,
+                                   step.src_instances, step_postconditions[idx]);
+        postconditions.insert(step_postconditions[idx].begin(),
+                              step_postconditions[idx].end());
+      }
+    }
+
     //--------------------------------------------------------------------------
     void CompositeView::issue_composite_copies_across(MappableInfo *info,
                                                       MaterializedView *dst,
@@ -20301,7 +21284,7 @@ namespace LegionRuntime {
                                          MaterializedView *dst,
                                          const FieldMask &event_mask,
                                  const std::map<Event,FieldMask> &preconditions,
-                                         std::set<Event> &event_set)
+                                         std::vector<Event> &event_set)
     //--------------------------------------------------------------------------
     {
 #ifdef DEBUG_HIGH_LEVEL
@@ -20326,7 +21309,8 @@ namespace LegionRuntime {
         // Make sure that all the events in the event_set are
         // included in the reduction preconditions because they
         // are copies are also writing to the fields.
-        std::set<Event> reduce_preconditions = event_set;
+        std::set<Event> reduce_preconditions(event_set.begin(),
+                                             event_set.end());
         for (std::map<Event,FieldMask>::const_iterator it = 
               preconditions.begin(); it != preconditions.end(); it++)
         {
@@ -20350,7 +21334,7 @@ namespace LegionRuntime {
                                           finder->second.intersections);
           // Add the result to the set of post conditions
           if (result.exists())
-            event_set.insert(result);
+            event_set.push_back(result);
         }
       }
     }
@@ -20514,6 +21498,14 @@ namespace LegionRuntime {
           }
         }
       }
+      // The tree changed so our shape and any plans are stale
+      shape_valid = false;
+      for (std::list<FlatCopyPlan*>::const_iterator it = 
+            flat_plans.begin(); it != flat_plans.end(); it++)
+      {
+        delete (*it);
+      }
+      flat_plans.clear();
       if (need_lock)
         view_lock.release();
     }
@@ -20882,12 +21874,18 @@ namespace LegionRuntime {
                                             FieldMask traversal_mask,
                                             const FieldMask &copy_mask,
                                       const std::map<Event,FieldMask> &preconds,
-                                      std::map<Event,FieldMask> &postconditions)
+                                      std::map<Event,FieldMask> &postconditions,
+                                   CompositeView::FlatCopyPlan *plan/*= NULL*/,
+                         const std::vector<unsigned> *antecedents/*= NULL*/)
     //--------------------------------------------------------------------------
     {
       // First check to see if any of our children are complete
       // If they are then we can skip issuing any copies from this level
       std::map<Event,FieldMask> dst_preconditions = preconds;
+      // When flattening, the steps behind the preconditions our children see
+      std::vector<unsigned> dst_antecedents;
+      if ((plan != NULL) && (antecedents != NULL))
+        dst_antecedents = *antecedents;
       if (!valid_views.empty())
       {
         // The fields we need to update are any in the traversal
@@ -20952,10 +21950,23 @@ namespace LegionRuntime {
             }
             // Now we have our preconditions so we can issue our copy
             std::map<Event,FieldMask> update_postconditions;
-            RegionTreeNode::issue_grouped_copies(info, dst, 
-                         update_preconditions, update_mask, 
-                         find_intersection_domains(dst->logical_node),
-                         src_instances, update_postconditions);
+            if ((plan == NULL) || !plan->record_only)
+              RegionTreeNode::issue_grouped_copies(info, dst, 
+                           update_preconditions, update_mask, 
+                           find_intersection_domains(dst->logical_node),
+                           src_instances, update_postconditions);
+            if (plan != NULL)
+            {
+              dst_antecedents.push_back(plan->steps.size());
+              plan->steps.push_back(CompositeView::FlatCopyStep());
+              CompositeView::FlatCopyStep &step = plan->steps.back();
+              step.src_instances = src_instances;
+              step.update_mask = update_mask;
+              step.intersections = 
+                find_intersection_domains(dst->logical_node);
+              if (antecedents != NULL)
+                step.antecedents = *antecedents;
+            }
             // If we dominate the target, then we can remove
             // the update_mask fields from the traversal_mask
             if (dominates(dst->logical_node))
@@ -20994,8 +22005,17 @@ namespace LegionRuntime {
                   composite_instances.end(); it++)
             {
               std::map<Event,FieldMask> postconds;
+              const unsigned first_step = 
+                (plan == NULL) ? 0 : plan->steps.size();
               it->first->issue_composite_copies(info, dst, it->second,
-                                                preconds, postconds);
+                                                preconds, postconds,
+                                                plan, antecedents);
+              if (plan != NULL)
+              {
+                for (unsigned idx = first_step; 
+                      idx < plan->steps.size(); idx++)
+                  dst_antecedents.push_back(idx);
+              }
               update_mask |= it->second;
               if (!postconds.empty())
               {
@@ -21033,7 +22053,8 @@ namespace LegionRuntime {
         // If we make it here then we need to traverse the child
         it->first->issue_update_copies(info, dst, traversal_mask, 
                                        overlap, dst_preconditions, 
-                                       postconditions);
+                                       postconditions, plan,
+                                 (plan == NULL) ? NULL : &dst_antecedents);
       }
     }
 
@@ -21217,6 +22238,29 @@ namespace LegionRuntime {
       }
     }
 
+    //--------------------------------------------------------------------------
+    void CompositeNode::find_shape(unsigned &nested_depth, unsigned &nodes)
+    //--------------------------------------------------------------------------
+    {
+      nodes++;
+      for (std::map<InstanceView*,FieldMask>::const_iterator it = 
+            valid_views.begin(); it != valid_views.end(); it++)
+      {
+        if (!it->first->is_composite_view())
+          continue;
+        unsigned depth, nested_nodes;
+        it->first->as_composite_view()->get_shape(depth, nested_nodes);
+        if (depth > nested_depth)
+          nested_depth = depth;
+        nodes += nested_nodes;
+      }
+      for (std::map<CompositeNode*,ChildInfo>::const_iterator it = 
+            open_children.begin(); it != open_children.end(); it++)
+      {
+        it->first->find_shape(nested_depth, nodes);
+      }
+    }
+
     //--------------------------------------------------------------------------
     void CompositeNode::add_gc_references(void)
     //--------------------------------------------------------------------------
@@ -22010,9 +23054,10 @@ namespace LegionRuntime {
     }
 
     //--------------------------------------------------------------------------
-    void ReductionView::collect_users(const std::set<Event> &term_events)
+    unsigned ReductionView::collect_users(const std::set<Event> &term_events)
     //--------------------------------------------------------------------------
     {
+      unsigned collected = 0;
       AutoLock v_lock(view_lock);
       bool has_local_references = false;
       for (std::set<Event>::const_iterator it = term_events.begin();
@@ -22035,7 +23080,10 @@ namespace LegionRuntime {
               it != reduction_users.end(); /*nothing*/)
         {
           if (term_events.find(it->term_event) != term_events.end())
+          {
             it = reduction_users.erase(it);
+            collected++;
+          }
           else
             it++;
         }
@@ -22043,12 +23091,16 @@ namespace LegionRuntime {
               it != reading_users.end(); /*nothing*/)
         {
           if (term_events.find(it->term_event) != term_events.end())
+          {
             it = reading_users.erase(it);
+            collected++;
+          }
           else
             it++;
         }
       }
 #endif
+      return collected;
     }
 
     //--------------------------------------------------------------------------
@@ -22817,7 +23869,7 @@ namespace LegionRuntime {
     //--------------------------------------------------------------------------
     {
       // Allocate the first entry
-      ptr_buffer[0] = new T[INC_SIZE];
+      ptr_buffer[0] = new T[INC_SIZE]();
       buffer_size = 1;
       remaining = INC_SIZE;
     }
@@ -22886,7 +23938,7 @@ namespace LegionRuntime {
 #endif
       // Allocate new arrays
       for (unsigned idx = 0; idx < new_arrays; idx++)
-        ptr_buffer[buffer_size+idx] = new T[INC_SIZE];
+        ptr_buffer[buffer_size+idx] = new T[INC_SIZE]();
       remaining = append_count % INC_SIZE;
       buffer_size += new_arrays;
     }
@@ -434,11 +434,77 @@ namespace LegionRuntime {
     public:
       bool perform_dynamic_tests(unsigned num_tests);
       void add_disjointness_test(const DynamicPartTest &test);
+#endif
+    public:
       static bool are_disjoint(const Domain &left,
                                const Domain &right);
       static bool are_disjoint(IndexSpaceNode *left,
                                IndexSpaceNode *right);
-#endif
+    public:
+      // Counters for the intersection caches on index tree nodes
+      struct IntersectionStatistics {
+      public:
+        IntersectionStatistics(void)
+          : cache_hits(0), cache_misses(0), cache_evictions(0),
+            graph_hits(0), graphs_built(0) { }
+      public:
+        unsigned long long cache_hits;
+        unsigned long long cache_misses;
+        unsigned long long cache_evictions;
+        unsigned long long graph_hits;
+        unsigned long long graphs_built;
+      };
+      IntersectionStatistics intersection_stats;
+    public:
+      // Accounting for the per-context states of region tree nodes
+      void record_state_creation(bool physical);
+      void record_state_deletion(bool physical);
+      void report_state_footprint(void);
+    public:
+      struct StateFootprint {
+      public:
+        StateFootprint(void)
+          : logical_states(0), physical_states(0),
+            peak_logical_states(0), peak_physical_states(0),
+            state_bytes(0), peak_state_bytes(0) { }
+      public:
+        unsigned long long logical_states;
+        unsigned long long physical_states;
+        unsigned long long peak_logical_states;
+        unsigned long long peak_physical_states;
+        // Bytes of both kinds of state resident together, so the
+        // peak is the high-water mark and not the sum of two peaks
+        unsigned long long state_bytes;
+        unsigned long long peak_state_bytes;
+      };
+      StateFootprint state_footprint;
+    public:
+      // Shape of the composite views made by closes and the cost
+      // of issuing copies out of them
+      void record_composite_view(unsigned depth, unsigned nodes);
+      void record_composite_copies(unsigned long long time, bool replayed);
+      void report_composite_statistics(void);
+    public:
+      struct CompositeStatistics {
+      public:
+        CompositeStatistics(void)
+          : views(0), total_depth(0), max_depth(0), total_nodes(0),
+            max_nodes(0), copy_issues(0), copy_time(0), plan_replays(0),
+            replay_time(0), plans_built(0), plans_rejected(0) { }
+      public:
+        unsigned long long views;
+        unsigned long long total_depth;
+        unsigned long long max_depth;
+        unsigned long long total_nodes;
+        unsigned long long max_nodes;
+        unsigned long long copy_issues;
+        unsigned long long copy_time;
+        unsigned long long plan_replays;
+        unsigned long long replay_time;
+        unsigned long long plans_built;
+        unsigned long long plans_rejected;
+      };
+      CompositeStatistics composite_stats;
 #ifdef DEBUG_PERF
     public:
       void record_call(int kind, unsigned long long time);
@@ -619,6 +685,41 @@ namespace LegionRuntime {
       NodeMask node_mask;
     };
 
+    /**
+     * \class IntersectionCache
+     * A bounded cache of the answers to intersection and
+     * dominance queries between an index tree node and other
+     * nodes.  Eviction approximates LRU with a clock: lookups
+     * set a referenced bit on the entry and the clock hand
+     * skips (and clears) referenced entries when looking for
+     * a victim.  Lookups only need a read lock on the node
+     * since setting the referenced bit is just a hint.
+     */
+    class IntersectionCache {
+    public:
+      struct CacheEntry {
+      public:
+        CacheEntry(void)
+          : node(NULL), result(false), referenced(false) { }
+        CacheEntry(IndexTreeNode *n, bool r)
+          : node(n), result(r), referenced(true) { }
+      public:
+        IndexTreeNode *node;
+        bool result;
+        volatile bool referenced;
+      };
+    public:
+      IntersectionCache(void);
+    public:
+      bool find(IndexTreeNode *node, bool &result);
+      // Returns true if an entry was evicted, max of zero is unbounded
+      bool insert(IndexTreeNode *node, bool result, size_t max_entries);
+    private:
+      std::vector<CacheEntry> entries;
+      std::map<IndexTreeNode*,unsigned> entry_index;
+      unsigned clock_hand;
+    };
+
     /**
      * \class IndexTreeNode
      * The abstract base class for nodes in the index space trees.
@@ -665,6 +766,15 @@ namespace LegionRuntime {
                                        Domain &result);
       static bool compute_dominates(const std::set<Domain> &left_set,
                                     const std::set<Domain> &right_set);
+      static bool compute_intersects(const std::set<Domain> &left,
+                                     const std::set<Domain> &right);
+      static bool compute_intersects(const std::set<Domain> &left,
+                                     const Domain &right);
+    protected:
+      bool find_cached_intersection(IndexTreeNode *other, bool &result);
+      void cache_intersection(IndexTreeNode *other, bool result);
+      bool find_cached_dominator(IndexTreeNode *other, bool &result);
+      void cache_dominator(IndexTreeNode *other, bool result);
     public:
       const unsigned depth;
       const Color color;
@@ -675,8 +785,12 @@ namespace LegionRuntime {
     protected:
       Reservation node_lock;
     protected:
+      // Intersection domains are handed out by reference so
+      // they are kept for the lifetime of the node, the 
+      // yes/no answers go in the bounded caches
       std::map<IndexTreeNode*,IntersectInfo> intersections;
-      std::map<IndexTreeNode*,bool> dominators;
+      IntersectionCache intersect_cache;
+      IntersectionCache dominator_cache;
     protected:
       std::map<SemanticTag,SemanticInfo> semantic_info;
     };
@@ -763,6 +877,15 @@ namespace LegionRuntime {
      * A node for representing a generic index partition.
      */
     class IndexPartNode : public IndexTreeNode { 
+    public:
+      // Number of children whose interference each task computes
+      static const unsigned INTERFERENCE_ROWS_PER_TASK = 32;
+      struct InterferenceArgs {
+      public:
+        HLRTaskID hlr_id;
+        IndexPartNode *node;
+        unsigned start, stop;
+      };
     public:
       IndexPartNode(IndexPartition p, IndexSpaceNode *par,
                     Color c, Domain color_space, bool dis,
@@ -789,6 +912,9 @@ namespace LegionRuntime {
       bool are_disjoint(Color c1, Color c2);
       void add_disjoint(Color c1, Color c2);
       bool is_complete(void);
+    public:
+      void build_interference_graph(const std::vector<IndexSpaceNode*> &kids);
+      void compute_interference_rows(unsigned start, unsigned stop);
     public:
       void add_instance(PartitionNode *inst);
       bool has_instance(RegionTreeID tid);
@@ -825,6 +951,15 @@ namespace LegionRuntime {
       std::map<Color,IndexSpaceNode*> valid_map;
       std::set<PartitionNode*> logical_nodes;
       std::set<std::pair<Color,Color> > disjoint_subspaces;
+    private:
+      // Interference graph for aliased partitions, one row of
+      // interfering colors per child sorted by color.  The rows 
+      // are only read once the graph is complete.
+      std::vector<Color> interference_colors;
+      std::vector<IndexSpaceNode*> interference_nodes;
+      std::vector<std::vector<Color> > interference_rows;
+      unsigned pending_interference_tasks;
+      volatile bool interference_complete;
     };
 
     /**
@@ -1156,6 +1291,155 @@ namespace LegionRuntime {
       unsigned rebuild_timeout;
     }; 
 
+    /**
+     * \class LogicalUserStore
+     * A contiguous store of logical users for one epoch of a
+     * logical state.  Users live in slots which are recycled
+     * when users are erased.  Once the number of users grows
+     * past Runtime::logical_index_threshold the store also
+     * maintains a bucket of slots for each field along with
+     * a summary mask of the fields that have buckets, so
+     * iterating over the users of a field mask only visits
+     * users that might overlap.  Bucket entries are validated
+     * lazily against the slot generation and field mask, so
+     * callers are free to remove fields from users or erase
+     * them while iterating.  Each indexed traversal gets its
+     * own list of candidate slots, so traversals can nest.
+     *
+     * Recycling slots means slot order is not insertion order.
+     * That is safe because the users of one epoch that share
+     * a field never interfere with each other (an interfering
+     * user ends the epoch for that field), so the dependences
+     * and dominator masks computed against them do not depend
+     * on the order in which they are visited.
+     */
+    template<AllocationType A>
+    class LogicalUserStore {
+    public:
+      // Number of extra slots each indexed traversal visits so
+      // users that are never queried still get timed out
+      static const unsigned SWEEP_SLOTS = 2;
+    public:
+      struct UserSlot {
+      public:
+        UserSlot(void)
+          : generation(0), stamp(0), valid(false) { }
+      public:
+        LogicalUser user;
+        unsigned generation;
+        unsigned stamp;
+        bool valid;
+      };
+      struct IndexEntry {
+      public:
+        IndexEntry(void) { }
+        IndexEntry(unsigned s, unsigned g)
+          : slot(s), generation(g) { }
+      public:
+        unsigned slot;
+        unsigned generation;
+      };
+      // The slots an indexed traversal visits, shared by the copies
+      // of its iterator and handed back to the store by the last one
+      struct CandidateList {
+      public:
+        CandidateList(void)
+          : references(0) { }
+      public:
+        std::vector<unsigned> slots;
+        unsigned references;
+      };
+    public:
+      class iterator {
+      public:
+        iterator(void)
+          : store(NULL), candidates(NULL), slot(INVALID_SLOT), next(0) { }
+        iterator(const iterator &rhs)
+          : store(rhs.store), candidates(rhs.candidates), 
+            slot(rhs.slot), next(rhs.next)
+          { if (candidates != NULL) candidates->references++; }
+        ~iterator(void) { release(); }
+      public:
+        inline iterator& operator=(const iterator &rhs)
+        {
+          if (rhs.candidates != NULL)
+            rhs.candidates->references++;
+          release();
+          store = rhs.store;
+          candidates = rhs.candidates;
+          slot = rhs.slot;
+          next = rhs.next;
+          return *this;
+        }
+        inline LogicalUser& operator*(void) const
+          { return store->slots[slot].user; }
+        inline LogicalUser* operator->(void) const
+          { return &(store->slots[slot].user); }
+        inline iterator& operator++(void)
+          { store->advance(*this); return *this; }
+        inline iterator operator++(int)
+          { iterator result = *this; store->advance(*this); return result; }
+        inline bool operator==(const iterator &rhs) const
+          { return (slot == rhs.slot); }
+        inline bool operator!=(const iterator &rhs) const
+          { return (slot != rhs.slot); }
+      private:
+        inline void release(void)
+        {
+          if ((candidates != NULL) && (--(candidates->references) == 0))
+            store->free_candidates.push_back(candidates);
+          candidates = NULL;
+        }
+      private:
+        friend class LogicalUserStore<A>;
+        LogicalUserStore<A> *store;
+        // NULL unless this is an indexed traversal
+        CandidateList *candidates;
+        unsigned slot;
+        size_t next;
+      };
+      friend class iterator;
+    public:
+      static const unsigned INVALID_SLOT = 0xFFFFFFFF;
+    public:
+      LogicalUserStore(void);
+      LogicalUserStore(const LogicalUserStore<A> &rhs);
+      ~LogicalUserStore(void);
+    public:
+      LogicalUserStore<A>& operator=(const LogicalUserStore<A> &rhs);
+    public:
+      // Visit all the users in slot order
+      iterator begin(void);
+      // Visit a superset of the users that overlap the mask
+      iterator begin(const FieldMask &mask);
+      inline iterator end(void) const { return iterator(); }
+      iterator erase(iterator it);
+      void push_back(const LogicalUser &user);
+      void clear(void);
+      inline bool empty(void) const { return (live_users == 0); }
+      inline size_t size(void) const { return live_users; }
+      inline bool is_indexed(void) const { return indexed; }
+    protected:
+      void advance(iterator &it);
+      void build_index(void);
+      void index_user(unsigned slot);
+    protected:
+      typename LegionContainer<UserSlot,A>::vector slots;
+      std::vector<unsigned> free_slots;
+      size_t live_users;
+      // The field index, only populated when indexed
+      bool indexed;
+      FieldMask indexed_fields;
+      // Buckets are only created up to the highest indexed field
+      std::vector<std::vector<IndexEntry> > field_buckets;
+      size_t index_entries;
+      size_t erased_users;
+      // Candidate lists no traversal is using right now
+      std::vector<CandidateList*> free_candidates;
+      unsigned current_stamp;
+      unsigned sweep_cursor;
+    };
+
     /**
      * \struct LogicalState
      * Track the version states for a given logical
@@ -1164,6 +1448,8 @@ namespace LegionRuntime {
      * needed to be performed.
      */
     struct LogicalState {
+    public:
+      static const AllocationType alloc_type = LOGICAL_STATE_ALLOC;
     public:
       LogicalState(void);
       LogicalState(const LogicalState &state);
@@ -1177,8 +1463,8 @@ namespace LegionRuntime {
                      LOGICAL_FIELD_VERSIONS_ALLOC>::map field_versions;
       LegionContainer<FieldState,LOGICAL_FIELD_STATE_ALLOC>::list field_states;
 #ifndef LOGICAL_FIELD_TREE
-      LegionContainer<LogicalUser,CURR_LOGICAL_ALLOC>::list curr_epoch_users;
-      LegionContainer<LogicalUser,PREV_LOGICAL_ALLOC>::list prev_epoch_users;
+      LogicalUserStore<CURR_LOGICAL_ALLOC> curr_epoch_users;
+      LogicalUserStore<PREV_LOGICAL_ALLOC> prev_epoch_users;
 #else
       FieldTree<LogicalUser> *curr_epoch_users;
       FieldTree<LogicalUser> *prev_epoch_users;
@@ -1305,6 +1591,8 @@ namespace LegionRuntime {
      * reduction and instance views.
      */
     struct PhysicalState {
+    public:
+      static const AllocationType alloc_type = PHYSICAL_STATE_ALLOC;
     public:
       PhysicalState(void);
       PhysicalState(ContextID ctx);
@@ -1568,6 +1856,8 @@ namespace LegionRuntime {
      * to shrink.  They are always maintained in a consistent state
      * so they can be accessed even when being appended to.  We assume
      * that there is only one appender at a time.  Access time is O(1).
+     * New entries are value initialized so stacks of pointers start
+     * out with every entry NULL.
      */
     template<typename T, int MAX_SIZE, int INC_SIZE>
     class LegionStack {
@@ -1592,6 +1882,8 @@ namespace LegionRuntime {
      * \struct PreconditionSet
      * A helper class for building sets of fields with 
      * a common set of preconditions for doing copies.
+     * The preconditions are kept in a vector so they can
+     * be handed straight to the array form of merge_events.
      */
     struct PreconditionSet {
     public:
@@ -1600,7 +1892,7 @@ namespace LegionRuntime {
         : pre_mask(m) { }
     public:
       FieldMask pre_mask;
-      std::set<Event> preconditions;
+      std::vector<Event> preconditions;
     };
 
     /**
@@ -1618,7 +1910,9 @@ namespace LegionRuntime {
     public:
       void reserve_contexts(unsigned num_contexts);
       LogicalState& get_logical_state(ContextID ctx);
+      LogicalState* find_logical_state(ContextID ctx);
       PhysicalState* acquire_physical_state(ContextID ctx, bool exclusive);
+      PhysicalState* find_physical_state(ContextID ctx);
       void acquire_physical_state(PhysicalState *state, bool exclusive);
       bool release_physical_state(PhysicalState *state);
     public:
@@ -1867,13 +2161,13 @@ namespace LegionRuntime {
     public:
 #ifndef LOGICAL_FIELD_TREE
       // Logical helper operations
-      template<typename ALLOC> 
+      template<AllocationType ALLOC> 
       FieldMask perform_dependence_checks(const LogicalUser &user, 
-            std::list<LogicalUser, ALLOC> &users, const FieldMask &check_mask,
+            LogicalUserStore<ALLOC> &users, const FieldMask &check_mask,
             bool validates_regions);
-      template<typename ALLOC>
+      template<AllocationType ALLOC>
       void perform_closing_checks(LogicalCloser &closer,
-            std::list<LogicalUser, ALLOC> &users, const FieldMask &check_mask);
+            LogicalUserStore<ALLOC> &users, const FieldMask &check_mask);
 #else
       FieldMask perform_dependence_checks(const LogicalUser &user,
             FieldTree<LogicalUser> *users, const FieldMask &check_mask,
@@ -1892,8 +2186,11 @@ namespace LegionRuntime {
       NodeMask destruction_set;
     protected:
       Reservation node_lock;
-      LegionStack<LogicalState,MAX_CONTEXTS,DEFAULT_CONTEXTS> logical_states;
-      LegionStack<PhysicalState,MAX_CONTEXTS,DEFAULT_CONTEXTS> physical_states;
+      // States are only made the first time a context touches this
+      // node and are given back when the context is invalidated
+      LegionStack<LogicalState*,MAX_CONTEXTS,DEFAULT_CONTEXTS> logical_states;
+      LegionStack<PhysicalState*,MAX_CONTEXTS,DEFAULT_CONTEXTS> 
+                                                            physical_states;
 #ifdef DEBUG_HIGH_LEVEL
       // Uses these for debugging to avoid races accessing
       // the logical and physical deques to check for size
@@ -2881,9 +3178,12 @@ namespace LegionRuntime {
       virtual void notify_invalid(void) = 0;
     public:
       void defer_collect_user(Event term_event);
-      virtual void collect_users(const std::set<Event> &term_events) = 0;
-      static void handle_deferred_collect(LogicalView *view,
-                                          const std::set<Event> &term_events);
+      // Returns the number of users that were removed
+      virtual unsigned collect_users(const std::set<Event> &term_events) = 0;
+      static void handle_deferred_collect(
+            const std::map<LogicalView*,std::set<Event> > &collections,
+            size_t &users_reclaimed, size_t &views_deleted,
+            size_t &bytes_reclaimed);
     public:
       void send_back_user(const PhysicalUser &user);
       virtual void process_send_back_user(AddressSpaceID source,
@@ -2937,7 +3237,7 @@ namespace LegionRuntime {
       virtual void notify_valid(void) = 0;
       virtual void notify_invalid(void) = 0;
     public:
-      virtual void collect_users(const std::set<Event> &term_events) = 0;
+      virtual unsigned collect_users(const std::set<Event> &term_events) = 0;
     public:
       virtual void process_send_back_user(AddressSpaceID source,
                                           PhysicalUser &user) = 0;
@@ -3036,7 +3336,7 @@ namespace LegionRuntime {
       virtual void garbage_collect(void);
       virtual void notify_valid(void);
       virtual void notify_invalid(void);
-      virtual void collect_users(const std::set<Event> &term_users);
+      virtual unsigned collect_users(const std::set<Event> &term_users);
       virtual void process_send_back_user(AddressSpaceID source,
                                           PhysicalUser &user);
     protected:
@@ -3060,8 +3360,8 @@ namespace LegionRuntime {
                                     const FieldMask &user_mask,
                                     Color child_color);
       void update_versions(const FieldMask &update_mask);
-      void filter_local_users(Event term_event);
-      void filter_local_users(const std::set<Event> &term_events);
+      unsigned filter_local_users(Event term_event);
+      unsigned filter_local_users(const std::set<Event> &term_events);
       template<typename ALLOC>
       void condense_user_list(std::list<PhysicalUser,ALLOC> &users, 
                               bool previous);
@@ -3147,6 +3447,35 @@ namespace LegionRuntime {
         FieldMask valid_fields;
         std::set<Domain> intersections;
       };
+      // One group of copies issued while walking the composite tree
+      struct FlatCopyStep {
+      public:
+        std::map<MaterializedView*,FieldMask> src_instances;
+        FieldMask update_mask;
+        std::set<Domain> intersections;
+        // Earlier steps whose copies must finish before this one
+        std::vector<unsigned> antecedents;
+      };
+      // The flattened list of copies that updating one destination
+      // needed so later updates of it don't walk the tree again
+      struct FlatCopyPlan {
+      public:
+        FlatCopyPlan(void)
+          : dst(NULL), dst_node(NULL), flattenable(true), 
+            record_only(false) { }
+        FlatCopyPlan(MaterializedView *d, const FieldMask &m);
+      public:
+        bool matches(MaterializedView *d, const FieldMask &m) const;
+      public:
+        MaterializedView *dst;
+        RegionTreeNode *dst_node;
+        PhysicalInstance dst_instance;
+        FieldMask copy_mask;
+        std::vector<FlatCopyStep> steps;
+        bool flattenable;
+        // Build the plan without issuing the walk's copies
+        bool record_only;
+      };
     public:
       CompositeView(RegionTreeForest *ctx, DistributedID did,
                     AddressSpaceID owner_proc, RegionTreeNode *node, 
@@ -3177,7 +3506,7 @@ namespace LegionRuntime {
       virtual void notify_valid(void);
       virtual void notify_invalid(void);
     public:
-      virtual void collect_users(const std::set<Event> &term_events);
+      virtual unsigned collect_users(const std::set<Event> &term_events);
     public:
       virtual void process_send_back_user(AddressSpaceID source,
                                           PhysicalUser &user);
@@ -3217,7 +3546,27 @@ namespace LegionRuntime {
                                   MaterializedView *dst,
                                   const FieldMask &copy_mask,
                   const std::map<Event,FieldMask> &preconditions,
-                        std::map<Event,FieldMask> &postconditions);
+                        std::map<Event,FieldMask> &postconditions,
+                                  FlatCopyPlan *plan = NULL,
+                  const std::vector<unsigned> *antecedents = NULL);
+    public:
+      // Depth counts this view plus any composite views nested in it
+      // and nodes counts all the composite nodes in all of them
+      void get_shape(unsigned &depth, unsigned &nodes);
+    protected:
+      void compute_shape(void);
+      bool should_flatten(void);
+      void issue_root_copies(MappableInfo *info,
+                             MaterializedView *dst,
+                             const FieldMask &copy_mask,
+                             const std::map<Event,FieldMask> &preconditions,
+                                   std::map<Event,FieldMask> &postconditions,
+                             FlatCopyPlan *plan);
+      void replay_flat_copies(MappableInfo *info,
+                              MaterializedView *dst,
+                              const FlatCopyPlan &plan,
+                              const std::map<Event,FieldMask> &preconditions,
+                                    std::map<Event,FieldMask> &postconditions);
     public:
       // Note that copy-across only works for a single field at a time
       void issue_composite_copies_across(MappableInfo *info,
@@ -3231,7 +3580,7 @@ namespace LegionRuntime {
                             MaterializedView *dst,
                             const FieldMask &event_mask,
                             const std::map<Event,FieldMask> &preconditions,
-                            std::set<Event> &event_set);
+                            std::vector<Event> &event_set);
     public:
       void pack_composite_view(Serializer &rez, bool send_back,
                                AddressSpaceID target,
@@ -3270,6 +3619,12 @@ namespace LegionRuntime {
       std::map<Color,CompositeView*> children;
       // Keep track of which fields have been sent remotely
       std::map<AddressSpaceID,FieldMask> remote_state;
+      // Size of the tree of composite nodes behind this view
+      bool shape_valid;
+      unsigned composite_depth;
+      unsigned composite_nodes;
+      // Most recently used flattened copy plans, newest first
+      std::list<FlatCopyPlan*> flat_plans;
     };
 
     /**
@@ -3314,7 +3669,9 @@ namespace LegionRuntime {
                                FieldMask traversal_mask,
                                const FieldMask &copy_mask,
                                const std::map<Event,FieldMask> &preconditions,
-                               std::map<Event,FieldMask> &postconditions);
+                               std::map<Event,FieldMask> &postconditions,
+                               CompositeView::FlatCopyPlan *plan = NULL,
+                         const std::vector<unsigned> *antecedents = NULL);
       void issue_across_copies(MappableInfo *info,
                                MaterializedView *dst,
                                unsigned src_index,
@@ -3328,6 +3685,7 @@ namespace LegionRuntime {
       const std::set<Domain>& find_intersection_domains(RegionTreeNode *dst);
     public:
       void find_bounding_roots(CompositeView *target, const FieldMask &mask);
+      void find_shape(unsigned &nested_depth, unsigned &nodes);
     public:
       void add_gc_references(void);
       void remove_gc_references(void);
@@ -3407,7 +3765,7 @@ namespace LegionRuntime {
       virtual void garbage_collect(void);
       virtual void notify_valid(void);
       virtual void notify_invalid(void);
-      virtual void collect_users(const std::set<Event> &term_events);
+      virtual unsigned collect_users(const std::set<Event> &term_events);
       virtual void process_send_back_user(AddressSpaceID source,
                                           PhysicalUser &user);
     public:
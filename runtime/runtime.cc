@@ -25,6 +25,7 @@
 #include "legion_spy.h"
 #include "legion_logging.h"
 #include "legion_profiling.h"
+#include "metrics.h"
 #ifdef HANG_TRACE
 #include <signal.h>
 #include <execinfo.h>
@@ -1691,8 +1692,9 @@ namespace LegionRuntime {
       this->message_lock = Reservation::create_reservation();
       this->stealing_lock = Reservation::create_reservation();
       this->thieving_lock = Reservation::create_reservation();
+      this->op_cache_lock.init();
       context_states.resize(MAX_CONTEXTS);
-      dependence_preconditions.resize(MAX_CONTEXTS, Event::NO_EVENT);
+      dependence_shards.resize(MAX_CONTEXTS);
       local_scheduler_preconditions.resize(superscalar_width, Event::NO_EVENT);
     }
 
@@ -1742,6 +1744,16 @@ namespace LegionRuntime {
       stealing_lock = Reservation::NO_RESERVATION;
       thieving_lock.destroy_reservation();
       thieving_lock = Reservation::NO_RESERVATION;
+      for (unsigned idx = 0; idx < LAST_ALLOC; idx++)
+      {
+        for (std::vector<Operation*>::const_iterator it = 
+              op_caches[idx].begin(); it != op_caches[idx].end(); it++)
+        {
+          delete *it;
+        }
+        op_caches[idx].clear();
+      }
+      op_cache_lock.destroy();
     }
 
     //--------------------------------------------------------------------------
@@ -2333,7 +2345,10 @@ namespace LegionRuntime {
     void ProcessorManager::perform_scheduling(void)
     //--------------------------------------------------------------------------
     {
-      perform_mapping_operations(); 
+      {
+        Metrics::ScopedTimer timer(Metrics::METRIC_SCHEDULER_TIME);
+        perform_mapping_operations(); 
+      }
       // Now re-take the lock and re-check the condition to see 
       // if the next scheduling task should be launched
       AutoLock q_lock(queue_lock);
@@ -2593,11 +2608,126 @@ namespace LegionRuntime {
       args.hlr_id = HLR_TRIGGER_DEPENDENCE_ID;
       args.manager = this;
       args.op = op;
+      args.shard = 0;
+      args.enqueue_time = 0;
+      // Operations in a trace have to register with the trace 
+      // in program order so they get ordered with everything
+      std::set<RegionTreeID> trees;
+      if (op->get_trace() == NULL)
+        op->find_dependence_trees(trees);
       ContextID ctx_id = op->get_parent()->get_context_id();
       AutoLock d_lock(dependence_lock);
+      DependenceShards &shards = dependence_shards[ctx_id];
+      Event precondition = Event::NO_EVENT;
+      // The array form of merge_events drops duplicates and
+      // triggered events itself so we don't need a set here
+      std::vector<Event> preconditions;
+      if (trees.empty())
+      {
+        preconditions.reserve(shards.tree_preconditions.size() + 1);
+        preconditions.push_back(shards.barrier);
+        for (std::map<RegionTreeID,Event>::const_iterator it = 
+              shards.tree_preconditions.begin(); it != 
+              shards.tree_preconditions.end(); it++)
+          preconditions.push_back(it->second);
+        precondition = Event::merge_events(preconditions);
+      }
+      else
+      {
+        // Every tree precondition is already ordered after the 
+        // barrier so we only need the barrier for new trees
+        preconditions.reserve(trees.size());
+        for (std::set<RegionTreeID>::const_iterator it = trees.begin();
+              it != trees.end(); it++)
+        {
+          std::map<RegionTreeID,Event>::const_iterator finder = 
+            shards.tree_preconditions.find(*it);
+          if (finder != shards.tree_preconditions.end())
+            preconditions.push_back(finder->second);
+          else
+            preconditions.push_back(shards.barrier);
+        }
+        if (preconditions.size() == 1)
+          precondition = preconditions[0];
+        else
+          precondition = Event::merge_events(preconditions);
+      }
+      if (Runtime::dependence_statistics)
+      {
+        args.shard = trees.empty() ? 0 : *(trees.begin());
+        args.enqueue_time = TimeStamp::get_current_time_in_micros();
+        DependenceStatistics &stats = dependence_stats[args.shard];
+        stats.pending++;
+        if (stats.pending > stats.max_pending)
+          stats.max_pending = stats.pending;
+      }
       Event next = utility_proc.spawn(HLR_TASK_ID, &args, sizeof(args),
-                                      dependence_preconditions[ctx_id]);
-      dependence_preconditions[ctx_id] = next;
+                                      precondition);
+      if (trees.empty())
+      {
+        shards.barrier = next;
+        shards.tree_preconditions.clear();
+      }
+      else
+      {
+        for (std::set<RegionTreeID>::const_iterator it = trees.begin();
+              it != trees.end(); it++)
+          shards.tree_preconditions[*it] = next;
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void ProcessorManager::record_dependence_analysis(RegionTreeID shard,
+                                               unsigned long long enqueue_time,
+                                               unsigned long long start_time,
+                                               unsigned long long stop_time)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock d_lock(dependence_lock);
+      DependenceStatistics &stats = dependence_stats[shard];
+#ifdef DEBUG_HIGH_LEVEL
+      assert(stats.pending > 0);
+#endif
+      stats.pending--;
+      stats.analyzed++;
+      stats.total_wait += (start_time - enqueue_time);
+      const unsigned long long analysis = stop_time - start_time;
+      stats.total_analysis += analysis;
+      if (analysis > stats.max_analysis)
+        stats.max_analysis = analysis;
+    }
+
+    //--------------------------------------------------------------------------
+    void ProcessorManager::report_dependence_statistics(void)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock d_lock(dependence_lock);
+      if (dependence_stats.empty())
+        return;
+      log_run.print("Dependence analysis for processor " IDFMT ": "
+                    "%ld region tree shards", local_proc.id, 
+                    dependence_stats.size() - 
+                      ((dependence_stats.find(0) != dependence_stats.end()) ?
+                       1 : 0));
+      for (std::map<RegionTreeID,DependenceStatistics>::const_iterator it =
+            dependence_stats.begin(); it != dependence_stats.end(); it++)
+      {
+        const DependenceStatistics &stats = it->second;
+        if (stats.analyzed == 0)
+          continue;
+        char shard_name[64];
+        if (it->first == 0)
+          snprintf(shard_name, 64, "Ordered with all trees");
+        else
+          snprintf(shard_name, 64, "Region tree %d", it->first);
+        log_run.print("  %s: %lld operations, max queue depth %lld, "
+                      "average wait %.2f us, average analysis %.2f us "
+                      "(max %lld us)", shard_name, stats.analyzed,
+                      stats.max_pending, 
+                      double(stats.total_wait) / stats.analyzed,
+                      double(stats.total_analysis) / stats.analyzed,
+                      stats.max_analysis);
+      }
     }
 
     //--------------------------------------------------------------------------
@@ -2659,6 +2789,49 @@ namespace LegionRuntime {
       return ready_queues[map_id].size();
     }
 
+    //--------------------------------------------------------------------------
+    template<typename T>
+    inline T* ProcessorManager::find_cached_operation(void)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock c_lock(op_cache_lock);
+      std::vector<Operation*> &cache = op_caches[T::alloc_type];
+      if (cache.empty())
+        return NULL;
+      T *result = static_cast<T*>(cache.back());
+      cache.pop_back();
+      return result;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    inline unsigned ProcessorManager::cache_operation(T *op, T **overflow)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock c_lock(op_cache_lock);
+      std::vector<Operation*> &cache = op_caches[T::alloc_type];
+      cache.push_back(op);
+      if (cache.size() <= DEFAULT_OPERATION_CACHE_SIZE)
+        return 0;
+      // Too many, hand the coldest ones back to the runtime so
+      // other processors can make use of them
+      for (unsigned idx = 0; idx < DEFAULT_OPERATION_CACHE_BATCH; idx++)
+        overflow[idx] = static_cast<T*>(cache[idx]);
+      cache.erase(cache.begin(), cache.begin()+DEFAULT_OPERATION_CACHE_BATCH);
+      return DEFAULT_OPERATION_CACHE_BATCH;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    inline void ProcessorManager::fill_operation_cache(T **ops, 
+                                                       unsigned num_ops)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock c_lock(op_cache_lock);
+      std::vector<Operation*> &cache = op_caches[T::alloc_type];
+      cache.insert(cache.end(), ops, ops+num_ops);
+    }
+
 #ifdef HANG_TRACE
     //--------------------------------------------------------------------------
     void ProcessorManager::dump_state(FILE *target)
@@ -3113,6 +3286,18 @@ namespace LegionRuntime {
       return remaining_capacity;
     }
 
+    //--------------------------------------------------------------------------
+    size_t MemoryManager::sample_largest_free_block(void)
+    //--------------------------------------------------------------------------
+    {
+      Machine::MemoryAllocStats stats;
+      if (runtime->machine->get_memory_alloc_stats(memory, stats))
+        return stats.largest_free_block;
+      // The allocator lives on another node so the best we
+      // can do is assume the free space is contiguous
+      return remaining_capacity;
+    }
+
     //--------------------------------------------------------------------------
     unsigned MemoryManager::sample_allocated_instances(void)
     //--------------------------------------------------------------------------
@@ -3135,12 +3320,12 @@ namespace LegionRuntime {
     //--------------------------------------------------------------------------
     {
       send_lock = Reservation::create_reservation();
-      receiving_buffer_size = max_message_size;
-      receiving_buffer = (char*)legion_malloc(MESSAGE_BUFFER_ALLOC,
-                                              receiving_buffer_size);
+      // The receiving buffer is pulled from the runtime's pool
+      // when the first part of a partial message arrives
+      receiving_buffer = NULL;
+      receiving_buffer_size = 0;
 #ifdef DEBUG_HIGH_LEVEL
       assert(sending_buffer != NULL);
-      assert(receiving_buffer != NULL);
 #endif
       // Figure out which processor to send to based on our address
       // space ID.  If there is an explicit utility processor for one
@@ -3178,6 +3363,10 @@ namespace LegionRuntime {
       sending_index += sizeof(packaged_messages);
       last_message_event = Event::NO_EVENT;
       partial = false;
+      pending_since = 0;
+      flush_task_launched = false;
+      for (unsigned idx = 0; idx < LAST_MESSAGE_KIND; idx++)
+        pending_kinds[idx] = 0;
       // Set up the receiving buffer
       received_messages = 0;
       receiving_index = 0;
@@ -3200,7 +3389,9 @@ namespace LegionRuntime {
       send_lock.destroy_reservation();
       send_lock = Reservation::NO_RESERVATION;
       free(sending_buffer);
-      free(receiving_buffer);
+      if (receiving_buffer != NULL)
+        legion_free(MESSAGE_BUFFER_ALLOC, receiving_buffer, 
+                    receiving_buffer_size);
       receiving_buffer = NULL;
       receiving_buffer_size = 0;
     }
@@ -3653,6 +3844,8 @@ namespace LegionRuntime {
       const char *buffer = (const char*)rez.get_buffer();
       // Need to hold the lock when manipulating the buffer
       AutoLock s_lock(send_lock);
+      stats.kinds[k].messages++;
+      stats.kinds[k].bytes += buffer_size;
       if ((sending_index+buffer_size+sizeof(k)+sizeof(buffer_size)) > 
           sending_buffer_size)
       {
@@ -3660,34 +3853,37 @@ namespace LegionRuntime {
         // Since there is no partial data we can fake the flush
         if ((sending_buffer_size - sending_index) <= 
             (sizeof(k)+sizeof(buffer_size)))
+        {
+          stats.full_flushes++;
           send_message(true/*complete*/);
+        }
         // Now can package up the meta data
         packaged_messages++;
+        pending_kinds[k]++;
         *((MessageKind*)(sending_buffer+sending_index)) = k;
         sending_index += sizeof(k);
         *((size_t*)(sending_buffer+sending_index)) = buffer_size;
         sending_index += sizeof(buffer_size);
-        while (buffer_size > 0)
-        {
-          unsigned remaining = sending_buffer_size - sending_index;
-          if (remaining == 0)
-            send_message(false/*complete*/);
-          remaining = sending_buffer_size - sending_index;
-#ifdef DEBUG_HIGH_LEVEL
-          assert(remaining > 0); // should be space after the send
-#endif
-          // Figure out how much to copy into the buffer
-          unsigned to_copy = (remaining < buffer_size) ? 
-                                            remaining : buffer_size;
-          memcpy(sending_buffer+sending_index,buffer,to_copy);
-          buffer_size -= to_copy;
-          buffer += to_copy;
-          sending_index += to_copy;
-        } 
+        // Send the parts of the message that don't fit directly
+        // out of the serializer's buffer behind whatever is already
+        // in the sending buffer so we don't copy them twice
+        while (buffer_size > (sending_buffer_size - sending_index))
+        {
+          size_t to_send = sending_buffer_size - sending_index;
+          stats.full_flushes++;
+          send_message(false/*complete*/, buffer, to_send);
+          buffer_size -= to_send;
+          buffer += to_send;
+        }
+        // The tail fits in the sending buffer, copy it there so
+        // that later messages can still be batched behind it
+        memcpy(sending_buffer+sending_index,buffer,buffer_size);
+        sending_index += buffer_size;
       }
       else
       {
         packaged_messages++;
+        pending_kinds[k]++;
         // Package up the kind and the size first
         *((MessageKind*)(sending_buffer+sending_index)) = k;
         sending_index += sizeof(k);
@@ -3697,12 +3893,44 @@ namespace LegionRuntime {
         memcpy(sending_buffer+sending_index,buffer,buffer_size); 
         sending_index += buffer_size;
       }
+      const size_t header_size = sizeof(HLRTaskID) + 
+        sizeof(local_address_space) + sizeof(header) + sizeof(unsigned);
       if (flush)
-        send_message(true/*complete*/);
+      {
+        // When aggregating, hold back explicit flushes until enough 
+        // bytes are waiting, the flush task bounds how long they wait
+        if ((Runtime::message_aggregation_bytes == 0) ||
+            (Runtime::message_flush_deadline == 0) ||
+            ((sending_index - header_size) >= 
+              Runtime::message_aggregation_bytes))
+        {
+          stats.requested_flushes++;
+          send_message(true/*complete*/);
+          return;
+        }
+      }
+      if ((Runtime::message_aggregation_bytes > 0) &&
+          (Runtime::message_flush_deadline > 0) && 
+          (sending_index > header_size))
+      {
+        unsigned long long now = TimeStamp::get_current_time_in_micros();
+        if (pending_since == 0)
+          pending_since = now;
+        else if ((now - pending_since) >= Runtime::message_flush_deadline)
+        {
+          // Piggyback on this send if the oldest message is overdue
+          stats.deadline_flushes++;
+          send_message(true/*complete*/);
+          return;
+        }
+        if (!flush_task_launched)
+          launch_flush_task();
+      }
     }
 
     //--------------------------------------------------------------------------
-    void MessageManager::send_message(bool complete)
+    void MessageManager::send_message(bool complete, const char *payload,
+                                      size_t payload_size)
     //--------------------------------------------------------------------------
     {
       // See if we need to switch the header file
@@ -3722,11 +3950,41 @@ namespace LegionRuntime {
                           sizeof(local_address_space))) = header;
       *((unsigned*)(sending_buffer + sizeof(HLRTaskID) +
             sizeof(local_address_space) + sizeof(header))) = packaged_messages;
-      // Send the message
-      Event next_event = target.spawn(HLR_TASK_ID, sending_buffer,
-                                      sending_index, last_message_event);
+      // Send the message, if we have an extra payload then we let 
+      // the low-level runtime gather it together with our buffer
+      Event next_event;
+      if (payload_size > 0)
+      {
+        std::vector<Processor::ArgSpan> spans(2);
+        spans[0] = Processor::ArgSpan(sending_buffer, sending_index);
+        spans[1] = Processor::ArgSpan(payload, payload_size);
+        next_event = target.spawn(HLR_TASK_ID, spans, last_message_event);
+      }
+      else
+        next_event = target.spawn(HLR_TASK_ID, sending_buffer,
+                                  sending_index, last_message_event);
       // Update the event
       last_message_event = next_event;
+      Metrics::increment(Metrics::METRIC_MESSAGES_SENT);
+      Metrics::increment(Metrics::METRIC_MESSAGES_BATCHED, packaged_messages);
+      Metrics::record(Metrics::METRIC_MESSAGE_BYTES, 
+                      sending_index + payload_size);
+      // Record how the messages were batched
+      stats.active_messages++;
+      stats.total_batched += packaged_messages;
+      if (packaged_messages > stats.max_batch)
+        stats.max_batch = packaged_messages;
+      if (packaged_messages > 0)
+      {
+        for (unsigned idx = 0; idx < LAST_MESSAGE_KIND; idx++)
+        {
+          if (pending_kinds[idx] == 0)
+            continue;
+          stats.kinds[idx].batched_messages += 
+            (pending_kinds[idx] * packaged_messages);
+          pending_kinds[idx] = 0;
+        }
+      }
       // Reset the state of the buffer
       sending_index = sizeof(HLRTaskID) + sizeof(local_address_space) + 
                       sizeof(header) + sizeof(unsigned);
@@ -3735,6 +3993,107 @@ namespace LegionRuntime {
       else
         header = FULL_MESSAGE;
       packaged_messages = 0;
+      pending_since = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    void MessageManager::launch_flush_task(void)
+    //--------------------------------------------------------------------------
+    {
+      // Should be holding the send lock
+      flush_task_launched = true;
+      MessageFlushArgs args;
+      args.hlr_id = HLR_MESSAGE_FLUSH_ID;
+      args.remote_space = remote_address_space;
+      // Don't run until the last message we sent has been handled,
+      // anything packaged in the meantime goes out with the flush
+      runtime->find_utility_group().spawn(HLR_TASK_ID, &args, sizeof(args),
+                                          last_message_event);
+    }
+
+    //--------------------------------------------------------------------------
+    void MessageManager::flush_aggregated_messages(void)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock s_lock(send_lock);
+      // Send whatever is still waiting, unless a later send already
+      // took it with it
+      if (pending_since > 0)
+      {
+        stats.deadline_flushes++;
+        send_message(true/*complete*/);
+      }
+      flush_task_launched = false;
+    }
+
+    //--------------------------------------------------------------------------
+    void MessageManager::get_statistics(MessageStatistics &result)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock s_lock(send_lock);
+      result = stats;
+    }
+
+    //--------------------------------------------------------------------------
+    void MessageManager::report_statistics(void)
+    //--------------------------------------------------------------------------
+    {
+      MessageStatistics result;
+      get_statistics(result);
+      log_run.print("Messages from node %d to node %d: %lld active messages "
+                    "holding %lld messages (average batch %.2f, max %lld), "
+                    "flushes: %lld requested, %lld full, %lld deadline",
+                    local_address_space, remote_address_space,
+                    result.active_messages, result.total_batched,
+                    (result.active_messages == 0) ? 0.0 :
+                      double(result.total_batched) / result.active_messages,
+                    result.max_batch, result.requested_flushes,
+                    result.full_flushes, result.deadline_flushes);
+      for (unsigned idx = 0; idx < LAST_MESSAGE_KIND; idx++)
+      {
+        const KindStatistics &kind = result.kinds[idx];
+        if (kind.messages == 0)
+          continue;
+        log_run.print("  %s: %lld messages, %lld bytes, average batch %.2f",
+                      get_message_kind_name(MessageKind(idx)), kind.messages,
+                      kind.bytes, double(kind.batched_messages) / kind.messages);
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ const char* MessageManager::get_message_kind_name(
+                                                               MessageKind kind)
+    //--------------------------------------------------------------------------
+    {
+      // Must be kept in the same order as the MessageKind enum
+      static const char* kind_names[] = {
+        "Task", "Steal Request", "Advertisement", "Index Space Node",
+        "Index Partition Node", "Field Space Node", "Logical Region Node",
+        "Index Space Destruction", "Index Partition Destruction",
+        "Field Space Destruction", "Logical Region Destruction",
+        "Logical Partition Destruction", "Field Allocation", 
+        "Field Destruction", "Individual Remote Mapped",
+        "Individual Remote Complete", "Individual Remote Commit",
+        "Slice Remote Mapped", "Slice Remote Complete", 
+        "Slice Remote Commit", "Distributed Remove Resource",
+        "Distributed Remove Remote", "Distributed Add Remote",
+        "Hierarchical Remove Resource", "Hierarchical Remove Remote",
+        "Back User", "Subscriber", "Materialized View", 
+        "Materialized Update", "Back Materialized View", "Composite View",
+        "Back Composite View", "Composite Update", "Reduction View",
+        "Reduction Update", "Back Reduction View", "Instance Manager",
+        "Reduction Manager", "Region State", "Partition State",
+        "Back Region State", "Back Partition State", "Remote References",
+        "Individual Request", "Individual Return", "Slice Request",
+        "Slice Return", "Future", "Future Result", "Future Subscription",
+        "Make Persistent", "Mapper Message", "Index Space Semantic Info",
+        "Index Partition Semantic Info", "Field Space Semantic Info",
+        "Field Semantic Info", "Logical Region Semantic Info",
+        "Logical Partition Semantic Info",
+      };
+      LEGION_STATIC_ASSERT((sizeof(kind_names)/sizeof(kind_names[0])) ==
+                           LAST_MESSAGE_KIND);
+      return kind_names[kind];
     }
 
     //--------------------------------------------------------------------------
@@ -3774,6 +4133,14 @@ namespace LegionRuntime {
                             receiving_index);
             receiving_index = 0;
             received_messages = 0;
+            // Give the buffer back so other message managers can use it
+            if (receiving_buffer != NULL)
+            {
+              runtime->release_message_buffer(receiving_buffer,
+                                              receiving_buffer_size);
+              receiving_buffer = NULL;
+              receiving_buffer_size = 0;
+            }
             break;
           }
         default:
@@ -4134,22 +4501,19 @@ namespace LegionRuntime {
       // Check to see if it fits
       if (receiving_buffer_size < (receiving_index+arglen))
       {
-        // Figure out what the new size should be
-        // Keep doubling until it's larger
-        size_t new_buffer_size = receiving_buffer_size;
-        while (new_buffer_size < (receiving_index+arglen))
-          new_buffer_size *= 2;
-#ifdef DEBUG_HIGH_LEVEL
-        assert(new_buffer_size != 0); // would cause deallocation
-#endif
-        // Now realloc the memory
-        void *new_ptr = legion_realloc(MESSAGE_BUFFER_ALLOC, receiving_buffer,
-                                       receiving_buffer_size, new_buffer_size);
+        // Get a big enough buffer from the runtime and move
+        // over anything that we've already received
+        size_t new_buffer_size;
+        char *new_buffer = runtime->acquire_message_buffer(
+                              receiving_index+arglen, new_buffer_size);
+        if (receiving_buffer != NULL)
+        {
+          memcpy(new_buffer, receiving_buffer, receiving_index);
+          runtime->release_message_buffer(receiving_buffer,
+                                          receiving_buffer_size);
+        }
+        receiving_buffer = new_buffer;
         receiving_buffer_size = new_buffer_size;
-#ifdef DEBUG_HIGH_LEVEL
-        assert(new_ptr != NULL);
-#endif
-        receiving_buffer = (char*)new_ptr;
       }
       // Copy the data in
       memcpy(receiving_buffer+receiving_index,args,arglen);
@@ -4162,7 +4526,7 @@ namespace LegionRuntime {
 
     //--------------------------------------------------------------------------
     GarbageCollectionEpoch::GarbageCollectionEpoch(Runtime *rt)
-      : runtime(rt)
+      : runtime(rt), total_events(0), launch_time(0)
     //--------------------------------------------------------------------------
     {
     }
@@ -4209,45 +4573,46 @@ namespace LegionRuntime {
       }
       else
         finder->second.insert(term);
+      total_events++;
     }
 
     //--------------------------------------------------------------------------
     void GarbageCollectionEpoch::launch(Processor utility, int priority)
     //--------------------------------------------------------------------------
     {
-      // Set remaining to the total number of collections
-      remaining = collections.size();
+      // Merge the events for the whole epoch once and do all
+      // the collections in a single task when they have triggered
+      std::set<Event> all_events;
+      for (std::map<LogicalView*,std::set<Event> >::const_iterator it =
+            collections.begin(); it != collections.end(); it++)
+      {
+        all_events.insert(it->second.begin(), it->second.end());
+      }
+      if (Runtime::gc_statistics)
+        launch_time = TimeStamp::get_current_time_in_micros();
       GarbageCollectionArgs args;
       args.hlr_id = HLR_DEFERRED_COLLECT_ID;
       args.epoch = this;
-      for (std::map<LogicalView*,std::set<Event> >::const_iterator it =
-            collections.begin(); it != collections.end(); /*nothing*/)
-      {
-        args.view = it->first;
-        Event precondition = Event::merge_events(it->second);
-        // Avoid the deletion race by testing the condition 
-        // before launching the task
-        it++;
-        bool done = (it == collections.end());
-        utility.spawn(HLR_TASK_ID, &args, sizeof(args), precondition, priority);
-        if (done)
-          break;
-      }
+      Event precondition = Event::merge_events(all_events);
+      // The utility group hands the task to whichever
+      // utility processor is free first
+      utility.spawn(HLR_TASK_ID, &args, sizeof(args), precondition, priority);
     }
 
     //--------------------------------------------------------------------------
-    bool GarbageCollectionEpoch::handle_collection(
-                                              const GarbageCollectionArgs *args)
+    void GarbageCollectionEpoch::handle_collection(void)
     //--------------------------------------------------------------------------
     {
-      std::map<LogicalView*,std::set<Event> >::iterator finder = 
-        collections.find(args->view);
-#ifdef DEBUG_HIGH_LEVEL
-      assert(finder != collections.end());
-#endif
-      LogicalView::handle_deferred_collect(args->view, finder->second);
-      // See if we are done
-      return (__sync_add_and_fetch(&remaining, -1) == 0);
+      size_t users_reclaimed = 0, views_deleted = 0, bytes_reclaimed = 0;
+      LogicalView::handle_deferred_collect(collections, users_reclaimed,
+                                           views_deleted, bytes_reclaimed);
+      if (Runtime::gc_statistics)
+      {
+        unsigned long long stop = TimeStamp::get_current_time_in_micros();
+        runtime->record_gc_epoch(collections.size(), total_events, 
+                                 stop - launch_time, users_reclaimed,
+                                 views_deleted, bytes_reclaimed);
+      }
     }
     
     /////////////////////////////////////////////////////////////
@@ -4285,6 +4650,7 @@ namespace LegionRuntime {
         future_lock(Reservation::create_reservation()),
         unique_distributed_id((unique == 0) ? runtime_stride : unique),
         remote_lock(Reservation::create_reservation()),
+        message_buffer_lock(true/*initialize*/),
         individual_task_lock(Reservation::create_reservation()), 
         point_task_lock(Reservation::create_reservation()),
         index_task_lock(Reservation::create_reservation()), 
@@ -4318,6 +4684,13 @@ namespace LegionRuntime {
         LegionLogging::initialize_legion_logging(unique, all_locals);
       }
 #endif
+#ifdef LEGION_SPY
+      if (Runtime::spy_file_prefix != NULL)
+        LegionSpy::start_binary_spy(Runtime::spy_file_prefix, address_space);
+#endif
+      if (Runtime::metrics_interval > 0)
+        Metrics::start_metrics(Runtime::metrics_interval, 
+                               Runtime::metrics_file_prefix, address_space);
 #ifdef LEGION_PROF
       {
         // See if we should disable profiling on this node
@@ -4341,6 +4714,11 @@ namespace LegionRuntime {
         // If it's less than zero, then they are all enabled by default
         else
           LegionProf::enable_profiling();
+        // Everything below goes to the binary file if we have one
+        if (LegionProf::profiling_enabled && 
+            (Runtime::profiling_file_prefix != NULL))
+          LegionProf::start_binary_profiling(Runtime::profiling_file_prefix,
+                                             address_space);
         const std::map<Processor::TaskFuncID,TaskVariantCollection*>& table =
           Runtime::get_collection_table();
         for (std::map<Processor::TaskFuncID,TaskVariantCollection*>::
@@ -4525,18 +4903,35 @@ namespace LegionRuntime {
           assert(kind == Processor::UTIL_PROC);
           LegionProf::finalize_processor(*it);
         }
+        const RegionTreeForest::IntersectionStatistics &stats = 
+          forest->intersection_stats;
+        LegionProf::register_intersection_cache(stats.cache_hits,
+            stats.cache_misses, stats.cache_evictions, 
+            stats.graph_hits, stats.graphs_built);
+        if (LegionProf::binary_profiling)
+          LegionProf::stop_binary_profiling();
       }
 #endif
+#ifdef LEGION_SPY
+      if (Runtime::spy_file_prefix != NULL)
+        LegionSpy::stop_binary_spy();
+#endif
+      if (Runtime::metrics_interval > 0)
+        Metrics::stop_metrics();
       delete high_level;
       for (std::map<Processor,ProcessorManager*>::const_iterator it = 
             proc_managers.begin(); it != proc_managers.end(); it++)
       {
+        if (dependence_statistics)
+          it->second->report_dependence_statistics();
         delete it->second;
       }
       proc_managers.clear();
       for (std::map<AddressSpaceID,MessageManager*>::const_iterator it = 
             message_managers.begin(); it != message_managers.end(); it++)
       {
+        if (message_statistics)
+          it->second->report_statistics();
         delete it->second;
       }
       for (std::map<ProjectionID,ProjectionFunctor*>::const_iterator it = 
@@ -4561,12 +4956,26 @@ namespace LegionRuntime {
       distributed_collectable_lock = Reservation::NO_RESERVATION;
       hierarchical_collectable_lock.destroy_reservation();
       hierarchical_collectable_lock = Reservation::NO_RESERVATION;
+      if (gc_statistics)
+        report_gc_statistics();
       gc_epoch_lock.destroy_reservation();
       gc_epoch_lock = Reservation::NO_RESERVATION;
       future_lock.destroy_reservation();
       future_lock = Reservation::NO_RESERVATION;
       remote_lock.destroy_reservation();
       remote_lock = Reservation::NO_RESERVATION;
+      for (unsigned idx = 0; idx < message_buffers.size(); idx++)
+      {
+        for (std::vector<char*>::const_iterator it = 
+              message_buffers[idx].begin(); it != 
+              message_buffers[idx].end(); it++)
+        {
+          legion_free(MESSAGE_BUFFER_ALLOC, *it, 
+                      size_t(max_message_size) << idx);
+        }
+      }
+      message_buffers.clear();
+      message_buffer_lock.destroy();
       for (std::deque<IndividualTask*>::const_iterator it = 
             available_individual_tasks.begin(); 
             it != available_individual_tasks.end(); it++)
@@ -4757,6 +5166,10 @@ namespace LegionRuntime {
       epoch_op_lock.destroy_reservation();
       epoch_op_lock = Reservation::NO_RESERVATION;
 
+      if (footprint_statistics)
+        forest->report_state_footprint();
+      if (composite_statistics)
+        forest->report_composite_statistics();
       delete forest;
 
 #ifdef DEBUG_HIGH_LEVEL
@@ -8803,6 +9216,14 @@ namespace LegionRuntime {
       return manager->sample_free_space();
     }
 
+    //--------------------------------------------------------------------------
+    size_t Runtime::sample_largest_free_block(Memory mem)
+    //--------------------------------------------------------------------------
+    {
+      MemoryManager *manager = find_memory(mem);
+      return manager->sample_largest_free_block();
+    }
+
     //--------------------------------------------------------------------------
     unsigned Runtime::sample_allocated_instances(Memory mem)
     //--------------------------------------------------------------------------
@@ -10758,6 +11179,57 @@ namespace LegionRuntime {
         return finder->second;
     }
 
+    //--------------------------------------------------------------------------
+    char* Runtime::acquire_message_buffer(size_t needed, size_t &actual)
+    //--------------------------------------------------------------------------
+    {
+      unsigned size_class = 0;
+      actual = max_message_size;
+      while (actual < needed)
+      {
+        actual <<= 1;
+        size_class++;
+      }
+      {
+        AutoLock m_lock(message_buffer_lock);
+        if ((size_class < message_buffers.size()) && 
+            !message_buffers[size_class].empty())
+        {
+          char *result = message_buffers[size_class].back();
+          message_buffers[size_class].pop_back();
+          return result;
+        }
+      }
+      char *result = (char*)legion_malloc(MESSAGE_BUFFER_ALLOC, actual);
+#ifdef DEBUG_HIGH_LEVEL
+      assert(result != NULL);
+#endif
+      return result;
+    }
+
+    //--------------------------------------------------------------------------
+    void Runtime::release_message_buffer(char *buffer, size_t size)
+    //--------------------------------------------------------------------------
+    {
+      unsigned size_class = 0;
+      while ((size_t(max_message_size) << size_class) < size)
+        size_class++;
+#ifdef DEBUG_HIGH_LEVEL
+      assert((size_t(max_message_size) << size_class) == size);
+#endif
+      {
+        AutoLock m_lock(message_buffer_lock);
+        if (size_class >= message_buffers.size())
+          message_buffers.resize(size_class+1);
+        if (message_buffers[size_class].size() < DEFAULT_MESSAGE_BUFFER_POOL)
+        {
+          message_buffers[size_class].push_back(buffer);
+          return;
+        }
+      }
+      legion_free(MESSAGE_BUFFER_ALLOC, buffer, size);
+    }
+
     //--------------------------------------------------------------------------
     void Runtime::defer_collect_user(LogicalView *view, Event term_event)
     //--------------------------------------------------------------------------
@@ -10801,6 +11273,46 @@ namespace LegionRuntime {
 #endif
     }
 
+    //--------------------------------------------------------------------------
+    void Runtime::record_gc_epoch(size_t views, size_t events,
+                                  unsigned long long latency, size_t users,
+                                  size_t deleted, size_t bytes)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock gc(gc_epoch_lock);
+      gc_stats.epochs++;
+      gc_stats.views += views;
+      gc_stats.events += events;
+      if (events > gc_stats.max_events)
+        gc_stats.max_events = events;
+      gc_stats.total_latency += latency;
+      if (latency > gc_stats.max_latency)
+        gc_stats.max_latency = latency;
+      gc_stats.users_reclaimed += users;
+      gc_stats.views_deleted += deleted;
+      gc_stats.bytes_reclaimed += bytes;
+    }
+
+    //--------------------------------------------------------------------------
+    void Runtime::report_gc_statistics(void)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock gc(gc_epoch_lock);
+      log_run.print("Garbage collection on node %d: %lld epochs, "
+                    "average %.2f events (max %lld) on %.2f views",
+                    address_space, gc_stats.epochs, (gc_stats.epochs == 0) ? 
+                      0.0 : double(gc_stats.events) / gc_stats.epochs,
+                    gc_stats.max_events, (gc_stats.epochs == 0) ? 0.0 :
+                      double(gc_stats.views) / gc_stats.epochs);
+      log_run.print("  latency from launch to collection: average %.2f us, "
+                    "max %lld us", (gc_stats.epochs == 0) ? 0.0 :
+                      double(gc_stats.total_latency) / gc_stats.epochs,
+                    gc_stats.max_latency);
+      log_run.print("  reclaimed %lld users and %lld views (%.2f KB)",
+                    gc_stats.users_reclaimed, gc_stats.views_deleted,
+                    gc_stats.bytes_reclaimed / 1024.0);
+    }
+
     //--------------------------------------------------------------------------
     void Runtime::initiate_runtime_shutdown(void)
     //--------------------------------------------------------------------------
@@ -10825,21 +11337,85 @@ namespace LegionRuntime {
     }
 
     //--------------------------------------------------------------------------
-    IndividualTask* Runtime::get_available_individual_task(void)
+    ProcessorManager* Runtime::find_local_manager(void) const
+    //--------------------------------------------------------------------------
+    {
+      // Utility processors don't have a manager and so they
+      // go straight to the runtime-wide free lists
+      Processor proc = Machine::get_executing_processor();
+      std::map<Processor,ProcessorManager*>::const_iterator finder = 
+        proc_managers.find(proc);
+      if (finder == proc_managers.end())
+        return NULL;
+      return finder->second;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    inline T* Runtime::get_available(Reservation reservation,
+                                     std::deque<T*> &queue)
     //--------------------------------------------------------------------------
     {
-      IndividualTask *result = NULL;
+      ProcessorManager *manager = find_local_manager();
+      if (manager != NULL)
       {
-        AutoLock i_lock(individual_task_lock);
-        if (!available_individual_tasks.empty())
+        T *result = manager->find_cached_operation<T>();
+        if (result != NULL)
+          return result;
+      }
+      // Nothing cached on this processor so go to the runtime-wide
+      // list and take a batch back with us while we hold the lock
+      T *batch[DEFAULT_OPERATION_CACHE_BATCH];
+      unsigned num_taken = 0;
+      {
+        const unsigned max_take = 
+          (manager == NULL) ? 1 : DEFAULT_OPERATION_CACHE_BATCH;
+        AutoLock a_lock(reservation);
+        while (!queue.empty() && (num_taken < max_take))
         {
-          result = available_individual_tasks.front();
-          available_individual_tasks.pop_front();
+          batch[num_taken++] = queue.front();
+          queue.pop_front();
         }
       }
       // Couldn't find one so make a new one
-      if (result == NULL)
-        result = legion_new<IndividualTask>(this);
+      if (num_taken == 0)
+        return legion_new<T>(this);
+      if (num_taken > 1)
+        manager->fill_operation_cache<T>(batch+1, num_taken-1);
+      return batch[0];
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    inline void Runtime::release_operation(Reservation reservation,
+                                           std::deque<T*> &queue, T *op)
+    //--------------------------------------------------------------------------
+    {
+      ProcessorManager *manager = find_local_manager();
+      if (manager != NULL)
+      {
+        T *overflow[DEFAULT_OPERATION_CACHE_BATCH];
+        unsigned num_overflow = manager->cache_operation<T>(op, overflow);
+        if (num_overflow > 0)
+        {
+          AutoLock a_lock(reservation);
+          for (unsigned idx = 0; idx < num_overflow; idx++)
+            queue.push_front(overflow[idx]);
+        }
+      }
+      else
+      {
+        AutoLock a_lock(reservation);
+        queue.push_front(op);
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    IndividualTask* Runtime::get_available_individual_task(void)
+    //--------------------------------------------------------------------------
+    {
+      IndividualTask *result = 
+        get_available(individual_task_lock, available_individual_tasks);
 #if defined(DEBUG_HIGH_LEVEL) || defined(HANG_TRACE)
       assert(result != NULL);
       {
@@ -10855,17 +11431,7 @@ namespace LegionRuntime {
     PointTask* Runtime::get_available_point_task(void)
     //--------------------------------------------------------------------------
     {
-      PointTask *result = NULL;
-      {
-        AutoLock p_lock(point_task_lock);
-        if (!available_point_tasks.empty())
-        {
-          result = available_point_tasks.front();
-          available_point_tasks.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<PointTask>(this);
+      PointTask *result = get_available(point_task_lock, available_point_tasks);
 #if defined(DEBUG_HIGH_LEVEL) || defined(HANG_TRACE)
       assert(result != NULL);
       {
@@ -10881,17 +11447,7 @@ namespace LegionRuntime {
     IndexTask* Runtime::get_available_index_task(void)
     //--------------------------------------------------------------------------
     {
-      IndexTask *result = NULL;
-      {
-        AutoLock i_lock(index_task_lock);
-        if (!available_index_tasks.empty())
-        {
-          result = available_index_tasks.front();
-          available_index_tasks.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<IndexTask>(this);
+      IndexTask *result = get_available(index_task_lock, available_index_tasks);
 #if defined(DEBUG_HIGH_LEVEL) || defined(HANG_TRACE)
       assert(result != NULL);
       {
@@ -10907,17 +11463,7 @@ namespace LegionRuntime {
     SliceTask* Runtime::get_available_slice_task(void)
     //--------------------------------------------------------------------------
     {
-      SliceTask *result = NULL;
-      {
-        AutoLock s_lock(slice_task_lock);
-        if (!available_slice_tasks.empty())
-        {
-          result = available_slice_tasks.front();
-          available_slice_tasks.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<SliceTask>(this);
+      SliceTask *result = get_available(slice_task_lock, available_slice_tasks);
 #if defined(DEBUG_HIGH_LEVEL) || defined(HANG_TRACE)
       assert(result != NULL);
       {
@@ -10933,17 +11479,8 @@ namespace LegionRuntime {
     RemoteTask* Runtime::get_available_remote_task(void)
     //--------------------------------------------------------------------------
     {
-      RemoteTask *result = NULL;
-      {
-        AutoLock r_lock(remote_task_lock);
-        if (!available_remote_tasks.empty())
-        {
-          result = available_remote_tasks.front();
-          available_remote_tasks.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<RemoteTask>(this);
+      RemoteTask *result = 
+        get_available(remote_task_lock, available_remote_tasks);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -10955,17 +11492,8 @@ namespace LegionRuntime {
     InlineTask* Runtime::get_available_inline_task(void)
     //--------------------------------------------------------------------------
     {
-      InlineTask *result = NULL;
-      {
-        AutoLock i_lock(inline_task_lock);
-        if (!available_inline_tasks.empty())
-        {
-          result = available_inline_tasks.front();
-          available_inline_tasks.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<InlineTask>(this);
+      InlineTask *result = 
+        get_available(inline_task_lock, available_inline_tasks);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -10977,17 +11505,7 @@ namespace LegionRuntime {
     MapOp* Runtime::get_available_map_op(void)
     //--------------------------------------------------------------------------
     {
-      MapOp *result = NULL;
-      {
-        AutoLock m_lock(map_op_lock);
-        if (!available_map_ops.empty())
-        {
-          result = available_map_ops.front();
-          available_map_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<MapOp>(this);
+      MapOp *result = get_available(map_op_lock, available_map_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -10999,17 +11517,7 @@ namespace LegionRuntime {
     CopyOp* Runtime::get_available_copy_op(void)
     //--------------------------------------------------------------------------
     {
-      CopyOp *result = NULL;
-      {
-        AutoLock c_lock(copy_op_lock);
-        if (!available_copy_ops.empty())
-        {
-          result = available_copy_ops.front();
-          available_copy_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<CopyOp>(this);
+      CopyOp *result = get_available(copy_op_lock, available_copy_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11021,17 +11529,7 @@ namespace LegionRuntime {
     FenceOp* Runtime::get_available_fence_op(void)
     //--------------------------------------------------------------------------
     {
-      FenceOp *result = NULL;
-      {
-        AutoLock f_lock(fence_op_lock);
-        if (!available_fence_ops.empty())
-        {
-          result = available_fence_ops.front();
-          available_fence_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<FenceOp>(this);
+      FenceOp *result = get_available(fence_op_lock, available_fence_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11043,17 +11541,7 @@ namespace LegionRuntime {
     FrameOp* Runtime::get_available_frame_op(void)
     //--------------------------------------------------------------------------
     {
-      FrameOp *result = NULL;
-      {
-        AutoLock f_lock(frame_op_lock);
-        if (!available_frame_ops.empty())
-        {
-          result = available_frame_ops.front();
-          available_frame_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<FrameOp>(this);
+      FrameOp *result = get_available(frame_op_lock, available_frame_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11065,17 +11553,8 @@ namespace LegionRuntime {
     DeletionOp* Runtime::get_available_deletion_op(void)
     //--------------------------------------------------------------------------
     {
-      DeletionOp *result = NULL;
-      {
-        AutoLock d_lock(deletion_op_lock);
-        if (!available_deletion_ops.empty())
-        {
-          result = available_deletion_ops.front();
-          available_deletion_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<DeletionOp>(this);
+      DeletionOp *result = 
+        get_available(deletion_op_lock, available_deletion_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11087,17 +11566,7 @@ namespace LegionRuntime {
     CloseOp* Runtime::get_available_close_op(void)
     //--------------------------------------------------------------------------
     {
-      CloseOp *result = NULL;
-      {
-        AutoLock c_lock(close_op_lock);
-        if (!available_close_ops.empty())
-        {
-          result = available_close_ops.front();
-          available_close_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<CloseOp>(this);
+      CloseOp *result = get_available(close_op_lock, available_close_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11109,17 +11578,8 @@ namespace LegionRuntime {
     FuturePredOp* Runtime::get_available_future_pred_op(void)
     //--------------------------------------------------------------------------
     {
-      FuturePredOp *result = NULL;
-      {
-        AutoLock f_lock(future_pred_op_lock);
-        if (!available_future_pred_ops.empty())
-        {
-          result = available_future_pred_ops.front();
-          available_future_pred_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<FuturePredOp>(this);
+      FuturePredOp *result = 
+        get_available(future_pred_op_lock, available_future_pred_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11131,17 +11591,8 @@ namespace LegionRuntime {
     NotPredOp* Runtime::get_available_not_pred_op(void)
     //--------------------------------------------------------------------------
     {
-      NotPredOp *result = NULL;
-      {
-        AutoLock n_lock(not_pred_op_lock);
-        if (!available_not_pred_ops.empty())
-        {
-          result = available_not_pred_ops.front();
-          available_not_pred_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<NotPredOp>(this);
+      NotPredOp *result = 
+        get_available(not_pred_op_lock, available_not_pred_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11153,17 +11604,8 @@ namespace LegionRuntime {
     AndPredOp* Runtime::get_available_and_pred_op(void)
     //--------------------------------------------------------------------------
     {
-      AndPredOp *result = NULL;
-      {
-        AutoLock a_lock(and_pred_op_lock);
-        if (!available_and_pred_ops.empty())
-        {
-          result = available_and_pred_ops.front();
-          available_and_pred_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<AndPredOp>(this);
+      AndPredOp *result = 
+        get_available(and_pred_op_lock, available_and_pred_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11175,17 +11617,7 @@ namespace LegionRuntime {
     OrPredOp* Runtime::get_available_or_pred_op(void)
     //--------------------------------------------------------------------------
     {
-      OrPredOp *result = NULL;
-      {
-        AutoLock o_lock(or_pred_op_lock);
-        if (!available_or_pred_ops.empty())
-        {
-          result = available_or_pred_ops.front();
-          available_or_pred_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<OrPredOp>(this);
+      OrPredOp *result = get_available(or_pred_op_lock, available_or_pred_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11197,17 +11629,7 @@ namespace LegionRuntime {
     AcquireOp* Runtime::get_available_acquire_op(void)
     //--------------------------------------------------------------------------
     {
-      AcquireOp *result = NULL;
-      {
-        AutoLock a_lock(acquire_op_lock);
-        if (!available_acquire_ops.empty())
-        {
-          result = available_acquire_ops.front();
-          available_acquire_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<AcquireOp>(this);
+      AcquireOp *result = get_available(acquire_op_lock, available_acquire_ops);
 #if defined(DEBUG_HIGH_LEVEL) || defined(HANG_TRACE)
       assert(result != NULL);
       {
@@ -11223,17 +11645,7 @@ namespace LegionRuntime {
     ReleaseOp* Runtime::get_available_release_op(void)
     //--------------------------------------------------------------------------
     {
-      ReleaseOp *result = NULL;
-      {
-        AutoLock r_lock(release_op_lock);
-        if (!available_release_ops.empty())
-        {
-          result = available_release_ops.front();
-          available_release_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<ReleaseOp>(this);
+      ReleaseOp *result = get_available(release_op_lock, available_release_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11245,17 +11657,8 @@ namespace LegionRuntime {
     TraceCaptureOp* Runtime::get_available_capture_op(void)
     //--------------------------------------------------------------------------
     {
-      TraceCaptureOp *result = NULL;
-      {
-        AutoLock c_lock(capture_op_lock);
-        if (!available_capture_ops.empty())
-        {
-          result = available_capture_ops.front();
-          available_capture_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<TraceCaptureOp>(this);
+      TraceCaptureOp *result = 
+        get_available(capture_op_lock, available_capture_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11267,17 +11670,8 @@ namespace LegionRuntime {
     TraceCompleteOp* Runtime::get_available_trace_op(void)
     //--------------------------------------------------------------------------
     {
-      TraceCompleteOp *result = NULL;
-      {
-        AutoLock t_lock(trace_op_lock);
-        if (!available_trace_ops.empty())
-        {
-          result = available_trace_ops.front();
-          available_trace_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<TraceCompleteOp>(this);
+      TraceCompleteOp *result = 
+        get_available(trace_op_lock, available_trace_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11289,17 +11683,7 @@ namespace LegionRuntime {
     MustEpochOp* Runtime::get_available_epoch_op(void)
     //--------------------------------------------------------------------------
     {
-      MustEpochOp *result = NULL;
-      {
-        AutoLock e_lock(epoch_op_lock);
-        if (!available_epoch_ops.empty())
-        {
-          result = available_epoch_ops.front();
-          available_epoch_ops.pop_front();
-        }
-      }
-      if (result == NULL)
-        result = legion_new<MustEpochOp>(this);
+      MustEpochOp *result = get_available(epoch_op_lock, available_epoch_ops);
 #ifdef DEBUG_HIGH_LEVEL
       assert(result != NULL);
 #endif
@@ -11311,44 +11695,52 @@ namespace LegionRuntime {
     void Runtime::free_individual_task(IndividualTask *task)
     //--------------------------------------------------------------------------
     {
-      AutoLock i_lock(individual_task_lock);
-      available_individual_tasks.push_front(task);
 #if defined(DEBUG_HIGH_LEVEL) || defined(HANG_TRACE)
-      out_individual_tasks.erase(task);
+      {
+        AutoLock i_lock(individual_task_lock);
+        out_individual_tasks.erase(task);
+      }
 #endif
+      release_operation(individual_task_lock, available_individual_tasks, task);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_point_task(PointTask *task)
     //--------------------------------------------------------------------------
     {
-      AutoLock p_lock(point_task_lock);
-      available_point_tasks.push_front(task);
 #if defined(DEBUG_HIGH_LEVEL) || defined(HANG_TRACE)
-      out_point_tasks.erase(task);
+      {
+        AutoLock p_lock(point_task_lock);
+        out_point_tasks.erase(task);
+      }
 #endif
+      release_operation(point_task_lock, available_point_tasks, task);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_index_task(IndexTask *task)
     //--------------------------------------------------------------------------
     {
-      AutoLock i_lock(index_task_lock);
-      available_index_tasks.push_front(task);
 #if defined(DEBUG_HIGH_LEVEL) || defined(HANG_TRACE)
-      out_index_tasks.erase(task);
+      {
+        AutoLock i_lock(index_task_lock);
+        out_index_tasks.erase(task);
+      }
 #endif
+      release_operation(index_task_lock, available_index_tasks, task);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_slice_task(SliceTask *task)
     //--------------------------------------------------------------------------
     {
-      AutoLock s_lock(slice_task_lock);
-      available_slice_tasks.push_front(task);
 #if defined(DEBUG_HIGH_LEVEL) || defined(HANG_TRACE)
-      out_slice_tasks.erase(task);
+      {
+        AutoLock s_lock(slice_task_lock);
+        out_slice_tasks.erase(task);
+      }
 #endif
+      release_operation(slice_task_lock, available_slice_tasks, task);
     }
 
     //--------------------------------------------------------------------------
@@ -11366,139 +11758,125 @@ namespace LegionRuntime {
         remote_contexts.erase(finder);
       }
       // Then we can put it back on the list of available remote tasks
-      AutoLock r_lock(remote_task_lock);
-      available_remote_tasks.push_front(task);
+      release_operation(remote_task_lock, available_remote_tasks, task);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_inline_task(InlineTask *task)
     //--------------------------------------------------------------------------
     {
-      AutoLock i_lock(inline_task_lock);
-      available_inline_tasks.push_front(task);
+      release_operation(inline_task_lock, available_inline_tasks, task);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_map_op(MapOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock m_lock(map_op_lock);
-      available_map_ops.push_front(op);
+      release_operation(map_op_lock, available_map_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_copy_op(CopyOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock c_lock(copy_op_lock);
-      available_copy_ops.push_front(op);
+      release_operation(copy_op_lock, available_copy_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_fence_op(FenceOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock f_lock(fence_op_lock);
-      available_fence_ops.push_front(op);
+      release_operation(fence_op_lock, available_fence_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_frame_op(FrameOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock f_lock(frame_op_lock);
-      available_frame_ops.push_back(op);
+      release_operation(frame_op_lock, available_frame_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_deletion_op(DeletionOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock d_lock(deletion_op_lock);
-      available_deletion_ops.push_front(op);
+      release_operation(deletion_op_lock, available_deletion_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_close_op(CloseOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock c_lock(close_op_lock);
-      available_close_ops.push_front(op);
+      release_operation(close_op_lock, available_close_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_future_predicate_op(FuturePredOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock f_lock(future_pred_op_lock);
-      available_future_pred_ops.push_front(op);
+      release_operation(future_pred_op_lock, available_future_pred_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_not_predicate_op(NotPredOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock n_lock(not_pred_op_lock);
-      available_not_pred_ops.push_front(op);
+      release_operation(not_pred_op_lock, available_not_pred_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_and_predicate_op(AndPredOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock a_lock(and_pred_op_lock);
-      available_and_pred_ops.push_front(op);
+      release_operation(and_pred_op_lock, available_and_pred_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_or_predicate_op(OrPredOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock o_lock(or_pred_op_lock);
-      available_or_pred_ops.push_front(op);
+      release_operation(or_pred_op_lock, available_or_pred_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_acquire_op(AcquireOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock a_lock(acquire_op_lock);
-      available_acquire_ops.push_front(op);
 #if defined(DEBUG_HIGH_LEVEL) || defined(HANG_TRACE)
-      out_acquire_ops.erase(op);
+      {
+        AutoLock a_lock(acquire_op_lock);
+        out_acquire_ops.erase(op);
+      }
 #endif
+      release_operation(acquire_op_lock, available_acquire_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_release_op(ReleaseOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock r_lock(release_op_lock);
-      available_release_ops.push_front(op);
+      release_operation(release_op_lock, available_release_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_capture_op(TraceCaptureOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock c_lock(capture_op_lock);
-      available_capture_ops.push_front(op);
+      release_operation(capture_op_lock, available_capture_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_trace_op(TraceCompleteOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock t_lock(trace_op_lock);
-      available_trace_ops.push_front(op);
+      release_operation(trace_op_lock, available_trace_ops, op);
     }
 
     //--------------------------------------------------------------------------
     void Runtime::free_epoch_op(MustEpochOp *op)
     //--------------------------------------------------------------------------
     {
-      AutoLock e_lock(epoch_op_lock);
-      available_epoch_ops.push_front(op);
+      release_operation(epoch_op_lock, available_epoch_ops, op);
     }
 
     //--------------------------------------------------------------------------
@@ -11916,6 +12294,12 @@ namespace LegionRuntime {
           return "Task Inline Tasks";
         case SEMANTIC_INFO_ALLOC:
           return "Semantic Information";
+        case OPERATION_EDGE_ALLOC:
+          return "Operation Edges";
+        case LOGICAL_STATE_ALLOC:
+          return "Logical States";
+        case PHYSICAL_STATE_ALLOC:
+          return "Physical States";
         default:
           assert(false); // should never get here
       }
@@ -12174,10 +12558,30 @@ namespace LegionRuntime {
                                       DEFAULT_SUPERSCALAR_WIDTH;
     /*static*/ unsigned Runtime::max_message_size = 
                                       DEFAULT_MAX_MESSAGE_SIZE;
+    /*static*/ unsigned Runtime::message_aggregation_bytes = 
+                                      DEFAULT_MESSAGE_AGGREGATION_BYTES;
+    /*static*/ unsigned Runtime::message_flush_deadline = 
+                                      DEFAULT_MESSAGE_FLUSH_DEADLINE;
+    /*static*/ bool Runtime::message_statistics = false;
     /*static*/ unsigned Runtime::max_filter_size = 
                                       DEFAULT_MAX_FILTER_SIZE;
+    /*static*/ unsigned Runtime::logical_index_threshold = 
+                                      DEFAULT_LOGICAL_INDEX_THRESHOLD;
+    /*static*/ unsigned Runtime::max_intersection_cache = 
+                                      DEFAULT_INTERSECTION_CACHE_SIZE;
+    /*static*/ unsigned Runtime::max_interference_colors = 
+                                      DEFAULT_MAX_INTERFERENCE_COLORS;
+    /*static*/ bool Runtime::footprint_statistics = false;
+    /*static*/ bool Runtime::dependence_statistics = false;
+    /*static*/ unsigned Runtime::flatten_depth = DEFAULT_FLATTEN_DEPTH;
+    /*static*/ unsigned Runtime::flatten_nodes = DEFAULT_FLATTEN_NODES;
+    /*static*/ bool Runtime::check_flat_plans = false;
+    /*static*/ bool Runtime::composite_statistics = false;
     /*static*/ unsigned Runtime::gc_epoch_size = 
                                       DEFAULT_GC_EPOCH_SIZE;
+    /*static*/ bool Runtime::gc_statistics = false;
+    /*static*/ unsigned Runtime::metrics_interval = 0;
+    /*static*/ const char* Runtime::metrics_file_prefix = NULL;
     /*static*/ bool Runtime::enable_imprecise_filter = false;
     /*static*/ bool Runtime::separate_runtime_instances = false;
     /*sattic*/ bool Runtime::stealing_disabled = false;
@@ -12207,6 +12611,10 @@ namespace LegionRuntime {
 #endif
 #ifdef LEGION_PROF
     /*static*/ int Runtime::num_profiling_nodes = -1;
+    /*static*/ const char* Runtime::profiling_file_prefix = NULL;
+#endif
+#ifdef LEGION_SPY
+    /*static*/ const char* Runtime::spy_file_prefix = NULL;
 #endif
 
 #ifdef HANG_TRACE
@@ -12279,8 +12687,23 @@ namespace LegionRuntime {
         initial_tasks_to_schedule = DEFAULT_MIN_TASKS_TO_SCHEDULE;
         superscalar_width = DEFAULT_SUPERSCALAR_WIDTH;
         max_message_size = DEFAULT_MAX_MESSAGE_SIZE;
+        message_aggregation_bytes = DEFAULT_MESSAGE_AGGREGATION_BYTES;
+        message_flush_deadline = DEFAULT_MESSAGE_FLUSH_DEADLINE;
+        message_statistics = false;
         max_filter_size = DEFAULT_MAX_FILTER_SIZE;
+        logical_index_threshold = DEFAULT_LOGICAL_INDEX_THRESHOLD;
+        max_intersection_cache = DEFAULT_INTERSECTION_CACHE_SIZE;
+        max_interference_colors = DEFAULT_MAX_INTERFERENCE_COLORS;
+        footprint_statistics = false;
+        dependence_statistics = false;
+        flatten_depth = DEFAULT_FLATTEN_DEPTH;
+        flatten_nodes = DEFAULT_FLATTEN_NODES;
+        check_flat_plans = false;
+        composite_statistics = false;
         gc_epoch_size = DEFAULT_GC_EPOCH_SIZE;
+        gc_statistics = false;
+        metrics_interval = 0;
+        metrics_file_prefix = NULL;
 #ifdef INORDER_EXECUTION
         program_order_execution = true;
 #endif
@@ -12289,6 +12712,10 @@ namespace LegionRuntime {
 #endif
 #ifdef LEGION_PROF
         num_profiling_nodes = -1;
+        profiling_file_prefix = NULL;
+#endif
+#ifdef LEGION_SPY
+        spy_file_prefix = NULL;
 #endif
 #ifdef DEBUG_HIGH_LEVEL
         logging_region_tree_state = false;
@@ -12305,6 +12732,12 @@ namespace LegionRuntime {
           BOOL_ARG("-hl:separate",separate_runtime_instances);
           BOOL_ARG("-hl:nosteal",stealing_disabled);
           BOOL_ARG("-hl:resilient",resilient_mode);
+          BOOL_ARG("-hl:msgstats",message_statistics);
+          BOOL_ARG("-hl:footprint",footprint_statistics);
+          BOOL_ARG("-hl:depstats",dependence_statistics);
+          BOOL_ARG("-hl:compstats",composite_statistics);
+          BOOL_ARG("-hl:flatcheck",check_flat_plans);
+          BOOL_ARG("-hl:gcstats",gc_statistics);
 #ifdef INORDER_EXECUTION
           if (!strcmp(argv[i],"-hl:outorder"))
             program_order_execution = false;
@@ -12314,8 +12747,21 @@ namespace LegionRuntime {
           INT_ARG("-hl:sched", initial_tasks_to_schedule);
           INT_ARG("-hl:width", superscalar_width);
           INT_ARG("-hl:message",max_message_size);
+          INT_ARG("-hl:aggregate",message_aggregation_bytes);
+          INT_ARG("-hl:msgdeadline",message_flush_deadline);
           INT_ARG("-hl:filter", max_filter_size);
+          INT_ARG("-hl:userindex", logical_index_threshold);
+          INT_ARG("-hl:intercache", max_intersection_cache);
+          INT_ARG("-hl:interference", max_interference_colors);
+          INT_ARG("-hl:flatdepth", flatten_depth);
+          INT_ARG("-hl:flatnodes", flatten_nodes);
           INT_ARG("-hl:epoch", gc_epoch_size);
+          INT_ARG("-hl:metrics", metrics_interval);
+          if (!strcmp(argv[i],"-hl:metricsfile"))
+          {
+            metrics_file_prefix = argv[++i];
+            continue;
+          }
 #ifdef DYNAMIC_TESTS
           if (!strcmp(argv[i],"-hl:no_dyn"))
             dynamic_independence_tests = false;
@@ -12346,6 +12792,11 @@ namespace LegionRuntime {
 #endif
 #ifdef LEGION_PROF
           INT_ARG("-hl:prof", num_profiling_nodes);
+          if (!strcmp(argv[i],"-hl:proffile"))
+          {
+            profiling_file_prefix = argv[++i];
+            continue;
+          }
 #else
           if (!strcmp(argv[i],"-hl:prof"))
           {
@@ -12354,6 +12805,21 @@ namespace LegionRuntime {
                                   "with the -DLEGION_PROF flag to enable "
                                   "profiling.");
           }
+#endif
+#ifdef LEGION_SPY
+          if (!strcmp(argv[i],"-hl:spyfile"))
+          {
+            spy_file_prefix = argv[++i];
+            continue;
+          }
+#else
+          if (!strcmp(argv[i],"-hl:spyfile"))
+          {
+            log_run(LEVEL_WARNING,"WARNING: Legion Spy is disabled.  The "
+                                  "-hl:spyfile flag will be ignored.  "
+                                  "Recompile with the -DLEGION_SPY flag "
+                                  "to enable Legion Spy logging.");
+          }
 #endif
         }
 #undef INT_ARG
@@ -13330,16 +13796,29 @@ namespace LegionRuntime {
           {
             const GarbageCollectionEpoch::GarbageCollectionArgs *collect_args =
               (const GarbageCollectionEpoch::GarbageCollectionArgs*)args;
-            bool done = collect_args->epoch->handle_collection(collect_args);
-            if (done)
-              delete collect_args->epoch;
+            collect_args->epoch->handle_collection();
+            delete collect_args->epoch;
             break;
           }
         case HLR_TRIGGER_DEPENDENCE_ID:
           {
             const ProcessorManager::DeferredTriggerArgs *deferred_trigger_args =
               (const ProcessorManager::DeferredTriggerArgs*)args;
-            deferred_trigger_args->op->trigger_dependence_analysis();
+            Metrics::ScopedTimer timer(
+                Metrics::METRIC_DEPENDENCE_ANALYSIS_TIME);
+            if (dependence_statistics)
+            {
+              unsigned long long start = 
+                TimeStamp::get_current_time_in_micros();
+              deferred_trigger_args->op->trigger_dependence_analysis();
+              unsigned long long stop = 
+                TimeStamp::get_current_time_in_micros();
+              deferred_trigger_args->manager->record_dependence_analysis(
+                  deferred_trigger_args->shard, 
+                  deferred_trigger_args->enqueue_time, start, stop);
+            }
+            else
+              deferred_trigger_args->op->trigger_dependence_analysis();
             break;
           }
         case HLR_TRIGGER_OP_ID:
@@ -13348,9 +13827,14 @@ namespace LegionRuntime {
             const ProcessorManager::TriggerOpArgs *trigger_args = 
                             (const ProcessorManager::TriggerOpArgs*)args;
             Operation *op = trigger_args->op;
-            bool mapped = op->trigger_execution();
+            bool mapped;
+            {
+              Metrics::ScopedTimer timer(Metrics::METRIC_MAPPING_TIME);
+              mapped = op->trigger_execution();
+            }
             if (!mapped)
             {
+              Metrics::increment(Metrics::METRIC_MAPPING_RETRIES);
               ProcessorManager *manager = trigger_args->manager;
               manager->add_to_local_ready_queue(op, true/*failure*/);
             }
@@ -13362,9 +13846,14 @@ namespace LegionRuntime {
             const ProcessorManager::TriggerTaskArgs *trigger_args = 
                           (const ProcessorManager::TriggerTaskArgs*)args;
             TaskOp *op = trigger_args->op; 
-            bool mapped = op->trigger_execution();
+            bool mapped;
+            {
+              Metrics::ScopedTimer timer(Metrics::METRIC_MAPPING_TIME);
+              mapped = op->trigger_execution();
+            }
             if (!mapped)
             {
+              Metrics::increment(Metrics::METRIC_MAPPING_RETRIES);
               ProcessorManager *manager = trigger_args->manager;
               manager->add_to_ready_queue(op, true/*failure*/);
             }
@@ -13456,6 +13945,22 @@ namespace LegionRuntime {
             resolve_args->future_pred_op->remove_predicate_reference();
             break;
           }
+        case HLR_MESSAGE_FLUSH_ID:
+          {
+            const MessageManager::MessageFlushArgs *flush_args = 
+              (const MessageManager::MessageFlushArgs*)args;
+            Runtime::get_runtime(p)->find_messenger(
+                flush_args->remote_space)->flush_aggregated_messages();
+            break;
+          }
+        case HLR_PARTITION_INTERFERENCE_ID:
+          {
+            const IndexPartNode::InterferenceArgs *inter_args = 
+              (const IndexPartNode::InterferenceArgs*)args;
+            inter_args->node->compute_interference_rows(inter_args->start,
+                                                        inter_args->stop);
+            break;
+          }
         case HLR_MPI_RANK_ID:
           {
             MPIRankArgs *margs = (MPIRankArgs*)args;
@@ -13532,6 +14037,15 @@ namespace LegionRuntime {
     }
 #endif
 
+    /////////////////////////////////////////////////////////////
+    // Legion Node Cache 
+    /////////////////////////////////////////////////////////////
+
+    /*static*/ __thread LegionNodeCache::FreeNode* 
+      LegionNodeCache::free_nodes[LegionNodeCache::NUM_SIZE_CLASSES];
+    /*static*/ __thread unsigned 
+      LegionNodeCache::num_free_nodes[LegionNodeCache::NUM_SIZE_CLASSES];
+
   }; // namespace HighLevel
 }; // namespace LegionRuntime
 
@@ -415,6 +415,35 @@ namespace LegionRuntime {
         HLRTaskID hlr_id;
         ProcessorManager *manager;
         Operation *op;
+        // Only used when gathering dependence statistics
+        RegionTreeID shard;
+        unsigned long long enqueue_time;
+      };
+      // Dependence analysis for a context is sharded by region
+      // tree so that operations on different trees can be analyzed
+      // in parallel while still being in program order per tree
+      struct DependenceShards {
+      public:
+        DependenceShards(void) : barrier(Event::NO_EVENT) { }
+      public:
+        // Last operation that had to be ordered with everything
+        Event barrier;
+        // Last operation on each region tree since the barrier
+        std::map<RegionTreeID,Event> tree_preconditions;
+      };
+      struct DependenceStatistics {
+      public:
+        DependenceStatistics(void)
+          : analyzed(0), pending(0), max_pending(0), total_wait(0),
+            total_analysis(0), max_analysis(0) { }
+      public:
+        unsigned long long analyzed;
+        unsigned long long pending;
+        unsigned long long max_pending;
+        // All times in microseconds
+        unsigned long long total_wait;
+        unsigned long long total_analysis;
+        unsigned long long max_analysis;
       };
       struct TriggerOpArgs {
       public:
@@ -511,11 +540,24 @@ namespace LegionRuntime {
       void process_advertisement(Processor advertiser, MapperID mid);
     public:
       void add_to_dependence_queue(Operation *op);
+      void record_dependence_analysis(RegionTreeID shard, 
+                                      unsigned long long enqueue_time,
+                                      unsigned long long start_time,
+                                      unsigned long long stop_time);
+      void report_dependence_statistics(void);
       void add_to_ready_queue(TaskOp *op, bool previous_failure);
       void add_to_local_ready_queue(Operation *op, bool previous_failure);
     public:
       // Mapper introspection methods
       unsigned sample_unmapped_tasks(MapperID map_id);
+    public:
+      // Caches of recycled operations for this processor
+      template<typename T>
+      inline T* find_cached_operation(void);
+      template<typename T>
+      inline unsigned cache_operation(T *op, T **overflow);
+      template<typename T>
+      inline void fill_operation_cache(T **ops, unsigned num_ops);
 #ifdef HANG_TRACE
     public:
       void dump_state(FILE *target);
@@ -541,7 +583,10 @@ namespace LegionRuntime {
     protected:
       // Dependence analysis state
       Reservation dependence_lock;
-      std::vector<Event> dependence_preconditions;
+      std::vector<DependenceShards> dependence_shards;
+      // Keyed by region tree, zero for operations ordered with everything
+      // and operations on several trees count against the lowest one
+      std::map<RegionTreeID,DependenceStatistics> dependence_stats;
     protected:
       // Local queue state
       Reservation local_queue_lock;
@@ -584,6 +629,11 @@ namespace LegionRuntime {
       // Reservations for stealing and thieving
       Reservation stealing_lock;
       Reservation thieving_lock;
+    protected:
+      // Recycled operations owned by this processor indexed by the
+      // allocation type of each operation class
+      ImmovableLock op_cache_lock;
+      std::vector<Operation*> op_caches[LAST_ALLOC];
     };
 
     /**
@@ -621,6 +671,7 @@ namespace LegionRuntime {
       // Method for mapper introspection
       size_t sample_allocated_space(void);
       size_t sample_free_space(void);
+      size_t sample_largest_free_block(void);
       unsigned sample_allocated_instances(void);
     protected:
       // The memory that we are managing
@@ -724,6 +775,7 @@ namespace LegionRuntime {
         SEND_FIELD_SEMANTIC_INFO,
         SEND_LOGICAL_REGION_SEMANTIC_INFO,
         SEND_LOGICAL_PARTITION_SEMANTIC_INFO,
+        LAST_MESSAGE_KIND, // must be last
       };
       // Implement a three-state state-machine for sending
       // messages.  Either fully self-contained messages
@@ -734,6 +786,38 @@ namespace LegionRuntime {
         PARTIAL_MESSAGE,
         FINAL_MESSAGE,
       };
+      // The flush task names its manager by address space rather than
+      // by pointer and looks it up when it runs
+      struct MessageFlushArgs {
+      public:
+        HLRTaskID hlr_id;
+        AddressSpaceID remote_space;
+      };
+      // Counters for profiling the message traffic to one node
+      struct KindStatistics {
+      public:
+        KindStatistics(void)
+          : messages(0), bytes(0), batched_messages(0) { }
+      public:
+        unsigned long long messages;
+        unsigned long long bytes;
+        // Sum over messages of the size of the batch they went in
+        unsigned long long batched_messages;
+      };
+      struct MessageStatistics {
+      public:
+        MessageStatistics(void)
+          : active_messages(0), total_batched(0), max_batch(0),
+            requested_flushes(0), full_flushes(0), deadline_flushes(0) { }
+      public:
+        KindStatistics kinds[LAST_MESSAGE_KIND];
+        unsigned long long active_messages;
+        unsigned long long total_batched;
+        unsigned long long max_batch;
+        unsigned long long requested_flushes;
+        unsigned long long full_flushes;
+        unsigned long long deadline_flushes;
+      };
     public:
       MessageManager(AddressSpaceID remote, 
                      Runtime *rt, size_t max,
@@ -805,9 +889,18 @@ namespace LegionRuntime {
     public:
       // Receiving message method
       void process_message(const void *args, size_t arglen);
+    public:
+      // Called by the background task that flushes aggregated messages
+      // once the previous message to the node has been handled
+      void flush_aggregated_messages(void);
+      void get_statistics(MessageStatistics &stats);
+      void report_statistics(void);
+      static const char* get_message_kind_name(MessageKind kind);
     private:
+      void launch_flush_task(void);
       void package_message(Serializer &rez, MessageKind k, bool flush);
-      void send_message(bool complete);
+      void send_message(bool complete, 
+                        const char *payload = NULL, size_t payload_size = 0);
       void handle_messages(unsigned num_messages, 
                            const char *args, size_t arglen);
       void buffer_messages(unsigned num_messages,
@@ -827,9 +920,16 @@ namespace LegionRuntime {
       MessageHeader header;
       unsigned packaged_messages;
       bool partial;
+      // When the oldest unsent message in the buffer was packaged
+      // (zero if nothing is waiting) and whether a flush task is out
+      unsigned long long pending_since;
+      bool flush_task_launched;
+      MessageStatistics stats;
+      unsigned pending_kinds[LAST_MESSAGE_KIND];
       // State for receiving messages
       // No lock for receiving messages since we know
-      // that they are ordered
+      // that they are ordered.  The receiving buffer is only
+      // held while a chain of partial messages is arriving.
       char *receiving_buffer;
       unsigned receiving_index;
       size_t receiving_buffer_size;
@@ -838,7 +938,9 @@ namespace LegionRuntime {
 
     /**
      * \class GarbageCollectionEpoch
-     * A class for managing the a set of garbage collections
+     * A class for managing the a set of garbage collections.
+     * All the collections in an epoch are done by a single
+     * runtime task once all of their events have triggered.
      */
     class GarbageCollectionEpoch {
     public:
@@ -846,7 +948,6 @@ namespace LegionRuntime {
       public:
         HLRTaskID hlr_id;
         GarbageCollectionEpoch *epoch;
-        LogicalView *view;
       };
     public:
       GarbageCollectionEpoch(Runtime *runtime);
@@ -857,11 +958,12 @@ namespace LegionRuntime {
     public:
       void add_collection(LogicalView *view, Event term_event);
       void launch(Processor utility, int priority);
-      bool handle_collection(const GarbageCollectionArgs *args);
+      void handle_collection(void);
     private:
       Runtime *const runtime;
-      int remaining;
       std::map<LogicalView*,std::set<Event> > collections;
+      unsigned total_events;
+      unsigned long long launch_time;
     };
 
     /**
@@ -1239,6 +1341,7 @@ namespace LegionRuntime {
       // Mapper introspection methods
       size_t sample_allocated_space(Memory mem);
       size_t sample_free_space(Memory mem);
+      size_t sample_largest_free_block(Memory mem);
       unsigned sample_allocated_instances(Memory mem);
       unsigned sample_unmapped_tasks(Processor proc, Mapper *mapper);
     public:
@@ -1504,9 +1607,36 @@ namespace LegionRuntime {
       Future::Impl* find_future(DistributedID did);
       Future::Impl* find_or_create_future(DistributedID did,
                                           AddressSpaceID owner_space);
+    public:
+      // Pooled buffers for reassembling large messages
+      char* acquire_message_buffer(size_t needed, size_t &actual);
+      void release_message_buffer(char *buffer, size_t size);
     public:
       void defer_collect_user(LogicalView *view, Event term_event);
       void complete_gc_epoch(GarbageCollectionEpoch *epoch);
+    public:
+      // Accounting for garbage collection epochs
+      struct GCStatistics {
+      public:
+        GCStatistics(void)
+          : epochs(0), views(0), events(0), max_events(0), 
+            total_latency(0), max_latency(0), users_reclaimed(0),
+            views_deleted(0), bytes_reclaimed(0) { }
+      public:
+        unsigned long long epochs;
+        unsigned long long views;
+        unsigned long long events;
+        unsigned long long max_events;
+        unsigned long long total_latency;
+        unsigned long long max_latency;
+        unsigned long long users_reclaimed;
+        unsigned long long views_deleted;
+        unsigned long long bytes_reclaimed;
+      };
+      void record_gc_epoch(size_t views, size_t events, 
+                           unsigned long long latency, size_t users, 
+                           size_t deleted, size_t bytes);
+      void report_gc_statistics(void);
     public:
       void initiate_runtime_shutdown(void);
     public:
@@ -1553,6 +1683,13 @@ namespace LegionRuntime {
       void free_capture_op(TraceCaptureOp *op);
       void free_trace_op(TraceCompleteOp *op);
       void free_epoch_op(MustEpochOp *op);
+    protected:
+      ProcessorManager* find_local_manager(void) const;
+      template<typename T>
+      inline T* get_available(Reservation reservation, std::deque<T*> &queue);
+      template<typename T>
+      inline void release_operation(Reservation reservation,
+                                    std::deque<T*> &queue, T *op);
     public:
       RemoteTask* find_or_init_remote_context(UniqueID uid); 
       bool is_local(Processor proc) const;
@@ -1684,6 +1821,7 @@ namespace LegionRuntime {
       LegionContainer<GarbageCollectionEpoch*,
                       RUNTIME_GC_EPOCH_ALLOC>::set pending_gc_epochs;
       unsigned gc_epoch_counter;
+      GCStatistics gc_stats;
     protected:
       // Keep track of futures
       Reservation future_lock;
@@ -1695,6 +1833,12 @@ namespace LegionRuntime {
       Reservation remote_lock;
       LegionKeyValue<UniqueID,RemoteTask*,
                      RUNTIME_REMOTE_ALLOC>::map remote_contexts;
+    protected:
+      // Free buffers for reassembling messages by size class, the
+      // smallest class is the maximum message size and each class 
+      // after that doubles in size
+      ImmovableLock message_buffer_lock;
+      std::vector<std::vector<char*> > message_buffers;
 #ifdef TRACE_ALLOCATION
     protected:
       struct AllocationTracker {
@@ -1853,8 +1997,23 @@ namespace LegionRuntime {
       static unsigned initial_tasks_to_schedule;
       static unsigned superscalar_width;
       static unsigned max_message_size;
+      static unsigned message_aggregation_bytes;
+      static unsigned message_flush_deadline;
+      static bool message_statistics;
       static unsigned max_filter_size;
+      static unsigned logical_index_threshold;
+      static unsigned max_intersection_cache;
+      static unsigned max_interference_colors;
+      static bool footprint_statistics;
+      static bool dependence_statistics;
+      static unsigned flatten_depth;
+      static unsigned flatten_nodes;
+      static bool check_flat_plans;
+      static bool composite_statistics;
       static unsigned gc_epoch_size;
+      static bool gc_statistics;
+      static unsigned metrics_interval;
+      static const char *metrics_file_prefix;
       static bool enable_imprecise_filter;
       static bool separate_runtime_instances;
       static bool stealing_disabled;
@@ -1887,6 +2046,11 @@ namespace LegionRuntime {
 #ifdef LEGION_PROF
     public:
       static int num_profiling_nodes;
+      static const char *profiling_file_prefix;
+#endif
+#ifdef LEGION_SPY
+    public:
+      static const char *spy_file_prefix;
 #endif
     public:
       // The baseline time for profiling
@@ -201,12 +201,15 @@ LOW_RUNTIME_SRC	+= $(LG_RT_DIR)/lowlevel.cc
 ifeq ($(strip $(USE_CUDA)),1)
 LOW_RUNTIME_SRC += $(LG_RT_DIR)/lowlevel_gpu.cc
 endif
-LOW_RUNTIME_SRC += $(LG_RT_DIR)/activemsg.cc $(LG_RT_DIR)/lowlevel_dma.cc
+LOW_RUNTIME_SRC += $(LG_RT_DIR)/activemsg.cc $(LG_RT_DIR)/lowlevel_dma.cc \
+		   $(LG_RT_DIR)/lowlevel_alloc.cc
 GPU_RUNTIME_SRC +=
 else
 CC_FLAGS	+= -DSHARED_LOWLEVEL
 LOW_RUNTIME_SRC	+= $(LG_RT_DIR)/shared_lowlevel.cc 
 endif
+# Metrics are recorded by both the low-level and high-level runtimes
+LOW_RUNTIME_SRC	+= $(LG_RT_DIR)/metrics.cc
 
 # If you want to go back to using the shared mapper, comment out the next line
 # and uncomment the one after that
@@ -224,6 +227,7 @@ HIGH_RUNTIME_SRC += $(LG_RT_DIR)/legion.cc \
 		    $(LG_RT_DIR)/legion_tasks.cc \
 		    $(LG_RT_DIR)/legion_trace.cc \
 		    $(LG_RT_DIR)/legion_spy.cc \
+		    $(LG_RT_DIR)/legion_profiling.cc \
 		    $(LG_RT_DIR)/region_tree.cc \
 		    $(LG_RT_DIR)/runtime.cc \
 		    $(LG_RT_DIR)/garbage_collection.cc
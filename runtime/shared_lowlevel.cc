@@ -17,6 +17,7 @@
 #include "lowlevel.h"
 #include "accessor.h"
 #include "legion_logging.h"
+#include "metrics.h"
 
 #ifndef __GNUC__
 #include "atomics.h" // for __sync_fetch_and_add
@@ -34,6 +35,7 @@ using namespace LegionRuntime::Accessor;
 #include <list>
 #include <deque>
 #include <vector>
+#include <algorithm>
 
 #include <pthread.h>
 #include <errno.h>
@@ -707,29 +709,51 @@ namespace LegionRuntime {
       wait(true);
     }
 
+    // counters for the merges we managed to avoid - reported at shutdown
+    //  with -ll:mergestats
+    struct MergeStats {
+      long merges_requested;
+      long merges_elided;
+      long inputs_requested;
+      long inputs_elided;
+    };
+    static MergeStats merge_stats = { 0, 0, 0, 0 };
+    static bool show_merge_stats = false;
+
+    static void note_merge(size_t requested, size_t remaining)
+    {
+      __sync_fetch_and_add(&merge_stats.merges_requested, 1L);
+      __sync_fetch_and_add(&merge_stats.inputs_requested, (long)requested);
+      __sync_fetch_and_add(&merge_stats.inputs_elided, 
+                           (long)(requested - remaining));
+      if (remaining < 2)
+        __sync_fetch_and_add(&merge_stats.merges_elided, 1L);
+    }
+
+    static void report_merge_stats(FILE *f)
+    {
+      const MergeStats &s = merge_stats;
+      fprintf(f,"EVENT MERGE STATISTICS:\n");
+      fprintf(f,"  merges requested: %ld (%ld elided, %ld built)\n",
+              s.merges_requested, s.merges_elided,
+              s.merges_requested - s.merges_elided);
+      fprintf(f,"  inputs requested: %ld (%ld elided)\n",
+              s.inputs_requested, s.inputs_elided);
+    }
+
     Event Event::merge_events(Event ev1, Event ev2, Event ev3,
                               Event ev4, Event ev5, Event ev6)
     {
-      std::set<Event> wait_for;
-      if (ev1.exists()) wait_for.insert(ev1);
-      if (ev2.exists()) wait_for.insert(ev2);
-      if (ev3.exists()) wait_for.insert(ev3);
-      if (ev4.exists()) wait_for.insert(ev4);
-      if (ev5.exists()) wait_for.insert(ev5);
-      if (ev6.exists()) wait_for.insert(ev6);
-
-      if (wait_for.empty())
-        return Event::NO_EVENT;
-      else if (wait_for.size() == 1)
-        return *(wait_for.begin());
-      else
-        return merge_events(wait_for);
+      Event wait_for[6] = { ev1, ev2, ev3, ev4, ev5, ev6 };
+      return merge_events(wait_for, 6);
     }
 
     Event Event::merge_events(const std::set<Event>& wait_for)
     {
         DetailedTimer::ScopedPush sp(TIME_LOW_LEVEL);
         size_t wait_for_size = wait_for.size();
+        note_merge(wait_for_size, 
+                   wait_for_size - wait_for.count(Event::NO_EVENT));
         // Ignore any no-events
         // Fast-outs for cases where there is 0 or 1 existing events
         if (wait_for.find(Event::NO_EVENT) != wait_for.end())
@@ -787,6 +811,40 @@ namespace LegionRuntime {
 	return e->merge_events(wait_for_impl);
     }
 
+    Event Event::merge_events(const Event *wait_for, size_t num_events)
+    {
+        DetailedTimer::ScopedPush sp(TIME_LOW_LEVEL);
+        // Drop any no-events, triggered events, and duplicates before
+        // we go build a map of the implementations
+        std::vector<Event> pending;
+        pending.reserve(num_events);
+        for (size_t idx = 0; idx < num_events; idx++)
+        {
+          if (!wait_for[idx].exists() || wait_for[idx].has_triggered())
+            continue;
+          pending.push_back(wait_for[idx]);
+        }
+        std::sort(pending.begin(), pending.end());
+        pending.erase(std::unique(pending.begin(), pending.end()), 
+                      pending.end());
+        note_merge(num_events, pending.size());
+        // Fast-outs for cases where there is 0 or 1 events left
+        if (pending.empty())
+          return Event::NO_EVENT;
+        if (pending.size() == 1)
+          return pending[0];
+        // Get a new event
+	EventImpl *e = Runtime::get_runtime()->get_free_event();
+        std::map<EventImpl*,Event> wait_for_impl;
+        for (std::vector<Event>::const_iterator it = pending.begin();
+              it != pending.end(); it++)
+        {
+          EventImpl *src_impl = Runtime::get_runtime()->get_event_impl(*it);
+          wait_for_impl.insert(std::pair<EventImpl*,Event>(src_impl,*it));
+        }
+	return e->merge_events(wait_for_impl);
+    }
+
     bool EventImpl::has_triggered(EventGeneration needed_gen)
     {
 	bool result = false;
@@ -1653,6 +1711,30 @@ namespace LegionRuntime {
 	return p->spawn(func_id, args, arglen, wait_on, priority);
     }
 
+    Event Processor::spawn(Processor::TaskFuncID func_id,
+                           const std::vector<ArgSpan>& arg_spans,
+                           Event wait_on, int priority) const
+    {
+        DetailedTimer::ScopedPush sp(TIME_LOW_LEVEL);
+        // tasks copy their arguments anyway so gather them here
+        size_t arglen = 0;
+        for (std::vector<ArgSpan>::const_iterator it = arg_spans.begin();
+              it != arg_spans.end(); it++)
+          arglen += it->second;
+        char *args = (char*)malloc(arglen);
+        size_t offset = 0;
+        for (std::vector<ArgSpan>::const_iterator it = arg_spans.begin();
+              it != arg_spans.end(); it++)
+        {
+          memcpy(args+offset, it->first, it->second);
+          offset += it->second;
+        }
+	ProcessorImpl *p = Runtime::get_runtime()->get_processor_impl(*this);
+	Event result = p->spawn(func_id, args, arglen, wait_on, priority);
+        free(args);
+        return result;
+    }
+
     Processor Processor::get_utility_processor(void) const
     {
         DetailedTimer::ScopedPush sp(TIME_LOW_LEVEL);
@@ -2218,7 +2300,8 @@ namespace LegionRuntime {
     class MemoryImpl {
     public:
 	MemoryImpl(size_t max, Memory::Kind k) 
-		: max_size(max), remaining(max), kind(k)
+		: max_size(max), remaining(max), kind(k),
+                  peak_used(0), num_allocs(0), num_failed(0)
 	{
                 mutex = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
 		PTHREAD_SAFE_CALL(pthread_mutex_init(mutex,NULL));
@@ -2234,11 +2317,13 @@ namespace LegionRuntime {
 	void free_space(void *ptr, size_t size);
         size_t total_space(void) const;  
         Memory::Kind get_kind(void) const;
+        void get_alloc_stats(Machine::MemoryAllocStats &stats);
     private:
 	const size_t max_size;
 	size_t remaining;
 	pthread_mutex_t *mutex;
         const Memory::Kind kind;
+        size_t peak_used, num_allocs, num_failed;
     };
 
     size_t MemoryImpl::remaining_bytes(void) 
@@ -2260,8 +2345,20 @@ namespace LegionRuntime {
 #ifdef DEBUG_LOW_LEVEL
 		assert(ptr != NULL);
 #endif
+                num_allocs++;
+                if ((max_size - remaining) > peak_used)
+                  peak_used = max_size - remaining;
 	}
+        else
+          num_failed++;
 	PTHREAD_SAFE_CALL(pthread_mutex_unlock(mutex));
+        if (ptr != NULL)
+        {
+          Metrics::increment(Metrics::METRIC_ALLOCATIONS);
+          Metrics::adjust(Metrics::METRIC_ALLOCATED_BYTES, size);
+        }
+        else
+          Metrics::increment(Metrics::METRIC_FAILED_ALLOCATIONS);
 	return ptr;
     }
 
@@ -2274,6 +2371,23 @@ namespace LegionRuntime {
 	remaining += size;
 	free(ptr);
 	PTHREAD_SAFE_CALL(pthread_mutex_unlock(mutex));
+        Metrics::adjust(Metrics::METRIC_ALLOCATED_BYTES, -(long long)size);
+    }
+
+    void MemoryImpl::get_alloc_stats(Machine::MemoryAllocStats &stats)
+    {
+	PTHREAD_SAFE_CALL(pthread_mutex_lock(mutex));
+        stats.total_bytes = max_size;
+        stats.used_bytes = max_size - remaining;
+        stats.peak_used_bytes = peak_used;
+        stats.free_bytes = remaining;
+        // space comes from malloc, so as far as we can tell whatever is
+        // left is one contiguous block
+        stats.largest_free_block = remaining;
+        stats.num_free_blocks = (remaining > 0) ? 1 : 0;
+        stats.num_allocs = num_allocs;
+        stats.num_failed_allocs = num_failed;
+	PTHREAD_SAFE_CALL(pthread_mutex_unlock(mutex));
     }
 
     size_t MemoryImpl::total_space(void) const
@@ -4607,6 +4721,7 @@ namespace LegionRuntime {
         // If we have a copy perform it and then delete it
         if (copy != NULL)
         {
+          Metrics::ScopedTimer timer(Metrics::METRIC_DMA_TIME);
           copy->perform_copy_operation();
           delete copy;
         }
@@ -4705,6 +4820,11 @@ namespace LegionRuntime {
           INT_ARG("-ll:dma", num_dma_threads);
           INT_ARG("-ll:stack",cpu_stack_size);
 #undef INT_ARG
+          if (!strcmp((*argv)[i], "-ll:mergestats"))
+          {
+            show_merge_stats = true;
+            continue;
+          }
         }
         cpu_stack_size = cpu_stack_size * (1 << 20);
 
@@ -5020,9 +5140,12 @@ namespace LegionRuntime {
           PTHREAD_SAFE_CALL(pthread_join(other_threads[id],&result));
       }
       Runtime::dma_queue->shutdown();
+      if (show_merge_stats)
+        report_merge_stats(stdout);
 #ifdef ORDERED_LOGGING 
       Logger::finalize();
 #endif
+      Logger::finalize_async_logging();
       // Once we're done with this, then we can exit with a successful error code
       exit(0);
     }
@@ -5067,6 +5190,13 @@ namespace LegionRuntime {
         return Runtime::runtime->get_memory_impl(m)->total_space();
     }
 
+    bool Machine::get_memory_alloc_stats(Memory m, 
+                                         MemoryAllocStats &stats) const
+    {
+        Runtime::runtime->get_memory_impl(m)->get_alloc_stats(stats);
+        return true;
+    }
+
     size_t Machine::get_address_space_count(void) const
     {
         return 1;
@@ -5579,6 +5709,8 @@ namespace LegionRuntime {
     int len = strlen(buffer);
     vsnprintf(buffer+len, 399-len, fmt, args);
     strcat(buffer, "\n");
+    if (async_log(buffer, strlen(buffer)))
+      return;
 #ifdef ORDERED_LOGGING 
     // Update the length to reflect the newline character
     len = strlen(buffer);
@@ -29,7 +29,9 @@
 #include <map>
 #include <vector>
 #include <pthread.h>
+#include <sched.h>
 #include <time.h>
+#include <sys/time.h>
 
 #include <fcntl.h>
 
@@ -71,6 +73,23 @@ enum {
 //#define DETAILED_TIMING
 
 namespace LegionRuntime {
+  /**
+   * \struct LogStagingBuffer
+   * Ring buffer of formatted log lines for one thread when the
+   * asynchronous logger is enabled.  The owning thread is the only
+   * producer and the flusher thread is the only consumer, so neither
+   * side takes a lock.
+   */
+  struct LogStagingBuffer {
+  public:
+    char *data;
+    size_t capacity; // power of 2
+    // monotonically increasing byte counts, wrapped on access
+    volatile size_t head, tail;
+    unsigned long long dropped, stalls, late;
+    LogStagingBuffer *next;
+  };
+
   /**
    * A logger class for tracking everything from debug messages
    * to error messages.
@@ -128,7 +147,243 @@ namespace LegionRuntime {
     // Need a finalize if we have a log file
     static void finalize(void);
 #endif
-    static void init(int argc, const char *argv[])
+    // The asynchronous backend (-logfile <prefix>) has each thread
+    // format into its own LogStagingBuffer and a flusher thread
+    // write the buffers out to <prefix>_<node>.log in batches.  Lines
+    // from one thread stay in order but lines from different threads
+    // are only ordered to within a flush interval.  A full buffer
+    // either blocks the thread until the flusher catches up or, with
+    // -logdrop, drops the line and counts it.  Once the logger starts
+    // shutting down the flusher is gone, so every later line is
+    // written straight to the file behind anything its thread had
+    // already staged.
+    struct AsyncState {
+    public:
+      bool enabled;
+      bool drop_when_full;
+      size_t buffer_size;
+      const char *prefix;
+      FILE *file;
+      pthread_t flusher;
+      pthread_mutex_t lock;
+      pthread_cond_t wakeup;
+      pthread_key_t buffer_key;
+      LogStagingBuffer *volatile buffers;
+      volatile bool shutdown;
+    };
+    static AsyncState& get_async_state(void)
+    {
+      static AsyncState state = { false, false, (64 << 10), NULL, NULL,
+        pthread_t(), PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+        pthread_key_t(), NULL, false };
+      return state;
+    }
+    // How often the flusher wakes up on its own in microseconds
+    static const unsigned async_flush_interval = 10000;
+    static void start_async_logging(int node)
+    {
+      AsyncState &state = get_async_state();
+      // round the buffers up to a power of 2
+      size_t size = 4096;
+      while (size < state.buffer_size)
+        size <<= 1;
+      state.buffer_size = size;
+      char file_name[1024];
+      snprintf(file_name, sizeof(file_name), "%s_%d.log", state.prefix, node);
+      state.file = fopen(file_name, "w");
+      if (state.file == NULL)
+      {
+        fprintf(stderr, "unable to open log file '%s'!\n", file_name);
+        exit(1);
+      }
+      pthread_key_create(&state.buffer_key, NULL);
+      state.shutdown = false;
+      pthread_create(&state.flusher, NULL, async_flusher_loop, NULL);
+      state.enabled = true;
+    }
+    static LogStagingBuffer* get_staging_buffer(void)
+    {
+      AsyncState &state = get_async_state();
+      LogStagingBuffer *buffer = 
+        (LogStagingBuffer*)pthread_getspecific(state.buffer_key);
+      if (buffer != NULL)
+        return buffer;
+      buffer = (LogStagingBuffer*)malloc(sizeof(LogStagingBuffer));
+      buffer->data = (char*)malloc(state.buffer_size);
+      assert(buffer->data != NULL);
+      buffer->capacity = state.buffer_size;
+      buffer->head = 0;
+      buffer->tail = 0;
+      buffer->dropped = 0;
+      buffer->stalls = 0;
+      buffer->late = 0;
+      // Buffers live until the logger is finalized so the flusher
+      // never has to worry about threads going away
+      LogStagingBuffer *old_head;
+      do {
+        old_head = state.buffers;
+        buffer->next = old_head;
+      } while (!__sync_bool_compare_and_swap(&state.buffers, old_head, buffer));
+      pthread_setspecific(state.buffer_key, buffer);
+      return buffer;
+    }
+    // Must be holding the async state lock
+    static void drain_staging_buffer(LogStagingBuffer *buffer)
+    {
+      AsyncState &state = get_async_state();
+      const size_t end = buffer->head;
+      __sync_synchronize();
+      const size_t start = buffer->tail;
+      if (start == end)
+        return;
+      const size_t first = start & (buffer->capacity - 1);
+      const size_t bytes = end - start;
+      if ((first + bytes) <= buffer->capacity)
+        fwrite(buffer->data + first, 1, bytes, state.file);
+      else
+      {
+        fwrite(buffer->data + first, 1, buffer->capacity - first, state.file);
+        fwrite(buffer->data, 1, bytes - (buffer->capacity - first), 
+               state.file);
+      }
+      __sync_synchronize();
+      buffer->tail = end;
+    }
+    // Must be holding the async state lock
+    static void drain_staging_buffers(void)
+    {
+      AsyncState &state = get_async_state();
+      for (LogStagingBuffer *buffer = state.buffers; 
+            buffer != NULL; buffer = buffer->next)
+        drain_staging_buffer(buffer);
+      fflush(state.file);
+    }
+    // Write a line straight to the file, after whatever the thread
+    // has already staged so that its lines stay in order
+    static void write_through(LogStagingBuffer *buffer, 
+                              const char *line, size_t len)
+    {
+      AsyncState &state = get_async_state();
+      pthread_mutex_lock(&state.lock);
+      drain_staging_buffer(buffer);
+      if (len > 0)
+        fwrite(line, 1, len, state.file);
+      fflush(state.file);
+      pthread_mutex_unlock(&state.lock);
+    }
+    // Returns false if the asynchronous backend isn't enabled
+    static inline bool async_log(const char *line, size_t len)
+    {
+      AsyncState &state = get_async_state();
+      if (!state.enabled)
+        return false;
+      LogStagingBuffer *buffer = get_staging_buffer();
+      if (state.shutdown)
+      {
+        buffer->late++;
+        write_through(buffer, line, len);
+        return true;
+      }
+      if (len > buffer->capacity)
+      {
+        // Too big to ever fit
+        write_through(buffer, line, len);
+        return true;
+      }
+      if ((buffer->head + len - buffer->tail) > buffer->capacity)
+      {
+        if (state.drop_when_full)
+        {
+          buffer->dropped++;
+          return true;
+        }
+        buffer->stalls++;
+        while (((buffer->head + len - buffer->tail) > buffer->capacity) &&
+               !state.shutdown)
+        {
+          pthread_cond_signal(&state.wakeup);
+          sched_yield();
+        }
+        // The flusher won't be coming back to make room
+        if (state.shutdown)
+        {
+          buffer->late++;
+          write_through(buffer, line, len);
+          return true;
+        }
+      }
+      const size_t first = buffer->head & (buffer->capacity - 1);
+      if ((first + len) <= buffer->capacity)
+        memcpy(buffer->data + first, line, len);
+      else
+      {
+        const size_t split = buffer->capacity - first;
+        memcpy(buffer->data + first, line, split);
+        memcpy(buffer->data, line + split, len - split);
+      }
+      // Make the line visible before publishing it
+      __sync_synchronize();
+      buffer->head += len;
+      // If shutdown started while the line was being staged, the final
+      // drain may already have passed this buffer, so drain it here
+      __sync_synchronize();
+      if (state.shutdown)
+        write_through(buffer, NULL, 0);
+      else if ((buffer->head - buffer->tail) > (buffer->capacity >> 1))
+        pthread_cond_signal(&state.wakeup);
+      return true;
+    }
+    static void* async_flusher_loop(void *args)
+    {
+      AsyncState &state = get_async_state();
+      pthread_mutex_lock(&state.lock);
+      while (!state.shutdown)
+      {
+        drain_staging_buffers();
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        unsigned long long wake_us = now.tv_usec + async_flush_interval;
+        struct timespec deadline;
+        deadline.tv_sec = now.tv_sec + (wake_us / 1000000);
+        deadline.tv_nsec = (wake_us % 1000000) * 1000;
+        pthread_cond_timedwait(&state.wakeup, &state.lock, &deadline);
+      }
+      pthread_mutex_unlock(&state.lock);
+      return NULL;
+    }
+    // Call once every thread that logs has stopped.  The file stays
+    // open afterwards and any straggling lines are written through.
+    static void finalize_async_logging(void)
+    {
+      AsyncState &state = get_async_state();
+      if (!state.enabled || state.shutdown)
+        return;
+      pthread_mutex_lock(&state.lock);
+      state.shutdown = true;
+      pthread_cond_signal(&state.wakeup);
+      pthread_mutex_unlock(&state.lock);
+      pthread_join(state.flusher, NULL);
+      pthread_mutex_lock(&state.lock);
+      drain_staging_buffers();
+      unsigned long long dropped = 0, stalls = 0, late = 0;
+      for (LogStagingBuffer *buffer = state.buffers; 
+            buffer != NULL; buffer = buffer->next)
+      {
+        dropped += buffer->dropped;
+        stalls += buffer->stalls;
+        late += buffer->late;
+      }
+      if (dropped > 0)
+        fprintf(state.file, "logger: dropped %llu messages on full buffers\n",
+                dropped);
+      fflush(state.file);
+      if ((dropped > 0) || (stalls > 0) || (late > 0))
+        fprintf(stderr, "logger: %llu messages dropped, %llu stalls on "
+                "full buffers, %llu messages logged during shutdown\n", 
+                dropped, stalls, late);
+      pthread_mutex_unlock(&state.lock);
+    }
+    static void init(int argc, const char *argv[], int node = 0)
     {
 #ifdef ORDERED_LOGGING 
       get_log_file(); // Initializes the log file
@@ -150,6 +405,21 @@ namespace LegionRuntime {
           continue;
         }
 
+        if(!strcmp(argv[i], "-logfile")) {
+          get_async_state().prefix = argv[++i];
+          continue;
+        }
+
+        if(!strcmp(argv[i], "-logbuf")) {
+          get_async_state().buffer_size = ((size_t)atoi(argv[++i])) << 10;
+          continue;
+        }
+
+        if(!strcmp(argv[i], "-logdrop")) {
+          get_async_state().drop_when_full = true;
+          continue;
+        }
+
         if(!strcmp(argv[i], "-cat")) {
           const char *p = argv[++i];
 
@@ -198,6 +468,8 @@ namespace LegionRuntime {
         }
       printf("\n");
 #endif
+      if(get_async_state().prefix != NULL)
+        start_async_logging(node);
     } 
 
     static inline void log(LogLevel level, int category, const char *fmt, ...)
@@ -494,6 +766,16 @@ namespace LegionRuntime {
       unsigned long long result = (((unsigned long long) spec.tv_sec) * 1000000) + (((unsigned long long)spec.tv_nsec) / 1000);
       return result;
     }
+    static inline unsigned long long get_current_time_in_nanos(void)
+    {
+      mach_timespec_t spec;
+      clock_serv_t cclock;
+      host_get_clock_service(mach_host_self(), CALENDAR_CLOCK, &cclock);
+      clock_get_time(cclock, &spec);
+      mach_port_deallocate(mach_task_self(), cclock);
+      unsigned long long result = (((unsigned long long) spec.tv_sec) * 1000000000) + ((unsigned long long)spec.tv_nsec);
+      return result;
+    }
   private:
     double get_diff_us(mach_timespec_t &start, mach_timespec_t &stop)
     {
@@ -0,0 +1,535 @@
+#!/usr/bin/env python
+
+# Copyright 2014 Stanford University
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Critical path analysis over a Legion Spy event graph weighted with the
+# times recorded by Legion Prof.  Operations and copies are joined to the
+# events that precede and follow them exactly as Legion Spy draws them, and
+# every operation is charged with the runtime analysis Legion Prof saw for
+# its unique IDs (including the slices and index launch of a point task),
+# the time it sat ready but not yet running, and its execution.  The
+# longest weighted path through the resulting graph is the critical path.
+
+import sys, os, tempfile
+from getopt import getopt
+import spy_parser, spy_analysis
+import legion_prof
+
+# Categories of time charged to each node, the first three are runtime overhead
+DEPENDENCE_TIME = 0
+MAPPING_TIME = 1
+SCHEDULER_TIME = 2
+READY_TIME = 3
+EXECUTION_TIME = 4
+NUM_TIME_KINDS = 5
+
+time_kind_names = ['dependence analysis', 'mapping', 'scheduler',
+                   'ready to start', 'execution']
+
+def range_time(time_range):
+    if time_range is None:
+        return 0
+    return time_range.cummulative_time()
+
+def spy_op_kind(op):
+    if isinstance(op, spy_analysis.SingleTask):
+        return 'Task'
+    if isinstance(op, spy_analysis.Mapping):
+        return 'Inline Mapping'
+    if isinstance(op, spy_analysis.CopyOp):
+        return 'Copy Op'
+    if isinstance(op, spy_analysis.AcquireOp):
+        return 'Acquire'
+    if isinstance(op, spy_analysis.ReleaseOp):
+        return 'Release'
+    if isinstance(op, spy_analysis.Close):
+        return 'Close'
+    if isinstance(op, spy_analysis.Copy):
+        return 'Copy'
+    return type(op).__name__
+
+class CriticalNode(object):
+    def __init__(self, spy_op, prof_ops, launch_ops):
+        self.spy_op = spy_op
+        # Records for the operation's own unique IDs, the first one is
+        # used to name it
+        self.prof_ops = prof_ops
+        self.prof_op = prof_ops[0] if len(prof_ops) > 0 else None
+        # Records for the slices and index launch of a point task
+        self.launch_ops = launch_ops
+        self.times = [0] * NUM_TIME_KINDS
+        # Points of an index space launch all wait on the analysis done
+        # once for the whole launch and on the slices that distributed
+        # them, so each point is charged all of it
+        for prof_op in prof_ops + launch_ops:
+            self.times[DEPENDENCE_TIME] += range_time(prof_op.dependence_range)
+            self.times[MAPPING_TIME] += range_time(prof_op.premap_range) + \
+                                       range_time(prof_op.mapping_range) + \
+                                       range_time(prof_op.post_range)
+            # Trigger ranges wrap the premapping, mapping, and triggering
+            # of slices done inside them, only count what is left over
+            for trigger in prof_op.trigger_ranges:
+                self.times[SCHEDULER_TIME] += trigger.non_cummulative_time()
+        # Time spent blocked inside the task is covered by the
+        # dependences on whatever it was waiting for.  A parent task
+        # runs alongside its children and its termination already
+        # waits on theirs, so only leaf tasks are charged execution.
+        execution = self.execution_range()
+        if execution is not None and not self.is_parent():
+            self.times[EXECUTION_TIME] = \
+                max(0, range_time(execution) - self.prof_op.waiting_time())
+        self.weight = sum(self.times)
+        # Filled in by the analysis
+        self.earliest_start = 0
+        self.latest_start = 0
+        self.critical_pred = None
+
+    def execution_range(self):
+        if self.prof_op is None:
+            return None
+        return self.prof_op.execution_range
+
+    def set_ready_time(self, ready):
+        # Once its preconditions have triggered and it has been mapped an
+        # operation can run, any delay after that before its execution
+        # began was spent waiting for a processor or for the scheduler
+        execution = self.execution_range()
+        if ready is None or execution is None or self.is_parent():
+            return
+        if self.prof_op.mapping_range is not None:
+            ready = max(ready, self.prof_op.mapping_range.end_event.abs_time)
+        self.times[READY_TIME] = max(0, execution.start_event.abs_time - ready)
+        self.weight = sum(self.times)
+
+    def finish_time(self, ready):
+        # When the operation actually finished, untimed operations such
+        # as low-level copies are assumed to finish as soon as they are ready
+        if self.prof_op is None:
+            return ready
+        if self.prof_op.execution_range is not None:
+            return self.prof_op.execution_range.end_event.abs_time
+        if self.prof_op.mapping_range is not None:
+            return self.prof_op.mapping_range.end_event.abs_time
+        return ready
+
+    def is_parent(self):
+        return len(getattr(self.spy_op, 'ops', [])) > 0
+
+    def is_timed(self):
+        return (len(self.prof_ops) + len(self.launch_ops)) > 0
+
+    def overhead(self):
+        return self.times[DEPENDENCE_TIME] + self.times[MAPPING_TIME] + \
+               self.times[SCHEDULER_TIME]
+
+    def slack(self):
+        return self.latest_start - self.earliest_start
+
+    def __repr__(self):
+        if self.prof_op is not None:
+            if self.is_parent():
+                return '%s %s (parent)' % (spy_op_kind(self.spy_op), repr(self.prof_op))
+            return '%s %s' % (spy_op_kind(self.spy_op), repr(self.prof_op))
+        name = getattr(self.spy_op, 'name', None)
+        if isinstance(self.spy_op, spy_analysis.Copy):
+            return 'Copy %s (untimed)' % self.spy_op.uid
+        if name is not None:
+            return '%s %s (UID %s, untimed)' % \
+                    (spy_op_kind(self.spy_op), name, self.spy_op.uid)
+        return '%s (UID %s, untimed)' % (spy_op_kind(self.spy_op), self.spy_op.uid)
+
+class CriticalPathAnalysis(object):
+    def __init__(self, spy_state, prof_state):
+        self.spy_state = spy_state
+        self.prof_state = prof_state
+        # Maps Legion Spy events, operations, and copies to their
+        # successors, operations and copies also have a CriticalNode
+        self.successors = dict()
+        self.predecessors = dict()
+        self.nodes = dict()
+        self.order = list()
+        self.ignored_edges = 0
+        self.length = 0
+        self.last = None
+        self.pred_of = dict()
+        # Points that moved between nodes are known by more than one
+        # unique ID, Legion Spy maps all of them to the same operation
+        self.op_uids = dict()
+        for uid,op in spy_state.ops.iteritems():
+            if op not in self.op_uids:
+                self.op_uids[op] = list()
+            self.op_uids[op].append(uid)
+
+    def launch_uids(self, uid):
+        # The slices an index space point was distributed through, then
+        # the index launch itself
+        result = list()
+        slice_id = self.spy_state.point_slice.get(uid)
+        while slice_id is not None:
+            result.append(slice_id)
+            if slice_id in self.spy_state.slice_slice:
+                slice_id = self.spy_state.slice_slice[slice_id]
+            else:
+                result.append(self.spy_state.slice_index[slice_id])
+                slice_id = None
+        return result
+
+    def add_op(self, op):
+        if op.start_event is None or op.term_event is None:
+            return False
+        prof_ops = list()
+        launch_ops = list()
+        if not isinstance(op, spy_analysis.Copy):
+            uids = sorted(self.op_uids.get(op, [op.uid]))
+            # The operation's own ID first so the node is named after it
+            if op.uid in uids:
+                uids.remove(op.uid)
+                uids.insert(0, op.uid)
+            launch = list()
+            for uid in uids:
+                if uid in self.prof_state.unique_ops:
+                    prof_ops.append(self.prof_state.unique_ops[uid])
+                for launch_uid in self.launch_uids(uid):
+                    if launch_uid not in launch:
+                        launch.append(launch_uid)
+            for uid in launch:
+                if uid in self.prof_state.unique_ops:
+                    launch_ops.append(self.prof_state.unique_ops[uid])
+        self.nodes[op] = CriticalNode(op, prof_ops, launch_ops)
+        return True
+
+    def add_edge(self, src, dst):
+        if src not in self.successors:
+            self.successors[src] = list()
+        self.successors[src].append(dst)
+        if dst not in self.predecessors:
+            self.predecessors[dst] = list()
+        self.predecessors[dst].append(src)
+
+    def is_vertex(self, item):
+        if isinstance(item, spy_analysis.Event):
+            return item.handle.exists()
+        return item in self.nodes
+
+    def build_graph(self):
+        for op in self.spy_state.ops.itervalues():
+            if hasattr(op, 'term_event'):
+                self.add_op(op)
+        for copy in self.spy_state.copies:
+            self.add_op(copy)
+        for op in self.nodes.iterkeys():
+            if op.term_event.handle.exists():
+                self.add_edge(op, op.term_event)
+        # Implicit dependences tie children to the start and
+        # termination of their parent task
+        for event in self.spy_state.events.itervalues():
+            if not event.handle.exists():
+                continue
+            for succ in event.physical_outgoing:
+                if self.is_vertex(succ):
+                    self.add_edge(event, succ)
+            for succ in event.implicit_outgoing:
+                if self.is_vertex(succ):
+                    self.add_edge(event, succ)
+
+    def sort_graph(self):
+        # Iterative depth first search so long chains of events do not
+        # exhaust the Python stack, edges back into the search are cycles
+        # from phase barrier generations and are ignored
+        visiting = set()
+        visited = set()
+        postorder = list()
+        for root in self.spy_state.events.values() + self.nodes.keys():
+            if root in visited or not self.is_vertex(root):
+                continue
+            stack = [(root, iter(self.successors.get(root, [])))]
+            visiting.add(root)
+            while len(stack) > 0:
+                item,succs = stack[-1]
+                advanced = False
+                for succ in succs:
+                    if succ in visiting:
+                        self.ignored_edges += 1
+                        self.successors[item].remove(succ)
+                        self.predecessors[succ].remove(item)
+                        # Restart the iterator over the updated list
+                        stack[-1] = (item, iter(self.successors[item]))
+                        advanced = True
+                        break
+                    if succ in visited:
+                        continue
+                    visiting.add(succ)
+                    stack.append((succ, iter(self.successors.get(succ, []))))
+                    advanced = True
+                    break
+                if not advanced:
+                    stack.pop()
+                    visiting.remove(item)
+                    visited.add(item)
+                    postorder.append(item)
+        postorder.reverse()
+        self.order = postorder
+
+    def weight(self, item):
+        if item in self.nodes:
+            return self.nodes[item].weight
+        return 0
+
+    def compute_ready_times(self):
+        # Replay the run with the recorded timestamps: an item is ready
+        # once the last of its predecessors has actually finished
+        finish = dict()
+        for item in self.order:
+            ready = None
+            for pred in self.predecessors.get(item, []):
+                if finish[pred] is not None and \
+                    (ready is None or finish[pred] > ready):
+                    ready = finish[pred]
+            if item in self.nodes:
+                node = self.nodes[item]
+                node.set_ready_time(ready)
+                finish[item] = node.finish_time(ready)
+            else:
+                finish[item] = ready
+
+    def compute_times(self):
+        earliest = dict()
+        pred_of = dict()
+        for item in self.order:
+            start = 0
+            best = None
+            for pred in self.predecessors.get(item, []):
+                finish = earliest[pred] + self.weight(pred)
+                if best is None or finish > start:
+                    start = finish
+                    best = pred
+            earliest[item] = start
+            pred_of[item] = best
+            finish = start + self.weight(item)
+            if self.last is None or finish > self.length:
+                self.length = finish
+                self.last = item
+        latest = dict()
+        for item in reversed(self.order):
+            finish = self.length
+            for succ in self.successors.get(item, []):
+                if latest[succ] < finish:
+                    finish = latest[succ]
+            latest[item] = finish - self.weight(item)
+        for op,node in self.nodes.iteritems():
+            node.earliest_start = earliest[op]
+            node.latest_start = latest[op]
+            node.critical_pred = pred_of[op]
+        self.pred_of = pred_of
+
+    def critical_path(self):
+        path = list()
+        item = self.last
+        while item is not None:
+            if item in self.nodes:
+                path.append(self.nodes[item])
+            item = self.pred_of[item]
+        path.reverse()
+        return path
+
+    def analyze(self):
+        self.build_graph()
+        self.sort_graph()
+        self.compute_ready_times()
+        self.compute_times()
+        if self.ignored_edges > 0:
+            print 'WARNING: Ignored %d event dependences that form cycles' % \
+                    self.ignored_edges
+
+    def observed_time(self):
+        first = None
+        last = None
+        for node in self.nodes.itervalues():
+            for op in node.prof_ops + node.launch_ops:
+                for time_range in [op.dependence_range, op.premap_range,
+                                   op.mapping_range, op.execution_range,
+                                   op.post_range] + op.trigger_ranges:
+                    if time_range is None:
+                        continue
+                    if first is None or time_range.start_event.abs_time < first:
+                        first = time_range.start_event.abs_time
+                    if last is None or time_range.end_event.abs_time > last:
+                        last = time_range.end_event.abs_time
+        if first is None:
+            return 0
+        return last - first
+
+    def print_critical_path(self):
+        path = self.critical_path()
+        print 'Critical Path (%d operations, %d us)' % (len(path), self.length)
+        print '  %10s %10s %10s %10s %10s %10s %10s  %s' % \
+                ('Start', 'Total', 'Depend', 'Mapping', 'Sched', 'Ready',
+                 'Execute', 'Operation')
+        for node in path:
+            print '  %10d %10d %10d %10d %10d %10d %10d  %s' % \
+                    (node.earliest_start, node.weight,
+                     node.times[DEPENDENCE_TIME], node.times[MAPPING_TIME],
+                     node.times[SCHEDULER_TIME], node.times[READY_TIME],
+                     node.times[EXECUTION_TIME], repr(node))
+        print ''
+
+    def print_breakdown(self):
+        path = self.critical_path()
+        totals = [0] * NUM_TIME_KINDS
+        untimed = 0
+        for node in path:
+            for kind in range(NUM_TIME_KINDS):
+                totals[kind] += node.times[kind]
+            if not node.is_timed():
+                untimed += 1
+        print 'Critical Path Breakdown'
+        print '  Observed time:          %10d us' % self.observed_time()
+        print '  Critical path length:   %10d us' % self.length
+        overhead = totals[DEPENDENCE_TIME] + totals[MAPPING_TIME] + \
+                   totals[SCHEDULER_TIME]
+        for kind in range(NUM_TIME_KINDS):
+            if kind == READY_TIME:
+                print '  Runtime overhead:       %10d us (%.2f%%)' % \
+                        (overhead, self.percent(overhead))
+            print '    %-22s%10d us (%.2f%%)' % \
+                    (time_kind_names[kind]+':', totals[kind],
+                     self.percent(totals[kind]))
+        if untimed > 0:
+            print '  %d operations on the critical path have no profiling ' \
+                  'data (copies are never timed)' % untimed
+        print ''
+
+    def percent(self, value):
+        if self.length == 0:
+            return 0.0
+        return 100.0 * value / self.length
+
+    def print_slack(self, limit):
+        nodes = sorted(self.nodes.values(),
+                       key=lambda n: (n.slack(), n.earliest_start))
+        print 'Operation Slack (%d operations)' % len(nodes)
+        print '  %10s %10s %10s %10s  %s' % \
+                ('Slack', 'Start', 'Total', 'Overhead', 'Operation')
+        if limit > 0:
+            nodes = nodes[:limit]
+        for node in nodes:
+            print '  %10d %10d %10d %10d  %s' % \
+                    (node.slack(), node.earliest_start, node.weight,
+                     node.overhead(), repr(node))
+        print ''
+
+def split_text_log(file_name):
+    # A single log captured with '-cat legion_spy,legion_prof' holds both
+    # kinds of lines, each parser wants a file of only its own lines
+    spy_lines = list()
+    prof_lines = list()
+    with open(file_name, 'r') as log:
+        for line in log:
+            if '{legion_spy}' in line:
+                spy_lines.append(line)
+            elif '{legion_prof}' in line:
+                prof_lines.append(line)
+    result = list()
+    for lines in [spy_lines, prof_lines]:
+        if len(lines) == 0:
+            result.append(None)
+            continue
+        fd,temp_name = tempfile.mkstemp(suffix='.log')
+        with os.fdopen(fd, 'w') as temp:
+            temp.writelines(lines)
+        result.append(temp_name)
+    return result
+
+def is_spy_binary_file(file_name):
+    with open(file_name, 'rb') as log:
+        return log.read(len(spy_parser.binary_magic)) == spy_parser.binary_magic
+
+def usage():
+    print 'Usage: '+sys.argv[0]+' [-n <count>] [-v] <file_name> [<file_name> ...]'
+    print '  -n <count> : number of operations to list by slack (default 20, 0 for all)'
+    print '  -v : verbose'
+    print 'Requires both Legion Spy and Legion Prof data from the same run, either'
+    print 'as binary files from -hl:spyfile and -hl:proffile or as text logs'
+    print 'captured with -cat legion_spy,legion_prof -level 2'
+    sys.exit(1)
+
+def main():
+    opts, args = getopt(sys.argv[1:],'n:v')
+    opts = dict(opts)
+    if len(args) < 1:
+        usage()
+    slack_limit = 20
+    verbose = False
+    if '-n' in opts:
+        slack_limit = int(opts['-n'])
+    if '-v' in opts:
+        verbose = True
+
+    spy_files = list()
+    prof_files = list()
+    temp_files = list()
+    for file_name in args:
+        if is_spy_binary_file(file_name):
+            spy_files.append(file_name)
+        elif legion_prof.is_binary_file(file_name):
+            prof_files.append(file_name)
+        else:
+            spy_name,prof_name = split_text_log(file_name)
+            if spy_name is not None:
+                spy_files.append(spy_name)
+                temp_files.append(spy_name)
+            if prof_name is not None:
+                prof_files.append(prof_name)
+                temp_files.append(prof_name)
+    try:
+        spy_state = spy_analysis.State(verbose)
+        spy_matches = spy_parser.parse_log_files(spy_files, spy_state)
+        prof_state = legion_prof.State()
+        prof_matches = 0
+        for file_name in prof_files:
+            if legion_prof.is_binary_file(file_name):
+                prof_matches += legion_prof.parse_binary_file(file_name, prof_state)
+            else:
+                prof_matches += legion_prof.parse_log_file(file_name, prof_state)
+    finally:
+        for file_name in temp_files:
+            os.remove(file_name)
+    if spy_matches == 0:
+        print 'No Legion Spy records found. Exiting...'
+        return
+    if prof_matches == 0:
+        print 'WARNING: No Legion Prof records found, only the structure ' \
+              'of the critical path will be reported'
+    else:
+        # Nest each processor's ranges so that the time a range spends in
+        # the ranges inside it can be told apart
+        prof_state.build_time_ranges()
+
+    analysis = CriticalPathAnalysis(spy_state, prof_state)
+    analysis.analyze()
+    ops = [n for n in analysis.nodes.itervalues()
+           if not isinstance(n.spy_op, spy_analysis.Copy)]
+    timed = len([n for n in ops if n.is_timed()])
+    print 'Joined %d of %d operations with profiling data ' \
+          '(%d low-level copies are never timed)' % \
+            (timed, len(ops), len(analysis.nodes) - len(ops))
+    print ''
+    analysis.print_critical_path()
+    analysis.print_breakdown()
+    analysis.print_slack(slack_limit)
+
+if __name__ == '__main__':
+    main()
@@ -16,7 +16,7 @@
 #
 
 import sys, os, shutil
-import string, re
+import string, re, struct
 from getopt import getopt
 
 prefix = r'\[(?P<node>[0-9]+) - (?P<thread>[0-9a-f]+)\] \{\w+\}\{legion_prof\}: '
@@ -31,6 +31,7 @@ event_pat = re.compile(prefix + r'Prof Event (?P<proc>[a-f0-9]+) (?P<kind>[0-9]+
 create_pat = re.compile(prefix + r'Prof Create Instance (?P<iid>[a-f0-9]+) (?P<mem>[0-9]+) (?P<redop>[0-9]+) (?P<bf>[0-9]+) (?P<time>[0-9]+)')
 field_pat = re.compile(prefix + r'Prof Instance Field (?P<iid>[a-f0-9]+) (?P<fid>[0-9]+) (?P<size>[0-9]+)')
 destroy_pat = re.compile(prefix + r'Prof Destroy Instance (?P<iid>[a-f0-9]+) (?P<time>[0-9]+)')
+intersection_pat = re.compile(prefix + r'Prof Intersection Cache (?P<hits>[0-9]+) (?P<misses>[0-9]+) (?P<evictions>[0-9]+) (?P<graph_hits>[0-9]+) (?P<graphs>[0-9]+)')
 
 # List of event kinds from legion_profiling.h
 event_kind_ids = {
@@ -1251,6 +1252,7 @@ class State(object):
         self.task_variants = {}
         self.unique_ops = {}
         self.instances = {}
+        self.intersection_stats = None
         self.last_time = None
 
     def create_processor(self, proc_id, utility, kind):
@@ -1350,6 +1352,12 @@ class State(object):
             self.instances[iid] = [Instance(iid)]
         self.instances[iid][-1].set_destroy(time)
 
+    def add_intersection_stats(self, hits, misses, evictions, graph_hits, graphs):
+        if self.intersection_stats is None:
+            self.intersection_stats = [0, 0, 0, 0, 0]
+        for idx,value in enumerate([hits, misses, evictions, graph_hits, graphs]):
+            self.intersection_stats[idx] += value
+
     def build_time_ranges(self):
         assert self.last_time is not None
 
@@ -1392,6 +1400,23 @@ class State(object):
         stat.print_stats(total_time, cummulative, verbose)
         print
 
+    def print_intersection_stats(self):
+        if self.intersection_stats is None:
+            return
+        hits, misses, evictions, graph_hits, graphs = self.intersection_stats
+        print '****************************************************'
+        print '   INTERSECTION CACHE STATS'
+        print '****************************************************'
+        queries = hits + misses
+        print '    Cache queries: %d' % queries
+        if queries > 0:
+            print '    Cache hits: %d (%.3f%%)' % (hits, 100.0*float(hits)/float(queries))
+            print '    Cache misses: %d (%.3f%%)' % (misses, 100.0*float(misses)/float(queries))
+        print '    Cache evictions: %d' % evictions
+        print '    Interference graphs built: %d' % graphs
+        print '    Interference graph lookups: %d' % graph_hits
+        print
+
     def generate_svg_picture(self, file_name, html_file):
         # Before doing this, generate all the colors
         num_variants = len(self.task_variants)
@@ -1519,10 +1544,20 @@ def parse_log_file(file_name, state):
                       iid = int(m.group('iid'),16),
                       time = long(m.group('time')))
                 continue
+            m = intersection_pat.match(line)
+            if m is not None:
+                state.add_intersection_stats(
+                      hits = long(m.group('hits')),
+                      misses = long(m.group('misses')),
+                      evictions = long(m.group('evictions')),
+                      graph_hits = long(m.group('graph_hits')),
+                      graphs = long(m.group('graphs')))
+                continue
             # If we made it here, then we failed to match.
             matches -= 1
             print 'Skipping line: %s' % line.strip()
-    state.last_time = last_time
+    if state.last_time is None or last_time > state.last_time:
+        state.last_time = last_time
     while len(replay_lines) > 0:
         to_delete = set()
         for line in replay_lines:
@@ -1567,21 +1602,142 @@ def parse_log_file(file_name, state):
             replay_lines.remove(line)
     return matches
 
+# Binary profiles (-hl:proffile) start with this magic string, followed by
+# the format version, the node, and the text layout of every record kind
+binary_magic = 'LGNPROF\0'
+binary_version = 1
+binary_types = { 'u16' : 'H', 'u32' : 'I', 'u64' : 'Q', 'i32' : 'i' }
+binary_record_header = struct.Struct('=HH')
+
+# Records that define things other records refer to
+binary_definition_records = set(['processor', 'memory', 'task_variant'])
+
+def is_binary_file(file_name):
+    with open(file_name, 'rb') as log:
+        return log.read(len(binary_magic)) == binary_magic
+
+def parse_binary_layouts(text):
+    layouts = dict()
+    for line in text.splitlines():
+        tokens = line.split()
+        if len(tokens) < 2:
+            continue
+        fields = list()
+        fmt = '='
+        has_str = False
+        for token in tokens[2:]:
+            name,kind = token.split(':')
+            if kind == 'str':
+                has_str = True
+            else:
+                fmt += binary_types[kind]
+            fields.append(name)
+        layouts[int(tokens[0])] = (tokens[1], struct.Struct(fmt), fields, has_str)
+    return layouts
+
+def apply_binary_record(state, name, args):
+    if name == 'processor':
+        args['utility'] = args['utility'] == 1
+        state.create_processor(**args)
+    elif name == 'memory':
+        state.create_memory(**args)
+    elif name == 'task_variant':
+        state.create_task_variant(**args)
+    elif name == 'unique_task':
+        state.create_unique_task(**args)
+    elif name == 'unique_map':
+        return state.create_unique_map(**args)
+    elif name == 'unique_close':
+        return state.create_unique_close(**args)
+    elif name == 'unique_copy':
+        return state.create_unique_copy(**args)
+    elif name == 'event':
+        return state.create_event(**args)
+    elif name == 'create_instance':
+        state.create_instance(**args)
+    elif name == 'instance_field':
+        state.add_instance_field(**args)
+    elif name == 'destroy_instance':
+        state.destroy_instance(**args)
+    elif name == 'intersection_cache':
+        state.add_intersection_stats(**args)
+    else:
+        print 'Skipping unknown record kind %s' % name
+    return True
+
+def parse_binary_file(file_name, state):
+    with open(file_name, 'rb') as log:
+        data = log.read()
+    pos = len(binary_magic)
+    version,node,layout_size = struct.unpack_from('=III', data, pos)
+    pos += 12
+    if version <> binary_version:
+        print 'ERROR: %s has binary profile version %d but this tool reads version %d' % \
+                (file_name, version, binary_version)
+        return 0
+    layouts = parse_binary_layouts(data[pos:pos+layout_size])
+    pos += layout_size
+    # Decode everything first, records from different processors are
+    # interleaved in the order their buffers were drained
+    definitions = list()
+    records = list()
+    last_time = 0L
+    while pos + binary_record_header.size <= len(data):
+        kind,size = binary_record_header.unpack_from(data, pos)
+        pos += binary_record_header.size
+        if pos + size > len(data):
+            print 'WARNING: %s ends with a truncated record' % file_name
+            break
+        if kind not in layouts:
+            print 'Skipping unknown record kind %d' % kind
+            pos += size
+            continue
+        name,layout,fields,has_str = layouts[kind]
+        values = list(layout.unpack_from(data, pos))
+        if has_str:
+            values.append(data[pos+layout.size:pos+size])
+        pos += size
+        args = dict(zip(fields, values))
+        if name in binary_definition_records:
+            definitions.append((name, args))
+        else:
+            records.append((name, args))
+        if name == 'event' and args['time'] > last_time:
+            last_time = args['time']
+    for name,args in definitions:
+        apply_binary_record(state, name, args)
+    replay = list()
+    for name,args in records:
+        if not apply_binary_record(state, name, args):
+            replay.append((name, args))
+    if state.last_time is None or last_time > state.last_time:
+        state.last_time = last_time
+    while len(replay) > 0:
+        remaining = list()
+        for name,args in replay:
+            if not apply_binary_record(state, name, args):
+                remaining.append((name, args))
+        if len(remaining) == len(replay):
+            print "ERROR: NO FORWARD PROGRESS ON REPLAY RECORDS!  BAD LEGION PROF ASSUMPTION!"
+            break
+        replay = remaining
+    return len(definitions) + len(records)
+
 def usage():
-    print 'Usage: '+sys.argv[0]+' [-c] [-p] [-v] <file_name>'
+    print 'Usage: '+sys.argv[0]+' [-c] [-p] [-v] <file_name> [<file_name> ...]'
     print '  -c : perform cummulative analysis'
     print '  -p : generate HTML and SVG files for pictures'
     print '  -v : print verbose profiling information'
     print '  -m <ppm> : set the micro-seconds per pixel for images (default %d)' % (US_PER_PIXEL)
     print '  -i : generate HTML and SVG files for memory pictures'
+    print 'Text logs and binary profiles (one per node) are detected automatically'
     sys.exit(1)
 
 def main():
     opts, args = getopt(sys.argv[1:],'cpvim:')
     opts = dict(opts)
-    if len(args) != 1:
+    if len(args) < 1:
         usage()
-    file_name = args[0]
     cummulative = False
     generate_pictures = False
     generate_instance = False
@@ -1602,10 +1758,18 @@ def main():
     mem_file_name = 'legion_prof_mem.svg'
     html_mem_file_name = 'legion_prof_mem.html'
 
-    print 'Loading log file %s...' % file_name
     state = State()
-    total_matches = parse_log_file(file_name, state)
-    print 'Matched %s lines' % total_matches
+    total_matches = 0
+    for file_name in args:
+        if is_binary_file(file_name):
+            print 'Loading binary profile %s...' % file_name
+            matches = parse_binary_file(file_name, state)
+            print 'Decoded %s records' % matches
+        else:
+            print 'Loading log file %s...' % file_name
+            matches = parse_log_file(file_name, state)
+            print 'Matched %s lines' % matches
+        total_matches += matches
     if total_matches == 0:
         print 'No matches. Exiting...'
         return
@@ -1621,6 +1785,9 @@ def main():
     # Print the per-task statistics
     state.print_task_stats(cummulative, verbose)
 
+    # Print the intersection cache statistics
+    state.print_intersection_stats()
+
     # Generate the svg profiling picture
     if generate_pictures:
         print 'Generating SVG execution profile in %s...' % svg_file_name
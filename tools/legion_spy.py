@@ -19,14 +19,14 @@ import subprocess
 import sys, os, shutil
 import string
 from getopt import getopt
-from spy_parser import parse_log_file
+from spy_parser import parse_log_files, summarize_log_files
 from spy_analysis import *
 #from spy_state import *
 
 temp_dir = ".cent/"
 
 def usage():
-    print "Usage: "+sys.argv[0]+" [-l -c -p -m -r -i -k -s -v -P] <file_name>"
+    print "Usage: "+sys.argv[0]+" [-l -c -p -m -r -i -k -s -v -P -t] <file_name>..."
     print "  -l : perform logical analyses"
     print "  -c : perform physical analyses"
     print "  -p : make task pictures"
@@ -35,17 +35,22 @@ def usage():
     print "  -v : verbose"
     print "  -P : make partition graphs"
     print "  -i : make instance graphs"
+    print "  -t : only count the records of each kind, no analyses"
+    print "Binary logs (-hl:spyfile) are read one block at a time, but every"
+    print "operation, event and instance is kept until the analysis ends, so"
+    print "memory use still grows with the length of the whole run.  Only"
+    print "-t runs in bounded memory."
     sys.exit(1)
 
 def main():
     if len(sys.argv) < 2:
         usage()
 
-    opts, args = getopt(sys.argv[1:],'lipckrmvsP')
+    opts, args = getopt(sys.argv[1:],'lipckrmvsPt')
     opts = dict(opts)
-    if len(args) <> 1:
+    if len(args) < 1:
         usage()
-    file_name = args[0]
+    file_names = args
 
     logical_checks = False
     physical_checks = False
@@ -57,6 +62,7 @@ def main():
     simplify_graphs = False 
     verbose = False
     make_partition_graphs = False
+    summarize_only = False
     for opt in opts:
         if opt == '-l':
             logical_checks = True
@@ -88,11 +94,20 @@ def main():
         if opt == '-P':
             make_partition_graphs = True
             continue
+        if opt == '-t':
+            summarize_only = True
+            continue
+
+    if summarize_only:
+        counts = summarize_log_files(file_names)
+        for kind in sorted(counts.keys()):
+            print '%10d %s' % (counts[kind], kind)
+        print 'Counted '+str(sum(counts.values()))+' records'
+        return
 
     state = State(verbose)
 
-    print 'Loading log file '+file_name+'...'
-    total_matches = parse_log_file(file_name, state)
+    total_matches = parse_log_files(file_names, state)
     print 'Matched '+str(total_matches)+' lines'
     if total_matches == 0:
         print 'No matches. Exiting...'
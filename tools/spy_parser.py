@@ -17,7 +17,7 @@
 
 #from spy_state import *
 from spy_analysis import *
-import sys, re
+import sys, re, struct
 
 # All of these calls are based on the print statements in legion_logging.h
 
@@ -274,6 +274,153 @@ def parse_log_line(line, state):
             return True
     return False
 
+# Binary logs (-hl:spyfile) start with this magic followed by the
+# version, node, event cache size and the record layouts
+binary_magic = 'LGNSPY\0\0'
+
+def parse_binary_layouts(text):
+    layouts = dict()
+    for line in text.splitlines():
+        fields = line.split()
+        kinds = [f.split(':')[1] for f in fields[2:]]
+        layouts[int(fields[0])] = (fields[1], kinds)
+    return layouts
+
+def read_varint(data, offset):
+    result = 0
+    shift = 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        result |= (byte & 0x7f) << shift
+        if byte < 0x80:
+            return result, offset
+        shift += 7
+
+def read_file_varint(log):
+    result = 0
+    shift = 0
+    while True:
+        byte = log.read(1)
+        if len(byte) == 0:
+            return None
+        byte = ord(byte)
+        result |= (byte & 0x7f) << shift
+        if byte < 0x80:
+            return result
+        shift += 7
+
+def decode_binary_block(data, layouts, cache, records):
+    offset = 0
+    while offset < len(data):
+        kind, offset = read_varint(data, offset)
+        name, kinds = layouts[kind]
+        args = list()
+        for field in kinds:
+            if field == 'e':
+                # Events go through the encoder's direct-mapped cache so
+                # the low bit says whether this is a hit on a known slot
+                slot, offset = read_varint(data, offset)
+                if (slot & 1) == 0:
+                    eid, offset = read_varint(data, offset)
+                    gen, offset = read_varint(data, offset)
+                    cache[slot >> 1] = (eid, gen)
+                args.extend(cache[slot >> 1])
+            elif field == 's':
+                length, offset = read_varint(data, offset)
+                args.append(str(data[offset:offset+length]))
+                offset += length
+            else:
+                value, offset = read_varint(data, offset)
+                args.append(value == 1 if field == 'b' else value)
+        records.append((name, args))
+
+def apply_binary_records(records, state):
+    # Returns the records that could not be applied yet
+    pending = list()
+    for record in records:
+        if not getattr(state, record[0])(*record[1]):
+            pending.append(record)
+    return pending
+
+def binary_record_blocks(log):
+    # Yields the records of a binary log one block at a time, the
+    # only records held in memory are those of the current block
+    version, node, cache_size, layout_size = struct.unpack('<4I', log.read(16))
+    layouts = parse_binary_layouts(log.read(layout_size))
+    cache = [(0,0)] * cache_size
+    while True:
+        size = read_file_varint(log)
+        if size is None:
+            break
+        data = bytearray(log.read(size))
+        records = list()
+        decode_binary_block(data, layouts, cache, records)
+        yield records
+    log.close()
+
+def parse_binary_file(log, state, pending):
+    matches = 0
+    # Besides the current block we only hold on to records that arrived
+    # ahead of something they depend on, but the state they are applied
+    # to keeps every operation, event and instance for the analyses, 
+    # which is what makes memory grow with the length of the run
+    for records in binary_record_blocks(log):
+        matches += len(records)
+        if len(pending) > 0:
+            pending[:] = apply_binary_records(pending, state)
+        pending.extend(apply_binary_records(records, state))
+    return matches
+
+def replay_binary_records(pending, state):
+    while len(pending) > 0:
+        remaining = apply_binary_records(pending, state)
+        if len(remaining) == len(pending):
+            print "ERROR: NO PROGRESS PARSING! BUG IN LEGION SPY LOGGING ASSUMPTIONS!"
+            for record in remaining:
+                print record
+            assert False
+        pending[:] = remaining
+
+def parse_log_files(file_names, state):
+    # Binary files from different nodes can refer to each other so
+    # records that are not ready yet carry over to the next file
+    matches = 0
+    pending = list()
+    for file_name in file_names:
+        print 'Loading log file '+file_name+'...'
+        log = open(file_name, 'rb')
+        if log.read(len(binary_magic)) == binary_magic:
+            matches += parse_binary_file(log, state, pending)
+        else:
+            log.close()
+            matches += parse_log_file(file_name, state)
+    replay_binary_records(pending, state)
+    return matches
+
+def summarize_log_files(file_names):
+    # Counts the records of each kind without building any state for
+    # the analyses, so unlike them this runs in bounded memory
+    counts = dict()
+    text_prefix = re.compile(prefix+"(?P<kind>[A-Za-z ]+)")
+    for file_name in file_names:
+        print 'Summarizing log file '+file_name+'...'
+        log = open(file_name, 'rb')
+        if log.read(len(binary_magic)) == binary_magic:
+            for records in binary_record_blocks(log):
+                for record in records:
+                    counts[record[0]] = counts.get(record[0], 0) + 1
+        else:
+            log.close()
+            log = open(file_name, 'r')
+            for line in log:
+                m = text_prefix.match(line)
+                if m <> None:
+                    kind = m.group('kind').strip()
+                    counts[kind] = counts.get(kind, 0) + 1
+            log.close()
+    return counts
+
 def parse_log_file(file_name, state):
     log = open(file_name, 'r')
     matches = 0